@@ -1,17 +1,20 @@
 #pragma once
 
 #include "nanovg.h"
+#include <vector>
+
+#ifdef _WIN32
 #include <windows.h>
 
 #include <DispatcherQueue.h>
 #include <windows.ui.composition.interop.h>
 
-#include <vector>
 #include <winrt/Windows.Foundation.Numerics.h>
 #include <winrt/Windows.System.h>
 #include <winrt/Windows.UI.Composition.Desktop.h>
 #include <winrt/Windows.UI.Composition.h>
 #include <winrt/base.h>
+#endif
 
 namespace ui {
 
@@ -25,6 +28,7 @@ struct acrylic_region {
     NVGcolor tint = nvgRGBAf(0, 0, 0, 0);
 };
 
+#ifdef _WIN32
 class acrylic_host {
 public:
     acrylic_host() = default;
@@ -73,5 +77,18 @@ private:
     std::vector<region_visual> region_visuals_{};
     bool visible_ = false;
 };
+#else
+// Acrylic is drawn by Windows composition, there is nothing to show it
+// with elsewhere
+class acrylic_host {
+public:
+    void update(void *, int, int, float, const std::vector<acrylic_region> &) {
+    }
+    void sync(void *, int, int, float) {}
+    void clear() {}
+    void hide() {}
+    void shutdown() {}
+};
+#endif
 
 } // namespace ui
@@ -5,7 +5,41 @@
 #include <numbers>
 #include <print>
 
+namespace {
+float eased_value(ui::easing_type easing, float from, float to,
+                  float progress) {
+    if (easing == ui::easing_type::linear) {
+        return std::lerp(from, to, progress);
+    } else if (easing == ui::easing_type::ease_in) {
+        return std::lerp(from, to, progress * progress);
+    } else if (easing == ui::easing_type::ease_out) {
+        return std::lerp(from, to, 1 - std::sqrt(1 - progress));
+    } else if (easing == ui::easing_type::ease_in_out) {
+        return std::lerp(from, to,
+                         (0.5f * std::sin(progress * std::numbers::pi -
+                                          std::numbers::pi / 2) +
+                          0.5f));
+    }
+    return to;
+}
+
+// Moving or resizing a widget is picked up from its bounds when damage is
+// collected, it doesn't mean that what it draws has changed
+bool changes_content(const ui::widget *owner, const ui::animated_float *anim) {
+    return anim != owner->x.get() && anim != owner->y.get() &&
+           anim != owner->width.get() && anim != owner->height.get();
+}
+void mark_for_repaint(ui::widget *owner, const ui::animated_float *anim) {
+    if (owner && changes_content(owner, anim))
+        owner->needs_repaint = true;
+}
+} // namespace
+
 void ui::animated_float::update(float delta_time) {
+    // The scheduler owns the state while the animation runs on it
+    if (_scheduler)
+        return;
+
     if (easing == easing_type::mutation) {
         if (destination != value || progress != 1.f) {
             value = destination;
@@ -46,19 +80,7 @@ void ui::animated_float::update(float delta_time) {
         return;
     }
 
-    if (easing == easing_type::linear) {
-        value = std::lerp(from, destination, progress);
-    } else if (easing == easing_type::ease_in) {
-        value = std::lerp(from, destination, progress * progress);
-    } else if (easing == easing_type::ease_out) {
-        value = std::lerp(from, destination, 1 - std::sqrt(1 - progress));
-    } else if (easing == easing_type::ease_in_out) {
-        value = std::lerp(from, destination,
-                          (0.5f * std::sin(progress * std::numbers::pi -
-                                           std::numbers::pi / 2) +
-                           0.5f));
-    }
-
+    value = eased_value(easing, from, destination, progress);
     _updated = true;
 }
 void ui::animated_float::animate_to(float dest) {
@@ -75,30 +97,269 @@ void ui::animated_float::animate_to(float dest) {
 
     if (this->easing == easing_type::mutation) {
         value = dest;
+        mark_for_repaint(owner, this);
     }
+
+    schedule();
 }
 float ui::animated_float::var() const { return value; }
 float ui::animated_float::prog() const { return progress; }
 float ui::animated_float::dest() const { return destination; }
 void ui::animated_float::reset_to(float dest) {
-    if (value != dest)
+    if (_scheduler)
+        _scheduler->unschedule(this);
+    if (value != dest) {
         _updated = true;
+        mark_for_repaint(owner, this);
+    }
     value = dest;
     this->from = dest;
     this->destination = dest;
     progress = 0.999999999f; // to avoid lerp issues
     delay_timer = 0.f;
 }
+void ui::animated_float::shift_by(float delta) {
+    if (delta == 0)
+        return;
+    value += delta;
+    from += delta;
+    destination += delta;
+    _updated = true;
+    mark_for_repaint(owner, this);
+    if (_scheduler)
+        _scheduler->sync(this);
+}
 void ui::animated_float::set_easing(easing_type easing) {
     this->easing = easing;
+    if (_scheduler)
+        _scheduler->sync(this);
 }
 void ui::animated_float::set_duration(float duration) {
     this->duration = duration;
+    if (_scheduler)
+        _scheduler->sync(this);
 }
 bool ui::animated_float::updated() const { return _updated; }
+bool ui::animated_float::running() const {
+    if (easing == easing_type::mutation)
+        return destination != value || progress != 1.f;
+    return value != destination || (progress < 1.f && from != destination);
+}
+float ui::animated_float::next_change_in() const {
+    if (_scheduler)
+        return _scheduler->next_change_in(this);
+    if (!running())
+        return INFINITY;
+    if (easing != easing_type::mutation && delay_timer < delay)
+        return delay - delay_timer;
+    return 0.f;
+}
+void ui::animated_float::schedule() {
+    // Stays alive until we are done, the owner may hold the last reference
+    // to a render target that is going away
+    std::shared_ptr<animation_scheduler> attached;
+    if (owner)
+        attached = owner->anim_scheduler.lock();
+    auto scheduler = attached ? attached.get() : _scheduler;
+    if (!scheduler)
+        return;
+    if (running())
+        scheduler->schedule(this);
+    else if (_scheduler)
+        _scheduler->unschedule(this);
+}
+ui::animated_float::animated_float(animated_float &&other) {
+    *this = std::move(other);
+}
+ui::animated_float &ui::animated_float::operator=(animated_float &&other) {
+    if (this == &other)
+        return *this;
+    if (_scheduler)
+        _scheduler->unschedule(this);
+    auto scheduler = other._scheduler;
+    if (scheduler)
+        scheduler->unschedule(&other);
+
+    before_animate = std::move(other.before_animate);
+    after_animate = std::move(other.after_animate);
+    easing = other.easing;
+    progress = other.progress;
+    name = std::move(other.name);
+    owner = other.owner;
+    duration = other.duration;
+    value = other.value;
+    from = other.from;
+    destination = other.destination;
+    delay = other.delay;
+    delay_timer = other.delay_timer;
+    _updated = other._updated;
+
+    if (scheduler)
+        scheduler->schedule(this);
+    return *this;
+}
+ui::animated_float::~animated_float() {
+    if (_scheduler)
+        _scheduler->unschedule(this);
+}
+
+ui::animation_scheduler::~animation_scheduler() {
+    while (!anims.empty())
+        remove_at(anims.size() - 1);
+}
+void ui::animation_scheduler::schedule(animated_float *anim) {
+    if (anim->_scheduler && anim->_scheduler != this)
+        anim->_scheduler->unschedule(anim);
+
+    if (anim->_scheduler != this) {
+        anim->_scheduler = this;
+        anim->_slot = static_cast<uint32_t>(anims.size());
+        anims.push_back(anim);
+        owners.emplace_back();
+        from.emplace_back();
+        to.emplace_back();
+        progress.emplace_back();
+        duration.emplace_back();
+        delay_left.emplace_back();
+        easings.emplace_back();
+    }
+
+    // Lets parents that skip updates of offscreen children see it
+    for (auto w = anim->owner; w && !w->_subtree_animating; w = w->parent)
+        w->_subtree_animating = true;
+
+    auto i = anim->_slot;
+    if (owners[i] != anim->owner) {
+        if (owners[i])
+            owners[i]->_running_animations--;
+        if (anim->owner)
+            anim->owner->_running_animations++;
+    }
+    owners[i] = anim->owner;
+    from[i] = anim->from;
+    to[i] = anim->destination;
+    // Entries at full progress are treated as finished by tick
+    progress[i] = anim->progress < 1.f ? anim->progress : 0.f;
+    duration[i] = anim->duration;
+    easings[i] = anim->easing;
+    delay_left[i] = anim->easing == easing_type::mutation
+                        ? 0.f
+                        : anim->delay - anim->delay_timer;
+}
+void ui::animation_scheduler::sync(animated_float *anim) {
+    if (anim->_scheduler != this)
+        return;
+    duration[anim->_slot] = anim->duration;
+    easings[anim->_slot] = anim->easing;
+    from[anim->_slot] = anim->from;
+    to[anim->_slot] = anim->destination;
+}
+void ui::animation_scheduler::unschedule(animated_float *anim) {
+    if (anim->_scheduler == this)
+        remove_at(anim->_slot);
+}
+void ui::animation_scheduler::remove_at(size_t index) {
+    auto anim = anims[index];
+    anim->delay_timer = anim->delay - std::max(delay_left[index], 0.f);
+    anim->_scheduler = nullptr;
+    if (owners[index])
+        owners[index]->_running_animations--;
+
+    auto last = anims.size() - 1;
+    if (index != last) {
+        anims[index] = anims[last];
+        owners[index] = owners[last];
+        from[index] = from[last];
+        to[index] = to[last];
+        progress[index] = progress[last];
+        duration[index] = duration[last];
+        delay_left[index] = delay_left[last];
+        easings[index] = easings[last];
+        anims[index]->_slot = static_cast<uint32_t>(index);
+    }
+    anims.pop_back();
+    owners.pop_back();
+    from.pop_back();
+    to.pop_back();
+    progress.pop_back();
+    duration.pop_back();
+    delay_left.pop_back();
+    easings.pop_back();
+}
+void ui::animation_scheduler::tick(float delta_time) {
+    repaint_widgets.clear();
+    // Indices are re-read every iteration: after_animate may start or stop
+    // other animations
+    for (size_t i = 0; i < anims.size();) {
+        auto anim = anims[i];
+        // Finished in the last tick, the change has been seen by now
+        if (progress[i] >= 1.f) {
+            anim->_updated = false;
+            remove_at(i);
+            continue;
+        }
+        auto index = i++;
+
+        bool updated = true, finished_changed = false;
+        if (easings[index] == easing_type::mutation) {
+            progress[index] = 1.f;
+            finished_changed = true;
+            anim->value = to[index];
+        } else if (delay_left[index] > 0) {
+            delay_left[index] -= delta_time;
+            anim->_updated = false;
+            continue;
+        } else {
+            progress[index] += duration[index] > 0
+                                   ? delta_time / duration[index]
+                                   : 1.f;
+            if (progress[index] >= 1.f) {
+                progress[index] = 1.f;
+                updated = finished_changed = anim->value != to[index];
+                anim->value = to[index];
+            } else {
+                anim->value = eased_value(easings[index], from[index],
+                                          to[index], progress[index]);
+            }
+        }
+
+        anim->progress = progress[index];
+        anim->_updated = updated;
+        if (updated) {
+            auto owner = owners[index];
+            if (owner && !owner->needs_repaint &&
+                changes_content(owner, anim)) {
+                owner->needs_repaint = true;
+                repaint_widgets.push_back(owner);
+            }
+        }
+
+        // Called last, it may restart this animation
+        if (finished_changed && anim->after_animate)
+            anim->after_animate.value()(anim->destination);
+    }
+}
+float ui::animation_scheduler::next_change_in() const {
+    float next = INFINITY;
+    for (size_t i = 0; i < anims.size(); i++) {
+        if (progress[i] >= 1.f)
+            continue;
+        if (delay_left[i] <= 0)
+            return 0.f;
+        next = std::min(next, delay_left[i]);
+    }
+    return next;
+}
+float ui::animation_scheduler::next_change_in(
+    const animated_float *anim) const {
+    if (anim->_scheduler != this || progress[anim->_slot] >= 1.f)
+        return INFINITY;
+    return std::max(delay_left[anim->_slot], 0.f);
+}
 void ui::animated_float::set_delay(float delay) {
     this->delay = delay;
     delay_timer = 0.f;
+    schedule();
 }
 std::array<float, 4> ui::animated_color::operator*() const {
     return {r->var(), g->var(), b->var(), a->var()};
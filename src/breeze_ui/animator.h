@@ -2,12 +2,15 @@
 #include "nanovg.h"
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <optional>
 #include <print>
+#include <vector>
 
 namespace ui {
 struct widget;
+struct animation_scheduler;
 enum class easing_type {
     mutation,
     linear,
@@ -17,8 +20,9 @@ enum class easing_type {
 };
 struct animated_float {
     animated_float() = default;
-    animated_float(animated_float &&) = default;
-    animated_float &operator=(animated_float &&) = default;
+    animated_float(animated_float &&other);
+    animated_float &operator=(animated_float &&other);
+    ~animated_float();
     animated_float(const animated_float &) = delete;
     animated_float &operator=(const animated_float &) = delete;
 
@@ -39,10 +43,15 @@ struct animated_float {
 
     operator float() const { return var(); }
     float operator*() const { return var(); }
+    // Advances an animation that isn't run by a scheduler, does nothing
+    // while it is
     void update(float delta_time);
 
     void animate_to(float destination);
     void reset_to(float destination);
+    // Moves the current value and the destination by `delta` without
+    // restarting an animation in flight
+    void shift_by(float delta);
     void set_duration(float duration);
     void set_easing(easing_type easing);
     void set_delay(float delay);
@@ -52,12 +61,29 @@ struct animated_float {
     float prog() const;
     float dest() const;
     bool updated() const;
+    // Milliseconds until the value changes again: 0 while animating, the
+    // remaining delay before a delayed animation starts, INFINITY once
+    // settled
+    float next_change_in() const;
+    // Hands the animation to the owner's scheduler if it is in flight.
+    // animate_to and set_delay call it, widgets call it for their animations
+    // when they are attached to a render target.
+    void schedule();
 
     easing_type easing = easing_type::mutation;
     float progress = 0.f;
     std::string name = "anim_float";
+    // The widget this animation belongs to, set by widget::anim_float. It is
+    // marked for repaint whenever the value changes, except for its position
+    // and size, which are compared when damage is collected.
+    widget *owner = nullptr;
 
 private:
+    friend struct animation_scheduler;
+    bool running() const;
+    animation_scheduler *_scheduler = nullptr;
+    uint32_t _slot = 0;
+
     float duration = 200.f;
     float value = 0.f;
     float from = 0.f;
@@ -68,6 +94,42 @@ private:
 
 using sp_anim_float = std::shared_ptr<animated_float>;
 
+// Runs the animations of one render target. Only animations in flight are
+// kept here, with their state in parallel arrays, so the cost of a frame
+// depends on the number of running animations and not on the widget count.
+struct animation_scheduler {
+    animation_scheduler() = default;
+    animation_scheduler(const animation_scheduler &) = delete;
+    animation_scheduler &operator=(const animation_scheduler &) = delete;
+    ~animation_scheduler();
+
+    // Starts running the animation from its current state, or restarts it
+    // if it is already running
+    void schedule(animated_float *anim);
+    // Picks up a changed duration, easing or range of a running animation
+    void sync(animated_float *anim);
+    void unschedule(animated_float *anim);
+    // Advances all running animations and sets needs_repaint on the owners
+    // of the ones that changed
+    void tick(float delta_time);
+    // Milliseconds until any animation changes, INFINITY when none runs
+    float next_change_in() const;
+    float next_change_in(const animated_float *anim) const;
+    // Animations that finished are dropped in the following tick
+    size_t running() const { return anims.size(); }
+
+    // Widgets marked for repaint by the last tick
+    std::vector<widget *> repaint_widgets;
+
+private:
+    void remove_at(size_t index);
+
+    std::vector<animated_float *> anims;
+    std::vector<widget *> owners;
+    std::vector<float> from, to, progress, duration, delay_left;
+    std::vector<easing_type> easings;
+};
+
 struct animated_color {
     sp_anim_float r = nullptr;
     sp_anim_float g = nullptr;
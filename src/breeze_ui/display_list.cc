@@ -0,0 +1,312 @@
+#include "breeze_ui/display_list.h"
+
+#include <cstring>
+
+namespace {
+enum class pool { args, paints, texts };
+pool pool_of(ui::display_list::op type) {
+    using op = ui::display_list::op;
+    switch (type) {
+    case op::stroke_paint:
+    case op::fill_paint:
+        return pool::paints;
+    case op::font_face:
+    case op::text:
+    case op::text_box:
+        return pool::texts;
+    default:
+        return pool::args;
+    }
+}
+} // namespace
+
+void ui::display_list::clear() {
+    commands.clear();
+    args.clear();
+    paints.clear();
+    texts.clear();
+    strings.clear();
+}
+
+size_t ui::display_list::arity(op type) {
+    switch (type) {
+    case op::composite_operation:
+    case op::shape_anti_alias:
+    case op::miter_limit:
+    case op::stroke_width:
+    case op::line_cap:
+    case op::line_join:
+    case op::global_alpha:
+    case op::rotate:
+    case op::skew_x:
+    case op::skew_y:
+    case op::path_winding:
+    case op::font_size:
+    case op::font_blur:
+    case op::text_letter_spacing:
+    case op::text_line_height:
+    case op::text_align:
+    case op::font_face_id:
+        return 1;
+    case op::composite_blend_func:
+    case op::translate:
+    case op::scale:
+    case op::move_to:
+    case op::line_to:
+        return 2;
+    case op::circle:
+        return 3;
+    case op::composite_blend_func_separate:
+    case op::stroke_color:
+    case op::fill_color:
+    case op::scissor:
+    case op::intersect_scissor:
+    case op::quad_to:
+    case op::rect:
+    case op::ellipse:
+        return 4;
+    case op::arc_to:
+    case op::rounded_rect:
+        return 5;
+    case op::transform:
+    case op::bezier_to:
+    case op::arc:
+        return 6;
+    case op::rounded_rect_varying:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+void ui::display_list::push(op type, std::initializer_list<float> values) {
+    commands.push_back({type, static_cast<uint32_t>(args.size())});
+    args.insert(args.end(), values);
+}
+
+void ui::display_list::push(op type, NVGcolor color) {
+    commands.push_back({type, static_cast<uint32_t>(args.size())});
+    args.insert(args.end(), color.rgba, color.rgba + 4);
+}
+
+void ui::display_list::push(op type, const NVGpaint &paint) {
+    commands.push_back({type, static_cast<uint32_t>(paints.size())});
+    paints.push_back(paint);
+}
+
+void ui::display_list::push(op type, const char *font_face) {
+    commands.push_back({type, static_cast<uint32_t>(texts.size())});
+    auto size = std::strlen(font_face);
+    texts.push_back({0, 0, 0, static_cast<uint32_t>(strings.size()),
+                     static_cast<uint32_t>(size)});
+    // Kept terminated, it is handed back to nanovg as it is
+    strings.append(font_face, size + 1);
+}
+
+void ui::display_list::push_text(op type, float x, float y,
+                                 float break_row_width, const char *string,
+                                 const char *end) {
+    commands.push_back({type, static_cast<uint32_t>(texts.size())});
+    auto size = end ? end - string : std::strlen(string);
+    texts.push_back({x, y, break_row_width,
+                     static_cast<uint32_t>(strings.size()),
+                     static_cast<uint32_t>(size)});
+    strings.append(string, size);
+}
+
+void ui::display_list::append(const display_list &other) {
+    auto args_base = static_cast<uint32_t>(args.size()),
+         paints_base = static_cast<uint32_t>(paints.size()),
+         texts_base = static_cast<uint32_t>(texts.size()),
+         strings_base = static_cast<uint32_t>(strings.size());
+    for (auto c : other.commands) {
+        switch (pool_of(c.type)) {
+        case pool::args:
+            c.index += args_base;
+            break;
+        case pool::paints:
+            c.index += paints_base;
+            break;
+        case pool::texts:
+            c.index += texts_base;
+            break;
+        }
+        commands.push_back(c);
+    }
+    args.insert(args.end(), other.args.begin(), other.args.end());
+    paints.insert(paints.end(), other.paints.begin(), other.paints.end());
+    for (auto t : other.texts) {
+        t.begin += strings_base;
+        texts.push_back(t);
+    }
+    strings += other.strings;
+}
+
+void ui::display_list::replay(NVGcontext *ctx) const {
+    for (auto &c : commands) {
+        auto a = pool_of(c.type) == pool::args ? args.data() + c.index
+                                               : nullptr;
+        switch (c.type) {
+        case op::save:
+            nvgSave(ctx);
+            break;
+        case op::restore:
+            nvgRestore(ctx);
+            break;
+        case op::reset:
+            nvgReset(ctx);
+            break;
+        case op::composite_operation:
+            nvgGlobalCompositeOperation(ctx, (int)a[0]);
+            break;
+        case op::composite_blend_func:
+            nvgGlobalCompositeBlendFunc(ctx, (int)a[0], (int)a[1]);
+            break;
+        case op::composite_blend_func_separate:
+            nvgGlobalCompositeBlendFuncSeparate(ctx, (int)a[0], (int)a[1],
+                                                (int)a[2], (int)a[3]);
+            break;
+        case op::shape_anti_alias:
+            nvgShapeAntiAlias(ctx, (int)a[0]);
+            break;
+        case op::stroke_color:
+            nvgStrokeColor(ctx, nvgRGBAf(a[0], a[1], a[2], a[3]));
+            break;
+        case op::stroke_paint:
+            nvgStrokePaint(ctx, paints[c.index]);
+            break;
+        case op::fill_color:
+            nvgFillColor(ctx, nvgRGBAf(a[0], a[1], a[2], a[3]));
+            break;
+        case op::fill_paint:
+            nvgFillPaint(ctx, paints[c.index]);
+            break;
+        case op::miter_limit:
+            nvgMiterLimit(ctx, a[0]);
+            break;
+        case op::stroke_width:
+            nvgStrokeWidth(ctx, a[0]);
+            break;
+        case op::line_cap:
+            nvgLineCap(ctx, (int)a[0]);
+            break;
+        case op::line_join:
+            nvgLineJoin(ctx, (int)a[0]);
+            break;
+        case op::global_alpha:
+            nvgGlobalAlpha(ctx, a[0]);
+            break;
+        case op::reset_transform:
+            nvgResetTransform(ctx);
+            break;
+        case op::transform:
+            nvgTransform(ctx, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case op::translate:
+            nvgTranslate(ctx, a[0], a[1]);
+            break;
+        case op::rotate:
+            nvgRotate(ctx, a[0]);
+            break;
+        case op::skew_x:
+            nvgSkewX(ctx, a[0]);
+            break;
+        case op::skew_y:
+            nvgSkewY(ctx, a[0]);
+            break;
+        case op::scale:
+            nvgScale(ctx, a[0], a[1]);
+            break;
+        case op::scissor:
+            nvgScissor(ctx, a[0], a[1], a[2], a[3]);
+            break;
+        case op::intersect_scissor:
+            nvgIntersectScissor(ctx, a[0], a[1], a[2], a[3]);
+            break;
+        case op::reset_scissor:
+            nvgResetScissor(ctx);
+            break;
+        case op::begin_path:
+            nvgBeginPath(ctx);
+            break;
+        case op::move_to:
+            nvgMoveTo(ctx, a[0], a[1]);
+            break;
+        case op::line_to:
+            nvgLineTo(ctx, a[0], a[1]);
+            break;
+        case op::bezier_to:
+            nvgBezierTo(ctx, a[0], a[1], a[2], a[3], a[4], a[5]);
+            break;
+        case op::quad_to:
+            nvgQuadTo(ctx, a[0], a[1], a[2], a[3]);
+            break;
+        case op::arc_to:
+            nvgArcTo(ctx, a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case op::close_path:
+            nvgClosePath(ctx);
+            break;
+        case op::path_winding:
+            nvgPathWinding(ctx, (int)a[0]);
+            break;
+        case op::arc:
+            nvgArc(ctx, a[0], a[1], a[2], a[3], a[4], (int)a[5]);
+            break;
+        case op::rect:
+            nvgRect(ctx, a[0], a[1], a[2], a[3]);
+            break;
+        case op::rounded_rect:
+            nvgRoundedRect(ctx, a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case op::rounded_rect_varying:
+            nvgRoundedRectVarying(ctx, a[0], a[1], a[2], a[3], a[4], a[5],
+                                  a[6], a[7]);
+            break;
+        case op::ellipse:
+            nvgEllipse(ctx, a[0], a[1], a[2], a[3]);
+            break;
+        case op::circle:
+            nvgCircle(ctx, a[0], a[1], a[2]);
+            break;
+        case op::fill:
+            nvgFill(ctx);
+            break;
+        case op::stroke:
+            nvgStroke(ctx);
+            break;
+        case op::font_size:
+            nvgFontSize(ctx, a[0]);
+            break;
+        case op::font_blur:
+            nvgFontBlur(ctx, a[0]);
+            break;
+        case op::text_letter_spacing:
+            nvgTextLetterSpacing(ctx, a[0]);
+            break;
+        case op::text_line_height:
+            nvgTextLineHeight(ctx, a[0]);
+            break;
+        case op::text_align:
+            nvgTextAlign(ctx, (int)a[0]);
+            break;
+        case op::font_face_id:
+            nvgFontFaceId(ctx, (int)a[0]);
+            break;
+        case op::font_face:
+            nvgFontFace(ctx, strings.data() + texts[c.index].begin);
+            break;
+        case op::text:
+        case op::text_box: {
+            auto &t = texts[c.index];
+            auto string = strings.data() + t.begin;
+            if (c.type == op::text)
+                nvgText(ctx, t.x, t.y, string, string + t.size);
+            else
+                nvgTextBox(ctx, t.x, t.y, t.break_row_width, string,
+                           string + t.size);
+            break;
+        }
+        }
+    }
+}
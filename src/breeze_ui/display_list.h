@@ -0,0 +1,129 @@
+#pragma once
+#include "nanovg.h"
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ui {
+// The calls made through a nanovg_context, in order: state, transforms,
+// scissor, paths, paints and text runs. Replaying it into a context makes
+// the same calls again without running the code that made them, and the
+// commands can be inspected without a renderer. Arguments are stored with
+// the offset of the nanovg_context already applied. clear() keeps the
+// memory, recording a frame like the last one does not allocate.
+struct display_list {
+    enum class op : uint8_t {
+        save,
+        restore,
+        reset,
+        composite_operation,
+        composite_blend_func,
+        composite_blend_func_separate,
+        shape_anti_alias,
+        stroke_color,
+        stroke_paint,
+        fill_color,
+        fill_paint,
+        miter_limit,
+        stroke_width,
+        line_cap,
+        line_join,
+        global_alpha,
+        reset_transform,
+        transform,
+        translate,
+        rotate,
+        skew_x,
+        skew_y,
+        scale,
+        scissor,
+        intersect_scissor,
+        reset_scissor,
+        begin_path,
+        move_to,
+        line_to,
+        bezier_to,
+        quad_to,
+        arc_to,
+        close_path,
+        path_winding,
+        arc,
+        rect,
+        rounded_rect,
+        rounded_rect_varying,
+        ellipse,
+        circle,
+        fill,
+        stroke,
+        font_size,
+        font_blur,
+        text_letter_spacing,
+        text_line_height,
+        text_align,
+        font_face_id,
+        font_face,
+        text,
+        text_box,
+    };
+    struct command {
+        op type;
+        // Into paints for stroke_paint and fill_paint, into texts for
+        // font_face, text and text_box, into args for everything else
+        uint32_t index;
+    };
+    struct text_run {
+        float x, y, break_row_width;
+        // The string in strings
+        uint32_t begin, size;
+    };
+
+    std::vector<command> commands;
+    std::vector<float> args;
+    std::vector<NVGpaint> paints;
+    std::vector<text_run> texts;
+    std::string strings;
+
+    void clear();
+    bool empty() const { return commands.empty(); }
+    size_t size() const { return commands.size(); }
+
+    // Number of floats the command takes from args
+    static size_t arity(op type);
+    void push(op type, std::initializer_list<float> values = {});
+    void push(op type, NVGcolor color);
+    void push(op type, const NVGpaint &paint);
+    void push(op type, const char *font_face);
+    void push_text(op type, float x, float y, float break_row_width,
+                   const char *string, const char *end);
+    // Appends the commands of another list
+    void append(const display_list &other);
+    // Makes the recorded calls on ctx
+    void replay(NVGcontext *ctx) const;
+
+    std::span<const float> arguments(const command &c) const {
+        auto count = arity(c.type);
+        if (!count)
+            return {};
+        return {args.data() + c.index, count};
+    }
+    std::string_view text(const command &c) const {
+        auto &t = texts[c.index];
+        return {strings.data() + t.begin, t.size};
+    }
+};
+
+// Commands a widget with cache_commands drew the last time its render()
+// ran, and where it drew them
+struct recorded_commands {
+    display_list list;
+    // Offset, transform and scissor the commands were recorded with. The
+    // commands only hold for the same ones.
+    std::array<float, 12> key{};
+    bool valid = false;
+};
+} // namespace ui
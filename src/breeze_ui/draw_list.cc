@@ -0,0 +1,278 @@
+#include "breeze_ui/draw_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+void ui::draw_list::clear() {
+    commands.clear();
+    calls.clear();
+    paths.clear();
+    vertices.clear();
+    textures.clear();
+    viewports.clear();
+    bytes.clear();
+}
+
+void ui::draw_list::drop_drawing() {
+    std::erase_if(commands, [](const command &c) {
+        return c.type != kind::create_texture &&
+               c.type != kind::update_texture &&
+               c.type != kind::delete_texture;
+    });
+    calls.clear();
+    paths.clear();
+    vertices.clear();
+    viewports.clear();
+}
+
+NVGcontext *ui::draw_recorder::create_context(bool edge_antialias) {
+    NVGparams params{
+        .userPtr = this,
+        .edgeAntiAlias = edge_antialias,
+        .renderCreate = create,
+        .renderCreateTexture = create_texture,
+        .renderDeleteTexture = delete_texture,
+        .renderUpdateTexture = update_texture,
+        .renderGetTextureSize = get_texture_size,
+        .renderViewport = set_viewport,
+        .renderCancel = cancel,
+        .renderFlush = flush,
+        .renderFill = fill,
+        .renderStroke = stroke,
+        .renderTriangles = triangles,
+        .renderDelete = destroy,
+    };
+    return nvgCreateInternal(&params);
+}
+
+int ui::draw_recorder::create(void *) { return 1; }
+void ui::draw_recorder::destroy(void *) {}
+
+int ui::draw_recorder::create_texture(void *uptr, int type, int w, int h,
+                                      int image_flags,
+                                      const unsigned char *data) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    auto image = self->_next_image++;
+    int bytes_per_pixel = type == NVG_TEXTURE_RGBA ? 4 : 1;
+    self->_textures[image] = {w, h, bytes_per_pixel};
+
+    auto &list = *self->target;
+    uint32_t size = data ? w * h * bytes_per_pixel : 0;
+    list.commands.push_back({draw_list::kind::create_texture,
+                             static_cast<uint32_t>(list.textures.size())});
+    list.textures.push_back({image, type, w, h, image_flags, 0, 0,
+                             static_cast<uint32_t>(list.bytes.size()), size});
+    list.bytes.insert(list.bytes.end(), data, data + size);
+    return image;
+}
+
+int ui::draw_recorder::delete_texture(void *uptr, int image) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    if (!self->_textures.erase(image))
+        return 0;
+    auto &list = *self->target;
+    list.commands.push_back({draw_list::kind::delete_texture,
+                             static_cast<uint32_t>(list.textures.size())});
+    list.textures.push_back({.image = image});
+    return 1;
+}
+
+int ui::draw_recorder::update_texture(void *uptr, int image, int x, int y,
+                                      int w, int h,
+                                      const unsigned char *data) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    auto it = self->_textures.find(image);
+    if (it == self->_textures.end())
+        return 0;
+
+    // The renderer reads the rectangle out of the whole image, keep the rows
+    // down to the bottom of it
+    auto &tex = it->second;
+    uint32_t size = (y + h) * tex.width * tex.bytes_per_pixel;
+    auto &list = *self->target;
+    list.commands.push_back({draw_list::kind::update_texture,
+                             static_cast<uint32_t>(list.textures.size())});
+    list.textures.push_back({image, 0, w, h, 0, x, y,
+                             static_cast<uint32_t>(list.bytes.size()), size});
+    list.bytes.insert(list.bytes.end(), data, data + size);
+    return 1;
+}
+
+int ui::draw_recorder::get_texture_size(void *uptr, int image, int *w,
+                                        int *h) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    auto it = self->_textures.find(image);
+    if (it == self->_textures.end())
+        return 0;
+    *w = it->second.width;
+    *h = it->second.height;
+    return 1;
+}
+
+void ui::draw_recorder::set_viewport(void *uptr, float width, float height,
+                                     float ratio) {
+    auto &list = *static_cast<draw_recorder *>(uptr)->target;
+    // A frame that was begun and never ended drew nothing
+    if (!list.commands.empty() &&
+        list.commands.back().type == draw_list::kind::viewport) {
+        list.viewports[list.commands.back().index] = {width, height, ratio};
+        return;
+    }
+    list.commands.push_back({draw_list::kind::viewport,
+                             static_cast<uint32_t>(list.viewports.size())});
+    list.viewports.push_back({width, height, ratio});
+}
+
+void ui::draw_recorder::cancel(void *uptr) {
+    auto &list = *static_cast<draw_recorder *>(uptr)->target;
+    list.commands.push_back({draw_list::kind::cancel, 0});
+}
+
+void ui::draw_recorder::flush(void *uptr) {
+    auto &list = *static_cast<draw_recorder *>(uptr)->target;
+    list.commands.push_back({draw_list::kind::flush, 0});
+}
+
+uint32_t ui::draw_recorder::add_paths(const NVGpath *paths, int npaths) {
+    auto &list = *target;
+    auto first = static_cast<uint32_t>(list.paths.size());
+    for (int i = 0; i < npaths; i++) {
+        auto &p = paths[i];
+        draw_list::path recorded{p, static_cast<uint32_t>(list.vertices.size()),
+                                 0};
+        if (p.nfill)
+            list.vertices.insert(list.vertices.end(), p.fill,
+                                 p.fill + p.nfill);
+        recorded.stroke = static_cast<uint32_t>(list.vertices.size());
+        if (p.nstroke)
+            list.vertices.insert(list.vertices.end(), p.stroke,
+                                 p.stroke + p.nstroke);
+        recorded.path.fill = recorded.path.stroke = nullptr;
+        list.paths.push_back(recorded);
+    }
+    return first;
+}
+
+void ui::draw_recorder::add_call(draw_list::kind type,
+                                 const draw_list::call &c) {
+    auto &list = *target;
+    list.commands.push_back({type, static_cast<uint32_t>(list.calls.size())});
+    list.calls.push_back(c);
+}
+
+void ui::draw_recorder::fill(void *uptr, NVGpaint *paint,
+                             NVGcompositeOperationState composite,
+                             NVGscissor *scissor, float fringe,
+                             const float *bounds, const NVGpath *paths,
+                             int npaths) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    draw_list::call c{*paint, composite, *scissor, fringe, 0, {},
+                      self->add_paths(paths, npaths),
+                      static_cast<uint32_t>(npaths)};
+    std::copy_n(bounds, 4, c.bounds);
+    self->add_call(draw_list::kind::fill, c);
+}
+
+void ui::draw_recorder::stroke(void *uptr, NVGpaint *paint,
+                               NVGcompositeOperationState composite,
+                               NVGscissor *scissor, float fringe,
+                               float stroke_width, const NVGpath *paths,
+                               int npaths) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    self->add_call(draw_list::kind::stroke,
+                   {*paint, composite, *scissor, fringe, stroke_width, {},
+                    self->add_paths(paths, npaths),
+                    static_cast<uint32_t>(npaths)});
+}
+
+void ui::draw_recorder::triangles(void *uptr, NVGpaint *paint,
+                                  NVGcompositeOperationState composite,
+                                  NVGscissor *scissor, const NVGvertex *verts,
+                                  int nverts, float fringe) {
+    auto self = static_cast<draw_recorder *>(uptr);
+    auto &list = *self->target;
+    auto first = static_cast<uint32_t>(list.vertices.size());
+    list.vertices.insert(list.vertices.end(), verts, verts + nverts);
+    self->add_call(draw_list::kind::triangles,
+                   {*paint, composite, *scissor, fringe, 0, {}, first,
+                    static_cast<uint32_t>(nverts)});
+}
+
+int ui::draw_replayer::image(int recorded) const {
+    if (!recorded)
+        return 0;
+    auto it = _images.find(recorded);
+    return it == _images.end() ? 0 : it->second;
+}
+
+void ui::draw_replayer::replay(const draw_list &list) {
+    auto uptr = renderer->userPtr;
+    for (auto [type, index] : list.commands) {
+        switch (type) {
+        case draw_list::kind::viewport: {
+            auto &v = list.viewports[index];
+            renderer->renderViewport(uptr, v.width, v.height, v.ratio);
+            break;
+        }
+        case draw_list::kind::cancel:
+            renderer->renderCancel(uptr);
+            break;
+        case draw_list::kind::flush:
+            renderer->renderFlush(uptr);
+            break;
+        case draw_list::kind::create_texture: {
+            auto &t = list.textures[index];
+            _images[t.image] = renderer->renderCreateTexture(
+                uptr, t.type, t.width, t.height, t.flags,
+                t.size ? list.bytes.data() + t.data : nullptr);
+            break;
+        }
+        case draw_list::kind::update_texture: {
+            auto &t = list.textures[index];
+            renderer->renderUpdateTexture(uptr, image(t.image), t.x, t.y,
+                                          t.width, t.height,
+                                          list.bytes.data() + t.data);
+            break;
+        }
+        case draw_list::kind::delete_texture: {
+            auto &t = list.textures[index];
+            renderer->renderDeleteTexture(uptr, image(t.image));
+            _images.erase(t.image);
+            break;
+        }
+        case draw_list::kind::fill:
+        case draw_list::kind::stroke:
+        case draw_list::kind::triangles: {
+            auto c = list.calls[index];
+            c.paint.image = image(c.paint.image);
+            if (type == draw_list::kind::triangles) {
+                renderer->renderTriangles(uptr, &c.paint, c.composite,
+                                          &c.scissor,
+                                          list.vertices.data() + c.first,
+                                          c.count, c.fringe);
+                break;
+            }
+
+            // The renderer only reads the vertices, the pointers can go
+            // straight into the list
+            _paths.clear();
+            for (uint32_t i = 0; i < c.count; i++) {
+                auto &p = list.paths[c.first + i];
+                auto &path = _paths.emplace_back(p.path);
+                auto vertices = const_cast<NVGvertex *>(list.vertices.data());
+                path.fill = path.nfill ? vertices + p.fill : nullptr;
+                path.stroke = path.nstroke ? vertices + p.stroke : nullptr;
+            }
+            if (type == draw_list::kind::fill)
+                renderer->renderFill(uptr, &c.paint, c.composite, &c.scissor,
+                                     c.fringe, c.bounds, _paths.data(),
+                                     c.count);
+            else
+                renderer->renderStroke(uptr, &c.paint, c.composite,
+                                       &c.scissor, c.fringe, c.stroke_width,
+                                       _paths.data(), c.count);
+            break;
+        }
+        }
+    }
+}
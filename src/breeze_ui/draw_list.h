@@ -0,0 +1,129 @@
+#pragma once
+#include "nanovg.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ui {
+// What nanovg handed to its renderer during a frame: the tessellated fills,
+// strokes and triangles and the texture changes, in order. Recording it on
+// one thread and replaying it into the GL renderer on another splits the
+// CPU side of drawing from the GPU side. clear() keeps the memory, a frame
+// like the last one does not allocate.
+struct draw_list {
+    enum class kind : uint8_t {
+        viewport,
+        cancel,
+        flush,
+        fill,
+        stroke,
+        triangles,
+        create_texture,
+        update_texture,
+        delete_texture,
+    };
+    struct command {
+        kind type;
+        // Into calls, textures or viewports depending on the kind
+        uint32_t index;
+    };
+    struct call {
+        NVGpaint paint;
+        NVGcompositeOperationState composite;
+        NVGscissor scissor;
+        float fringe, stroke_width;
+        float bounds[4];
+        // Paths of fills and strokes, vertices of triangles
+        uint32_t first, count;
+    };
+    // NVGpath with its vertices stored as offsets into vertices
+    struct path {
+        NVGpath path;
+        uint32_t fill, stroke;
+    };
+    struct texture {
+        int image, type, width, height, flags;
+        int x, y;
+        // Pixels in bytes, none when size is 0
+        uint32_t data, size;
+    };
+    struct viewport {
+        float width, height, ratio;
+    };
+
+    std::vector<command> commands;
+    std::vector<call> calls;
+    std::vector<path> paths;
+    std::vector<NVGvertex> vertices;
+    std::vector<texture> textures;
+    std::vector<viewport> viewports;
+    std::vector<unsigned char> bytes;
+
+    void clear();
+    // Keeps only the texture changes, for a frame that is not presented
+    void drop_drawing();
+    bool empty() const { return commands.empty(); }
+};
+
+// nanovg renderer that records into a draw_list instead of drawing. Texture
+// ids are handed out here and mapped to the real ones on replay.
+struct draw_recorder {
+    draw_list *target = nullptr;
+
+    // The context draws into target. edge_antialias has to match the
+    // NVG_ANTIALIAS flag of the context the list is replayed into, it
+    // changes how paths are tessellated.
+    NVGcontext *create_context(bool edge_antialias);
+
+  private:
+    static int create(void *uptr);
+    static int create_texture(void *uptr, int type, int w, int h,
+                              int image_flags, const unsigned char *data);
+    static int delete_texture(void *uptr, int image);
+    static int update_texture(void *uptr, int image, int x, int y, int w,
+                              int h, const unsigned char *data);
+    static int get_texture_size(void *uptr, int image, int *w, int *h);
+    static void set_viewport(void *uptr, float width, float height,
+                             float ratio);
+    static void cancel(void *uptr);
+    static void flush(void *uptr);
+    static void fill(void *uptr, NVGpaint *paint,
+                     NVGcompositeOperationState composite,
+                     NVGscissor *scissor, float fringe, const float *bounds,
+                     const NVGpath *paths, int npaths);
+    static void stroke(void *uptr, NVGpaint *paint,
+                       NVGcompositeOperationState composite,
+                       NVGscissor *scissor, float fringe, float stroke_width,
+                       const NVGpath *paths, int npaths);
+    static void triangles(void *uptr, NVGpaint *paint,
+                          NVGcompositeOperationState composite,
+                          NVGscissor *scissor, const NVGvertex *verts,
+                          int nverts, float fringe);
+    static void destroy(void *uptr);
+
+    uint32_t add_paths(const NVGpath *paths, int npaths);
+    void add_call(draw_list::kind type, const draw_list::call &c);
+
+    struct texture_size {
+        int width, height, bytes_per_pixel;
+    };
+    std::unordered_map<int, texture_size> _textures;
+    int _next_image = 1;
+};
+
+// Plays draw lists back into a renderer, usually the one of a GL context
+// made with nvgCreateGL3 on the thread that presents
+struct draw_replayer {
+    explicit draw_replayer(NVGparams *renderer) : renderer(renderer) {}
+    NVGparams *renderer;
+
+    void replay(const draw_list &list);
+
+  private:
+    int image(int recorded) const;
+    // Recorded texture ids to the renderer's ones
+    std::unordered_map<int, int> _images;
+    std::vector<NVGpath> _paths;
+};
+} // namespace ui
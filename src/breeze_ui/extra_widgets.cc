@@ -1,12 +1,28 @@
 #include "breeze_ui/extra_widgets.h"
 #include "breeze_ui/widget.h"
+#include <algorithm>
 #include <iostream>
 
 #include "breeze_ui/ui.h"
 
+namespace {
+// Returns true and remembers the color if it differs from the painted one
+bool update_painted_color(NVGcolor &painted, const NVGcolor &color) {
+    if (std::ranges::equal(painted.rgba, color.rgba))
+        return false;
+    painted = color;
+    return true;
+}
+} // namespace
+
 namespace ui {
 void acrylic_background_widget::update(update_context &ctx) {
     rect_widget::update(ctx);
+    if (update_painted_color(_painted_acrylic_bg_color, acrylic_bg_color) ||
+        _painted_bg_alpha != bg_color.a) {
+        _painted_bg_alpha = bg_color.a;
+        needs_repaint = true;
+    }
 }
 
 void acrylic_background_widget::render(nanovg_context ctx) {
@@ -40,6 +56,14 @@ void rect_widget::render(nanovg_context ctx) {
     ctx.fillColor(bg_color);
     ctx.fillRoundedRect(*x, *y, *width, *height, *radius);
 }
+void rect_widget::update(update_context &ctx) {
+    widget::update(ctx);
+    // render() overwrites the alpha with the opacity
+    auto color = bg_color;
+    color.a = *opacity / 255.f;
+    if (update_painted_color(_painted_bg_color, color))
+        needs_repaint = true;
+}
 rect_widget::rect_widget() : widget() {}
 rect_widget::~rect_widget() {}
 } // namespace ui
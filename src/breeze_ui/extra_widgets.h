@@ -15,13 +15,19 @@ struct rect_widget : public widget {
     sp_anim_float radius = anim_float(0, 0);
 
     NVGcolor bg_color = nvgRGBAf(0, 0, 0, 0);
+    // Colors of the last repaint, plain fields don't mark the widget dirty
+    // on their own
+    NVGcolor _painted_bg_color = nvgRGBAf(0, 0, 0, 0);
 
     void render(nanovg_context ctx) override;
+    void update(update_context &ctx) override;
 };
 
 struct acrylic_background_widget : public rect_widget {
     ~acrylic_background_widget();
     NVGcolor acrylic_bg_color = nvgRGBAf(1, 0, 0, 0);
+    NVGcolor _painted_acrylic_bg_color = nvgRGBAf(1, 0, 0, 0);
+    float _painted_bg_alpha = 0;
 
     void render(nanovg_context ctx) override;
 
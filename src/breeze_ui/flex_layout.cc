@@ -0,0 +1,348 @@
+#include "breeze_ui/flex_layout.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+float clamp_size(float value, float min, float max) {
+    return std::max(min, std::min(value, max));
+}
+} // namespace
+
+ui::flex_layout::node ui::flex_layout::add(node p, size_t count) {
+    assert(p == none || p < size());
+    auto first = static_cast<node>(size());
+    auto end = first + count;
+    parent.resize(end, p);
+    first_child.resize(end, none);
+    last_child.resize(end, none);
+    next_sibling.resize(end, none);
+    prev_sibling.resize(end, none);
+    if (p != none) {
+        for (auto n = first; n < end; n++) {
+            prev_sibling[n] = last_child[p];
+            if (last_child[p] == none)
+                first_child[p] = n;
+            else
+                next_sibling[last_child[p]] = n;
+            last_child[p] = n;
+        }
+    }
+
+    for (auto v : {&width, &height, &min_width, &min_height, &grow, &shrink,
+                   &gap, &padding_left, &padding_right, &padding_top,
+                   &padding_bottom, &x, &y, &out_width, &out_height, &_base,
+                   &_target})
+        v->resize(end, 0);
+    max_width.resize(end, INFINITY);
+    max_height.resize(end, INFINITY);
+    basis.resize(end, -1);
+    flags.resize(end, 0);
+    _frozen.resize(end, 0);
+    justify_content.resize(end, justify::start);
+    align_items.resize(end, align::start);
+    return first;
+}
+
+void ui::flex_layout::clear() {
+    for (auto v : {&parent, &first_child, &last_child, &next_sibling,
+                   &prev_sibling})
+        v->clear();
+    for (auto v : {&width, &height, &min_width, &max_width, &min_height,
+                   &max_height, &basis, &grow, &shrink, &gap, &padding_left,
+                   &padding_right, &padding_top, &padding_bottom, &x, &y,
+                   &out_width, &out_height, &_base, &_target})
+        v->clear();
+    flags.clear();
+    _frozen.clear();
+    justify_content.clear();
+    align_items.clear();
+}
+
+void ui::flex_layout::compute_sizes() {
+    // Children always come after their parent
+    for (auto n = size(); n-- > 0;)
+        measure(static_cast<node>(n));
+}
+
+void ui::flex_layout::compute() {
+    compute_sizes();
+    for (node n = 0; n < size(); n++) {
+        if (parent[n] == none)
+            x[n] = y[n] = 0;
+        arrange(n);
+    }
+}
+
+float ui::flex_layout::item_base(node item, bool horizontal) {
+    float base;
+    if (flags[item] & is_spacer)
+        base = 0;
+    else if (basis[item] >= 0)
+        base = basis[item];
+    else
+        base = horizontal ? out_width[item] : out_height[item];
+    return _base[item] =
+               horizontal
+                   ? clamp_size(base, min_width[item], max_width[item])
+                   : clamp_size(base, min_height[item], max_height[item]);
+}
+
+ui::flex_layout::line ui::flex_layout::next_line(node n, node start,
+                                                 float available) {
+    bool horizontal = flags[n] & is_horizontal;
+    bool wraps = flags[n] & is_wrapping;
+    auto &next = flags[n] & is_reversed ? prev_sibling : next_sibling;
+    line l;
+    float main = 0;
+    node item = start;
+    for (; item != none; item = next[item]) {
+        float base = item_base(item, horizontal);
+        float with_item = main + (l.count ? gap[n] : 0) + base;
+        if (wraps && l.count && with_item > available)
+            break;
+        main = with_item;
+        l.count++;
+        l.base += base;
+        if (flags[item] & is_spacer) {
+            l.spacers++;
+        } else {
+            l.cross = std::max(l.cross,
+                               horizontal ? out_height[item] : out_width[item]);
+        }
+    }
+    l.end = item;
+    return l;
+}
+
+// Size of the node from its own size or from its children, before the
+// parent grows, shrinks or stretches it. A leaf with a NAN size is only as
+// big as its padding.
+void ui::flex_layout::measure(node n) {
+    float w = width[n], h = height[n];
+    if (first_child[n] == none && !std::isnan(w) && !std::isnan(h)) {
+        out_width[n] = clamp_size(w, min_width[n], max_width[n]);
+        out_height[n] = clamp_size(h, min_height[n], max_height[n]);
+        return;
+    }
+
+    bool horizontal = flags[n] & is_horizontal;
+    float padding_x = padding_left[n] + padding_right[n],
+          padding_y = padding_top[n] + padding_bottom[n];
+    float padding_main = horizontal ? padding_x : padding_y;
+    float fixed_main = horizontal ? w : h;
+    // A container that takes the size of its children only wraps at its
+    // maximum size
+    float available =
+        (std::isnan(fixed_main) ? (horizontal ? max_width[n] : max_height[n])
+                                : fixed_main) -
+        padding_main;
+
+    float content_main = 0, content_cross = 0;
+    size_t lines = 0;
+    auto start = flags[n] & is_reversed ? last_child[n] : first_child[n];
+    while (start != none) {
+        auto l = next_line(n, start, available);
+        content_main =
+            std::max(content_main, l.base + (l.count - 1) * gap[n]);
+        content_cross += (lines++ ? gap[n] : 0) + l.cross;
+        start = l.end;
+    }
+
+    auto content_w = horizontal ? content_main : content_cross,
+         content_h = horizontal ? content_cross : content_main;
+    out_width[n] = clamp_size(std::isnan(w) ? content_w + padding_x : w,
+                              min_width[n], max_width[n]);
+    out_height[n] = clamp_size(std::isnan(h) ? content_h + padding_y : h,
+                               min_height[n], max_height[n]);
+}
+
+// Resolves the main sizes of the items on a line into _target, freezing
+// the ones that hit their min or max size until the rest fit. Returns the
+// sum of the sizes.
+float ui::flex_layout::flex_line(node n, node start, const line &l,
+                                 float inner_main) {
+    bool horizontal = flags[n] & is_horizontal;
+    auto &next = flags[n] & is_reversed ? prev_sibling : next_sibling;
+    float space = inner_main - (l.count - 1) * gap[n];
+    float free = space - l.base;
+    bool growing = free > 0;
+    auto factor = [&](node item) {
+        return growing ? grow[item] : shrink[item] * _base[item];
+    };
+
+    // Spacers take the free space before anything grows
+    if (l.spacers || free == 0) {
+        float spacer = l.spacers && growing ? free / l.spacers : 0;
+        for (auto item = start; item != l.end; item = next[item]) {
+            _target[item] = flags[item] & is_spacer ? spacer : _base[item];
+        }
+        return l.base + spacer * l.spacers;
+    }
+
+    // Sizes of the frozen items and bases and factors of the others
+    float frozen = 0, unfrozen = 0, factors = 0;
+    for (auto item = start; item != l.end; item = next[item]) {
+        _target[item] = _base[item];
+        _frozen[item] = !(factor(item) > 0);
+        if (_frozen[item]) {
+            frozen += _base[item];
+        } else {
+            unfrozen += _base[item];
+            factors += factor(item);
+        }
+    }
+
+    // Every round freezes at least one item
+    for (size_t round = 0; round < l.count && factors > 0; round++) {
+        float remaining = space - frozen - unfrozen;
+        float violation = 0, total = frozen;
+        for (auto item = start; item != l.end; item = next[item]) {
+            if (_frozen[item])
+                continue;
+            float size = _base[item] + remaining * factor(item) / factors;
+            _target[item] =
+                horizontal
+                    ? clamp_size(size, min_width[item], max_width[item])
+                    : clamp_size(size, min_height[item], max_height[item]);
+            violation += _target[item] - size;
+            total += _target[item];
+        }
+        if (violation == 0)
+            return total;
+
+        // Freeze the items clamped in the direction of the total violation
+        float round_factors = factors;
+        for (auto item = start; item != l.end; item = next[item]) {
+            if (_frozen[item])
+                continue;
+            float size =
+                _base[item] + remaining * factor(item) / round_factors;
+            if (violation > 0 ? _target[item] > size : _target[item] < size) {
+                _frozen[item] = 1;
+                frozen += _target[item];
+                unfrozen -= _base[item];
+                factors -= factor(item);
+            }
+        }
+    }
+
+    float total = 0;
+    for (auto item = start; item != l.end; item = next[item])
+        total += _target[item];
+    return total;
+}
+
+// Places the children of the node, its own size is final by now
+void ui::flex_layout::arrange(node n) {
+    if (first_child[n] == none)
+        return;
+
+    bool horizontal = flags[n] & is_horizontal;
+    bool wraps = flags[n] & is_wrapping;
+    auto &next = flags[n] & is_reversed ? prev_sibling : next_sibling;
+    auto first = flags[n] & is_reversed ? last_child[n] : first_child[n];
+    float main_start = horizontal ? padding_left[n] : padding_top[n];
+    float cross_start = horizontal ? padding_top[n] : padding_left[n];
+    float inner_main = horizontal ? out_width[n] - padding_left[n] -
+                                        padding_right[n]
+                                  : out_height[n] - padding_top[n] -
+                                        padding_bottom[n];
+    float inner_cross = horizontal ? out_height[n] - padding_top[n] -
+                                         padding_bottom[n]
+                                   : out_width[n] - padding_left[n] -
+                                         padding_right[n];
+
+    // A single line takes the whole cross size, wrapped lines share what
+    // is left over after their content
+    float extra_cross = 0;
+    if (wraps) {
+        float lines_cross = 0;
+        size_t lines = 0;
+        for (auto start = first; start != none;) {
+            auto l = next_line(n, start, inner_main);
+            lines_cross += (lines++ ? gap[n] : 0) + l.cross;
+            start = l.end;
+        }
+        extra_cross = std::max(0.f, inner_cross - lines_cross) / lines;
+    }
+
+    float line_pos = cross_start;
+    for (auto start = first; start != none;) {
+        auto l = next_line(n, start, inner_main);
+        float line_cross = wraps ? l.cross + extra_cross : inner_cross;
+        float remaining = inner_main - (l.count - 1) * gap[n] -
+                          flex_line(n, start, l, inner_main);
+
+        float offset = 0, spacing = gap[n];
+        auto mode = justify_content[n];
+        // Distributing negative space falls back to start or center
+        if (remaining < 0 && mode == justify::space_between)
+            mode = justify::start;
+        else if (remaining < 0 && (mode == justify::space_around ||
+                                   mode == justify::space_evenly))
+            mode = justify::center;
+        switch (mode) {
+        case justify::end:
+            offset = remaining;
+            break;
+        case justify::center:
+            offset = remaining / 2;
+            break;
+        case justify::space_between:
+            if (l.count > 1)
+                spacing += remaining / (l.count - 1);
+            break;
+        case justify::space_around:
+            spacing += remaining / l.count;
+            offset = remaining / l.count / 2;
+            break;
+        case justify::space_evenly:
+            spacing += remaining / (l.count + 1);
+            offset = remaining / (l.count + 1);
+            break;
+        default:
+            break;
+        }
+
+        float pos = main_start + offset;
+        for (auto item = start; item != l.end; item = next[item]) {
+            auto &item_main = horizontal ? out_width[item] : out_height[item];
+            auto &item_cross = horizontal ? out_height[item] : out_width[item];
+            item_main = _target[item];
+            (horizontal ? x[item] : y[item]) = pos;
+            pos += item_main + spacing;
+
+            auto &cross_pos = horizontal ? y[item] : x[item];
+            if (flags[item] & is_spacer) {
+                cross_pos = NAN;
+                continue;
+            }
+            switch (align_items[n]) {
+            case align::start:
+                cross_pos = line_pos;
+                break;
+            case align::end:
+                cross_pos = line_pos + line_cross - item_cross;
+                break;
+            case align::center:
+                cross_pos = line_pos + (line_cross - item_cross) / 2;
+                break;
+            case align::stretch:
+                item_cross =
+                    horizontal ? clamp_size(line_cross, min_height[item],
+                                            max_height[item])
+                               : clamp_size(line_cross, min_width[item],
+                                            max_width[item]);
+                cross_pos = line_pos;
+                break;
+            default:
+                cross_pos = NAN;
+                break;
+            }
+        }
+
+        line_pos += line_cross + gap[n];
+        start = l.end;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ui {
+// Flexbox layout over a flat tree of nodes kept in parallel arrays.
+// Parents are added before their children, so compute() sizes the tree with
+// one loop from the last node to the first and places it with one loop the
+// other way round. clear() keeps the memory, laying out the same amount of
+// nodes again does not allocate.
+//
+// Supported: direction, reverse order, wrapping, gap, padding, grow, shrink,
+// basis, min/max sizes, justify-content and align-items. Lines of a wrapping
+// container share the free cross space equally, like align-content: normal.
+struct flex_layout {
+    enum class justify {
+        start,
+        end,
+        center,
+        space_between,
+        space_around,
+        space_evenly,
+        free
+    };
+    // free leaves the cross position of the children alone
+    enum class align { start, end, center, stretch, free };
+
+    using node = uint32_t;
+    static constexpr node none = UINT32_MAX;
+
+    enum : uint8_t {
+        // Container lays its children out in a row instead of a column
+        is_horizontal = 1,
+        is_wrapping = 2,
+        // Children are laid out last to first
+        is_reversed = 4,
+        // Takes an equal share of the free space before anything grows
+        is_spacer = 8,
+    };
+
+    // Adds nodes as the last children of the parent, which has to be added
+    // before, and returns the first one. All inputs start at their defaults.
+    node add(node parent = none, size_t count = 1);
+    // Drops all nodes, keeping the memory
+    void clear();
+    size_t size() const { return parent.size(); }
+    // Lays out every tree in the arrays
+    void compute();
+    // Only works out the sizes of the roots, which are the sizes the trees
+    // want to be, without placing anything
+    void compute_sizes();
+
+    std::vector<node> parent, first_child, last_child, next_sibling,
+        prev_sibling;
+
+    // Size of a leaf, or the fixed size of a container. NAN makes a
+    // container take the size of its children.
+    std::vector<float> width, height;
+    std::vector<float> min_width, max_width, min_height, max_height;
+    // Main size the node starts from before growing or shrinking, the width
+    // or height is used when it is < 0
+    std::vector<float> basis;
+    std::vector<float> grow, shrink;
+    std::vector<uint8_t> flags;
+    // Used by containers only
+    std::vector<float> gap;
+    std::vector<float> padding_left, padding_right, padding_top,
+        padding_bottom;
+    std::vector<justify> justify_content;
+    std::vector<align> align_items;
+
+    // Results. Positions are relative to the parent's top left corner, NAN
+    // where the node is not positioned on that axis.
+    std::vector<float> x, y, out_width, out_height;
+
+  private:
+    // Main size of each item before and after flexing
+    std::vector<float> _base, _target;
+    std::vector<uint8_t> _frozen;
+
+    struct line {
+        node end = none;
+        size_t count = 0, spacers = 0;
+        float base = 0, cross = 0;
+    };
+
+    void measure(node n);
+    void arrange(node n);
+    // Items from start up to where the line breaks
+    line next_line(node n, node start, float available);
+    float flex_line(node n, node start, const line &l, float inner_main);
+    float item_base(node item, bool horizontal);
+};
+} // namespace ui
@@ -1,12 +1,16 @@
 #include "breeze_ui/font.h"
+#include "breeze_ui/text_metrics.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <mutex>
 #include <unordered_map>
 
 #include "nanovg.h"
+#ifdef _WIN32
 #include "windows.h"
+#endif
 
 namespace {
 
@@ -27,6 +31,9 @@ struct font_registry {
 
 std::mutex g_font_registry_mutex;
 std::unordered_map<NVGcontext *, font_registry> g_font_registries;
+// Contexts that resolve their faces with the registry of another one
+std::unordered_map<NVGcontext *, NVGcontext *> g_shared_font_registries;
+std::atomic<uint64_t> g_font_registry_generation = 1;
 
 std::string to_lower_ascii(std::string_view text) {
     std::string result(text);
@@ -172,6 +179,7 @@ std::vector<ui::weighted_font_face> build_default_family_faces(
 namespace ui {
 
 std::filesystem::path windows_font_directory() {
+#ifdef _WIN32
     std::wstring buffer(MAX_PATH, L'\0');
     const auto written = GetWindowsDirectoryW(buffer.data(),
                                               static_cast<UINT>(buffer.size()));
@@ -179,6 +187,7 @@ std::filesystem::path windows_font_directory() {
         buffer.resize(written);
         return std::filesystem::path(buffer) / "Fonts";
     }
+#endif
     return std::filesystem::path("C:\\Windows\\Fonts");
 }
 
@@ -265,12 +274,31 @@ bool register_font_family(NVGcontext *nvg,
     auto &registry = g_font_registries[nvg];
     registry.families[definition.family_name] = std::move(family);
     rebuild_fallbacks_locked(nvg, registry);
+    g_font_registry_generation++;
     return true;
 }
 
 void clear_font_registry(NVGcontext *nvg) {
     std::lock_guard lock(g_font_registry_mutex);
     g_font_registries.erase(nvg);
+    std::erase_if(g_shared_font_registries,
+                  [&](const auto &entry) { return entry.second == nvg; });
+    g_font_registry_generation++;
+    text_metrics_cache::forget(nvg);
+}
+
+void share_font_registry(NVGcontext *nvg, NVGcontext *source) {
+    std::lock_guard lock(g_font_registry_mutex);
+    if (source) {
+        g_shared_font_registries[nvg] = source;
+    } else {
+        g_shared_font_registries.erase(nvg);
+    }
+    g_font_registry_generation++;
+}
+
+uint64_t font_registry_generation() {
+    return g_font_registry_generation.load(std::memory_order_acquire);
 }
 
 std::string resolve_font_face_name(NVGcontext *nvg, std::string_view family_name,
@@ -280,6 +308,10 @@ std::string resolve_font_face_name(NVGcontext *nvg, std::string_view family_name
     }
 
     std::lock_guard lock(g_font_registry_mutex);
+    if (const auto shared_it = g_shared_font_registries.find(nvg);
+        shared_it != g_shared_font_registries.end()) {
+        nvg = shared_it->second;
+    }
     const auto registry_it = g_font_registries.find(nvg);
     if (registry_it == g_font_registries.end()) {
         return std::string(family_name);
@@ -295,6 +327,27 @@ std::string resolve_font_face_name(NVGcontext *nvg, std::string_view family_name
     return face ? face->face_name : std::string(family_name);
 }
 
+int resolve_font_face(font_face_handle &face, NVGcontext *nvg,
+                      std::string_view family_name, int weight) {
+    // Read before resolving, registering fonts meanwhile resolves again
+    auto generation = font_registry_generation();
+    if (face.nvg == nvg && face.generation == generation &&
+        face.weight == weight && face.family_name == family_name &&
+        (face.font_id >= 0 || face.font_count == nvgFontCount(nvg))) {
+        return face.font_id;
+    }
+
+    const auto font_count = nvgFontCount(nvg);
+    const auto face_name = resolve_font_face_name(nvg, family_name, weight);
+    face.nvg = nvg;
+    face.generation = generation;
+    face.family_name.assign(family_name);
+    face.weight = weight;
+    face.font_id = nvgFindFont(nvg, face_name.c_str());
+    face.font_count = font_count;
+    return face.font_id;
+}
+
 void register_default_windows_font_suite(
     NVGcontext *nvg, const default_windows_font_suite_definition &suite) {
     static constexpr windows_font_face_candidate main_candidates[] = {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <span>
 #include <string>
@@ -46,8 +47,31 @@ make_windows_font_family(std::string family_name,
 bool register_font_family(NVGcontext *nvg,
                           const font_family_definition &definition);
 void clear_font_registry(NVGcontext *nvg);
+// Resolves the faces of nvg with the families registered for source, for
+// contexts that share the fonts of another one. nullptr stops sharing.
+void share_font_registry(NVGcontext *nvg, NVGcontext *source);
+// Changes whenever fonts are registered or a registry is cleared or shared.
+// Caches of resolved faces and text metrics are dropped when it changes.
+uint64_t font_registry_generation();
 std::string resolve_font_face_name(NVGcontext *nvg, std::string_view family_name,
                                    int weight = 400);
+
+// A face resolved to its nanovg font id, for one context, family and weight
+struct font_face_handle {
+    NVGcontext *nvg = nullptr;
+    uint64_t generation = 0;
+    std::string family_name;
+    int weight = 0;
+    int font_id = -1;
+    // Fonts loaded in nvg when a face that is not loaded was looked up
+    int font_count = -1;
+};
+// The font id of the face resolve_font_face_name picks. face keeps it, and
+// while the arguments and the registry generation stay the same it is
+// returned without locking or allocating. Faces that are not loaded yet are
+// looked up again once more fonts are loaded.
+int resolve_font_face(font_face_handle &face, NVGcontext *nvg,
+                      std::string_view family_name, int weight = 400);
 void register_default_windows_font_suite(
     NVGcontext *nvg, const default_windows_font_suite_definition &suite);
 
@@ -0,0 +1,75 @@
+#include "breeze_ui/frame_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+ui::frame_stats::percentiles percentiles_of(std::vector<float> &values) {
+    if (values.empty())
+        return {};
+    std::ranges::sort(values);
+    auto at = [&](float fraction) {
+        auto index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5f);
+        return values[index];
+    };
+    return {at(0.5f), at(0.95f), at(0.99f), values.back()};
+}
+} // namespace
+
+ui::frame_stats::frame_stats() = default;
+
+void ui::frame_stats::record(const frame &f) {
+    auto index = _frames.load(std::memory_order_relaxed);
+    auto &s = _slots[index % window];
+    s.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.interval_ms.store(f.interval_ms, std::memory_order_relaxed);
+    s.total_ms.store(f.total_ms, std::memory_order_relaxed);
+    s.update_ms.store(f.update_ms, std::memory_order_relaxed);
+    s.render_ms.store(f.render_ms, std::memory_order_relaxed);
+    s.seq.store(index + 1, std::memory_order_release);
+    if (f.repainted)
+        _repainted.fetch_add(1, std::memory_order_relaxed);
+    _frames.store(index + 1, std::memory_order_release);
+}
+
+ui::frame_stats::summary ui::frame_stats::snapshot() const {
+    summary result;
+    result.frames = _frames.load(std::memory_order_acquire);
+    result.repainted =
+        std::min(_repainted.load(std::memory_order_relaxed), result.frames);
+    result.skipped = result.frames - result.repainted;
+
+    std::vector<float> interval, total, update, render;
+    for (auto &v : {&interval, &total, &update, &render})
+        v->reserve(window);
+    for (auto &s : _slots) {
+        auto seq = s.seq.load(std::memory_order_acquire);
+        if (!seq)
+            continue;
+        float values[] = {
+            s.interval_ms.load(std::memory_order_relaxed),
+            s.total_ms.load(std::memory_order_relaxed),
+            s.update_ms.load(std::memory_order_relaxed),
+            s.render_ms.load(std::memory_order_relaxed),
+        };
+        // Left out when the frame was overwritten while we read it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != seq)
+            continue;
+        interval.push_back(values[0]);
+        total.push_back(values[1]);
+        update.push_back(values[2]);
+        render.push_back(values[3]);
+
+        auto bucket = std::ranges::lower_bound(bucket_bounds, values[1]) -
+                      bucket_bounds.begin();
+        result.histogram[bucket]++;
+    }
+    result.window_frames = total.size();
+    result.interval_ms = percentiles_of(interval);
+    result.total_ms = percentiles_of(total);
+    result.update_ms = percentiles_of(update);
+    result.render_ms = percentiles_of(render);
+    return result;
+}
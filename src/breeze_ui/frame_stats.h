@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ui {
+// Timing of the frames of one render target. The loop thread records each
+// frame, any thread can take a summary without locks, so a monitor can
+// watch every window for jank without stalling its frames.
+struct frame_stats {
+    // Number of recent frames the percentiles and the histogram cover
+    static constexpr size_t window = 256;
+    // Upper bounds of the histogram buckets in milliseconds, the last bucket
+    // holds the frames above them
+    static constexpr std::array<float, 8> bucket_bounds = {
+        2, 4, 8, 12, 16.7f, 33.4f, 50, 100};
+
+    struct frame {
+        // Milliseconds since the frame before started
+        float interval_ms = 0;
+        // Milliseconds spent on the frame, of them in update_frame and in
+        // drawing and presenting it
+        float total_ms = 0, update_ms = 0, render_ms = 0;
+        // Frames with nothing to repaint are skipped after the update
+        bool repainted = false;
+    };
+    struct percentiles {
+        float p50 = 0, p95 = 0, p99 = 0, max = 0;
+    };
+    struct summary {
+        // Since the render target was created
+        uint64_t frames = 0, repainted = 0, skipped = 0;
+        // Over the last frames, up to window of them
+        size_t window_frames = 0;
+        percentiles interval_ms, total_ms, update_ms, render_ms;
+        // The recent frames counted by total_ms into bucket_bounds
+        std::array<uint32_t, bucket_bounds.size() + 1> histogram{};
+    };
+
+    frame_stats();
+    frame_stats(const frame_stats &) = delete;
+    frame_stats &operator=(const frame_stats &) = delete;
+
+    // Only called from one thread at a time
+    void record(const frame &f);
+    summary snapshot() const;
+
+  private:
+    // seq is 0 while the frame is written and its number plus one after
+    struct slot {
+        std::atomic<uint64_t> seq = 0;
+        std::atomic<float> interval_ms = 0, total_ms = 0, update_ms = 0,
+                           render_ms = 0;
+    };
+    std::array<slot, window> _slots;
+    std::atomic<uint64_t> _frames = 0, _repainted = 0;
+};
+} // namespace ui
@@ -0,0 +1,62 @@
+#include "breeze_ui/glyph_run.h"
+#include "breeze_ui/font.h"
+#include "breeze_ui/nanovg_wrapper.h"
+#include "breeze_ui/text_metrics.h"
+
+void ui::glyph_run::draw(nanovg_context &ctx, float x, float y,
+                         std::string_view text, float break_row_width) {
+    x += ctx.offset_x;
+    y += ctx.offset_y;
+    if (break_row_width < 0)
+        break_row_width = -1;
+    ctx.record_text(break_row_width < 0 ? display_list::op::text
+                                        : display_list::op::text_box,
+                    x, y, break_row_width, text.data(),
+                    text.data() + text.size());
+
+    NVGtextStyle style;
+    nvgGetTextStyle(ctx.ctx, &style);
+    if (_ctx != ctx.ctx || _text != text ||
+        _break_row_width != break_row_width ||
+        !same_text_style(_style, style) ||
+        _atlas_generation != nvgTextAtlasGeneration(ctx.ctx) ||
+        _font_generation != font_registry_generation()) {
+        _ctx = ctx.ctx;
+        _text = text;
+        _style = style;
+        _break_row_width = break_row_width;
+        layout(ctx.ctx, text);
+    }
+    nvgDrawTextQuads(ctx.ctx, x, y, _quads.data(),
+                     static_cast<int>(_quads.size()));
+}
+
+void ui::glyph_run::layout(NVGcontext *ctx, std::string_view text) {
+    layouts++;
+    _font_generation = font_registry_generation();
+    // No more glyphs than bytes
+    _quads.resize(text.size());
+    auto first = text.data(), last = text.data() + text.size();
+    auto max_quads = static_cast<int>(_quads.size());
+    int count = 0;
+    // Running out of atlas space resets it, the rows laid out before would
+    // point into the old one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        _atlas_generation = nvgTextAtlasGeneration(ctx);
+        count = _break_row_width < 0
+                    ? nvgTextQuads(ctx, 0, 0, first, last, _quads.data(),
+                                   max_quads)
+                    : nvgTextBoxQuads(ctx, 0, 0, _break_row_width, first,
+                                      last, _quads.data(), max_quads);
+        if (_atlas_generation == nvgTextAtlasGeneration(ctx))
+            break;
+    }
+    _atlas_generation = nvgTextAtlasGeneration(ctx);
+    _quads.resize(count);
+}
+
+void ui::glyph_run::clear() {
+    _ctx = nullptr;
+    _text.clear();
+    _quads.clear();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "nanovg.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ui {
+struct nanovg_context;
+
+// The glyphs of a string laid out once, with their places in the font
+// atlas, so that drawing the same text again only moves the quads instead
+// of going through fontstash. The glyphs are laid out again when the string,
+// the text style, the wrap width, the fonts or the font atlas change.
+struct glyph_run {
+    // Draws like nanovg_context::text, or like textBox when break_row_width
+    // is not negative, and records the same call
+    void draw(nanovg_context &ctx, float x, float y, std::string_view text,
+              float break_row_width = -1);
+    void clear();
+    std::span<const NVGglyphQuad> quads() const { return _quads; }
+    // Number of times the glyphs were laid out
+    size_t layouts = 0;
+
+  private:
+    void layout(NVGcontext *ctx, std::string_view text);
+
+    NVGcontext *_ctx = nullptr;
+    std::string _text;
+    NVGtextStyle _style{};
+    float _break_row_width = -1;
+    int _atlas_generation = 0;
+    uint64_t _font_generation = 0;
+    std::vector<NVGglyphQuad> _quads;
+};
+} // namespace ui
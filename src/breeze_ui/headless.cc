@@ -0,0 +1,205 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/display_list.h"
+#include "breeze_ui/font.h"
+#include "breeze_ui/trace.h"
+
+#include <cmath>
+
+namespace {
+int null_create(void *) { return 1; }
+int null_create_texture(void *, int, int, int, int, const unsigned char *) {
+    return 1;
+}
+int null_delete_texture(void *, int) { return 1; }
+int null_update_texture(void *, int, int, int, int, int,
+                        const unsigned char *) {
+    return 1;
+}
+// Textures aren't kept, all of them have the size nanovg starts the font
+// atlas with
+int null_get_texture_size(void *, int, int *w, int *h) {
+    *w = *h = 512;
+    return 1;
+}
+void null_viewport(void *, float, float, float) {}
+void null_cancel(void *) {}
+void null_flush(void *) {}
+void null_fill(void *, NVGpaint *, NVGcompositeOperationState, NVGscissor *,
+               float, const float *, const NVGpath *, int) {}
+void null_stroke(void *, NVGpaint *, NVGcompositeOperationState, NVGscissor *,
+                 float, float, const NVGpath *, int) {}
+void null_triangles(void *, NVGpaint *, NVGcompositeOperationState,
+                    NVGscissor *, const NVGvertex *, int, float) {}
+void null_delete(void *) {}
+} // namespace
+
+NVGparams ui::null_nvg_params() {
+    return {
+        .userPtr = nullptr,
+        .edgeAntiAlias = 1,
+        .renderCreate = null_create,
+        .renderCreateTexture = null_create_texture,
+        .renderDeleteTexture = null_delete_texture,
+        .renderUpdateTexture = null_update_texture,
+        .renderGetTextureSize = null_get_texture_size,
+        .renderViewport = null_viewport,
+        .renderCancel = null_cancel,
+        .renderFlush = null_flush,
+        .renderFill = null_fill,
+        .renderStroke = null_stroke,
+        .renderTriangles = null_triangles,
+        .renderDelete = null_delete,
+    };
+}
+
+NVGcontext *ui::create_null_nvg() {
+    auto params = null_nvg_params();
+    return nvgCreateInternal(&params);
+}
+
+ui::headless_target::headless_target(int width, int height, float dpi_scale)
+    : headless_target(create_null_nvg(), width, height, dpi_scale) {
+    _owns_nvg = true;
+}
+
+ui::headless_target::headless_target(NVGcontext *nvg, int width, int height,
+                                     float dpi_scale)
+    : screen{width, height, dpi_scale}, _owns_nvg(false) {
+    rt.nvg = nvg;
+    rt.width = width;
+    rt.height = height;
+    rt.dpi_scale = dpi_scale;
+    rt.root = std::make_shared<widget>();
+}
+
+ui::headless_target::~headless_target() {
+    // Its threads measure with the fonts of nvg
+    rt.layout_workers.reset();
+    if (_owns_nvg) {
+        clear_font_registry(rt.nvg);
+        nvgDeleteInternal(rt.nvg);
+    }
+    rt.nvg = nullptr;
+}
+
+void ui::headless_target::push_key(int key, int action) {
+    if (key < 0 || key > GLFW_KEY_LAST)
+        return;
+    _held_keys[key] = action == GLFW_PRESS;
+    // Like GLFW, the mods of a modifier key's own press include it
+    auto held = [&](int left, int right) {
+        return _held_keys[left] || _held_keys[right];
+    };
+    int mods = 0;
+    if (held(GLFW_KEY_LEFT_SHIFT, GLFW_KEY_RIGHT_SHIFT))
+        mods |= GLFW_MOD_SHIFT;
+    if (held(GLFW_KEY_LEFT_CONTROL, GLFW_KEY_RIGHT_CONTROL))
+        mods |= GLFW_MOD_CONTROL;
+    if (held(GLFW_KEY_LEFT_ALT, GLFW_KEY_RIGHT_ALT))
+        mods |= GLFW_MOD_ALT;
+    if (held(GLFW_KEY_LEFT_SUPER, GLFW_KEY_RIGHT_SUPER))
+        mods |= GLFW_MOD_SUPER;
+    rt.push_input_event({.type = input_event::kind::key,
+                         .key = key,
+                         .action = action,
+                         .mods = mods});
+}
+
+void ui::headless_target::key_press(int key) { push_key(key, GLFW_PRESS); }
+
+void ui::headless_target::key_release(int key) {
+    push_key(key, GLFW_RELEASE);
+}
+
+void ui::headless_target::type(std::u32string_view text) {
+    for (auto codepoint : text) {
+        rt.push_input_event(
+            {.type = input_event::kind::text, .codepoint = codepoint});
+    }
+}
+
+ui::damage_region ui::headless_target::frame(float delta_time) {
+    trace_zone frame_zone("frame");
+    auto start = rt.clock.now();
+    // Tasks posted from other threads run here, like on the loop thread
+    while (true) {
+        std::unique_lock lock(rt.loop_thread_tasks_lock);
+        if (rt.loop_thread_tasks.empty())
+            break;
+        auto task = std::move(rt.loop_thread_tasks.front());
+        rt.loop_thread_tasks.pop();
+        lock.unlock();
+        if (task)
+            task();
+    }
+    rt.frame_requested = false;
+
+    auto dpi_scale = rt.dpi_scale = screen.dpi_scale;
+    auto width = static_cast<float>(rt.width),
+         height = static_cast<float>(rt.height);
+    nanovg_context vg{rt.nvg, &rt};
+    vg.recording = recording;
+    vg.beginFrame(std::lround(width * dpi_scale),
+                  std::lround(height * dpi_scale), 1);
+    vg.scale(dpi_scale, dpi_scale);
+
+    bool need_repaint = false;
+    update_context ctx{
+        .delta_time = delta_time,
+        .mouse_x = mouse_x,
+        .mouse_y = mouse_y,
+        .mouse_down = mouse_down,
+        .right_mouse_down = right_mouse_down,
+        .window = nullptr,
+        .mouse_clicked = mouse_down && !_mouse_down,
+        .right_mouse_clicked = right_mouse_down && !_right_mouse_down,
+        .mouse_up = !mouse_down && _mouse_down,
+        .screen = screen,
+        .scroll_y = scroll_y,
+        .need_repaint = need_repaint,
+        .rt = rt,
+        .vg = vg,
+    };
+    ctx.clip = rect{0, 0, width, height};
+    _mouse_down = mouse_down;
+    _right_mouse_down = right_mouse_down;
+    scroll_y = 0;
+
+    auto update_start = rt.clock.now();
+    auto frame_damage = rt.update_frame(ctx);
+    auto update_end = rt.clock.now();
+    if (need_repaint)
+        frame_damage.add_full();
+    if (!frame_damage.empty()) {
+        if (frame_damage.full) {
+            vg.scissor(0, 0, width, height);
+        } else {
+            rt.repaint_region =
+                frame_damage.bounds.intersected({0, 0, width, height});
+            vg.scissor(rt.repaint_region->x, rt.repaint_region->y,
+                       rt.repaint_region->width, rt.repaint_region->height);
+        }
+        trace_zone zone("render");
+        std::lock_guard lock(rt.rt_lock);
+        rt.root->render(vg);
+    }
+    {
+        trace_zone zone("endFrame");
+        vg.endFrame();
+    }
+    rt.repaint_region.reset();
+    frame_count++;
+
+    auto ms = [](auto duration) {
+        return 1000 * std::chrono::duration<float>(duration).count();
+    };
+    auto end = rt.clock.now();
+    rt.stats.record({
+        .interval_ms = delta_time,
+        .total_ms = ms(end - start),
+        .update_ms = ms(update_end - update_start),
+        .render_ms = ms(end - update_end),
+        .repainted = !frame_damage.empty(),
+    });
+    return frame_damage;
+}
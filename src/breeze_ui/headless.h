@@ -0,0 +1,59 @@
+#pragma once
+#include "breeze_ui/ui.h"
+
+#include <string>
+
+namespace ui {
+struct display_list;
+
+// nanovg renderer that draws nothing. nanovg still tessellates everything
+// it is given, only the GPU work is left out. Tests that look at what would
+// be drawn replace single callbacks of the params.
+NVGparams null_nvg_params();
+// Free with nvgDeleteInternal
+NVGcontext *create_null_nvg();
+
+// Runs a widget tree without a window: input, time and screen are set by
+// the caller, and each frame() updates the tree and draws what changed into
+// a nanovg context. By default the context has a renderer that draws
+// nothing, so tests and benchmarks measure the widgets alone and run on
+// machines without a display or GPU.
+struct headless_target {
+    // Logical size of the window
+    headless_target(int width, int height, float dpi_scale = 1);
+    // Draws into nvg instead, which stays owned by the caller
+    headless_target(NVGcontext *nvg, int width, int height,
+                    float dpi_scale = 1);
+    ~headless_target();
+    headless_target(const headless_target &) = delete;
+    headless_target &operator=(const headless_target &) = delete;
+
+    render_target rt;
+    screen_info screen;
+
+    // Input of the next frame, in window coordinates
+    double mouse_x = -1, mouse_y = -1;
+    bool mouse_down = false, right_mouse_down = false;
+    // Scrolled since the last frame
+    float scroll_y = 0;
+    // Seen by the next frame(), in the order they were called
+    void key_press(int key);
+    void key_release(int key);
+    void type(std::u32string_view text);
+
+    // Appends what frames draw when set
+    display_list *recording = nullptr;
+
+    // Runs one frame delta_time milliseconds after the last one. Returns
+    // the area that was repainted, empty when nothing changed.
+    damage_region frame(float delta_time = 1000.f / 60);
+    size_t frame_count = 0;
+
+  private:
+    bool _owns_nvg;
+    bool _mouse_down = false, _right_mouse_down = false;
+    // Keys pressed and not released yet, for the mods of key events
+    std::bitset<GLFW_KEY_LAST + 1> _held_keys;
+    void push_key(int key, int action);
+};
+} // namespace ui
@@ -0,0 +1,170 @@
+#include "breeze_ui/layer_cache.h"
+#include "breeze_ui/ui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+extern "C" {
+#include "nanovg_gl_utils.h"
+}
+
+ui::layer_cache::~layer_cache() { clear(); }
+
+void ui::layer_cache::mark(widget &w, bool changed) {
+    auto &l = layers[&w];
+    // Another widget may have been created at the address of a dead one
+    if (l.owner.lock().get() != &w) {
+        l.owner = w.weak_from_this();
+        l.valid = false;
+        if (l.owner.expired()) {
+            // Only widgets owned by a shared_ptr can be tracked
+            release(l);
+            layers.erase(&w);
+            return;
+        }
+    }
+
+    rect bounds = w._subtree_bounds;
+    bounds.x -= w._collected_x;
+    bounds.y -= w._collected_y;
+    if (changed || bounds != l.bounds)
+        l.valid = false;
+    l.bounds = bounds;
+    l.marked_frame = frame + 1;
+}
+
+bool ui::layer_cache::render_pending(NVGcontext *vg, render_target *rt,
+                                     float dpi_scale) {
+    this->vg = vg;
+    frame++;
+
+    // Forget layers of widgets that are gone
+    for (auto it = layers.begin(); it != layers.end();) {
+        if (it->second.owner.expired()) {
+            release(it->second);
+            it = layers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    bool rendered = false;
+    for (auto &[w, l] : layers) {
+        if (l.marked_frame != frame || l.bounds.empty())
+            continue;
+        if (l.valid && l.dpi_scale == dpi_scale)
+            continue;
+
+        int pixel_width = std::ceil(l.bounds.width * dpi_scale),
+            pixel_height = std::ceil(l.bounds.height * dpi_scale);
+        size_t bytes = size_t(pixel_width) * pixel_height * 4;
+        if (!l.framebuffer || l.pixel_width != pixel_width ||
+            l.pixel_height != pixel_height) {
+            release(l);
+            // Without room in the budget the widget is drawn directly
+            evict(bytes);
+            if (stats.texture_bytes + bytes > budget_bytes)
+                continue;
+            l.framebuffer =
+                nvgluCreateFramebuffer(vg, pixel_width, pixel_height, 0);
+            if (!l.framebuffer)
+                continue;
+            l.pixel_width = pixel_width;
+            l.pixel_height = pixel_height;
+            stats.texture_bytes += bytes;
+            stats.layer_count++;
+        }
+
+        nvgluBindFramebuffer(l.framebuffer);
+        glViewport(0, 0, pixel_width, pixel_height);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        nanovg_context ctx{vg, rt};
+        ctx.beginFrame(pixel_width, pixel_height, 1);
+        ctx.scale(dpi_scale, dpi_scale);
+        // Put the top left corner of the subtree at the origin
+        ctx.offset_x = -l.bounds.x - **w->x;
+        ctx.offset_y = -l.bounds.y - **w->y;
+        rendering = true;
+        ctx.save();
+        w->render(ctx);
+        ctx.restore();
+        rendering = false;
+        ctx.endFrame();
+
+        l.valid = true;
+        l.dpi_scale = dpi_scale;
+        l.drawn_frame = frame;
+        stats.misses++;
+        rendered = true;
+    }
+
+    if (rendered)
+        nvgluBindFramebuffer(nullptr);
+    return rendered;
+}
+
+bool ui::layer_cache::draw(nanovg_context &ctx, widget &w) {
+    if (rendering)
+        return false;
+    auto it = layers.find(&w);
+    if (it == layers.end())
+        return false;
+    auto &l = it->second;
+    if (!l.valid || !l.framebuffer || l.marked_frame != frame)
+        return false;
+
+    l.used_frame = frame;
+    if (l.drawn_frame != frame)
+        stats.hits++;
+
+    // Through the wrapper, so that a recording of the parent has it too
+    auto vg = ctx.with_offset(*w.x, *w.y);
+    auto paint =
+        vg.imagePattern(l.bounds.x, l.bounds.y, l.bounds.width,
+                        l.bounds.height, 0, l.framebuffer->image,
+                        w.layer_opacity);
+    vg.beginPath();
+    vg.rect(l.bounds.x, l.bounds.y, l.bounds.width, l.bounds.height);
+    vg.fillPaint(paint);
+    vg.fill();
+    return true;
+}
+
+void ui::layer_cache::release(layer &l) {
+    if (!l.framebuffer)
+        return;
+    nvgluDeleteFramebuffer(l.framebuffer);
+    l.framebuffer = nullptr;
+    stats.texture_bytes -= size_t(l.pixel_width) * l.pixel_height * 4;
+    stats.layer_count--;
+    l.pixel_width = l.pixel_height = 0;
+    l.valid = false;
+}
+
+void ui::layer_cache::evict(size_t needed) {
+    if (stats.texture_bytes + needed <= budget_bytes)
+        return;
+
+    // Least recently used first, layers in use this frame are kept
+    std::vector<layer *> candidates;
+    for (auto &[w, l] : layers) {
+        if (l.framebuffer && l.marked_frame != frame)
+            candidates.push_back(&l);
+    }
+    std::ranges::sort(candidates, {}, &layer::used_frame);
+    for (auto l : candidates) {
+        if (stats.texture_bytes + needed <= budget_bytes)
+            break;
+        release(*l);
+        stats.evictions++;
+    }
+}
+
+void ui::layer_cache::clear() {
+    for (auto &[w, l] : layers)
+        release(l);
+    layers.clear();
+}
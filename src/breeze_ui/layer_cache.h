@@ -0,0 +1,76 @@
+#pragma once
+#include "breeze_ui/nanovg_wrapper.h"
+#include "breeze_ui/widget.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+struct NVGLUframebuffer;
+
+namespace ui {
+struct render_target;
+
+// Offscreen images of the widgets that set cache_as_layer. A layer is only
+// drawn again after something in its subtree changed, otherwise the image
+// is composited in place of the subtree. Once the textures exceed the
+// budget the least recently used layers are dropped.
+struct layer_cache {
+    // Memory the layer textures may take up, in bytes
+    size_t budget_bytes = 64 * 1024 * 1024;
+
+    struct layer_stats {
+        // Layers composited from the cache, and layers that were drawn
+        size_t hits = 0, misses = 0;
+        size_t evictions = 0;
+        size_t layer_count = 0;
+        size_t texture_bytes = 0;
+
+        float hit_rate() const {
+            auto total = hits + misses;
+            return total ? static_cast<float>(hits) / total : 0;
+        }
+    };
+    layer_stats stats;
+
+    layer_cache() = default;
+    layer_cache(const layer_cache &) = delete;
+    layer_cache &operator=(const layer_cache &) = delete;
+    // Frees the textures, clear() has to be called before the nanovg
+    // context goes away
+    ~layer_cache();
+
+    // Called for widgets with cache_as_layer after their update. `changed`
+    // is set when something in the subtree was repainted, moved or resized.
+    void mark(widget &w, bool changed);
+    // Draws the layers that are out of date. It binds their framebuffers and
+    // runs nanovg frames of its own, so it can't be called in the middle of
+    // a frame. Returns whether any layer was drawn.
+    bool render_pending(NVGcontext *vg, render_target *rt, float dpi_scale);
+    // Composites the layer of the widget at its current position. Returns
+    // false when it has none and has to be drawn directly.
+    bool draw(nanovg_context &ctx, widget &w);
+    // Frees all layers, the GL context has to be current
+    void clear();
+
+  private:
+    struct layer {
+        std::weak_ptr<widget> owner;
+        NVGLUframebuffer *framebuffer = nullptr;
+        int pixel_width = 0, pixel_height = 0;
+        float dpi_scale = 0;
+        // Subtree bounds relative to the widget's position
+        rect bounds;
+        bool valid = false;
+        uint64_t marked_frame = 0, drawn_frame = 0, used_frame = 0;
+    };
+    void release(layer &l);
+    void evict(size_t needed);
+
+    std::unordered_map<widget *, layer> layers;
+    uint64_t frame = 0;
+    NVGcontext *vg = nullptr;
+    // Set while layers are drawn, nested layers are then drawn directly
+    bool rendering = false;
+};
+} // namespace ui
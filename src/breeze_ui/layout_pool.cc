@@ -0,0 +1,107 @@
+#include "breeze_ui/layout_pool.h"
+#include "breeze_ui/text_metrics.h"
+#include "breeze_ui/font.h"
+#include "breeze_ui/trace.h"
+#include "breeze_ui/ui.h"
+
+#include "nanovg.h"
+
+ui::layout_pool::layout_pool(size_t threads) {
+    for (size_t i = 0; i < threads; i++)
+        _contexts.push_back(nvgCreateMeasureContext());
+    for (size_t i = 0; i < threads; i++)
+        _workers.emplace_back(
+            [this, i](std::stop_token stop) { worker(stop, i); });
+}
+
+ui::layout_pool::~layout_pool() {
+    // Stops and joins the threads before their contexts go away
+    _workers.clear();
+    for (auto vg : _contexts) {
+        share_font_registry(vg, nullptr);
+        text_metrics_cache::forget(vg);
+        nvgDeleteInternal(vg);
+    }
+}
+
+void ui::layout_pool::collect(widget &w, const constraints &limits) {
+    // Clean containers keep their last layout, and so does everything in
+    // them, see widget::invalidate_layout
+    if (!w.layout_dirty)
+        return;
+
+    auto flex = dynamic_cast<flex_widget *>(&w);
+    if (!flex) {
+        for (auto &child : w.children)
+            if (child)
+                collect(*child, child->_layout_limits);
+        return;
+    }
+
+    // Virtual lists place their items themselves
+    if (!flex->auto_size && !dynamic_cast<virtual_list_widget *>(flex))
+        _tasks.push_back({flex, limits});
+    // Predict the limits the children get from this layout, so that the
+    // ones measured on the first frame are already the right ones
+    auto child_limits = flex->children_limits(limits);
+    for (auto &child : flex->children)
+        if (child)
+            collect(*child, child_limits);
+}
+
+void ui::layout_pool::work(update_context &ctx) {
+    trace_zone zone("measure");
+    for (auto i = _next_task++; i < _tasks.size(); i = _next_task++)
+        _tasks[i].container->measure_children(ctx, _tasks[i].limits);
+}
+
+void ui::layout_pool::worker(std::stop_token stop, size_t index) {
+    tracing().name_thread("layout " + std::to_string(index));
+    uint64_t seen = 0;
+    std::unique_lock lock(_lock);
+    while (_start.wait(lock, stop, [&] { return _round != seen; })) {
+        seen = _round;
+        lock.unlock();
+
+        auto ctx = *_ctx;
+        ctx.vg.ctx = _contexts[index];
+        work(ctx);
+
+        lock.lock();
+        if (--_busy == 0)
+            _done.notify_one();
+    }
+}
+
+void ui::layout_pool::measure(update_context &ctx, widget &root) {
+    _tasks.clear();
+    collect(root, root._layout_limits);
+    measured_containers = _tasks.size();
+    _next_task = 0;
+    if (_tasks.size() < 2 || _workers.empty()) {
+        work(ctx);
+        return;
+    }
+
+    // Fonts may have been registered since the last frame, and the text
+    // has to be measured at the same scale as on the loop thread
+    for (auto vg : _contexts) {
+        nvgShareFonts(vg, ctx.vg.ctx);
+        if (_fonts != ctx.vg.ctx)
+            share_font_registry(vg, ctx.vg.ctx);
+    }
+    _fonts = ctx.vg.ctx;
+
+    _ctx = &ctx;
+    {
+        std::lock_guard lock(_lock);
+        _round++;
+        _busy = _workers.size();
+    }
+    _start.notify_all();
+    work(ctx);
+
+    std::unique_lock lock(_lock);
+    _done.wait(lock, [&] { return _busy == 0; });
+    _ctx = nullptr;
+}
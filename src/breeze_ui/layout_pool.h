@@ -0,0 +1,61 @@
+#pragma once
+#include "breeze_ui/widget.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct NVGcontext;
+
+namespace ui {
+// Threads that measure independent parts of the widget tree ahead of the
+// update. The parts are the flex containers with a fixed size: sizes of
+// their children can't change anything outside of them, and measuring stops
+// at children that have a fixed size, so no two parts share a widget. Each
+// thread measures text with a nanovg context of its own that shares the
+// fonts of the window's one, fontstash is not thread safe.
+//
+// Measuring only fills the measurement caches of the widgets. The update
+// still lays everything out on the loop thread and finds the sizes there,
+// so the result is the same as without the pool.
+struct layout_pool {
+    // Number of threads besides the calling one
+    explicit layout_pool(size_t threads);
+    ~layout_pool();
+    layout_pool(const layout_pool &) = delete;
+    layout_pool &operator=(const layout_pool &) = delete;
+
+    size_t threads() const { return _workers.size(); }
+    // Measures the containers below root that need layout and returns once
+    // all of them are done. Has to be called right before root is updated,
+    // with nothing else using the tree.
+    void measure(update_context &ctx, widget &root);
+    // Containers measured by the last measure()
+    size_t measured_containers = 0;
+
+  private:
+    struct task {
+        flex_widget *container;
+        constraints limits;
+    };
+    void collect(widget &w, const constraints &limits);
+    void work(update_context &ctx);
+    void worker(std::stop_token stop, size_t index);
+
+    std::vector<task> _tasks;
+    std::atomic<size_t> _next_task = 0;
+    std::vector<NVGcontext *> _contexts;
+    NVGcontext *_fonts = nullptr;
+    update_context *_ctx = nullptr;
+
+    std::mutex _lock;
+    std::condition_variable_any _start;
+    std::condition_variable _done;
+    uint64_t _round = 0;
+    size_t _busy = 0;
+    std::vector<std::jthread> _workers;
+};
+} // namespace ui
@@ -1,4 +1,6 @@
 #pragma once
+#include "breeze_ui/display_list.h"
+#include "breeze_ui/text_metrics.h"
 #include "glad/glad.h"
 #include "nanosvg.h"
 #include "nanosvgrast.h"
@@ -24,38 +26,43 @@ console.log([...nanovgSource.replace(/,\n/gm, ',').replaceAll('\t', '').matchAll
           })
         .join(',')
     }); }`
+// Calls that draw or change state are also passed to record(), see
+// display_list
+
 }).join('\n'))
    */
 
   float offset_x = 0, offset_y = 0;
+  // Set to also append the calls to a display_list
+  display_list *recording = nullptr;
 
 
 inline auto beginFrame( float windowWidth, float windowHeight, float devicePixelRatio) { return nvgBeginFrame(ctx,windowWidth,windowHeight,devicePixelRatio); }
 inline auto cancelFrame() { return nvgCancelFrame(ctx); }
 inline auto endFrame() { return nvgEndFrame(ctx); }
-inline auto globalCompositeOperation( int op) { return nvgGlobalCompositeOperation(ctx,op); }
-inline auto globalCompositeBlendFunc( int sfactor, int dfactor) { return nvgGlobalCompositeBlendFunc(ctx,sfactor,dfactor); }
-inline auto globalCompositeBlendFuncSeparate( int srcRGB, int dstRGB, int srcAlpha, int dstAlpha) { return nvgGlobalCompositeBlendFuncSeparate(ctx,srcRGB,dstRGB,srcAlpha,dstAlpha); }
-inline auto save() { return nvgSave(ctx); }
-inline auto restore() { return nvgRestore(ctx); }
-inline auto reset() { return nvgReset(ctx); }
-inline auto shapeAntiAlias( int enabled) { return nvgShapeAntiAlias(ctx,enabled); }
-inline auto strokeColor( NVGcolor color) { return nvgStrokeColor(ctx,color); }
-inline auto strokePaint( NVGpaint paint) { return nvgStrokePaint(ctx,paint); }
-inline auto fillColor( NVGcolor color) { return nvgFillColor(ctx,color); }
-inline auto fillPaint( NVGpaint paint) { return nvgFillPaint(ctx,paint); }
-inline auto miterLimit( float limit) { return nvgMiterLimit(ctx,limit); }
-inline auto strokeWidth( float size) { return nvgStrokeWidth(ctx,size); }
-inline auto lineCap( int cap) { return nvgLineCap(ctx,cap); }
-inline auto lineJoin( int join) { return nvgLineJoin(ctx,join); }
-inline auto globalAlpha( float alpha) { return nvgGlobalAlpha(ctx,alpha); }
-inline auto resetTransform() { return nvgResetTransform(ctx); }
-inline auto transform( float a, float b, float c, float d, float e, float f) { return nvgTransform(ctx,a,b,c,d,e,f); }
-inline auto translate( float x, float y) { return nvgTranslate(ctx,x,y); }
-inline auto rotate( float angle) { return nvgRotate(ctx,angle); }
-inline auto skewX( float angle) { return nvgSkewX(ctx,angle); }
-inline auto skewY( float angle) { return nvgSkewY(ctx,angle); }
-inline auto scale( float x, float y) { return nvgScale(ctx,x + offset_x,y + offset_y); }
+inline auto globalCompositeOperation( int op) { record(display_list::op::composite_operation,op); return nvgGlobalCompositeOperation(ctx,op); }
+inline auto globalCompositeBlendFunc( int sfactor, int dfactor) { record(display_list::op::composite_blend_func,sfactor,dfactor); return nvgGlobalCompositeBlendFunc(ctx,sfactor,dfactor); }
+inline auto globalCompositeBlendFuncSeparate( int srcRGB, int dstRGB, int srcAlpha, int dstAlpha) { record(display_list::op::composite_blend_func_separate,srcRGB,dstRGB,srcAlpha,dstAlpha); return nvgGlobalCompositeBlendFuncSeparate(ctx,srcRGB,dstRGB,srcAlpha,dstAlpha); }
+inline auto save() { record(display_list::op::save); return nvgSave(ctx); }
+inline auto restore() { record(display_list::op::restore); return nvgRestore(ctx); }
+inline auto reset() { record(display_list::op::reset); return nvgReset(ctx); }
+inline auto shapeAntiAlias( int enabled) { record(display_list::op::shape_anti_alias,enabled); return nvgShapeAntiAlias(ctx,enabled); }
+inline auto strokeColor( NVGcolor color) { record(display_list::op::stroke_color,color); return nvgStrokeColor(ctx,color); }
+inline auto strokePaint( NVGpaint paint) { record(display_list::op::stroke_paint,paint); return nvgStrokePaint(ctx,paint); }
+inline auto fillColor( NVGcolor color) { record(display_list::op::fill_color,color); return nvgFillColor(ctx,color); }
+inline auto fillPaint( NVGpaint paint) { record(display_list::op::fill_paint,paint); return nvgFillPaint(ctx,paint); }
+inline auto miterLimit( float limit) { record(display_list::op::miter_limit,limit); return nvgMiterLimit(ctx,limit); }
+inline auto strokeWidth( float size) { record(display_list::op::stroke_width,size); return nvgStrokeWidth(ctx,size); }
+inline auto lineCap( int cap) { record(display_list::op::line_cap,cap); return nvgLineCap(ctx,cap); }
+inline auto lineJoin( int join) { record(display_list::op::line_join,join); return nvgLineJoin(ctx,join); }
+inline auto globalAlpha( float alpha) { record(display_list::op::global_alpha,alpha); return nvgGlobalAlpha(ctx,alpha); }
+inline auto resetTransform() { record(display_list::op::reset_transform); return nvgResetTransform(ctx); }
+inline auto transform( float a, float b, float c, float d, float e, float f) { record(display_list::op::transform,a,b,c,d,e,f); return nvgTransform(ctx,a,b,c,d,e,f); }
+inline auto translate( float x, float y) { record(display_list::op::translate,x,y); return nvgTranslate(ctx,x,y); }
+inline auto rotate( float angle) { record(display_list::op::rotate,angle); return nvgRotate(ctx,angle); }
+inline auto skewX( float angle) { record(display_list::op::skew_x,angle); return nvgSkewX(ctx,angle); }
+inline auto skewY( float angle) { record(display_list::op::skew_y,angle); return nvgSkewY(ctx,angle); }
+inline auto scale( float x, float y) { record(display_list::op::scale,x + offset_x,y + offset_y); return nvgScale(ctx,x + offset_x,y + offset_y); }
 inline auto currentTransform( float* xform) { return nvgCurrentTransform(ctx,xform); }
 inline auto createImage( const char* filename, int imageFlags) { return nvgCreateImage(ctx,filename,imageFlags); }
 inline auto createImageMem( int imageFlags, unsigned char* data, int ndata) { return nvgCreateImageMem(ctx,imageFlags,data,ndata); }
@@ -67,25 +74,26 @@ inline auto linearGradient( float sx, float sy, float ex, float ey,  NVGcolor ic
 inline auto boxGradient( float x, float y, float w, float h, float r, float f, NVGcolor icol, NVGcolor ocol) { return nvgBoxGradient(ctx,x + offset_x,y + offset_y,w,h,r,f,icol,ocol); }
 inline auto radialGradient( float cx, float cy, float inr, float outr,  NVGcolor icol, NVGcolor ocol) { return nvgRadialGradient(ctx,cx + offset_x,cy + offset_y,inr,outr,icol,ocol); }
 inline auto imagePattern( float ox, float oy, float ex, float ey,float angle, int image, float alpha) { return nvgImagePattern(ctx,ox + offset_x,oy + offset_y,ex,ey,angle,image,alpha); }
-inline auto scissor( float x, float y, float w, float h) { return nvgScissor(ctx,x + offset_x,y + offset_y,w,h); }
-inline auto intersectScissor( float x, float y, float w, float h) { return nvgIntersectScissor(ctx,x + offset_x,y + offset_y,w,h); }
-inline auto resetScissor() { return nvgResetScissor(ctx); }
-inline auto beginPath() { return nvgBeginPath(ctx); }
-inline auto moveTo( float x, float y) { return nvgMoveTo(ctx,x + offset_x,y + offset_y); }
-inline auto lineTo( float x, float y) { return nvgLineTo(ctx,x + offset_x,y + offset_y); }
-inline auto bezierTo( float c1x, float c1y, float c2x, float c2y, float x, float y) { return nvgBezierTo(ctx,c1x + offset_x,c1y + offset_y,c2x,c2y,x + offset_x,y + offset_y); }
-inline auto quadTo( float cx, float cy, float x, float y) { return nvgQuadTo(ctx,cx + offset_x,cy + offset_y,x + offset_x,y + offset_y); }
-inline auto arcTo( float x1, float y1, float x2, float y2, float radius) { return nvgArcTo(ctx,x1 + offset_x,y1 + offset_y,x2 + offset_x,y2 + offset_y,radius); }
-inline auto closePath() { return nvgClosePath(ctx); }
-inline auto pathWinding( int dir) { return nvgPathWinding(ctx,dir); }
-inline auto arc( float cx, float cy, float r, float a0, float a1, int dir) { return nvgArc(ctx,cx + offset_x,cy + offset_y,r,a0,a1,dir); }
-inline auto rect( float x, float y, float w, float h) { return nvgRect(ctx,x + offset_x,y + offset_y,w,h); }
-inline auto roundedRect( float x, float y, float w, float h, float r) { return nvgRoundedRect(ctx,x + offset_x,y + offset_y,w,h,r); }
-inline auto roundedRectVarying( float x, float y, float w, float h, float radTopLeft, float radTopRight, float radBottomRight, float radBottomLeft) { return nvgRoundedRectVarying(ctx,x + offset_x,y + offset_y,w,h,radTopLeft,radTopRight,radBottomRight,radBottomLeft); }
-inline auto ellipse( float cx, float cy, float rx, float ry) { return nvgEllipse(ctx,cx + offset_x,cy + offset_y,rx,ry); }
-inline auto circle( float cx, float cy, float r) { return nvgCircle(ctx,cx + offset_x,cy + offset_y,r); }
-inline auto fill() { return nvgFill(ctx); }
-inline auto stroke() { return nvgStroke(ctx); }
+inline auto scissor( float x, float y, float w, float h) { record(display_list::op::scissor,x + offset_x,y + offset_y,w,h); return nvgScissor(ctx,x + offset_x,y + offset_y,w,h); }
+inline auto intersectScissor( float x, float y, float w, float h) { record(display_list::op::intersect_scissor,x + offset_x,y + offset_y,w,h); return nvgIntersectScissor(ctx,x + offset_x,y + offset_y,w,h); }
+inline auto resetScissor() { record(display_list::op::reset_scissor); return nvgResetScissor(ctx); }
+inline auto currentScissor( float* bounds) { return nvgCurrentScissor(ctx,bounds); }
+inline auto beginPath() { record(display_list::op::begin_path); return nvgBeginPath(ctx); }
+inline auto moveTo( float x, float y) { record(display_list::op::move_to,x + offset_x,y + offset_y); return nvgMoveTo(ctx,x + offset_x,y + offset_y); }
+inline auto lineTo( float x, float y) { record(display_list::op::line_to,x + offset_x,y + offset_y); return nvgLineTo(ctx,x + offset_x,y + offset_y); }
+inline auto bezierTo( float c1x, float c1y, float c2x, float c2y, float x, float y) { record(display_list::op::bezier_to,c1x + offset_x,c1y + offset_y,c2x,c2y,x + offset_x,y + offset_y); return nvgBezierTo(ctx,c1x + offset_x,c1y + offset_y,c2x,c2y,x + offset_x,y + offset_y); }
+inline auto quadTo( float cx, float cy, float x, float y) { record(display_list::op::quad_to,cx + offset_x,cy + offset_y,x + offset_x,y + offset_y); return nvgQuadTo(ctx,cx + offset_x,cy + offset_y,x + offset_x,y + offset_y); }
+inline auto arcTo( float x1, float y1, float x2, float y2, float radius) { record(display_list::op::arc_to,x1 + offset_x,y1 + offset_y,x2 + offset_x,y2 + offset_y,radius); return nvgArcTo(ctx,x1 + offset_x,y1 + offset_y,x2 + offset_x,y2 + offset_y,radius); }
+inline auto closePath() { record(display_list::op::close_path); return nvgClosePath(ctx); }
+inline auto pathWinding( int dir) { record(display_list::op::path_winding,dir); return nvgPathWinding(ctx,dir); }
+inline auto arc( float cx, float cy, float r, float a0, float a1, int dir) { record(display_list::op::arc,cx + offset_x,cy + offset_y,r,a0,a1,dir); return nvgArc(ctx,cx + offset_x,cy + offset_y,r,a0,a1,dir); }
+inline auto rect( float x, float y, float w, float h) { record(display_list::op::rect,x + offset_x,y + offset_y,w,h); return nvgRect(ctx,x + offset_x,y + offset_y,w,h); }
+inline auto roundedRect( float x, float y, float w, float h, float r) { record(display_list::op::rounded_rect,x + offset_x,y + offset_y,w,h,r); return nvgRoundedRect(ctx,x + offset_x,y + offset_y,w,h,r); }
+inline auto roundedRectVarying( float x, float y, float w, float h, float radTopLeft, float radTopRight, float radBottomRight, float radBottomLeft) { record(display_list::op::rounded_rect_varying,x + offset_x,y + offset_y,w,h,radTopLeft,radTopRight,radBottomRight,radBottomLeft); return nvgRoundedRectVarying(ctx,x + offset_x,y + offset_y,w,h,radTopLeft,radTopRight,radBottomRight,radBottomLeft); }
+inline auto ellipse( float cx, float cy, float rx, float ry) { record(display_list::op::ellipse,cx + offset_x,cy + offset_y,rx,ry); return nvgEllipse(ctx,cx + offset_x,cy + offset_y,rx,ry); }
+inline auto circle( float cx, float cy, float r) { record(display_list::op::circle,cx + offset_x,cy + offset_y,r); return nvgCircle(ctx,cx + offset_x,cy + offset_y,r); }
+inline auto fill() { record(display_list::op::fill); return nvgFill(ctx); }
+inline auto stroke() { record(display_list::op::stroke); return nvgStroke(ctx); }
 inline auto createFont( const char* name, const char* filename) { return nvgCreateFont(ctx,name,filename); }
 inline auto createFontAtIndex( const char* name, const char* filename, const int fontIndex) { return nvgCreateFontAtIndex(ctx,name,filename,fontIndex); }
 inline auto createFontMem( const char* name, unsigned char* data, int ndata, int freeData) { return nvgCreateFontMem(ctx,name,data,ndata,freeData); }
@@ -95,15 +103,15 @@ inline auto addFallbackFontId( int baseFont, int fallbackFont) { return nvgAddFa
 inline auto addFallbackFont( const char* baseFont, const char* fallbackFont) { return nvgAddFallbackFont(ctx,baseFont,fallbackFont); }
 inline auto resetFallbackFontsId( int baseFont) { return nvgResetFallbackFontsId(ctx,baseFont); }
 inline auto resetFallbackFonts( const char* baseFont) { return nvgResetFallbackFonts(ctx,baseFont); }
-inline auto fontSize( float size) { return nvgFontSize(ctx,size); }
-inline auto fontBlur( float blur) { return nvgFontBlur(ctx,blur); }
-inline auto textLetterSpacing( float spacing) { return nvgTextLetterSpacing(ctx,spacing); }
-inline auto textLineHeight( float lineHeight) { return nvgTextLineHeight(ctx,lineHeight); }
-inline auto textAlign( int align) { return nvgTextAlign(ctx,align); }
-inline auto fontFaceId( int font) { return nvgFontFaceId(ctx,font); }
-inline auto fontFace( const char* font) { return nvgFontFace(ctx,font); }
-inline auto text( float x, float y, const char* string, const char* end) { return nvgText(ctx,x + offset_x,y + offset_y,string,end); }
-inline auto textBox( float x, float y, float breakRowWidth, const char* string, const char* end) { return nvgTextBox(ctx,x + offset_x,y + offset_y,breakRowWidth,string,end); }
+inline auto fontSize( float size) { record(display_list::op::font_size,size); return nvgFontSize(ctx,size); }
+inline auto fontBlur( float blur) { record(display_list::op::font_blur,blur); return nvgFontBlur(ctx,blur); }
+inline auto textLetterSpacing( float spacing) { record(display_list::op::text_letter_spacing,spacing); return nvgTextLetterSpacing(ctx,spacing); }
+inline auto textLineHeight( float lineHeight) { record(display_list::op::text_line_height,lineHeight); return nvgTextLineHeight(ctx,lineHeight); }
+inline auto textAlign( int align) { record(display_list::op::text_align,align); return nvgTextAlign(ctx,align); }
+inline auto fontFaceId( int font) { record(display_list::op::font_face_id,font); return nvgFontFaceId(ctx,font); }
+inline auto fontFace( const char* font) { record(display_list::op::font_face,font); return nvgFontFace(ctx,font); }
+inline auto text( float x, float y, const char* string, const char* end) { record_text(display_list::op::text, x + offset_x, y + offset_y, 0, string, end); return nvgText(ctx,x + offset_x,y + offset_y,string,end); }
+inline auto textBox( float x, float y, float breakRowWidth, const char* string, const char* end) { record_text(display_list::op::text_box, x + offset_x, y + offset_y, breakRowWidth, string, end); return nvgTextBox(ctx,x + offset_x,y + offset_y,breakRowWidth,string,end); }
 inline auto textBounds( float x, float y, const char* string, const char* end, float* bounds) { return nvgTextBounds(ctx,x + offset_x,y + offset_y,string,end,bounds); }
 inline auto textBoxBounds( float x, float y, float breakRowWidth, const char* string, const char* end, float* bounds) { return nvgTextBoxBounds(ctx,x + offset_x,y + offset_y,breakRowWidth,string,end,bounds); }
 inline auto textGlyphPositions( float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions) { return nvgTextGlyphPositions(ctx,x + offset_x,y + offset_y,string,end,positions,maxPositions); }
@@ -115,6 +123,37 @@ inline auto debugDumpPathCache() { return nvgDebugDumpPathCache(ctx); }
 inline auto fonsResetAtlas() { return nvgFonsResetAtlas(ctx); }
     // clang-format on
 
+    template <typename... T>
+    inline void record(display_list::op type, T... values) {
+        if (recording)
+            recording->push(type, std::initializer_list<float>{
+                                      static_cast<float>(values)...});
+    }
+    inline void record(display_list::op type, NVGcolor color) {
+        if (recording)
+            recording->push(type, color);
+    }
+    inline void record(display_list::op type, const NVGpaint &paint) {
+        if (recording)
+            recording->push(type, paint);
+    }
+    inline void record(display_list::op type, const char *font_face) {
+        if (recording)
+            recording->push(type, font_face);
+    }
+    inline void record_text(display_list::op type, float x, float y,
+                            float break_row_width, const char *string,
+                            const char *end) {
+        if (recording)
+            recording->push_text(type, x, y, break_row_width, string, end);
+    }
+    // Makes the calls of a display_list again, and records them too
+    inline void play(const display_list &list) {
+        list.replay(ctx);
+        if (recording)
+            recording->append(list);
+    }
+
     // shortcuts
     inline auto fillRect(float x, float y, float w, float h) {
         beginPath();
@@ -164,39 +203,28 @@ inline auto fonsResetAtlas() { return nvgFonsResetAtlas(ctx); }
         stroke();
     }
 
+    // The measure helpers go through the text metrics cache of the context
     inline auto measureTextWithYOffset(const char *string) {
-        float bounds[4];
-        nvgTextBounds(ctx, 0, 0, string, nullptr, bounds);
-        auto align = nvgGetTextAlign(ctx);
-        return std::make_tuple(bounds[2] - bounds[0], bounds[3] - bounds[1],
-                               (align & NVG_ALIGN_TOP) ? (-bounds[1])
-                               : (align & NVG_ALIGN_BOTTOM)
-                                   ? bounds[3]
-                                   : (bounds[3] - bounds[1]) / 2 - bounds[3]);
+        auto m = ui::text_metrics_cache::of(ctx).measure(ctx, string);
+        return std::make_tuple(m.width, m.height, m.y_offset);
     }
 
     inline auto measureTextBoxWithYOffset(const char *string,
                                           float breakRowWidth) {
-        float bounds[4];
-        nvgTextBoxBounds(ctx, 0, 0, breakRowWidth, string, nullptr, bounds);
-        auto align = nvgGetTextAlign(ctx);
-        return std::make_tuple(bounds[2] - bounds[0], bounds[3] - bounds[1],
-                               (align & NVG_ALIGN_TOP) ? (-bounds[1])
-                               : (align & NVG_ALIGN_BOTTOM)
-                                   ? bounds[3]
-                                   : (bounds[3] - bounds[1]) / 2 - bounds[3]);
+        auto m = ui::text_metrics_cache::of(ctx).measure(ctx, string,
+                                                          breakRowWidth);
+        return std::make_tuple(m.width, m.height, m.y_offset);
     }
 
     inline auto measureText(const char *string) {
-        float bounds[4];
-        textBounds(0, 0, string, nullptr, bounds);
-        return std::make_pair(bounds[2] - bounds[0], bounds[3] - bounds[1]);
+        auto m = ui::text_metrics_cache::of(ctx).measure(ctx, string);
+        return std::make_pair(m.width, m.height);
     }
 
     inline auto measureTextBox(const char *string, float breakRowWidth) {
-        float bounds[4];
-        textBoxBounds(0, 0, breakRowWidth, string, nullptr, bounds);
-        return std::make_pair(bounds[2] - bounds[0], bounds[3] - bounds[1]);
+        auto m = ui::text_metrics_cache::of(ctx).measure(ctx, string,
+                                                          breakRowWidth);
+        return std::make_pair(m.width, m.height);
     }
 
     inline nanovg_context with_offset(float x, float y) {
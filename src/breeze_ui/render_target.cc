@@ -0,0 +1,85 @@
+#include "breeze_ui/trace.h"
+#include "breeze_ui/ui.h"
+
+#include <cmath>
+
+// The parts of render_target that don't touch the window, shared by the
+// Win32 loop in ui.cc and by headless_target
+namespace ui {
+std::atomic_int render_target::view_cnt = 0;
+thread_local render_target *render_target::current = nullptr;
+
+damage_region render_target::update_frame(update_context &ctx) {
+    std::lock_guard lock(rt_lock);
+    root->owner_rt = this;
+    render_target::current = this;
+    next_frame_delay = INFINITY;
+    drawn_widgets = culled_widgets = skipped_updates = 0;
+    replayed_widgets = 0;
+    measure_calls = 0;
+    {
+        // Swapping keeps the capacity of both, no frame allocates for input
+        std::lock_guard input_lock(incoming_input_lock);
+        input_events.swap(incoming_input);
+        incoming_input.clear();
+    }
+    text_input.clear();
+    for (const auto &event : input_events) {
+        if (event.type == input_event::kind::text) {
+            text_input.push_back(event.codepoint);
+        } else if (event.key >= 0 && event.key <= GLFW_KEY_LAST &&
+                   event.action != GLFW_REPEAT) {
+            held_keys[event.key] = event.action == GLFW_PRESS;
+        }
+    }
+    {
+        trace_zone zone("hit test");
+        frame_number++;
+        hit_index.query(ctx.mouse_x, ctx.mouse_y);
+    }
+    {
+        trace_zone zone("animations");
+        animations->tick(ctx.delta_time);
+    }
+    if (layout_threads) {
+        trace_zone zone("layout");
+        if (!layout_workers || layout_workers->threads() != layout_threads)
+            layout_workers = std::make_unique<layout_pool>(layout_threads);
+        layout_workers->measure(ctx, *root);
+    }
+    {
+        // Layout that isn't done by the pool happens in here too
+        trace_zone zone("update");
+        root->update(ctx);
+    }
+    {
+        trace_zone zone("damage");
+        root->collect_damage(ctx);
+    }
+    next_frame_delay = std::min(next_frame_delay, animations->next_change_in());
+    auto frame_damage = damage;
+    damage.clear();
+    return frame_damage;
+}
+
+void render_target::push_input_event(input_event event) {
+    event.time = clock.now();
+    std::lock_guard lock(incoming_input_lock);
+    incoming_input.push_back(event);
+}
+
+void render_target::request_frame() {
+    {
+        std::lock_guard lock(frame_request_lock);
+        frame_requested = true;
+    }
+    frame_request_cv.notify_one();
+}
+
+void render_target::clear_ime_composition() {
+    std::lock_guard lock(ime_composition_lock);
+    ime_composition = {};
+}
+
+void render_target::begin_acrylic_frame() { acrylic_regions.clear(); }
+} // namespace ui
@@ -0,0 +1,321 @@
+#include "breeze_ui/text_document.h"
+
+#include <algorithm>
+
+namespace {
+bool is_continuation_byte(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// xorshift32, priorities only have to be spread out
+uint32_t next_random(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void append_breaks(std::vector<size_t> &breaks, std::string_view text,
+                   size_t base) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n')
+            breaks.push_back(base + i);
+    }
+}
+} // namespace
+
+ui::text_document::text_document(std::string text) { assign(std::move(text)); }
+
+size_t ui::text_document::length_of(uint32_t n) const {
+    return n == no_node ? 0 : _nodes[n].length;
+}
+
+size_t ui::text_document::breaks_of(uint32_t n) const {
+    return n == no_node ? 0 : _nodes[n].subtree_breaks;
+}
+
+size_t ui::text_document::breaks_before(bool added, size_t pos) const {
+    const auto &breaks = added ? _added_breaks : _original_breaks;
+    return static_cast<size_t>(std::ranges::lower_bound(breaks, pos) -
+                               breaks.begin());
+}
+
+uint32_t ui::text_document::make_node(const piece &p, uint32_t priority) {
+    uint32_t n;
+    if (!_free.empty()) {
+        n = _free.back();
+        _free.pop_back();
+    } else {
+        n = static_cast<uint32_t>(_nodes.size());
+        _nodes.emplace_back();
+    }
+    auto &node = _nodes[n];
+    node = {};
+    node.p = p;
+    node.breaks = breaks_before(p.added, p.start + p.length) -
+                  breaks_before(p.added, p.start);
+    node.priority = priority;
+    update(n);
+    return n;
+}
+
+void ui::text_document::update(uint32_t n) {
+    auto &node = _nodes[n];
+    node.length = length_of(node.left) + node.p.length + length_of(node.right);
+    node.subtree_breaks =
+        breaks_of(node.left) + node.breaks + breaks_of(node.right);
+}
+
+std::pair<uint32_t, uint32_t> ui::text_document::split(uint32_t n,
+                                                       size_t offset) {
+    if (n == no_node)
+        return {no_node, no_node};
+    auto left_length = length_of(_nodes[n].left);
+    auto piece_end = left_length + _nodes[n].p.length;
+    if (offset <= left_length) {
+        auto [left, right] = split(_nodes[n].left, offset);
+        _nodes[n].left = right;
+        update(n);
+        return {left, n};
+    }
+    if (offset >= piece_end) {
+        auto [left, right] = split(_nodes[n].right, offset - piece_end);
+        _nodes[n].right = left;
+        update(n);
+        return {n, right};
+    }
+
+    // The piece itself is split, its tail takes its place above the right
+    // subtree
+    auto head_length = offset - left_length;
+    auto tail = _nodes[n].p;
+    tail.start += head_length;
+    tail.length -= head_length;
+    auto t = make_node(tail, _nodes[n].priority);
+    _nodes[t].right = _nodes[n].right;
+    update(t);
+    auto &head = _nodes[n];
+    head.right = no_node;
+    head.p.length = head_length;
+    head.breaks -= _nodes[t].breaks;
+    update(n);
+    return {n, t};
+}
+
+uint32_t ui::text_document::merge(uint32_t left, uint32_t right) {
+    if (left == no_node)
+        return right;
+    if (right == no_node)
+        return left;
+    if (_nodes[left].priority > _nodes[right].priority) {
+        _nodes[left].right = merge(_nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    _nodes[right].left = merge(left, _nodes[right].left);
+    update(right);
+    return right;
+}
+
+void ui::text_document::free_nodes(uint32_t n) {
+    if (n == no_node)
+        return;
+    free_nodes(_nodes[n].left);
+    free_nodes(_nodes[n].right);
+    _free.push_back(n);
+}
+
+size_t ui::text_document::line_start(size_t line) const {
+    line = std::min(line, line_count() - 1);
+    // Start of the document or just after the line-th '\n'
+    size_t base = 0;
+    for (auto n = _root; n != no_node && line;) {
+        const auto &node = _nodes[n];
+        if (line <= breaks_of(node.left)) {
+            n = node.left;
+            continue;
+        }
+        line -= breaks_of(node.left);
+        base += length_of(node.left);
+        if (line <= node.breaks) {
+            auto first = breaks_before(node.p.added, node.p.start);
+            const auto &breaks =
+                node.p.added ? _added_breaks : _original_breaks;
+            return base + breaks[first + line - 1] - node.p.start + 1;
+        }
+        line -= node.breaks;
+        base += node.p.length;
+        n = node.right;
+    }
+    return base;
+}
+
+size_t ui::text_document::line_end(size_t line) const {
+    return line + 1 < line_count() ? line_start(line + 1) - 1 : _size;
+}
+
+size_t ui::text_document::line_of(size_t offset) const {
+    // The '\n' before offset
+    size_t line = 0;
+    for (auto n = _root; n != no_node;) {
+        const auto &node = _nodes[n];
+        auto left_length = length_of(node.left);
+        if (offset < left_length) {
+            n = node.left;
+            continue;
+        }
+        line += breaks_of(node.left);
+        offset -= left_length;
+        if (offset < node.p.length) {
+            return line + breaks_before(node.p.added, node.p.start + offset) -
+                   breaks_before(node.p.added, node.p.start);
+        }
+        line += node.breaks;
+        offset -= node.p.length;
+        n = node.right;
+    }
+    return line;
+}
+
+std::string_view ui::text_document::piece_text(const piece &p) const {
+    return std::string_view(p.added ? _added : _original)
+        .substr(p.start, p.length);
+}
+
+char ui::text_document::at(size_t offset) const {
+    if (offset >= _size)
+        return '\0';
+    for (auto n = _root;;) {
+        const auto &node = _nodes[n];
+        auto left_length = length_of(node.left);
+        if (offset < left_length) {
+            n = node.left;
+        } else if (offset - left_length < node.p.length) {
+            return piece_text(node.p)[offset - left_length];
+        } else {
+            offset -= left_length + node.p.length;
+            n = node.right;
+        }
+    }
+}
+
+void ui::text_document::collect(uint32_t n, size_t from, size_t to,
+                                std::string &out) const {
+    if (n == no_node || from >= to)
+        return;
+    const auto &node = _nodes[n];
+    auto left_length = length_of(node.left);
+    auto piece_end = left_length + node.p.length;
+    if (from < left_length)
+        collect(node.left, from, std::min(to, left_length), out);
+    if (from < piece_end && to > left_length) {
+        auto begin = std::max(from, left_length);
+        out += piece_text(node.p).substr(begin - left_length,
+                                         std::min(to, piece_end) - begin);
+    }
+    if (to > piece_end)
+        collect(node.right, std::max(from, piece_end) - piece_end,
+                to - piece_end, out);
+}
+
+std::string ui::text_document::text(size_t offset, size_t length) const {
+    std::string result;
+    if (offset >= _size)
+        return result;
+    length = std::min(length, _size - offset);
+    result.reserve(length);
+    collect(_root, offset, offset + length, result);
+    return result;
+}
+
+std::string ui::text_document::line(size_t line) const {
+    auto start = line_start(line);
+    return text(start, line_end(line) - start);
+}
+
+std::string ui::text_document::str() const { return text(0, _size); }
+
+void ui::text_document::assign(std::string text) {
+    _original = std::move(text);
+    _added.clear();
+    _original_breaks.clear();
+    _added_breaks.clear();
+    append_breaks(_original_breaks, _original, 0);
+    _nodes.clear();
+    _free.clear();
+    _root = no_node;
+    if (!_original.empty())
+        _root = make_node({false, 0, _original.size()}, next_random(_random));
+    _size = _original.size();
+    _revision++;
+}
+
+void ui::text_document::insert(size_t offset, std::string_view text) {
+    if (text.empty())
+        return;
+    offset = std::min(offset, _size);
+
+    auto [before, after] = split(_root, offset);
+    auto start = _added.size();
+    _added += text;
+    append_breaks(_added_breaks, text, start);
+
+    // Typing continues the piece typed before, the last one of `before`
+    auto last = before;
+    while (last != no_node && _nodes[last].right != no_node)
+        last = _nodes[last].right;
+    if (last != no_node && _nodes[last].p.added &&
+        _nodes[last].p.start + _nodes[last].p.length == start) {
+        auto breaks = _added_breaks.size() - breaks_before(true, start);
+        _nodes[last].p.length += text.size();
+        _nodes[last].breaks += breaks;
+        for (auto n = before; n != no_node; n = _nodes[n].right) {
+            _nodes[n].length += text.size();
+            _nodes[n].subtree_breaks += breaks;
+        }
+    } else {
+        before = merge(before,
+                       make_node({true, start, text.size()},
+                                 next_random(_random)));
+    }
+    _root = merge(before, after);
+    _size += text.size();
+    _revision++;
+}
+
+void ui::text_document::erase(size_t offset, size_t length) {
+    if (offset >= _size || !length)
+        return;
+    length = std::min(length, _size - offset);
+
+    auto [before, rest] = split(_root, offset);
+    auto [removed, after] = split(rest, length);
+    free_nodes(removed);
+    _root = merge(before, after);
+    _size -= length;
+    _revision++;
+}
+
+size_t ui::text_document::char_start(size_t offset) const {
+    offset = std::min(offset, _size);
+    while (offset > 0 && offset < _size && is_continuation_byte(at(offset)))
+        offset--;
+    return offset;
+}
+
+size_t ui::text_document::next_char(size_t offset) const {
+    offset = char_start(offset);
+    if (offset >= _size)
+        return _size;
+    offset++;
+    while (offset < _size && is_continuation_byte(at(offset)))
+        offset++;
+    return offset;
+}
+
+size_t ui::text_document::prev_char(size_t offset) const {
+    offset = char_start(offset);
+    if (offset == 0)
+        return 0;
+    return char_start(offset - 1);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ui {
+// The text of a large document as a piece table. The text it was created
+// with and everything inserted since stay where they are, an edit only
+// splits, adds and drops pieces. The pieces are kept in a balanced tree
+// that knows the length and the line breaks of each subtree, so finding an
+// offset or a line and editing take O(log n) in the number of pieces and
+// line breaks, instead of growing with the size of the document.
+// Offsets are in bytes of UTF-8.
+struct text_document {
+    text_document() = default;
+    explicit text_document(std::string text);
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    // Changes with every edit
+    uint64_t revision() const { return _revision; }
+    size_t piece_count() const { return _nodes.size() - _free.size(); }
+
+    // Lines are separated by '\n', an empty document has one line
+    size_t line_count() const { return breaks_of(_root) + 1; }
+    size_t line_start(size_t line) const;
+    // Where the line ends, before its '\n'
+    size_t line_end(size_t line) const;
+    size_t line_of(size_t offset) const;
+
+    char at(size_t offset) const;
+    std::string text(size_t offset, size_t length) const;
+    std::string line(size_t line) const;
+    std::string str() const;
+
+    void assign(std::string text);
+    void insert(size_t offset, std::string_view text);
+    void erase(size_t offset, size_t length);
+
+    // Offsets of the UTF-8 characters around offset, which is moved back to
+    // the start of its character first
+    size_t char_start(size_t offset) const;
+    size_t next_char(size_t offset) const;
+    size_t prev_char(size_t offset) const;
+
+  private:
+    struct piece {
+        // In _added, otherwise in _original
+        bool added = false;
+        size_t start = 0, length = 0;
+    };
+    static constexpr uint32_t no_node = UINT32_MAX;
+    // A treap ordered by the place of the pieces in the document. Priorities
+    // are random, which keeps it balanced in expectation.
+    struct node {
+        piece p;
+        // '\n' in the piece
+        size_t breaks = 0;
+        uint32_t priority = 0;
+        uint32_t left = no_node, right = no_node;
+        // Bytes and '\n' of the subtree
+        size_t length = 0, subtree_breaks = 0;
+    };
+    std::string_view piece_text(const piece &p) const;
+    // '\n' in the buffer of the piece before pos
+    size_t breaks_before(bool added, size_t pos) const;
+    uint32_t make_node(const piece &p, uint32_t priority);
+    void update(uint32_t n);
+    size_t length_of(uint32_t n) const;
+    size_t breaks_of(uint32_t n) const;
+    // The subtree split into the first offset bytes and the rest
+    std::pair<uint32_t, uint32_t> split(uint32_t n, size_t offset);
+    uint32_t merge(uint32_t left, uint32_t right);
+    void free_nodes(uint32_t n);
+    // Appends the bytes from, to of the subtree to out
+    void collect(uint32_t n, size_t from, size_t to, std::string &out) const;
+
+    std::string _original, _added;
+    // Offsets of the '\n' in _original and _added
+    std::vector<size_t> _original_breaks, _added_breaks;
+    std::vector<node> _nodes;
+    std::vector<uint32_t> _free;
+    uint32_t _root = no_node;
+    uint32_t _random = 0x9E3779B9;
+    size_t _size = 0;
+    uint64_t _revision = 0;
+};
+} // namespace ui
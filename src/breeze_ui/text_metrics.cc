@@ -0,0 +1,128 @@
+#include "breeze_ui/text_metrics.h"
+#include "breeze_ui/font.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace {
+std::mutex g_caches_lock;
+std::unordered_map<NVGcontext *, std::unique_ptr<ui::text_metrics_cache>>
+    g_caches;
+// Changes when a cache is freed, so that no thread keeps using it
+std::atomic<uint64_t> g_caches_epoch = 0;
+
+struct last_cache {
+    NVGcontext *ctx = nullptr;
+    ui::text_metrics_cache *cache = nullptr;
+    uint64_t epoch = 0;
+};
+thread_local last_cache t_last_cache;
+
+size_t hash_key(std::string_view text, const NVGtextStyle &style,
+                float break_row_width) {
+    size_t seed = std::hash<std::string_view>{}(text);
+    auto mix = [&](auto value) {
+        seed ^= std::hash<decltype(value)>{}(value) + 0x9e3779b97f4a7c15 +
+                (seed << 6) + (seed >> 2);
+    };
+    mix(style.fontId);
+    mix(style.fontSize);
+    mix(style.letterSpacing);
+    mix(style.lineHeight);
+    mix(style.textAlign);
+    mix(style.scale);
+    mix(style.fontBlur);
+    mix(break_row_width);
+    return seed;
+}
+} // namespace
+
+bool ui::same_text_style(const NVGtextStyle &a, const NVGtextStyle &b) {
+    return a.fontId == b.fontId && a.fontSize == b.fontSize &&
+           a.letterSpacing == b.letterSpacing &&
+           a.lineHeight == b.lineHeight && a.textAlign == b.textAlign &&
+           a.scale == b.scale && a.fontBlur == b.fontBlur;
+}
+
+ui::text_metrics_cache &ui::text_metrics_cache::of(NVGcontext *ctx) {
+    auto &last = t_last_cache;
+    auto epoch = g_caches_epoch.load(std::memory_order_acquire);
+    if (last.ctx == ctx && last.epoch == epoch)
+        return *last.cache;
+
+    std::lock_guard lock(g_caches_lock);
+    auto &cache = g_caches[ctx];
+    if (!cache)
+        cache = std::make_unique<text_metrics_cache>();
+    last = {ctx, cache.get(), epoch};
+    return *cache;
+}
+
+void ui::text_metrics_cache::forget(NVGcontext *ctx) {
+    std::lock_guard lock(g_caches_lock);
+    if (g_caches.erase(ctx))
+        g_caches_epoch++;
+}
+
+ui::text_metrics ui::text_metrics_cache::measure(NVGcontext *ctx,
+                                                 std::string_view text,
+                                                 float break_row_width) {
+    if (auto generation = font_registry_generation();
+        generation != _font_generation) {
+        clear();
+        _font_generation = generation;
+    }
+
+    NVGtextStyle style;
+    nvgGetTextStyle(ctx, &style);
+    if (break_row_width < 0)
+        break_row_width = -1;
+    auto hash = hash_key(text, style, break_row_width);
+    auto [begin, end] = _index.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+        auto &e = *it->second;
+        if (e.text == text && e.break_row_width == break_row_width &&
+            same_text_style(e.style, style)) {
+            hits++;
+            _entries.splice(_entries.begin(), _entries, it->second);
+            return e.metrics;
+        }
+    }
+
+    misses++;
+    float bounds[4];
+    auto first = text.data(), last = text.data() + text.size();
+    if (break_row_width < 0)
+        nvgTextBounds(ctx, 0, 0, first, last, bounds);
+    else
+        nvgTextBoxBounds(ctx, 0, 0, break_row_width, first, last, bounds);
+    text_metrics metrics{
+        .width = bounds[2] - bounds[0],
+        .height = bounds[3] - bounds[1],
+        .y_offset = (style.textAlign & NVG_ALIGN_TOP)      ? -bounds[1]
+                    : (style.textAlign & NVG_ALIGN_BOTTOM) ? bounds[3]
+                    : (bounds[3] - bounds[1]) / 2 - bounds[3],
+    };
+
+    if (_entries.size() >= capacity) {
+        auto &oldest = _entries.back();
+        auto [old_begin, old_end] = _index.equal_range(oldest.hash);
+        for (auto it = old_begin; it != old_end; ++it) {
+            if (&*it->second == &oldest) {
+                _index.erase(it);
+                break;
+            }
+        }
+        _entries.pop_back();
+    }
+    _entries.push_front({std::string(text), style, break_row_width, hash,
+                         metrics});
+    _index.emplace(hash, _entries.begin());
+    return metrics;
+}
+
+void ui::text_metrics_cache::clear() {
+    _entries.clear();
+    _index.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "nanovg.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ui {
+// Size of a measured string and the offset that moves its top to y = 0
+struct text_metrics {
+    float width = 0, height = 0, y_offset = 0;
+};
+
+bool same_text_style(const NVGtextStyle &a, const NVGtextStyle &b);
+
+// Bounds of the strings measured with one NVGcontext. Entries are keyed by
+// the string and the text style of the context, so a hit is what nanovg
+// would have returned, and the least recently used ones are dropped beyond
+// capacity. Registering fonts empties the caches of all contexts.
+struct text_metrics_cache {
+    static constexpr size_t capacity = 4096;
+
+    // The cache of ctx, made on first use. Like the context, only one thread
+    // may use it at a time.
+    static text_metrics_cache &of(NVGcontext *ctx);
+    // Frees the cache of a context that goes away
+    static void forget(NVGcontext *ctx);
+
+    // A single line when break_row_width is negative, otherwise the box of
+    // nvgTextBox. Sizes are in the units of the current transform.
+    text_metrics measure(NVGcontext *ctx, std::string_view text,
+                         float break_row_width = -1);
+    void clear();
+    size_t size() const { return _entries.size(); }
+    size_t hits = 0, misses = 0;
+
+  private:
+    struct entry {
+        std::string text;
+        NVGtextStyle style;
+        float break_row_width;
+        size_t hash;
+        text_metrics metrics;
+    };
+    // Most recently used first
+    std::list<entry> _entries;
+    std::unordered_multimap<size_t, std::list<entry>::iterator> _index;
+    uint64_t _font_generation = 0;
+};
+} // namespace ui
@@ -0,0 +1,200 @@
+#include "breeze_ui/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+namespace {
+uint32_t thread_index() {
+    static std::atomic<uint32_t> next_thread = 1;
+    thread_local uint32_t index = next_thread++;
+    return index;
+}
+
+std::string widget_type_name(const char *name) {
+#if __has_include(<cxxabi.h>)
+    int status = 0;
+    if (auto demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status)) {
+        std::string result = demangled;
+        std::free(demangled);
+        return result;
+    }
+#endif
+    std::string_view result = name;
+    for (std::string_view prefix : {"struct ", "class "}) {
+        if (result.starts_with(prefix))
+            result.remove_prefix(prefix.size());
+    }
+    return std::string(result);
+}
+
+void write_json_string(std::ostream &out, std::string_view s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+} // namespace
+
+ui::trace_buffer::trace_buffer() = default;
+ui::trace_buffer::~trace_buffer() = default;
+
+void ui::trace_buffer::enable(bool widget_zones) {
+    {
+        std::lock_guard lock(_thread_names_lock);
+        if (!_slots)
+            _slots = std::make_unique<slot[]>(capacity);
+    }
+    _widget_zones.store(widget_zones, std::memory_order_relaxed);
+    // Zones only add events after seeing this, the slots exist by then
+    _enabled.store(true, std::memory_order_release);
+}
+
+void ui::trace_buffer::disable() {
+    _enabled.store(false, std::memory_order_relaxed);
+    _widget_zones.store(false, std::memory_order_relaxed);
+}
+
+void ui::trace_buffer::clear() {
+    if (!_slots)
+        return;
+    for (size_t i = 0; i < capacity; i++)
+        _slots[i].seq.store(0, std::memory_order_relaxed);
+}
+
+void ui::trace_buffer::name_thread(std::string name) {
+    auto index = thread_index();
+    std::lock_guard lock(_thread_names_lock);
+    for (auto &[thread, thread_name] : _thread_names) {
+        if (thread == index) {
+            thread_name = std::move(name);
+            return;
+        }
+    }
+    _thread_names.emplace_back(index, std::move(name));
+}
+
+uint64_t ui::trace_buffer::now() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void ui::trace_buffer::add(const char *name, bool widget_type,
+                           uint64_t begin, uint64_t end) {
+    auto index = _next.fetch_add(1, std::memory_order_relaxed);
+    auto &s = _slots[index % capacity];
+    s.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.begin.store(begin, std::memory_order_relaxed);
+    s.duration.store(end - begin, std::memory_order_relaxed);
+    s.thread.store(thread_index(), std::memory_order_relaxed);
+    s.widget_type.store(widget_type, std::memory_order_relaxed);
+    s.seq.store(index + 1, std::memory_order_release);
+}
+
+void ui::trace_buffer::write_chrome_trace(std::ostream &out) const {
+    struct event {
+        const char *name;
+        uint64_t begin, duration;
+        uint32_t thread;
+        bool widget_type;
+    };
+    std::vector<event> events;
+    if (_slots) {
+        events.reserve(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            auto &s = _slots[i];
+            auto seq = s.seq.load(std::memory_order_acquire);
+            if (!seq)
+                continue;
+            event e{
+                s.name.load(std::memory_order_relaxed),
+                s.begin.load(std::memory_order_relaxed),
+                s.duration.load(std::memory_order_relaxed),
+                s.thread.load(std::memory_order_relaxed),
+                s.widget_type.load(std::memory_order_relaxed),
+            };
+            // Overwritten while we read it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) == seq)
+                events.push_back(e);
+        }
+    }
+    std::ranges::sort(events, {}, &event::begin);
+
+    std::unordered_map<const char *, std::string> type_names;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    {
+        std::lock_guard lock(_thread_names_lock);
+        for (auto &[thread, name] : _thread_names) {
+            out << (first ? "\n" : ",\n")
+                << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                << "\"tid\":" << thread << ",\"args\":{\"name\":";
+            write_json_string(out, name);
+            out << "}}";
+            first = false;
+        }
+    }
+    char time[64];
+    for (auto &e : events) {
+        out << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"name\":";
+        if (e.widget_type) {
+            auto [it, inserted] = type_names.try_emplace(e.name);
+            if (inserted)
+                it->second = widget_type_name(e.name);
+            write_json_string(out, it->second);
+        } else {
+            write_json_string(out, e.name);
+        }
+        // Microseconds
+        std::snprintf(time, sizeof(time), "\"ts\":%.3f,\"dur\":%.3f",
+                      e.begin / 1e3, e.duration / 1e3);
+        out << ",\"cat\":\"" << (e.widget_type ? "widget" : "frame")
+            << "\"," << time << ",\"pid\":1,\"tid\":" << e.thread << "}";
+        first = false;
+    }
+    out << "\n]}\n";
+}
+
+bool ui::trace_buffer::dump_chrome_trace(
+    const std::filesystem::path &path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    write_chrome_trace(out);
+    return static_cast<bool>(out);
+}
+
+ui::trace_buffer &ui::tracing() {
+    static trace_buffer *buffer = [] {
+        // Never destroyed, zones on other threads can end after exit
+        auto buffer = new trace_buffer();
+        if (auto path = std::getenv("BREEZE_TRACE"); path && *path) {
+            static std::filesystem::path dump_path = path;
+            buffer->enable();
+            std::atexit([] { tracing().dump_chrome_trace(dump_path); });
+        }
+        return buffer;
+    }();
+    return *buffer;
+}
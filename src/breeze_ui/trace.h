@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace ui {
+// The last events of scoped trace zones from all threads, in a ring buffer
+// that can be written out as a Chrome trace while the program runs. Zones
+// only check a flag while tracing is off, so they stay compiled in.
+struct trace_buffer {
+    // Events kept, older ones are overwritten
+    static constexpr size_t capacity = 1 << 16;
+
+    trace_buffer();
+    trace_buffer(const trace_buffer &) = delete;
+    trace_buffer &operator=(const trace_buffer &) = delete;
+    ~trace_buffer();
+
+    // Widget zones add a zone named after the type of every widget that is
+    // updated or rendered, which costs far more than the frame phases
+    void enable(bool widget_zones = false);
+    void disable();
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+    bool widget_zones() const {
+        return _widget_zones.load(std::memory_order_relaxed);
+    }
+    void clear();
+    // Shows the calling thread with a name in the trace
+    void name_thread(std::string name);
+
+    // Nanoseconds on the clock events are timed with
+    static uint64_t now();
+    void add(const char *name, bool widget_type, uint64_t begin,
+             uint64_t end);
+
+    // The Chrome trace event format, which chrome://tracing and Perfetto
+    // open. Events that are being written are left out.
+    void write_chrome_trace(std::ostream &out) const;
+    bool dump_chrome_trace(const std::filesystem::path &path) const;
+
+  private:
+    // Written without locks, seq is 0 while the event is being written and
+    // the index of the event plus one after
+    struct slot {
+        std::atomic<uint64_t> seq = 0;
+        std::atomic<const char *> name = nullptr;
+        std::atomic<uint64_t> begin = 0, duration = 0;
+        std::atomic<uint32_t> thread = 0;
+        std::atomic<bool> widget_type = false;
+    };
+    std::unique_ptr<slot[]> _slots;
+    std::atomic<uint64_t> _next = 0;
+    std::atomic<bool> _enabled = false, _widget_zones = false;
+
+    mutable std::mutex _thread_names_lock;
+    std::vector<std::pair<uint32_t, std::string>> _thread_names;
+};
+
+// Set BREEZE_TRACE to a file name to start with tracing enabled and have the
+// trace written to it at exit
+trace_buffer &tracing();
+
+// Times the scope it lives in
+struct trace_zone {
+    // name has to outlive the trace, usually a string literal
+    explicit trace_zone(const char *name) {
+        if (tracing().enabled()) {
+            _name = name;
+            _begin = trace_buffer::now();
+        }
+    }
+    // A widget zone, named after the type
+    explicit trace_zone(const std::type_info &widget_type) {
+        if (tracing().widget_zones()) {
+            _name = widget_type.name();
+            _widget_type = true;
+            _begin = trace_buffer::now();
+        }
+    }
+    ~trace_zone() {
+        if (_name)
+            tracing().add(_name, _widget_type, _begin, trace_buffer::now());
+    }
+    trace_zone(const trace_zone &) = delete;
+    trace_zone &operator=(const trace_zone &) = delete;
+
+  private:
+    const char *_name = nullptr;
+    bool _widget_type = false;
+    uint64_t _begin = 0;
+};
+} // namespace ui
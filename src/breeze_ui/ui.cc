@@ -16,19 +16,41 @@
 #include "breeze_ui/ui.h"
 
 #include "breeze_ui/font.h"
+#include "breeze_ui/trace.h"
 #include "breeze_ui/widget.h"
 
 #include "nanovg.h"
 #define NANOVG_GL3
 #include "nanovg_gl.h"
+extern "C" {
+#include "nanovg_gl_utils.h"
+}
 
 #include "shellscalingapi.h"
 #include "simdutf.h"
 
 namespace ui {
-std::atomic_int render_target::view_cnt = 0;
 thread_local static bool is_in_loop_thread = false;
 constexpr wchar_t kRenderTargetPropName[] = L"breeze_ui_render_target";
+// Milliseconds the loop waits after a frame that wasn't presented, about
+// one refresh interval
+constexpr float kUnpresentedFrameDelay = 16;
+
+// Damaged area snapped to whole framebuffer pixels, so that the nanovg
+// scissor and the cleared area line up exactly
+struct pixel_rect {
+    int left, top, right, bottom;
+};
+pixel_rect snap_to_pixels(const rect &bounds, float dpi_scale, int fb_width,
+                          int fb_height) {
+    int left = std::max((int)std::floor(bounds.x * dpi_scale), 0);
+    int top = std::max((int)std::floor(bounds.y * dpi_scale), 0);
+    int right =
+        std::min((int)std::ceil(bounds.right() * dpi_scale), fb_width);
+    int bottom =
+        std::min((int)std::ceil(bounds.bottom() * dpi_scale), fb_height);
+    return {left, top, std::max(right, left), std::max(bottom, top)};
+}
 
 std::u32string utf16_to_u32(std::wstring_view text) {
     if (text.empty()) {
@@ -150,10 +172,12 @@ LRESULT CALLBACK render_target_wndproc(HWND hwnd, UINT msg, WPARAM wparam,
 
     if (msg == WM_KILLFOCUS) {
         rt->clear_ime_composition();
+        rt->request_frame();
     }
 
     if (msg == WM_IME_STARTCOMPOSITION) {
         set_ime_composition_state(rt, {.active = true});
+        rt->request_frame();
         sync_ime_window_position(
             hwnd, rt->ime_caret_active, rt->ime_caret_x, rt->ime_caret_y,
             rt->ime_caret_height, rt->ime_document_x, rt->ime_document_y,
@@ -163,6 +187,7 @@ LRESULT CALLBACK render_target_wndproc(HWND hwnd, UINT msg, WPARAM wparam,
 
     if (msg == WM_IME_ENDCOMPOSITION) {
         rt->clear_ime_composition();
+        rt->request_frame();
         return 0;
     }
 
@@ -179,9 +204,9 @@ LRESULT CALLBACK render_target_wndproc(HWND hwnd, UINT msg, WPARAM wparam,
         if (lparam & GCS_RESULTSTR) {
             const auto result =
                 utf16_to_u32(get_ime_string(himc, GCS_RESULTSTR));
-            if (!result.empty()) {
-                auto lock = rt->char_input.get_back_lock();
-                rt->char_input.get_back() += result;
+            for (auto codepoint : result) {
+                rt->push_input_event({.type = input_event::kind::text,
+                                      .codepoint = codepoint});
             }
             set_ime_composition_state(rt, {});
         } else {
@@ -199,6 +224,7 @@ LRESULT CALLBACK render_target_wndproc(HWND hwnd, UINT msg, WPARAM wparam,
         }
 
         ImmReleaseContext(hwnd, himc);
+        rt->request_frame();
         return 0;
     }
 
@@ -260,10 +286,19 @@ float get_dpi_scale_from_monitor(HMONITOR monitor) {
 
 void render_target::start_loop() {
     is_in_loop_thread = true;
-    glfwMakeContextCurrent(window);
+    tracing().name_thread("loop");
+    if (pipelined) {
+        // The GL context can only be current on one thread
+        glfwMakeContextCurrent(nullptr);
+        frames.open();
+        render_thread = std::jthread([this] { present_loop(); });
+    } else {
+        glfwMakeContextCurrent(window);
+    }
     while (!glfwWindowShouldClose(window) && !should_loop_stop_hide_as_close) {
         sync_acrylic_host();
         render();
+        bool ran_tasks = false;
         {
             while (true) {
                 std::unique_lock lock(loop_thread_tasks_lock);
@@ -273,6 +308,7 @@ void render_target::start_loop() {
                 auto fn = std::move(loop_thread_tasks.front());
                 loop_thread_tasks.pop();
                 lock.unlock();
+                ran_tasks = true;
                 if (!fn) {
                     std::print("Warning: empty task posted to loop thread, "
                                "skipping\n");
@@ -290,6 +326,35 @@ void render_target::start_loop() {
                 }
             }
         }
+
+        // Tasks usually change widgets, pick the changes up right away
+        if (ran_tasks)
+            continue;
+
+        // Sleep until there is input, a posted task, or a widget's next
+        // deadline. Presented frames are paced by the vsync'd swap, a frame
+        // that drew nothing isn't and would spin without a wait.
+        auto delay = next_frame_delay;
+        if (!frame_presented)
+            delay = std::max(delay, kUnpresentedFrameDelay);
+        std::unique_lock lock(frame_request_lock);
+        auto requested = [&] { return frame_requested; };
+        if (std::isinf(delay)) {
+            frame_request_cv.wait(lock, requested);
+            // Nothing was running while we slept, don't let the idle time
+            // leak into the animations started by this frame
+            last_time = clock.now();
+        } else if (delay > 0) {
+            frame_request_cv.wait_for(
+                lock, std::chrono::duration<float, std::milli>(delay),
+                requested);
+        }
+        frame_requested = false;
+    }
+    if (pipelined) {
+        frames.close();
+        render_thread.join();
+        glfwMakeContextCurrent(window);
     }
     if (should_loop_stop_hide_as_close) {
         should_loop_stop_hide_as_close = false;
@@ -303,12 +368,13 @@ void render_target::start_loop() {
         {
             std::lock_guard lock(rt_lock);
             root->children.clear();
+            damage.add_full();
         }
     }
     glfwMakeContextCurrent(nullptr);
 }
 std::expected<bool, std::string> render_target::init() {
-    root = std::make_shared<widget>();
+    root = arena ? arena->make<widget>() : std::make_shared<widget>();
 
     std::ignore = init_global();
     std::promise<void> p;
@@ -412,6 +478,7 @@ std::expected<bool, std::string> render_target::init() {
             rt->width = width / rt->dpi_scale;
             rt->height = height / rt->dpi_scale;
             rt->reset_view();
+            rt->request_frame();
         });
 
     glfwSetWindowFocusCallback(window, [](GLFWwindow *window, int focused) {
@@ -420,6 +487,7 @@ std::expected<bool, std::string> render_target::init() {
         if (thiz->on_focus_changed) {
             thiz->on_focus_changed.value()(focused);
         }
+        thiz->request_frame();
     });
 
     glfwSetWindowContentScaleCallback(
@@ -427,6 +495,7 @@ std::expected<bool, std::string> render_target::init() {
             auto rt =
                 static_cast<render_target *>(glfwGetWindowUserPointer(window));
             rt->dpi_scale = x;
+            rt->request_frame();
         });
 
     glfwSetScrollCallback(
@@ -434,23 +503,46 @@ std::expected<bool, std::string> render_target::init() {
             auto rt =
                 static_cast<render_target *>(glfwGetWindowUserPointer(window));
             rt->scroll_y += yoffset;
+            rt->request_frame();
         });
 
+    // Mouse state is read when the frame is rendered, these only wake the
+    // loop thread
+    glfwSetCursorPosCallback(window, [](GLFWwindow *window, double, double) {
+        static_cast<render_target *>(glfwGetWindowUserPointer(window))
+            ->request_frame();
+    });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow *window, int) {
+        static_cast<render_target *>(glfwGetWindowUserPointer(window))
+            ->request_frame();
+    });
+    glfwSetMouseButtonCallback(window,
+                               [](GLFWwindow *window, int, int, int) {
+                                   static_cast<render_target *>(
+                                       glfwGetWindowUserPointer(window))
+                                       ->request_frame();
+                               });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *window) {
+        auto rt =
+            static_cast<render_target *>(glfwGetWindowUserPointer(window));
+        {
+            std::lock_guard lock(rt->rt_lock);
+            rt->damage.add_full();
+        }
+        rt->request_frame();
+    });
+
     glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
                                   int action, int mods) {
         auto rt =
             static_cast<render_target *>(glfwGetWindowUserPointer(window));
         if (key >= 0 && key <= GLFW_KEY_LAST) {
-            auto lock = rt->key_states.get_back_lock();
-            auto &back = rt->key_states.get_back();
-            if (action == GLFW_PRESS) {
-                back[key] |= key_state::pressed;
-            } else if (action == GLFW_RELEASE) {
-                back[key] |= key_state::released;
-            } else if (action == GLFW_REPEAT) {
-                back[key] |= key_state::repeated;
-            }
+            rt->push_input_event({.type = input_event::kind::key,
+                                  .key = key,
+                                  .action = action,
+                                  .mods = mods});
         }
+        rt->request_frame();
     });
 
     glfwSetCharCallback(window, [](GLFWwindow *window, unsigned int codepoint) {
@@ -459,8 +551,9 @@ std::expected<bool, std::string> render_target::init() {
         if (!rt || codepoint == 0) {
             return;
         }
-        auto lock = rt->char_input.get_back_lock();
-        rt->char_input.get_back().push_back(static_cast<char32_t>(codepoint));
+        rt->push_input_event({.type = input_event::kind::text,
+                              .codepoint = static_cast<char32_t>(codepoint)});
+        rt->request_frame();
     });
 
     dpi_scale = get_dpi_scale_from_monitor(
@@ -490,12 +583,27 @@ render_target::~render_target() {
         acrylic_host_window->shutdown();
     }
 
+    if (render_thread.joinable()) {
+        frames.close();
+        render_thread.join();
+    }
+
     if (nvg) {
         if (window) {
             glfwMakeContextCurrent(window);
         }
+        if (framebuffer) {
+            nvgluDeleteFramebuffer(framebuffer);
+            framebuffer = nullptr;
+        }
+        layers.clear();
+        // Its threads measure with the fonts of nvg
+        layout_workers.reset();
         clear_font_registry(nvg);
+        // The recorder's context has no GL state, deleting it is the same
         nvgDeleteGL3(nvg);
+        if (present_nvg)
+            nvgDeleteGL3(present_nvg);
         if (window) {
             glfwMakeContextCurrent(nullptr);
         }
@@ -504,8 +612,6 @@ render_target::~render_target() {
     glfwDestroyWindow(window);
 }
 
-thread_local render_target *render_target::current = nullptr;
-
 std::expected<bool, std::string> render_target::init_global() {
     static std::atomic_bool initialized = false;
     if (initialized.exchange(true)) {
@@ -545,44 +651,22 @@ std::expected<bool, std::string> render_target::init_global() {
     return future.get();
 }
 void render_target::render() {
+    trace_zone frame_zone("frame");
     int fb_width, fb_height;
     glfwGetFramebufferSize(window, &fb_width, &fb_height);
-    glViewport(0, 0, fb_width, fb_height);
+    if (!pipelined)
+        glViewport(0, 0, fb_width, fb_height);
 
     auto now = clock.now();
     auto delta_time =
         1000 * std::chrono::duration<float>(now - last_time).count();
     last_time = now;
-    if constexpr (true) {
-        static float counter = 0, time_ctr = 0;
-        counter++;
-        time_ctr += delta_time;
-        if (time_ctr > 1000) {
-            time_ctr = 0;
-            std::printf("FPS: %f\n", counter);
-            counter = 0;
-        }
-    }
-
-    auto begin = clock.now();
-    auto ms_steady =
-        duration_cast<std::chrono::milliseconds>(now.time_since_epoch())
-            .count();
-    auto time_checkpoints = [&](const char *name) {
-        if constexpr (false) {
-            auto end = clock.now();
-            auto delta = std::chrono::duration<float>(end - begin).count();
-            std::printf("%s: %fms\n", name, delta);
-            begin = end;
-        }
-    };
 
     nanovg_context vg{nvg, this};
-    time_checkpoints("NanoVG context");
-
     vg.beginFrame(fb_width, fb_height, 1);
     vg.scale(dpi_scale, dpi_scale);
 
+    std::optional<trace_zone> input_zone(std::in_place, "input");
     double mouse_x, mouse_y;
     glfwGetCursorPos(window, &mouse_x, &mouse_y);
     int window_x, window_y;
@@ -619,46 +703,277 @@ void render_target::render() {
     ctx.mouse_clicked = ctx.mouse_down && !mouse_down;
     ctx.right_mouse_clicked = ctx.right_mouse_down && !right_mouse_down;
     ctx.mouse_up = !ctx.mouse_down && mouse_down;
+    ctx.clip = rect{0, 0, fb_width / dpi_scale, fb_height / dpi_scale};
     mouse_down = ctx.mouse_down;
     right_mouse_down = ctx.right_mouse_down;
     set_ime_caret_rect(0, 0, 0, false);
+    input_zone.reset();
     {
-        time_checkpoints("Update context");
-        {
-            std::lock_guard lock(rt_lock);
-            root->owner_rt = this;
-            render_target::current = this;
-            root->update(ctx);
-            key_states.flip();
-            char_input.flip();
+        auto update_start = clock.now();
+        auto frame_damage = update_frame(ctx);
+        auto update_end = clock.now();
+        auto finish_frame = [&](bool repainted) {
+            auto end = clock.now();
+            auto ms = [](auto duration) {
+                return 1000 * std::chrono::duration<float>(duration).count();
+            };
+            stats.record({
+                .interval_ms = delta_time,
+                .total_ms = ms(end - now),
+                .update_ms = ms(update_end - update_start),
+                .render_ms = ms(end - update_end),
+                .repainted = repainted,
+            });
+            if (!print_fps)
+                return;
+            fps_print_elapsed += delta_time;
+            if (fps_print_elapsed > 1000) {
+                auto summary = stats.snapshot();
+                std::println("{}: {} fps, p99 frame time {:.2f} ms", title,
+                             summary.frames - fps_print_frames,
+                             summary.total_ms.p99);
+                fps_print_elapsed = 0;
+                fps_print_frames = summary.frames;
+            }
+        };
+
+        if (pipelined) {
+            trace_zone zone("record");
+            record_frame(vg, frame_damage, need_repaint, fb_width, fb_height);
+            finish_frame(!frame_damage.empty());
+            return;
+        }
+
+        if (!framebuffer || framebuffer_width != fb_width ||
+            framebuffer_height != fb_height ||
+            framebuffer_dpi_scale != dpi_scale) {
+            if (framebuffer)
+                nvgluDeleteFramebuffer(framebuffer);
+            framebuffer = nvgluCreateFramebuffer(nvg, fb_width, fb_height, 0);
+            framebuffer_width = fb_width;
+            framebuffer_height = fb_height;
+            framebuffer_dpi_scale = dpi_scale;
+            frame_damage.add_full();
         }
-        time_checkpoints("Update root");
-        if (need_repaint || (ms_steady - last_repaint) > 1000) {
+
+        if (need_repaint)
+            frame_damage.add_full();
+        // Acrylic regions are registered while rendering, so they need every
+        // widget to be visited
+        if (!frame_damage.empty() &&
+            (acrylic_host_window || !acrylic_regions.empty()))
+            frame_damage.add_full();
+
+        // The framebuffer can't be created while the window has no size
+        bool repainted = !frame_damage.empty() && framebuffer;
+        frame_presented = repainted;
+        if (repainted) {
+            bool layers_rendered;
+            {
+                trace_zone zone("layers");
+                std::lock_guard lock(rt_lock);
+                layers_rendered = layers.render_pending(nvg, this, dpi_scale);
+            }
+            // Layers run frames of their own, start ours again
+            if (layers_rendered) {
+                vg.beginFrame(fb_width, fb_height, 1);
+                vg.scale(dpi_scale, dpi_scale);
+            }
+
+            nvgluBindFramebuffer(framebuffer);
+            glViewport(0, 0, fb_width, fb_height);
             glClearColor(0, 0, 0, 0);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
-                    GL_STENCIL_BUFFER_BIT);
-            last_repaint = ms_steady;
+            if (frame_damage.full) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                        GL_STENCIL_BUFFER_BIT);
+                // Lets widgets outside of the window be culled
+                vg.scissor(0, 0, fb_width / dpi_scale, fb_height / dpi_scale);
+            } else {
+                auto [left, top, right, bottom] = snap_to_pixels(
+                    frame_damage.bounds, dpi_scale, fb_width, fb_height);
+                repaint_region = rect{left / dpi_scale, top / dpi_scale,
+                                      (right - left) / dpi_scale,
+                                      (bottom - top) / dpi_scale};
+
+                glEnable(GL_SCISSOR_TEST);
+                glScissor(left, fb_height - bottom, right - left,
+                          bottom - top);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                        GL_STENCIL_BUFFER_BIT);
+                glDisable(GL_SCISSOR_TEST);
+                vg.scissor(repaint_region->x, repaint_region->y,
+                           repaint_region->width, repaint_region->height);
+            }
+
             {
+                trace_zone zone("render");
                 std::lock_guard lock(rt_lock);
-                begin_acrylic_frame();
+                if (frame_damage.full)
+                    begin_acrylic_frame();
                 root->render(vg);
-                commit_acrylic_frame();
+                if (frame_damage.full)
+                    commit_acrylic_frame();
             }
-            vg.endFrame();
+            {
+                trace_zone zone("endFrame");
+                vg.endFrame();
+            }
+            repaint_region.reset();
+
+            // Windows has no way to present part of a GL surface, so the
+            // whole buffer is copied to the window and swapped
+            trace_zone swap_zone("swap");
+            nvgluBindFramebuffer(nullptr);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, fb_width, fb_height, 0, 0, fb_width,
+                              fb_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
             glFlush();
             glfwSwapBuffers(window);
 
         } else {
             commit_acrylic_frame();
-            if (vsync)
-                Sleep(5);
         }
-        time_checkpoints("Render root");
+        finish_frame(repainted);
+    }
+}
+void render_target::record_frame(nanovg_context &vg,
+                                 damage_region &frame_damage,
+                                 bool need_repaint, int fb_width,
+                                 int fb_height) {
+    // The render thread keeps its framebuffer in step with the frames, a new
+    // one starts out empty
+    if (framebuffer_width != fb_width || framebuffer_height != fb_height ||
+        framebuffer_dpi_scale != dpi_scale) {
+        framebuffer_width = fb_width;
+        framebuffer_height = fb_height;
+        framebuffer_dpi_scale = dpi_scale;
+        frame_damage.add_full();
+    }
+    if (need_repaint)
+        frame_damage.add_full();
+    if (!frame_damage.empty() &&
+        (acrylic_host_window || !acrylic_regions.empty()))
+        frame_damage.add_full();
+    frame_presented = false;
+    if (frame_damage.empty() || fb_width <= 0 || fb_height <= 0) {
+        commit_acrylic_frame();
+        return;
+    }
+
+    auto &frame = frames.back();
+    frame.width = fb_width;
+    frame.height = fb_height;
+    frame.full = frame_damage.full;
+    if (frame.full) {
+        vg.scissor(0, 0, fb_width / dpi_scale, fb_height / dpi_scale);
+    } else {
+        auto [left, top, right, bottom] = snap_to_pixels(
+            frame_damage.bounds, dpi_scale, fb_width, fb_height);
+        frame.clear_left = left;
+        frame.clear_top = top;
+        frame.clear_right = right;
+        frame.clear_bottom = bottom;
+        repaint_region =
+            rect{left / dpi_scale, top / dpi_scale,
+                 (right - left) / dpi_scale, (bottom - top) / dpi_scale};
+        vg.scissor(repaint_region->x, repaint_region->y,
+                   repaint_region->width, repaint_region->height);
+    }
+
+    {
+        trace_zone zone("render");
+        std::lock_guard lock(rt_lock);
+        if (frame_damage.full)
+            begin_acrylic_frame();
+        root->render(vg);
+        if (frame_damage.full)
+            commit_acrylic_frame();
+    }
+    {
+        trace_zone zone("endFrame");
+        vg.endFrame();
+    }
+    repaint_region.reset();
+
+    // Waits for the render thread to be done with the frame before, whose
+    // buffer is recorded into next
+    if (frames.publish()) {
+        frame_presented = true;
+        frames.back().list.clear();
+        recorder.target = &frames.back().list;
+    } else {
+        // The loop is stopping and this frame is never presented. Its
+        // textures are still needed, and the next frame has to be drawn in
+        // full.
+        frames.back().list.drop_drawing();
+        framebuffer_width = 0;
+    }
+}
+void render_target::present_loop() {
+    tracing().name_thread("render");
+    glfwMakeContextCurrent(window);
+    if (!present_nvg) {
+        present_nvg = nvgCreateGL3(NVG_STENCIL_STROKES | NVG_ANTIALIAS);
+        replayer =
+            std::make_unique<draw_replayer>(nvgInternalParams(present_nvg));
+    }
+
+    while (auto frame = frames.acquire()) {
+        trace_zone zone("present");
+        int width = frame->width, height = frame->height;
+        if (!framebuffer || framebuffer->image == 0 ||
+            present_size != std::pair{width, height}) {
+            if (framebuffer)
+                nvgluDeleteFramebuffer(framebuffer);
+            framebuffer = nvgluCreateFramebuffer(present_nvg, width, height, 0);
+            present_size = {width, height};
+        }
+
+        nvgluBindFramebuffer(framebuffer);
+        glViewport(0, 0, width, height);
+        glClearColor(0, 0, 0, 0);
+        if (frame->full) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                    GL_STENCIL_BUFFER_BIT);
+        } else {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(frame->clear_left, height - frame->clear_bottom,
+                      frame->clear_right - frame->clear_left,
+                      frame->clear_bottom - frame->clear_top);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                    GL_STENCIL_BUFFER_BIT);
+            glDisable(GL_SCISSOR_TEST);
+        }
+        {
+            trace_zone zone("replay");
+            replayer->replay(frame->list);
+        }
+
+        trace_zone swap_zone("swap");
+        nvgluBindFramebuffer(nullptr);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glFlush();
+        glfwSwapBuffers(window);
+        frames.release();
     }
+    glfwMakeContextCurrent(nullptr);
 }
 void render_target::reset_view() {
-    if (!nvg)
+    if (nvg)
+        return;
+    if (pipelined) {
+        // Fonts and images are created through the recorder from now on
+        recorder.target = &frames.back().list;
+        nvg = recorder.create_context(true);
+    } else {
         nvg = nvgCreateGL3(NVG_STENCIL_STROKES | NVG_ANTIALIAS);
+    }
 }
 void render_target::set_position(int x, int y) {
     glfwSetWindowPos(window, x, y);
@@ -666,6 +981,11 @@ void render_target::set_position(int x, int y) {
 void render_target::resize(int width, int height) {
     this->width = width;
     this->height = height;
+    {
+        std::lock_guard lock(rt_lock);
+        damage.add_full();
+    }
+    request_frame();
     post_main_thread_task([this] {
         glfwSetWindowSize(window, this->width, this->height);
         glClearColor(0, 0, 0, 0);
@@ -681,6 +1001,7 @@ void render_target::close() {
     }
     ShowWindow(glfwGetWin32Window(window), SW_HIDE);
     glfwSetWindowShouldClose(window, true);
+    request_frame();
 }
 
 std::queue<std::function<void()>> render_target::main_thread_tasks = {};
@@ -706,6 +1027,11 @@ void render_target::show() {
         SetWindowPos(glfwGetWin32Window(window), HWND_TOPMOST, 0, 0, 0, 0,
                      SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
 
+    {
+        std::lock_guard lock(rt_lock);
+        damage.add_full();
+    }
+    request_frame();
     sync_acrylic_host();
 }
 void render_target::hide() {
@@ -727,6 +1053,7 @@ void render_target::hide_as_close() {
         acrylic_host_window->clear();
         acrylic_host_window->hide();
     }
+    request_frame();
 }
 void render_target::post_loop_thread_task(std::function<void()> task,
                                           bool delay) {
@@ -734,8 +1061,11 @@ void render_target::post_loop_thread_task(std::function<void()> task,
         task();
         return;
     }
-    std::lock_guard lock(loop_thread_tasks_lock);
-    loop_thread_tasks.push(std::move(task));
+    {
+        std::lock_guard lock(loop_thread_tasks_lock);
+        loop_thread_tasks.push(std::move(task));
+    }
+    request_frame();
 }
 void render_target::focus() {
     if (this->window) {
@@ -795,16 +1125,10 @@ void render_target::set_ime_caret_rect(float x, float y, float height,
                                  doc_x, doc_y, doc_width, doc_height);
     });
 }
-void render_target::clear_ime_composition() {
-    std::lock_guard lock(ime_composition_lock);
-    ime_composition = {};
-}
 void *render_target::hwnd() const {
     return window ? glfwGetWin32Window(window) : nullptr;
 }
 
-void render_target::begin_acrylic_frame() { acrylic_regions.clear(); }
-
 void render_target::register_acrylic_region(acrylic_region region) {
     if (!window || region.width <= 0 || region.height <= 0 ||
         region.opacity <= 0) {
@@ -1,7 +1,9 @@
 #pragma once
 #include <atomic>
+#include <bitset>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <expected>
 #include <future>
 #include <memory>
@@ -9,6 +11,7 @@
 #include <print>
 #include <queue>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <utility>
 
@@ -16,8 +19,14 @@
 #include "nanovg.h"
 
 #include "breeze_ui/acrylic_host.h"
+#include "breeze_ui/draw_list.h"
+#include "breeze_ui/frame_stats.h"
+#include "breeze_ui/layer_cache.h"
+#include "breeze_ui/layout_pool.h"
 #include "breeze_ui/widget.h"
 
+struct NVGLUframebuffer;
+
 namespace ui {
 
 struct ime_composition_state {
@@ -26,69 +35,94 @@ struct ime_composition_state {
     bool active = false;
 };
 
-template <typename T> struct flip_buffer {
-    T buffer1{}, buffer2{};
-    std::atomic_bool use_buffer2 = false;
-    mutable std::mutex buffer1_lock{}, buffer2_lock{};
-
-    T &get() { return use_buffer2 ? buffer2 : buffer1; }
-    T &get_back() { return use_buffer2 ? buffer1 : buffer2; }
+// Two buffers passed between a producer and a consumer thread without
+// locks. The producer fills back() and publish()es it, the consumer takes
+// it with acquire() and hands it back with release(). publish() waits for
+// the consumer to release the last buffer, so the producer is never more
+// than one buffer ahead and nothing published is skipped.
+template <typename T> struct swap_buffer {
+    T &back() { return buffers[1 - front]; }
 
-    std::unique_lock<std::mutex> get_front_lock() const {
-        return std::unique_lock<std::mutex>(use_buffer2 ? buffer2_lock
-                                                        : buffer1_lock);
+    // Returns false once closed, back() is left as it was
+    bool publish() {
+        auto s = state.load(std::memory_order_acquire);
+        while ((s & ~closed) != empty) {
+            if (s & closed)
+                return false;
+            state.wait(s, std::memory_order_acquire);
+            s = state.load(std::memory_order_acquire);
+        }
+        if (s & closed)
+            return false;
+        front = 1 - front;
+        // Only the producer leaves empty, so this fails only when closed
+        if (!state.compare_exchange_strong(s, ready,
+                                           std::memory_order_release)) {
+            front = 1 - front;
+            return false;
+        }
+        state.notify_all();
+        return true;
     }
-
-    std::unique_lock<std::mutex> get_back_lock() const {
-        return std::unique_lock<std::mutex>(use_buffer2 ? buffer1_lock
-                                                        : buffer2_lock);
+    // Waits for a published buffer. Once closed, the buffer published
+    // before is still handed out, then nullptr.
+    T *acquire() {
+        auto s = state.load(std::memory_order_acquire);
+        while (true) {
+            if ((s & ~closed) == ready) {
+                if (state.compare_exchange_weak(s, busy | (s & closed),
+                                                std::memory_order_acquire))
+                    return &buffers[front];
+                continue;
+            }
+            if (s & closed)
+                return nullptr;
+            state.wait(s, std::memory_order_acquire);
+            s = state.load(std::memory_order_acquire);
+        }
     }
-
-    template <typename U = T,
-              typename = std::enable_if_t<std::is_default_constructible_v<U>>>
-    void flip() {
-        flip(T{});
+    void release() {
+        auto s = state.load(std::memory_order_relaxed);
+        while (!state.compare_exchange_weak(s, empty | (s & closed),
+                                            std::memory_order_release))
+            ;
+        state.notify_all();
     }
-
-    void flip(T value) {
-        {
-            std::unique_lock<std::mutex> lock(use_buffer2 ? buffer1_lock
-                                                          : buffer2_lock);
-            use_buffer2 = !use_buffer2;
-        }
-
-        std::unique_lock<std::mutex> lock(use_buffer2 ? buffer1_lock
-                                                      : buffer2_lock);
-        if (use_buffer2) {
-            buffer1 = value;
-        } else {
-            buffer2 = value;
-        }
+    // Wakes up both sides for good, until open() is called again
+    void close() {
+        state.fetch_or(closed, std::memory_order_acq_rel);
+        state.notify_all();
     }
+    // A buffer published and not consumed yet stays for the next consumer
+    void open() {
+        state.fetch_and(static_cast<uint8_t>(~closed),
+                        std::memory_order_acq_rel);
+    }
+
+  private:
+    enum state_t : uint8_t { empty, ready, busy, closed = 0x80 };
+    T buffers[2]{};
+    // Only written by the producer, while the consumer holds no buffer
+    int front = 0;
+    std::atomic<uint8_t> state = empty;
 };
-enum class key_state : char {
-    none = 0,
-    pressed = 1 << 1,  // Pressed
-    released = 1 << 2, // Released
-    repeated = 1 << 3, // Repeated
-};
-inline constexpr key_state &operator|=(key_state &a, key_state b) {
-    a = static_cast<key_state>(static_cast<char>(a) | static_cast<char>(b));
-    return a;
-}
-inline constexpr key_state operator&(key_state a, key_state b) {
-    return static_cast<key_state>(static_cast<char>(a) & static_cast<char>(b));
-}
-inline constexpr key_state operator|(key_state a, key_state b) {
-    return static_cast<key_state>(static_cast<char>(a) | static_cast<char>(b));
-}
 
-constexpr key_state test_pressed = key_state::pressed | key_state::repeated;
-static_assert((bool)(test_pressed & key_state::pressed),
-              "test_pressed should contain pressed state");
+// A frame recorded on the loop thread, for the render thread to present
+struct recorded_frame {
+    draw_list list;
+    // Framebuffer size in pixels
+    int width = 0, height = 0;
+    // Pixels cleared before drawing when only part of the window is
+    // repainted
+    bool full = true;
+    int clear_left = 0, clear_top = 0, clear_right = 0, clear_bottom = 0;
+};
 
 struct render_target {
     std::shared_ptr<widget> root;
+    // Set before init() to allocate the root, and everything created below
+    // it with emplace_child, from an arena
+    std::shared_ptr<widget_arena> arena;
     GLFWwindow *window;
     static thread_local render_target *current;
     // float: darkness of the acrylic effect, 0~1
@@ -109,11 +143,79 @@ struct render_target {
     int view_id = view_cnt++;
     float dpi_scale = 1;
     float scroll_y = 0;
-    flip_buffer<std::array<key_state, GLFW_KEY_LAST + 1>> key_states;
-    flip_buffer<std::u32string> char_input;
+    // Key and text events of the current frame, in the order they came in.
+    // Input callbacks add to incoming_input, update_frame takes them from
+    // there at the start of each frame.
+    std::vector<input_event> input_events;
+    std::vector<input_event> incoming_input;
+    std::mutex incoming_input_lock;
+    // Stamps the event with the time and adds it to incoming_input
+    void push_input_event(input_event event);
+    // Text of the text events, and keys held down after the key events of
+    // the current frame
+    std::u32string text_input;
+    std::bitset<GLFW_KEY_LAST + 1> held_keys;
     ime_composition_state ime_composition;
     std::mutex ime_composition_lock{};
-    int64_t last_repaint = 0;
+    // Area changed since the last paint, filled by the widgets during update
+    damage_region damage;
+    // Runs the animations of all widgets in this window. Widgets only keep
+    // a weak reference, so ones that outlive the window see it is gone.
+    std::shared_ptr<animation_scheduler> animations =
+        std::make_shared<animation_scheduler>();
+    // Widget rects of the last frame, queried with the mouse position at the
+    // start of each frame
+    hit_test_index hit_index;
+    // Counts the frames of update_frame. The last frame a widget claimed the
+    // hover in, widgets stamp themselves with it too.
+    uint64_t frame_number = 1;
+    uint64_t hover_claimed = 0;
+    // Widgets drawn and subtrees culled because they were outside of the
+    // scissor or the repaint region, counted over the last frame
+    size_t drawn_widgets = 0, culled_widgets = 0;
+    // Widgets with cache_commands whose recorded commands were played
+    // instead of calling render()
+    size_t replayed_widgets = 0;
+    // Children not updated because of skip_offscreen_updates
+    size_t skipped_updates = 0;
+    // widget::measure calls that missed the measurement cache
+    size_t measure_calls = 0;
+    // Frame times and repainted frames of this window
+    frame_stats stats;
+    // Prints the frame rate of this window to stdout every second
+    bool print_fps = false;
+    float fps_print_elapsed = 0;
+    uint64_t fps_print_frames = 0;
+    // Threads measuring fixed size containers ahead of the update, see
+    // layout_pool. 0 measures everything on the loop thread.
+    size_t layout_threads = 0;
+    std::unique_ptr<layout_pool> layout_workers;
+    // Offscreen images of widgets with cache_as_layer
+    layer_cache layers;
+    // Set while render() repaints only part of the window, widgets outside
+    // of it are skipped
+    std::optional<rect> repaint_region;
+    // Window contents are kept in an offscreen buffer so that a partial
+    // repaint only has to redraw the damaged area
+    NVGLUframebuffer *framebuffer = nullptr;
+    int framebuffer_width = 0, framebuffer_height = 0;
+    float framebuffer_dpi_scale = 0;
+    // Set before init() to draw and present from a thread of its own. The
+    // loop thread records frame N + 1 while the render thread replays frame
+    // N into GL and swaps, waiting for it when it falls behind, so frames
+    // are at most one frame late. Layers are drawn directly in this mode.
+    bool pipelined = false;
+    draw_recorder recorder;
+    swap_buffer<recorded_frame> frames;
+    std::jthread render_thread;
+    // GL context of the render thread that the frames are replayed into,
+    // framebuffer belongs to it in this mode
+    NVGcontext *present_nvg = nullptr;
+    std::unique_ptr<draw_replayer> replayer;
+    std::pair<int, int> present_size;
+    void record_frame(nanovg_context &vg, damage_region &frame_damage,
+                      bool need_repaint, int fb_width, int fb_height);
+    void present_loop();
     std::expected<bool, std::string> init();
     void begin_acrylic_frame();
     void register_acrylic_region(acrylic_region region);
@@ -129,6 +231,10 @@ struct render_target {
     static std::expected<bool, std::string> init_global();
     void start_loop();
     void render();
+    // Updates the tree for one frame and returns the area to repaint.
+    // render() calls it with the input of the window, headless_target with
+    // the input it is given.
+    damage_region update_frame(update_context &ctx);
     void resize(int width, int height);
     void set_position(int x, int y);
     void reset_view();
@@ -150,6 +256,19 @@ struct render_target {
     std::mutex loop_thread_tasks_lock{};
     std::queue<std::function<void()>> loop_thread_tasks{};
     void post_loop_thread_task(std::function<void()> task, bool delay = false);
+    // Wakes the loop thread to render a frame. Input callbacks and
+    // post_loop_thread_task call it; other threads changing widgets under
+    // rt_lock have to call it too.
+    void request_frame();
+    std::mutex frame_request_lock{};
+    std::condition_variable frame_request_cv{};
+    bool frame_requested = false;
+    // Milliseconds until a widget needs the next frame, collected during
+    // update. The loop thread sleeps until then unless woken earlier.
+    float next_frame_delay = INFINITY;
+    // Whether the last frame was swapped, or handed to the render thread
+    // which swaps it. The swap waits for vsync and paces the loop.
+    bool frame_presented = false;
     template <typename T>
     T inline post_loop_thread_task(std::function<T()> task) {
         std::promise<T> p;
@@ -0,0 +1,54 @@
+#include "breeze_ui/ui.h"
+
+#include <cmath>
+
+// render_target on platforms without the Win32 window of ui.cc. Only what
+// widgets call is here, frames are driven by headless_target.
+namespace ui {
+render_target::~render_target() {
+    // Its threads measure with the fonts of nvg, which the owner of the
+    // context frees
+    layout_workers.reset();
+}
+
+void render_target::post_loop_thread_task(std::function<void()> task,
+                                          bool delay) {
+    if (current == this && !delay) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard lock(loop_thread_tasks_lock);
+        loop_thread_tasks.push(std::move(task));
+    }
+    request_frame();
+}
+
+void render_target::set_ime_caret_rect(float x, float y, float height,
+                                       bool active, float document_x,
+                                       float document_y, float document_width,
+                                       float document_height) {
+    ime_caret_active = active;
+    if (!active) {
+        ime_caret_x = ime_caret_y = ime_caret_height = 0;
+        ime_document_x = ime_document_y = 0;
+        ime_document_width = ime_document_height = 0;
+        return;
+    }
+    ime_caret_x = static_cast<int>(std::lround(x * dpi_scale));
+    ime_caret_y = static_cast<int>(std::lround(y * dpi_scale));
+    ime_caret_height =
+        static_cast<int>(std::max(std::lround(height * dpi_scale), 1L));
+    ime_document_x = static_cast<int>(std::lround(document_x * dpi_scale));
+    ime_document_y = static_cast<int>(std::lround(document_y * dpi_scale));
+    ime_document_width =
+        static_cast<int>(std::max(std::lround(document_width * dpi_scale), 1L));
+    ime_document_height = static_cast<int>(
+        std::max(std::lround(document_height * dpi_scale), 1L));
+}
+
+// There is no window for acrylic to show through
+void render_target::register_acrylic_region(acrylic_region) {}
+void render_target::commit_acrylic_frame() {}
+void render_target::sync_acrylic_host() {}
+} // namespace ui
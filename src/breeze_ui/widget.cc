@@ -1,7 +1,11 @@
 #include "breeze_ui/font.h"
+#include "breeze_ui/flex_layout.h"
+#include "breeze_ui/trace.h"
 #include "breeze_ui/widget.h"
 #include "breeze_ui/ui.h"
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cmath>
 #include <limits>
 #include <print>
@@ -11,13 +15,19 @@
 #include "simdutf.h"
 
 namespace {
-void apply_font_face(ui::nanovg_context &ctx, std::string_view family,
-                     int weight) {
-    auto font_face = ui::resolve_font_face_name(ctx.ctx, family, weight);
-    if (font_face.empty()) {
-        font_face = std::string(family);
-    }
-    ctx.fontFace(font_face.c_str());
+// face keeps the font id between calls, see resolve_font_face
+void apply_font_face(ui::nanovg_context &ctx, ui::font_face_handle &face,
+                     std::string_view family, int weight) {
+    ctx.fontFaceId(ui::resolve_font_face(face, ctx.ctx, family, weight));
+}
+
+// Combines the hashes of the values into a measure key
+template <typename... T> size_t hash_values(const T &...values) {
+    size_t seed = 0;
+    ((seed ^= std::hash<T>{}(values) + 0x9e3779b97f4a7c15 + (seed << 6) +
+              (seed >> 2)),
+     ...);
+    return seed;
 }
 
 struct utf8_index_map {
@@ -250,111 +260,230 @@ textbox_visual_state make_textbox_visual_state(
     return state;
 }
 
-textbox_layout build_textbox_layout(ui::nanovg_context &vg,
-                                    std::string_view text, float font_size,
-                                    int font_weight, bool multiline,
-                                    float inner_width,
-                                    float line_height_multiplier) {
-    textbox_layout layout;
+// Rows of the paragraphs from the one starting at first to the one ending
+// at last, which is a newline or the end of the text. The first of them is
+// row first_row of the layout.
+std::vector<text_row_layout>
+layout_textbox_paragraphs(ui::nanovg_context &vg, std::string_view text,
+                          const utf8_index_map &map, int first, int last,
+                          float wrap_width, float line_height,
+                          size_t first_row) {
+    std::vector<text_row_layout> rows;
+    auto push_row = [&](int start, int end, bool soft_wrap_to_next = false) {
+        const auto y_offset =
+            line_height * static_cast<float>(first_row + rows.size());
+        rows.push_back(make_text_row_layout(vg, text, map, start, end,
+                                            y_offset, soft_wrap_to_next));
+    };
 
-    vg.fontSize(font_size);
-    apply_font_face(vg, "main", font_weight);
-    vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
-    vg.textMetrics(&layout.ascender, &layout.descender, &layout.line_height);
-    layout.line_height =
-        std::max(layout.line_height * std::max(line_height_multiplier, 0.1f),
-                 1.0f);
+    int line_start = first;
+    for (int i = first; i <= last; ++i) {
+        if (i != last && text[byte_offset_for_char(map, i)] != '\n') {
+            continue;
+        }
 
-    const auto map = build_utf8_index_map(text);
-    float y_offset = 0.0f;
+        const int line_end = i;
+        const auto line_text =
+            utf8_substr_chars(text, map, line_start, line_end);
+        const auto line_map = build_utf8_index_map(line_text);
 
-    auto push_row = [&](int start, int end, bool soft_wrap_to_next = false) {
-        auto row = make_text_row_layout(vg, text, map, start, end, y_offset,
-                                        soft_wrap_to_next);
-        layout.content_width = std::max(layout.content_width, row.width);
-        layout.rows.push_back(std::move(row));
-        y_offset += layout.line_height;
-    };
+        if (line_text.empty()) {
+            push_row(line_start, line_end);
+        } else {
+            const char *cursor = line_text.c_str();
+            const char *end = cursor + line_text.size();
+            while (cursor < end) {
+                NVGtextRow row_data[1];
+                int row_count =
+                    vg.textBreakLines(cursor, end, wrap_width, row_data, 1);
+                if (row_count <= 0 || row_data[0].start >= row_data[0].end) {
+                    break;
+                }
 
-    if (multiline) {
-        const float wrap_width = std::max(inner_width, 1.0f);
-        int line_start = 0;
-
-        for (int i = 0; i <= map.char_count(); ++i) {
-            const bool is_end = i == map.char_count();
-            const bool is_newline =
-                !is_end && text[byte_offset_for_char(map, i)] == '\n';
-            if (!is_end && !is_newline) {
-                continue;
+                const auto row_start_byte =
+                    static_cast<int>(row_data[0].start - line_text.c_str());
+                const auto row_next_byte =
+                    static_cast<int>(row_data[0].next - line_text.c_str());
+                const bool soft_wrap_to_next = row_data[0].next < end;
+
+                push_row(line_start +
+                             char_index_for_byte(line_map, row_start_byte),
+                         line_start +
+                             char_index_for_byte(line_map, row_next_byte),
+                         soft_wrap_to_next);
+                cursor = row_data[0].next;
             }
+        }
 
-            const int line_end = i;
-            const auto line_text =
-                utf8_substr_chars(text, map, line_start, line_end);
-            const auto line_map = build_utf8_index_map(line_text);
+        line_start = i + 1;
+    }
+    return rows;
+}
 
-            if (line_text.empty()) {
-                push_row(line_start, line_end);
-            } else {
-                const char *cursor = line_text.c_str();
-                const char *end = cursor + line_text.size();
-                while (cursor < end) {
-                    NVGtextRow row_data[1];
-                    int row_count =
-                        vg.textBreakLines(cursor, end, wrap_width, row_data, 1);
-                    if (row_count <= 0 || row_data[0].start >= row_data[0].end) {
-                        break;
-                    }
+// A textbox layout kept between frames, with what it was laid out for
+struct cached_textbox_layout {
+    std::string text;
+    utf8_index_map map;
+    textbox_layout layout;
+    float font_size = 0;
+    float inner_width = 0;
+    float line_height_multiplier = 0;
+    int font_id = -1;
+    uint64_t font_generation = 0;
+    bool multiline = false;
+    bool valid = false;
+    // The only row is the one added for text without any rows
+    bool placeholder_row = false;
+};
 
-                    const auto row_start_byte =
-                        static_cast<int>(row_data[0].start - line_text.c_str());
-                    const auto row_next_byte =
-                        static_cast<int>(row_data[0].next - line_text.c_str());
-                    const bool soft_wrap_to_next = row_data[0].next < end;
-
-                    push_row(line_start + char_index_for_byte(line_map,
-                                                              row_start_byte),
-                             line_start +
-                                 char_index_for_byte(line_map, row_next_byte),
-                             soft_wrap_to_next);
-                    cursor = row_data[0].next;
-                }
-            }
+void finish_textbox_layout(cached_textbox_layout &cache) {
+    auto &layout = cache.layout;
+    cache.placeholder_row = layout.rows.empty();
+    if (cache.placeholder_row) {
+        layout.rows.push_back({.start = 0, .end = 0});
+    }
+    layout.content_width = 0;
+    for (const auto &row : layout.rows) {
+        layout.content_width = std::max(layout.content_width, row.width);
+    }
+    layout.content_height =
+        layout.line_height * static_cast<float>(layout.rows.size());
+}
 
-            line_start = i + 1;
-        }
-    } else {
-        push_row(0, map.char_count());
+// Lays out the paragraphs an edit changed again and moves the rows after
+// them. The edit is found by comparing the text with the cached one.
+void relayout_changed_paragraphs(cached_textbox_layout &cache,
+                                 ui::nanovg_context &vg,
+                                 std::string_view text) {
+    const std::string_view old_text = cache.text;
+    const auto common = std::min(old_text.size(), text.size());
+    const auto prefix = static_cast<size_t>(
+        std::mismatch(old_text.begin(), old_text.begin() + common,
+                      text.begin())
+            .first -
+        old_text.begin());
+    size_t suffix = 0;
+    while (suffix < common - prefix &&
+           old_text[old_text.size() - 1 - suffix] ==
+               text[text.size() - 1 - suffix]) {
+        ++suffix;
     }
 
-    if (layout.rows.empty()) {
-        push_row(0, 0);
+    // Bytes of the paragraphs around the edit, the same in both texts
+    const auto before = prefix ? old_text.rfind('\n', prefix - 1)
+                               : std::string_view::npos;
+    const auto first_byte = before == std::string_view::npos ? 0 : before + 1;
+    auto old_last_byte = old_text.find('\n', old_text.size() - suffix);
+    if (old_last_byte == std::string_view::npos) {
+        old_last_byte = old_text.size();
+    }
+    const auto new_last_byte = old_last_byte + text.size() - old_text.size();
+
+    auto map = build_utf8_index_map(text);
+    const int first = char_index_for_byte(cache.map, first_byte);
+    const int old_last = char_index_for_byte(cache.map, old_last_byte);
+    const int new_last = char_index_for_byte(map, new_last_byte);
+    const int char_delta = map.char_count() - cache.map.char_count();
+
+    auto &layout = cache.layout;
+    auto &rows = layout.rows;
+    const auto removed_begin = std::ranges::lower_bound(
+        rows, first, {}, &text_row_layout::start);
+    const auto removed_end = std::ranges::upper_bound(
+        removed_begin, rows.end(), old_last, {}, &text_row_layout::start);
+    const auto row_index = static_cast<size_t>(removed_begin - rows.begin());
+    auto new_rows = layout_textbox_paragraphs(
+        vg, text, map, first, new_last, std::max(cache.inner_width, 1.0f),
+        layout.line_height, row_index);
+
+    const auto inserted_end = row_index + new_rows.size();
+    rows.erase(removed_begin, removed_end);
+    rows.insert(rows.begin() + static_cast<std::ptrdiff_t>(row_index),
+                std::make_move_iterator(new_rows.begin()),
+                std::make_move_iterator(new_rows.end()));
+    for (auto i = inserted_end; i < rows.size(); ++i) {
+        rows[i].start += char_delta;
+        rows[i].end += char_delta;
+        rows[i].y = layout.line_height * static_cast<float>(i);
+    }
+
+    cache.text.assign(text);
+    cache.map = std::move(map);
+    finish_textbox_layout(cache);
+}
+
+// The layout of text in cache, laid out again as far as the text, the font
+// or the width changed since the last call. Leaves the font set on vg.
+const textbox_layout &
+layout_textbox(cached_textbox_layout &cache, ui::nanovg_context &vg,
+               ui::font_face_handle &face, std::string_view text,
+               float font_size, int font_weight, bool multiline,
+               float inner_width, float line_height_multiplier) {
+    vg.fontSize(font_size);
+    apply_font_face(vg, face, "main", font_weight);
+    vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+
+    // Single lines do not wrap, the width does not matter to them
+    const bool same_style =
+        cache.valid && cache.font_id == face.font_id &&
+        cache.font_generation == face.generation &&
+        cache.font_size == font_size && cache.multiline == multiline &&
+        cache.line_height_multiplier == line_height_multiplier &&
+        (!multiline || cache.inner_width == inner_width);
+    if (same_style && cache.text == text) {
+        return cache.layout;
+    }
+    if (same_style && multiline && !cache.placeholder_row) {
+        relayout_changed_paragraphs(cache, vg, text);
+        return cache.layout;
     }
 
-    layout.content_height = std::max(y_offset, layout.line_height);
-    return layout;
+    cache.font_id = face.font_id;
+    cache.font_generation = face.generation;
+    cache.font_size = font_size;
+    cache.multiline = multiline;
+    cache.line_height_multiplier = line_height_multiplier;
+    cache.inner_width = inner_width;
+    cache.valid = true;
+    cache.text.assign(text);
+    cache.map = build_utf8_index_map(text);
+
+    auto &layout = cache.layout;
+    layout = {};
+    vg.textMetrics(&layout.ascender, &layout.descender, &layout.line_height);
+    layout.line_height =
+        std::max(layout.line_height * std::max(line_height_multiplier, 0.1f),
+                 1.0f);
+    if (multiline) {
+        layout.rows = layout_textbox_paragraphs(
+            vg, text, cache.map, 0, cache.map.char_count(),
+            std::max(inner_width, 1.0f), layout.line_height, 0);
+    } else {
+        layout.rows.push_back(make_text_row_layout(
+            vg, text, cache.map, 0, cache.map.char_count(), 0, false));
+    }
+    finish_textbox_layout(cache);
+    return cache.layout;
 }
 
 int find_row_for_index(const textbox_layout &layout, int char_index) {
     if (layout.rows.empty()) {
         return 0;
     }
-    for (int i = 0; i < static_cast<int>(layout.rows.size()); ++i) {
-        const auto &row = layout.rows[static_cast<size_t>(i)];
-        if (char_index < row.start) {
-            return i;
-        }
-        if (char_index == row.end &&
-            i + 1 < static_cast<int>(layout.rows.size()) &&
-            layout.rows[static_cast<size_t>(i + 1)].start == row.end &&
-            row.soft_wrap_to_next) {
-            return i + 1;
-        }
-        if (char_index <= row.end) {
-            return i;
-        }
+    // The first row that ends at or after the index
+    const auto it = std::ranges::lower_bound(layout.rows, char_index, {},
+                                             &text_row_layout::end);
+    if (it == layout.rows.end()) {
+        return static_cast<int>(layout.rows.size()) - 1;
+    }
+    const auto i = static_cast<int>(it - layout.rows.begin());
+    // The end of a wrapped row is also the start of the next one, where
+    // the caret goes
+    if (char_index == it->end && it->soft_wrap_to_next && it + 1 != layout.rows.end() &&
+        (it + 1)->start == it->end) {
+        return i + 1;
     }
-    return static_cast<int>(layout.rows.size()) - 1;
+    return i;
 }
 
 float caret_x_for_index(const text_row_layout &row, int char_index) {
@@ -366,14 +495,19 @@ int caret_index_from_x(const text_row_layout &row, float x) {
     if (row.caret_xs.empty()) {
         return row.start;
     }
-    for (int i = 0; i < row.end - row.start; ++i) {
-        const float left = row.caret_xs[static_cast<size_t>(i)];
-        const float right = row.caret_xs[static_cast<size_t>(i + 1)];
+    // caret_xs never decrease, neither do the middles between them
+    int low = 0, high = row.end - row.start;
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        const float left = row.caret_xs[static_cast<size_t>(mid)];
+        const float right = row.caret_xs[static_cast<size_t>(mid + 1)];
         if (x < (left + right) * 0.5f) {
-            return row.start + i;
+            high = mid;
+        } else {
+            low = mid + 1;
         }
     }
-    return row.end;
+    return row.start + low;
 }
 
 int caret_index_from_point(const textbox_layout &layout, float x, float y) {
@@ -402,13 +536,81 @@ void ui::widget::update_child_basic(update_context &ctx,
         return;
     // handle dying time
     if (w->dying_time && w->dying_time.time <= 0) {
+        ctx.add_damage(w->_subtree_bounds);
+        _children_changed = true;
+        if (_painted_child_count)
+            _painted_child_count--;
         w = nullptr;
         return;
     }
     w->parent = this;
-    w->update(ctx);
+
+    if (skip_offscreen_updates && ctx.clip && w->_paint_bounds &&
+        !w->_subtree_animating && !w->dying_time) {
+        // Move the bounds from the last update along with the offset, the
+        // subtree itself can't have changed without an update
+        auto dx = ctx.offset_x + *w->x - w->_collected_x,
+             dy = ctx.offset_y + *w->y - w->_collected_y;
+        auto bounds = w->_subtree_bounds;
+        bounds.x += dx;
+        bounds.y += dy;
+        if (!bounds.empty() && !bounds.intersects(*ctx.clip)) {
+            // What was drawn before it went offscreen has to go
+            ctx.add_damage(w->_subtree_bounds.intersected(*ctx.clip));
+            w->_subtree_bounds = bounds;
+            w->_paint_bounds->x += dx;
+            w->_paint_bounds->y += dy;
+            w->_collected_x += dx;
+            w->_collected_y += dy;
+            w->_subtree_changed = false;
+            ctx.rt.skipped_updates++;
+            return;
+        }
+    }
+
+    // A claimed hover covers the children updated after the claim
+    if (_hover_claimed == ctx.rt.frame_number)
+        w->_hover_claimed = _hover_claimed;
+    {
+        trace_zone zone(typeid(*w));
+        w->update(ctx);
+    }
+    w->collect_damage(ctx);
+
+    // The child's size is only final after its own update, so a change is
+    // picked up by our layout in the next frame.
+    if (w->width->dest() != w->_reported_width ||
+        w->height->dest() != w->_reported_height ||
+        w->flex_grow != w->_reported_flex_grow ||
+        w->flex_shrink != w->_reported_flex_shrink ||
+        w->flex_basis != w->_reported_flex_basis ||
+        w->size_limits != w->_reported_size_limits) {
+        w->_reported_width = w->width->dest();
+        w->_reported_height = w->height->dest();
+        w->_reported_flex_grow = w->flex_grow;
+        w->_reported_flex_shrink = w->flex_shrink;
+        w->_reported_flex_basis = w->flex_basis;
+        w->_reported_size_limits = w->size_limits;
+        invalidate_layout();
+    }
 }
 
+namespace {
+// The scissor in window coordinates. Unknown when a widget has moved the
+// drawing space away from them with a transform.
+std::optional<ui::rect> visible_area(ui::nanovg_context &ctx) {
+    float xform[6];
+    ctx.currentTransform(xform);
+    if (xform[1] != 0 || xform[2] != 0 || xform[4] != 0 || xform[5] != 0 ||
+        xform[0] != xform[3])
+        return std::nullopt;
+
+    float bounds[4];
+    if (!ctx.currentScissor(bounds))
+        return std::nullopt;
+    return ui::rect{bounds[0], bounds[1], bounds[2], bounds[3]};
+}
+} // namespace
 void ui::widget::render_child_basic(nanovg_context ctx,
                                     std::shared_ptr<widget> &w) {
     if (!w)
@@ -423,11 +625,67 @@ void ui::widget::render_child_basic(nanovg_context ctx,
                  ? std::max(std::min(**w->height, **height - *w->y), 0.f)
                  : INFINITY;
 
-    if (can_render_width > 0 && can_render_height > 0) {
-        ctx.save();
-        w->render(ctx);
-        ctx.restore();
+    // Skip subtrees that don't touch the area being repainted or are
+    // outside of the scissor. Their bounds are from the last update.
+    bool culled = can_render_width <= 0 || can_render_height <= 0;
+    if (!culled && ctx.rt && w->_paint_bounds &&
+        !w->_subtree_bounds.empty()) {
+        if (ctx.rt->repaint_region) {
+            culled = !w->_subtree_bounds.intersects(*ctx.rt->repaint_region);
+        }
+        if (auto visible = visible_area(ctx); !culled && visible) {
+            culled = !w->_subtree_bounds.intersects(*visible);
+        }
+    }
+    if (culled) {
+        if (ctx.rt)
+            ctx.rt->culled_widgets++;
+        return;
+    }
+
+    if (ctx.rt)
+        ctx.rt->drawn_widgets++;
+    if (w->cache_as_layer && ctx.rt && ctx.rt->layers.draw(ctx, *w))
+        return;
+    // Acrylic regions are registered by render(), they would be lost
+    if (w->cache_commands && ctx.rt && !ctx.rt->acrylic_host_window) {
+        w->render_recorded(ctx);
+        return;
     }
+    trace_zone zone(typeid(*w));
+    ctx.save();
+    w->render(ctx);
+    ctx.restore();
+}
+void ui::widget::render_recorded(nanovg_context ctx) {
+    // The commands hold the position and the scissor they were recorded
+    // with
+    std::array<float, 12> key{ctx.offset_x + *x, ctx.offset_y + *y};
+    ctx.currentTransform(key.data() + 2);
+    if (!ctx.currentScissor(key.data() + 8))
+        std::fill(key.begin() + 8, key.end(), -1.f);
+
+    auto &recorded = _recorded_commands;
+    if (!recorded)
+        recorded = std::make_unique<recorded_commands>();
+    ctx.save();
+    if (recorded->valid && recorded->key == key) {
+        ctx.play(recorded->list);
+        ctx.rt->replayed_widgets++;
+    } else if (ctx.rt->repaint_region) {
+        // Parts of the subtree may be culled, that is no recording to keep
+        render(ctx);
+    } else {
+        auto outer = ctx.recording;
+        recorded->list.clear();
+        ctx.recording = &recorded->list;
+        render(ctx);
+        recorded->key = key;
+        recorded->valid = true;
+        if (outer)
+            outer->append(recorded->list);
+    }
+    ctx.restore();
 }
 
 void ui::widget::render(nanovg_context ctx) {
@@ -457,20 +715,26 @@ void ui::widget::render(nanovg_context ctx) {
 void ui::widget::update(update_context &ctx) {
     children_dirty = false;
     owner_rt = &ctx.rt;
-    for (auto anim : anim_floats) {
-        anim->update(ctx.delta_time);
-
-        if (anim->updated()) {
-            ctx.need_repaint = true;
+    // Animations are ticked by the render target's scheduler. Hand over the
+    // ones created before we were attached to it. Compared without locking,
+    // an expired scheduler never equals a live one.
+    if (anim_scheduler.owner_before(ctx.rt.animations) ||
+        ctx.rt.animations.owner_before(anim_scheduler)) {
+        anim_scheduler = ctx.rt.animations;
+        for (auto &anim : anim_floats) {
+            if (!anim->owner)
+                anim->owner = this;
+            // Settle initial values right away, as a first tick would
+            if (anim->easing == easing_type::mutation)
+                anim->update(ctx.delta_time);
+            anim->schedule();
         }
     }
 
-    if (this->needs_repaint) {
-        ctx.need_repaint = true;
-        this->needs_repaint = false;
-    }
-
     dying_time.update(ctx.delta_time);
+    // The parent removes us in the first frame after the time is up
+    if (dying_time)
+        ctx.request_frame_after(std::max(dying_time.time, 0.f));
     update_context upd = ctx.with_offset(*x, *y);
     update_children(upd, children);
     if constexpr (false)
@@ -487,36 +751,272 @@ void ui::widget::update(update_context &ctx) {
     last_offset_x = ctx.offset_x;
     last_offset_y = ctx.offset_y;
 }
+ui::widget::~widget() {
+    // Animations shared with someone else outlive us, keep them from
+    // marking a dead widget
+    for (auto &anim : anim_floats) {
+        if (anim->owner == this) {
+            anim->owner = nullptr;
+            anim->schedule();
+        }
+    }
+}
 void ui::widget::add_child(std::shared_ptr<widget> child) {
+    child->parent = this;
     children.push_back(std::move(child));
     children_dirty = true;
     needs_repaint = true;
+    _children_changed = true;
+    invalidate_layout();
+    if (owner_rt)
+        owner_rt->request_frame();
+}
+void ui::widget::collect_damage(update_context &ctx) {
+    // The context is the one update() got, last_offset may include the
+    // scrolling of the widget's own content
+    _collected_x = ctx.offset_x + *x;
+    _collected_y = ctx.offset_y + *y;
+    rect bounds{_collected_x, _collected_y, *width, *height};
+    if (!bounds.empty())
+        bounds = bounds.inflated(damage_margin);
+
+    if (!_paint_bounds) {
+        ctx.add_damage(bounds);
+    } else if (needs_repaint || bounds != *_paint_bounds) {
+        // Empty bounds add nothing, a widget without a size that is still
+        // being laid out or animated has nothing of its own to repaint
+        ctx.add_damage(*_paint_bounds);
+        ctx.add_damage(bounds);
+    }
+
+    // Changes of our own position don't count for our layer, only for the
+    // layers of the parents
+    rect local_bounds{*x, *y, *width, *height};
+    bool content_changed = !_paint_bounds || needs_repaint ||
+                           _children_changed ||
+                           local_bounds.width != _local_bounds.width ||
+                           local_bounds.height != _local_bounds.height;
+    bool moved = local_bounds.x != _local_bounds.x ||
+                 local_bounds.y != _local_bounds.y;
+    needs_repaint = false;
+    _children_changed = false;
+    _paint_bounds = bounds;
+    _local_bounds = local_bounds;
+
+    _subtree_bounds = bounds;
+    _subtree_animating = _running_animations > 0;
+    for (auto &child : children) {
+        if (!child)
+            continue;
+        _subtree_bounds = _subtree_bounds.united(child->_subtree_bounds);
+        _subtree_animating |= child->_subtree_animating;
+        content_changed |= child->_subtree_changed;
+    }
+    _painted_child_count = children.size();
+    _subtree_changed = content_changed || moved;
+    if (cache_as_layer)
+        ctx.rt.layers.mark(*this, content_changed);
+    if (_recorded_commands && content_changed)
+        _recorded_commands->valid = false;
+
+    _hit_rect = hit_rect(ctx);
+    _hit_slot = ctx.rt.hit_index.add(_hit_rect);
+    _hit_generation = ctx.rt.hit_index.generation();
+}
+void ui::update_context::add_damage(const rect &r) { rt.damage.add(r); }
+uint32_t ui::hit_test_index::add(const rect &r) {
+    _left.push_back(r.x);
+    _top.push_back(r.y);
+    _right.push_back(r.right());
+    _bottom.push_back(r.bottom());
+    return static_cast<uint32_t>(_left.size() - 1);
+}
+void ui::hit_test_index::query(float x, float y) {
+    auto count = _left.size();
+    _hits.resize(count);
+    _hit_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool hit = x >= _left[i] && x <= _right[i] && y >= _top[i] &&
+                   y <= _bottom[i];
+        _hits[i] = hit;
+        _hit_count += hit;
+    }
+
+    _queried = _generation++;
+    _left.clear();
+    _top.clear();
+    _right.clear();
+    _bottom.clear();
+}
+namespace {
+thread_local ui::widget_arena *current_widget_arena = nullptr;
+}
+ui::widget_arena::scope::scope(widget_arena *arena)
+    : previous(current_widget_arena) {
+    current_widget_arena = arena;
+}
+ui::widget_arena::scope::~scope() { current_widget_arena = previous; }
+std::shared_ptr<ui::widget_arena> ui::widget_arena::current() {
+    return current_widget_arena ? current_widget_arena->shared_from_this()
+                                : nullptr;
+}
+// Objects larger than this get their own heap allocation
+static constexpr size_t widget_arena_max_object = ui::widget_arena::block_size / 4;
+void *ui::widget_arena::allocate(size_t size, size_t align) {
+    if (size > widget_arena_max_object)
+        return ::operator new(size, std::align_val_t{align});
+
+    std::lock_guard guard(lock);
+    auto offset = current_block ? (current_block->used + align - 1) & ~(align - 1)
+                                : block_size;
+    if (offset + size > block_size) {
+        if (current_block && current_block->live == 0) {
+            ::operator delete(current_block, std::align_val_t{block_size});
+            block_count--;
+        }
+        // Blocks are aligned to their size so deallocate can find the header
+        current_block = static_cast<block_header *>(
+            ::operator new(block_size, std::align_val_t{block_size}));
+        current_block->used = sizeof(block_header);
+        current_block->live = 0;
+        block_count++;
+        offset = (current_block->used + align - 1) & ~(align - 1);
+    }
+    current_block->used = offset + size;
+    current_block->live++;
+    return reinterpret_cast<std::byte *>(current_block) + offset;
+}
+void ui::widget_arena::deallocate(void *p, size_t size, size_t align) {
+    if (size > widget_arena_max_object) {
+        ::operator delete(p, std::align_val_t{align});
+        return;
+    }
+
+    auto block = reinterpret_cast<block_header *>(
+        reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(block_size - 1));
+    std::lock_guard guard(lock);
+    if (--block->live)
+        return;
+    if (block == current_block) {
+        block->used = sizeof(block_header);
+    } else {
+        ::operator delete(block, std::align_val_t{block_size});
+        block_count--;
+    }
+}
+ui::widget_arena::~widget_arena() {
+    if (current_block)
+        ::operator delete(current_block, std::align_val_t{block_size});
+}
+void ui::update_context::request_frame_after(float ms) const {
+    rt.next_frame_delay = std::min(rt.next_frame_delay, ms);
+}
+bool ui::rect::intersects(const rect &other) const {
+    return !empty() && !other.empty() && x < other.right() &&
+           other.x < right() && y < other.bottom() && other.y < bottom();
+}
+ui::rect ui::rect::intersected(const rect &other) const {
+    auto left = std::max(x, other.x), top = std::max(y, other.y);
+    return {left, top, std::max(std::min(right(), other.right()) - left, 0.f),
+            std::max(std::min(bottom(), other.bottom()) - top, 0.f)};
+}
+ui::rect ui::rect::united(const rect &other) const {
+    if (other.empty())
+        return *this;
+    if (empty())
+        return other;
+    auto left = std::min(x, other.x), top = std::min(y, other.y);
+    return {left, top, std::max(right(), other.right()) - left,
+            std::max(bottom(), other.bottom()) - top};
+}
+void ui::widget::invalidate_layout() {
+    // Walk the whole chain instead of stopping at the first dirty ancestor:
+    // a parent may already have been laid out this frame while this widget
+    // is still waiting for its own update.
+    for (auto w = this; w; w = w->parent) {
+        w->layout_dirty = true;
+        w->_measured.reset();
+    }
 }
 
 bool ui::update_context::hovered(widget *w, bool hittest) const {
-    auto hit = w->check_hit(*this);
-    if (!hit)
+    if (hittest && rt.hover_claimed == rt.frame_number &&
+        w->_hover_claimed != rt.frame_number)
         return false;
 
-    if (hittest) {
-        if (!hovered_widgets->empty()) {
-            // iterate through parent chain
-            auto p = w;
-            while (p) {
-                if (std::ranges::contains(*hovered_widgets, p)) {
-                    return true;
-                }
-
-                p = p->parent;
-            }
-            return false;
+    // The index holds the rects of the last frame, it can only be trusted
+    // when the widget hasn't moved since. It only rules out misses,
+    // check_hit may narrow the area down.
+    if (rt.hit_index.answers(w->_hit_generation) &&
+        w->_hit_rect == w->hit_rect(*this) &&
+        !rt.hit_index.hit(w->_hit_slot))
+        return false;
+    return w->check_hit(*this);
+}
+ui::size ui::widget::measure(update_context &ctx, const constraints &limits) {
+    return limits.clamp({measure_width(ctx), measure_height(ctx)});
+}
+float ui::widget::measure_height(update_context &ctx) {
+    return height->dest();
+}
+float ui::widget::measure_width(update_context &ctx) {
+    return width->dest();
+}
+size_t ui::widget::measure_key() const {
+    return hash_values(width->dest(), height->dest());
+}
+ui::size ui::widget::measured(update_context &ctx, const constraints &limits) {
+    if (auto key = measure_key();
+        !_measured || key != _measure_key || limits != _measured_limits) {
+        // Also counted on the threads of a layout_pool
+        std::atomic_ref(ctx.rt.measure_calls)
+            .fetch_add(1, std::memory_order_relaxed);
+        _measured = measure(ctx, limits);
+        _measured_limits = limits;
+        _measure_key = key;
+    }
+    return *_measured;
+}
+namespace {
+// Children decide their own auto sizing from the direction and alignment of
+// their parent, so they have to be laid out again when those change
+void invalidate_children_layout(ui::flex_widget &w,
+                                const ui::flex_widget::layout_inputs &inputs) {
+    if (!w._last_layout_inputs ||
+        inputs.horizontal != w._last_layout_inputs->horizontal ||
+        inputs.align_items != w._last_layout_inputs->align_items) {
+        for (auto &child : w.children) {
+            child->layout_dirty = true;
         }
     }
-
-    return true;
 }
-float ui::widget::measure_height(update_context &ctx) { return height->dest(); }
-float ui::widget::measure_width(update_context &ctx) { return width->dest(); }
+} // namespace
+ui::flex_widget::layout_inputs
+ui::flex_widget::current_layout_inputs() const {
+    return {
+        .width = width->dest(),
+        .height = height->dest(),
+        .padding_left = *padding_left,
+        .padding_right = *padding_right,
+        .padding_top = *padding_top,
+        .padding_bottom = *padding_bottom,
+        .gap = gap,
+        .child_count = children.size(),
+        .horizontal = horizontal,
+        .auto_size = auto_size,
+        .reverse = reverse,
+        .wrap = wrap,
+        .justify_content = justify_content,
+        .align_items = align_items,
+    };
+}
+void ui::flex_widget::finish_layout() {
+    layout_dirty = false;
+    actual_height = height->dest();
+    if (max_height < actual_height)
+        height->reset_to(max_height);
+    _last_layout_inputs = current_layout_inputs();
+}
 void ui::flex_widget::update(update_context &ctx) {
     if (ctx.hovered(this) && enable_scrolling) {
         scroll_top->animate_to(
@@ -524,20 +1024,32 @@ void ui::flex_widget::update(update_context &ctx) {
                        height->dest() - actual_height, 0.f));
     }
 
-    auto forkctx2 = ctx.with_offset(*x, *y + *scroll_top);
-    reposition_children_flex(forkctx2, children);
+    if (auto inputs = current_layout_inputs();
+        inputs != _last_layout_inputs) {
+        invalidate_children_layout(*this, inputs);
+        invalidate_layout();
+    }
 
-    auto forkctx = ctx.with_offset(0, *scroll_top);
-    widget::update(forkctx);
+    // Already clean when the parent laid us out along with itself
+    if (layout_dirty) {
+        layout_dirty = false;
+        auto forkctx2 = ctx.with_offset(*x, *y + *scroll_top);
+        reposition_children_flex(forkctx2, children);
+        finish_layout();
+    }
 
-    actual_height = height->dest();
-    if (max_height < actual_height)
-        height->reset_to(max_height);
+    auto forkctx =
+        crop_overflow || enable_scrolling
+            ? ctx.with_clip({ctx.offset_x + *x, ctx.offset_y + *y, *width,
+                             *height})
+                  .with_offset(0, *scroll_top)
+            : ctx.with_offset(0, *scroll_top);
+    widget::update(forkctx);
 }
 void ui::flex_widget::render(nanovg_context ctx) {
     auto t = ctx.transaction();
     if (crop_overflow || enable_scrolling)
-        ctx.scissor(*x, *y, *width, *height);
+        ctx.intersectScissor(*x, *y, *width, *height);
     widget::render(ctx.with_offset(0, *scroll_top));
 
     if (enable_scrolling && actual_height > height->dest()) {
@@ -551,312 +1063,521 @@ void ui::flex_widget::render(nanovg_context ctx) {
                             scrollbar_height, scroll_bar_radius);
     }
 }
-void ui::flex_widget::reposition_children_flex(
-    update_context &ctx, std::vector<std::shared_ptr<widget>> &children) {
-    float x = *padding_left, y = *padding_top;
+ui::virtual_list_widget::virtual_list_widget() { enable_scrolling = true; }
+void ui::virtual_list_widget::render(nanovg_context ctx) {
+    // Clipped even without scrolling, the overscan items are drawn otherwise
+    auto t = ctx.transaction();
+    ctx.intersectScissor(*x, *y, *width, *height);
+    flex_widget::render(ctx);
+}
+float ui::virtual_list_widget::average_height() const {
+    return _measured_count ? _measured_sum / _measured_count
+                           : estimated_item_height;
+}
+float ui::virtual_list_widget::item_offset(size_t index) const {
+    index = std::min(index, _heights.size());
+    double sum = 0;
+    size_t count = 0;
+    for (auto i = index; i > 0; i &= i - 1) {
+        sum += _height_tree[i - 1];
+        count += _count_tree[i - 1];
+    }
+    return sum + (index - count) * average_height() + index * gap;
+}
+size_t ui::virtual_list_widget::item_at(float offset) const {
+    auto n = _heights.size();
+    if (n == 0)
+        return 0;
+    // Walk down the trees, each node covers `step` items ending at `next`
+    auto average = average_height();
+    size_t pos = 0;
+    double remaining = offset;
+    for (auto step = std::bit_floor(n); step; step >>= 1) {
+        auto next = pos + step;
+        if (next > n)
+            continue;
+        auto span = _height_tree[next - 1] +
+                    (step - _count_tree[next - 1]) * average + step * gap;
+        if (span <= remaining) {
+            pos = next;
+            remaining -= span;
+        }
+    }
+    return std::min(pos, n - 1);
+}
+float ui::virtual_list_widget::content_height() const {
+    return _heights.empty() ? 0 : item_offset(_heights.size()) - gap;
+}
+void ui::virtual_list_widget::set_height(size_t index, float height) {
+    auto old = _heights[index];
+    if (old == height)
+        return;
+    double delta = height;
+    int count_delta = 1;
+    if (!std::isnan(old)) {
+        delta -= old;
+        count_delta = 0;
+    }
+    _heights[index] = height;
+    _measured_sum += delta;
+    _measured_count += count_delta;
+    for (auto i = index + 1; i <= _heights.size(); i += i & -i) {
+        _height_tree[i - 1] += delta;
+        _count_tree[i - 1] += count_delta;
+    }
+}
+void ui::virtual_list_widget::invalidate_items() {
+    for (auto &child : children) {
+        if (child && recycle_item)
+            _recycled.push_back(std::move(child));
+    }
+    children.clear();
+    _children_changed = true;
+    _first = 0;
+    _heights.clear();
+    _height_tree.clear();
+    _count_tree.clear();
+    _measured_sum = 0;
+    _measured_count = 0;
+    needs_repaint = true;
+    if (owner_rt)
+        owner_rt->request_frame();
+}
+void ui::virtual_list_widget::scroll_to_item(size_t index) {
+    _scroll_target = index;
+    scroll_top->animate_to(std::clamp(-item_offset(index),
+                                      height->dest() - actual_height, 0.f));
+}
+ui::size ui::virtual_list_widget::measure(update_context &ctx,
+                                          const constraints &limits) {
+    if (!auto_size)
+        return limits.clamp({width->dest(), height->dest()});
+    return limits.clamp(
+        {width->dest(),
+         std::min(max_height,
+                  content_height() + *padding_top + *padding_bottom)});
+}
+size_t ui::virtual_list_widget::measure_key() const {
+    return hash_values(flex_widget::measure_key(), content_height(),
+                       max_height);
+}
+void ui::virtual_list_widget::sync_items(update_context &ctx) {
+    auto top = -*scroll_top - *padding_top;
+    auto bottom = top + height->dest();
+    size_t first = 0, count = 0;
+    if (!_heights.empty()) {
+        auto first_visible = item_at(top);
+        first = first_visible - std::min(first_visible, overscan);
+        auto last = std::min(item_at(bottom) + overscan, _heights.size() - 1);
+        count = last - first + 1;
+    }
 
-    constexpr bool floor_position = true;
-    auto r = [](float value) {
-        return floor_position ? std::floor(value) : value;
+    auto release = [&](std::shared_ptr<widget> &child) {
+        child->parent = nullptr;
+        if (recycle_item)
+            _recycled.push_back(std::move(child));
     };
+    auto &items = _next_children;
+    items.assign(count, nullptr);
+    for (size_t i = 0; i < children.size(); i++) {
+        auto &child = children[i];
+        if (!child)
+            continue;
+        auto index = _first + i;
+        if (index >= first && index < first + count)
+            items[index - first] = std::move(child);
+        else
+            release(child);
+    }
 
-    auto children_rev =
-        reverse ? children | std::views::reverse |
-                      std::ranges::to<std::vector<std::shared_ptr<widget>>>()
-                : children;
-
-    auto spacer_count =
-        std::ranges::count_if(children_rev, [](const auto &child) {
-            return dynamic_cast<const spacer *>(child.get());
-        });
-
-    std::vector<std::pair<float, float>> measure_cache;
-    measure_cache.reserve(children_rev.size());
-
-    // Pass 1: Measure all children and calculate total flex grow/shrink
-    float max_child_width = 0, max_child_height = 0;
-    float total_fixed_size = 0;
-    float total_flex_grow = 0.0f;
-    float total_flex_shrink = 0.0f;
-
-    for (auto &child : children_rev) {
-        // Set max_width for text_widget before measuring to get correct size
-        if (!horizontal && align_items == align::stretch) {
-            float container_width =
-                width->dest() - *padding_left - *padding_right;
-            if (auto tw = dynamic_cast<text_widget *>(child.get())) {
-                tw->max_width = container_width;
+    auto content_width = width->dest() - *padding_left - *padding_right;
+    // Stretched like the children of a column, wrapped text wraps to it
+    constraints item_limits{content_width, content_width};
+    for (size_t i = 0; i < count; i++) {
+        auto &item = items[i];
+        if (!item) {
+            if (!_recycled.empty() && recycle_item) {
+                item = std::move(_recycled.back());
+                _recycled.pop_back();
+                recycle_item(*item, first + i);
+            } else if (create_item) {
+                item = create_item(first + i);
+            }
+            // Children map to items by position, so the ones below a
+            // missing item wait for the next sync as well
+            if (!item) {
+                for (auto j = i + 1; j < count; j++) {
+                    if (items[j])
+                        release(items[j]);
+                }
+                items.resize(i);
+                break;
             }
+            item->parent = this;
         }
+        item->x->reset_to(*padding_left);
+        item->y->reset_to(*padding_top + item_offset(first + i));
+        item->width->reset_to(content_width);
+        item->_layout_limits = item_limits;
+    }
 
-        float child_width = child->measure_width(ctx);
-        float child_height = child->measure_height(ctx);
-        measure_cache.emplace_back(child_width, child_height);
+    if (_recycled.size() > count)
+        _recycled.resize(count);
+    if (children != items)
+        _children_changed = true;
+    children.swap(items);
+    items.clear();
+    _first = first;
+}
+void ui::virtual_list_widget::update(update_context &ctx) {
+    if (ctx.hovered(this) && enable_scrolling && ctx.scroll_y != 0) {
+        _scroll_target.reset();
+        scroll_top->animate_to(
+            std::clamp(scroll_top->dest() + ctx.scroll_y * 100,
+                       height->dest() - actual_height, 0.f));
+    }
 
-        if (horizontal) {
-            max_child_height = std::max(max_child_height, child_height);
-            if (!dynamic_cast<const spacer *>(child.get())) {
-                total_fixed_size += child_width;
-                total_flex_grow += child->flex_grow;
-                total_flex_shrink += child->flex_shrink;
+    if (_heights.size() != item_count) {
+        _heights.resize(item_count, NAN);
+        _height_tree.assign(item_count, 0);
+        _count_tree.assign(item_count, 0);
+        _measured_sum = 0;
+        _measured_count = 0;
+        for (size_t i = 1; i <= item_count; i++) {
+            if (!std::isnan(_heights[i - 1])) {
+                _height_tree[i - 1] += _heights[i - 1];
+                _count_tree[i - 1]++;
+                _measured_sum += _heights[i - 1];
+                _measured_count++;
             }
-        } else {
-            max_child_width = std::max(max_child_width, child_width);
-            if (!dynamic_cast<const spacer *>(child.get())) {
-                total_fixed_size += child_height;
-                total_flex_grow += child->flex_grow;
-                total_flex_shrink += child->flex_shrink;
+            if (auto parent = i + (i & -i); parent <= item_count) {
+                _height_tree[parent - 1] += _height_tree[i - 1];
+                _count_tree[parent - 1] += _count_tree[i - 1];
             }
         }
     }
 
-    float gap_space = (children_rev.size() - 1) * gap;
-    // Calculate spacer size if needed
-    float spacer_size = 0;
-    if (spacer_count > 0 && !should_autosize(true)) {
-        float available_space =
-            horizontal ? (width->dest() - *padding_left - *padding_right)
-                       : (height->dest() - *padding_top - *padding_bottom);
-
-        spacer_size =
-            std::max(0.0f, (available_space - total_fixed_size - gap_space) /
-                               spacer_count);
-    }
+    actual_height = content_height() + *padding_top + *padding_bottom;
+    if (auto_size)
+        height->reset_to(std::min(max_height, actual_height));
+    // The content may have shrunk below the scrolled position
+    auto min_scroll = std::min(0.f, height->dest() - actual_height);
+    if (scroll_top->dest() < min_scroll)
+        scroll_top->reset_to(min_scroll);
+
+    sync_items(ctx);
+    // Items are laid out by us, size changes only need new measurements
+    layout_dirty = false;
+    // Overscan items reach past our bounds, only the part inside is visible
+    auto forkctx =
+        ctx.with_clip({ctx.offset_x + *x, ctx.offset_y + *y, *width, *height})
+            .with_offset(0, *scroll_top);
+    widget::update(forkctx);
 
-    // Calculate total content size (including gaps and spacers)
-    float total_content_size =
-        total_fixed_size + gap_space + spacer_count * spacer_size;
-
-    // Set container dimensions if auto_size enabled
-    // should_autosize decides if we should auto size in the main axis
-    // When horizontal is true, the main axis is width side, so we check if we
-    // should auto size width by passing in true When horizontal is false, the
-    // main axis is not width side, so we check if we should auto size width by
-    // passing in false
-    if (should_autosize(horizontal)) {
-        width->animate_to(
-            r((horizontal ? total_content_size : max_child_width) +
-              *padding_left + *padding_right));
+    // Keep the item at the top of the view in place while the heights
+    // above it turn from estimates into measurements
+    auto anchor = item_at(-*scroll_top - *padding_top);
+    auto anchor_offset = item_offset(anchor);
+    bool changed = false;
+    for (size_t i = 0; i < children.size(); i++) {
+        if (!children[i])
+            continue;
+        auto height = children[i]->height->dest();
+        if (_heights[_first + i] != height) {
+            set_height(_first + i, height);
+            changed = true;
+        }
+    }
+    if (changed)
+        scroll_top->shift_by(anchor_offset - item_offset(anchor));
+
+    // Land exactly on the target once the animation is done
+    if (_scroll_target && scroll_top->dest() == *scroll_top) {
+        auto target = std::clamp(-item_offset(*_scroll_target),
+                                 height->dest() - actual_height, 0.f);
+        if (target != *scroll_top) {
+            scroll_top->reset_to(target);
+            changed = true;
+        } else if (!changed) {
+            _scroll_target.reset();
+        }
+    }
+    if (!changed)
+        return;
+    // Items are moved to their measured offsets in the next frame
+    ctx.request_frame_after(0);
+}
+namespace {
+// Flex layouts of this thread, one for each level of nested measure() calls.
+// They keep their memory, so laying out does not allocate.
+struct scratch_layout {
+    ui::flex_layout &layout;
+    // Containers laid out in `layout`, with their node, parents first
+    std::vector<std::pair<ui::flex_widget *, ui::flex_layout::node>>
+        &containers;
+    scratch_layout() : scratch_layout(acquire()) {}
+    ~scratch_layout() { depth()--; }
+    scratch_layout(const scratch_layout &) = delete;
+
+  private:
+    struct entry {
+        ui::flex_layout layout;
+        std::vector<std::pair<ui::flex_widget *, ui::flex_layout::node>>
+            containers;
+    };
+    scratch_layout(entry &e) : layout(e.layout), containers(e.containers) {
+        layout.clear();
+        containers.clear();
+    }
+    static size_t &depth() {
+        thread_local size_t depth = 0;
+        return depth;
     }
+    static entry &acquire() {
+        thread_local std::deque<entry> pool;
+        if (depth() == pool.size())
+            pool.emplace_back();
+        return pool[depth()++];
+    }
+};
+
+// What the container's layout reads from the container itself
+void set_container(ui::flex_layout &l, ui::flex_layout::node n,
+                   const ui::flex_widget &w) {
+    l.flags[n] = (w.horizontal ? ui::flex_layout::is_horizontal : 0) |
+                 (w.wrap ? ui::flex_layout::is_wrapping : 0) |
+                 (w.reverse ? ui::flex_layout::is_reversed : 0);
+    l.gap[n] = w.gap;
+    l.padding_left[n] = *w.padding_left;
+    l.padding_right[n] = *w.padding_right;
+    l.padding_top[n] = *w.padding_top;
+    l.padding_bottom[n] = *w.padding_bottom;
+    l.justify_content[n] = w.justify_content;
+    l.align_items[n] = w.align_items;
+}
 
-    if (should_autosize(!horizontal)) {
-        height->animate_to(
-            r((horizontal ? max_child_height : total_content_size) +
-              *padding_top + *padding_bottom));
+// Adds the children to the container node as leaves, measured within
+// child_limits
+void add_leaves(ui::update_context &ctx, ui::flex_layout &l,
+                ui::flex_layout::node parent,
+                std::vector<std::shared_ptr<ui::widget>> &children,
+                const ui::constraints &child_limits) {
+    auto n = l.add(parent, children.size());
+    for (auto &child : children) {
+        child->_layout_limits = child_limits;
+        auto measured = child->measured(ctx, child_limits);
+        l.width[n] = measured.width;
+        l.height[n] = measured.height;
+        l.min_width[n] = child->size_limits.min_width;
+        l.max_width[n] = child->size_limits.max_width;
+        l.min_height[n] = child->size_limits.min_height;
+        l.max_height[n] = child->size_limits.max_height;
+        l.basis[n] = child->flex_basis;
+        l.grow[n] = child->flex_grow;
+        l.shrink[n] = child->flex_shrink;
+        if (dynamic_cast<const ui::flex_widget::spacer *>(child.get()))
+            l.flags[n] = ui::flex_layout::is_spacer;
+        n++;
     }
+}
 
-    // Get final container dimensions for layout
-    float container_width = width->dest() - *padding_left - *padding_right;
-    float container_height = height->dest() - *padding_top - *padding_bottom;
+// Adds the container with its children as leaves, measured within
+// child_limits. Axes that are not auto sized keep their current size.
+ui::flex_layout::node add_flex_nodes(
+    ui::update_context &ctx, ui::flex_widget &w,
+    std::vector<std::shared_ptr<ui::widget>> &children, ui::flex_layout &l,
+    const ui::constraints &limits, const ui::constraints &child_limits,
+    bool auto_width, bool auto_height) {
+    auto root = l.add();
+    l.width[root] = auto_width ? NAN : w.width->dest();
+    l.height[root] = auto_height ? NAN : w.height->dest();
+    l.min_width[root] = limits.min_width;
+    l.max_width[root] = limits.max_width;
+    l.min_height[root] = limits.min_height;
+    l.max_height[root] = limits.max_height;
+    set_container(l, root, w);
+    add_leaves(ctx, l, root, children, child_limits);
+    return root;
+}
 
-    // Pass 2: Apply align-items to children
-    for (size_t i = 0; i < children_rev.size(); ++i) {
-        auto &child = children_rev[i];
-        if (dynamic_cast<const spacer *>(child.get())) {
-            if (horizontal) {
-                child->width->animate_to(spacer_size);
-            } else {
-                child->height->animate_to(spacer_size);
-            }
-            continue;
-        }
+// The child if it can be laid out in the same flex_layout as its parent.
+// Its children are measured before the layout gives it a size, so their
+// limits must not depend on it, see flex_widget::children_limits.
+// Subclasses may measure or place their children differently and lay
+// themselves out.
+ui::flex_widget *nested_container(ui::widget &child) {
+    if (!child.layout_dirty || typeid(child) != typeid(ui::flex_widget))
+        return nullptr;
+    auto &flex = static_cast<ui::flex_widget &>(child);
+    bool fill_cross = flex.align_items == ui::flex_widget::align::stretch &&
+                      !flex.should_autosize(!flex.horizontal);
+    return fill_cross ? nullptr : &flex;
+}
+} // namespace
 
-        auto [cached_width, cached_height] = measure_cache[i];
-        if (horizontal) {
-            switch (align_items) {
-            case align::center:
-                child->y->animate_to(
-                    r(y + (container_height - cached_height) / 2));
-                break;
-            case align::end:
-                child->y->animate_to(r(y + container_height - cached_height));
-                break;
-            case align::stretch:
-                child->height->animate_to(r(container_height));
-                child->y->animate_to(r(y));
-                break;
-            case align::start:
-                child->y->animate_to(r(y));
-                break;
-            default:
-                break;
-            }
-        } else {
-            switch (align_items) {
-            case align::center:
-                child->x->animate_to(
-                    r(x + (container_width - cached_width) / 2));
-                break;
-            case align::end:
-                child->x->animate_to(r(x + container_width - cached_width));
-                break;
-            case align::stretch:
-                child->width->animate_to(r(container_width));
-                child->x->animate_to(r(x));
-                break;
-            case align::start:
-                child->x->animate_to(r(x));
-                break;
-            default:
-                break;
+void ui::flex_widget::reposition_children_flex(
+    update_context &ctx, std::vector<std::shared_ptr<widget>> &children) {
+    constexpr bool floor_position = true;
+    auto r = [](float value) {
+        return floor_position ? std::floor(value) : value;
+    };
+
+    // should_autosize(horizontal) checks the width side,
+    // should_autosize(!horizontal) the height side
+    bool auto_width = should_autosize(horizontal),
+         auto_height = should_autosize(!horizontal);
+    scratch_layout scratch;
+    auto &layout = scratch.layout;
+    auto &containers = scratch.containers;
+    auto root = add_flex_nodes(ctx, *this, children, layout, size_limits,
+                               children_limits(_layout_limits), auto_width,
+                               auto_height);
+    containers.push_back({this, root});
+
+    // Nested containers that need a new layout become containers in the
+    // same flex_layout, so the whole tree is solved with one compute().
+    // Like in measure(), they start from the size of their children.
+    for (size_t c = 0; c < containers.size(); c++) {
+        auto [w, node] = containers[c];
+        auto n = layout.first_child[node];
+        for (auto &child : w->children) {
+            auto nested = nested_container(*child);
+            if (!nested) {
+                n++;
+                continue;
             }
+            // The limits it would have been measured with
+            auto limits = child->_layout_limits;
+            layout.width[n] = nested->auto_size ? NAN : nested->width->dest();
+            layout.height[n] =
+                nested->auto_size ? NAN : nested->height->dest();
+            layout.min_width[n] =
+                std::max(limits.min_width, layout.min_width[n]);
+            layout.max_width[n] =
+                std::min(limits.max_width, layout.max_width[n]);
+            layout.min_height[n] =
+                std::max(limits.min_height, layout.min_height[n]);
+            layout.max_height[n] =
+                std::min(limits.max_height, layout.max_height[n]);
+            set_container(layout, n, *nested);
+            invalidate_children_layout(*nested,
+                                       nested->current_layout_inputs());
+            add_leaves(ctx, layout, n, nested->children,
+                       nested->children_limits(limits));
+            containers.push_back({nested, n});
+            n++;
         }
     }
-
-    // Pass 3: Apply justify-content and position children
-    float remaining_space =
-        (horizontal ? container_width : container_height) - total_content_size;
-    float initial_offset = 0;
-    float effective_gap = gap;
-
-    switch (justify_content) {
-    case justify::end:
-        initial_offset = remaining_space;
-        break;
-    case justify::center:
-        initial_offset = remaining_space / 2;
-        break;
-    case justify::space_between:
-        if (children.size() > 1) {
-            effective_gap += remaining_space / (children.size() - 1);
+    layout.compute();
+
+    if (auto_width)
+        width->animate_to(r(layout.out_width[root]));
+    if (auto_height)
+        height->animate_to(r(layout.out_height[root]));
+
+    // Children keep their own size on the axes they size themselves on,
+    // unless the layout clamped it. Nested containers are written after
+    // their parent gave them their size.
+    for (auto [w, node] : containers) {
+        auto n = layout.first_child[node];
+        for (auto &child : w->children) {
+            bool spacer = layout.flags[n] & flex_layout::is_spacer;
+            bool owns_main = spacer || child->flex_grow > 0 ||
+                             child->flex_shrink > 0 || child->flex_basis >= 0;
+            bool owns_cross = !spacer && w->align_items == align::stretch;
+            bool owns_width = w->horizontal ? owns_main : owns_cross,
+                 owns_height = w->horizontal ? owns_cross : owns_main;
+
+            if (!std::isnan(layout.x[n]))
+                child->x->animate_to(r(layout.x[n]));
+            if (!std::isnan(layout.y[n]))
+                child->y->animate_to(r(layout.y[n]));
+            if (owns_width || layout.out_width[n] != layout.width[n])
+                child->width->animate_to(r(layout.out_width[n]));
+            if (owns_height || layout.out_height[n] != layout.height[n])
+                child->height->animate_to(r(layout.out_height[n]));
+            n++;
         }
-        break;
-    case justify::space_around:
-        effective_gap += remaining_space / children.size();
-        initial_offset = effective_gap / 2;
-        break;
-    case justify::space_evenly:
-        effective_gap += remaining_space / (children.size() + 1);
-        initial_offset = effective_gap;
-        break;
-    case justify::start:
-    default:
-        break;
-    }
-
-    // Calculate space to distribute among flex-growing/shrinking children
-    float flex_space_to_distribute = 0.0f;
-    if (remaining_space > 0.0f && total_flex_grow > 0.0f) {
-        flex_space_to_distribute = remaining_space;
-    } else if (remaining_space < 0.0f && total_flex_shrink > 0.0f) {
-        flex_space_to_distribute = remaining_space; // negative
+        if (w != this)
+            w->finish_layout();
     }
+}
 
+ui::constraints
+ui::flex_widget::children_limits(const constraints &limits) const {
+    // Stretched children are measured against the cross size they are going
+    // to get, so that text wraps to it. Otherwise they only get the limits
+    // we were measured with ourselves.
+    constraints child_limits;
+    auto inner = limits.deflated(*padding_left + *padding_right,
+                                 *padding_top + *padding_bottom);
+    bool fill_cross =
+        align_items == align::stretch && !should_autosize(!horizontal);
     if (horizontal) {
-        x += initial_offset;
-        for (size_t i = 0; i < children_rev.size(); ++i) {
-            auto &child = children_rev[i];
-            child->x->animate_to(r(x));
-
-            float child_base_size = dynamic_cast<const spacer *>(child.get())
-                                        ? spacer_size
-                                        : measure_cache[i].first;
-
-            // Apply flex grow/shrink if this child can flex
-            float flex_extra = 0.0f;
-            if (flex_space_to_distribute != 0.0f) {
-                float flex_factor = 0.0f;
-                float total_flex = 0.0f;
-                if (flex_space_to_distribute > 0.0f && total_flex_grow > 0.0f) {
-                    flex_factor = child->flex_grow;
-                    total_flex = total_flex_grow;
-                } else if (flex_space_to_distribute < 0.0f &&
-                           total_flex_shrink > 0.0f) {
-                    flex_factor = child->flex_shrink;
-                    total_flex = total_flex_shrink;
-                }
-                if (flex_factor > 0.0f && total_flex > 0.0f) {
-                    flex_extra =
-                        (flex_factor / total_flex) * flex_space_to_distribute;
-                    if (horizontal) {
-                        child->width->animate_to(
-                            r(child_base_size + flex_extra));
-                    }
-                }
-            }
-
-            float child_size = child_base_size + flex_extra;
-            x += child_size + effective_gap;
-        }
+        child_limits.max_height =
+            fill_cross ? height->dest() - *padding_top - *padding_bottom
+                       : inner.max_height;
     } else {
-        y += initial_offset;
-        for (size_t i = 0; i < children_rev.size(); ++i) {
-            auto &child = children_rev[i];
-            child->y->animate_to(r(y));
-
-            float child_base_size = dynamic_cast<const spacer *>(child.get())
-                                        ? spacer_size
-                                        : measure_cache[i].second;
-
-            // Apply flex grow/shrink if this child can flex
-            float flex_extra = 0.0f;
-            if (flex_space_to_distribute != 0.0f) {
-                float flex_factor = 0.0f;
-                float total_flex = 0.0f;
-                if (flex_space_to_distribute > 0.0f && total_flex_grow > 0.0f) {
-                    flex_factor = child->flex_grow;
-                    total_flex = total_flex_grow;
-                } else if (flex_space_to_distribute < 0.0f &&
-                           total_flex_shrink > 0.0f) {
-                    flex_factor = child->flex_shrink;
-                    total_flex = total_flex_shrink;
-                }
-                if (flex_factor > 0.0f && total_flex > 0.0f) {
-                    flex_extra =
-                        (flex_factor / total_flex) * flex_space_to_distribute;
-                    if (!horizontal) {
-                        child->height->animate_to(
-                            r(child_base_size + flex_extra));
-                    }
-                }
-            }
-
-            float child_size = child_base_size + flex_extra;
-            y += child_size + effective_gap;
-        }
+        child_limits.max_width =
+            fill_cross ? width->dest() - *padding_left - *padding_right
+                       : inner.max_width;
     }
+    return child_limits;
 }
 
-float ui::flex_widget::measure_height(update_context &ctx) {
-    if (!auto_size) {
-        return height->dest();
-    }
-
-    if (horizontal) {
-        float max_height = 0;
-        for (auto &child : children) {
-            max_height = std::max(max_height, child->measure_height(ctx));
-        }
-        return max_height + *padding_top + *padding_bottom;
-    } else {
-        float total_height = 0;
-        for (auto &child : children) {
-            total_height += child->measure_height(ctx);
-        }
-        total_height += (children.size() - 1) * gap;
-        return total_height + *padding_top + *padding_bottom;
+void ui::flex_widget::measure_children(update_context &ctx,
+                                       const constraints &limits) {
+    auto child_limits = children_limits(limits);
+    for (auto &child : children) {
+        child->_layout_limits = child_limits;
+        child->measured(ctx, child_limits);
     }
 }
+
 float ui::flex_widget::measure_width(update_context &ctx) {
+    return measure(ctx, {}).width;
+}
+float ui::flex_widget::measure_height(update_context &ctx) {
+    return measure(ctx, {}).height;
+}
+ui::size ui::flex_widget::measure(update_context &ctx,
+                                  const constraints &limits) {
     if (!auto_size) {
-        return width->dest();
+        return limits.clamp({width->dest(), height->dest()});
     }
 
+    // Children are laid out in lines, only the cross axis is limited
+    auto inner = limits.deflated(*padding_left + *padding_right,
+                                 *padding_top + *padding_bottom);
+    constraints child_limits;
     if (horizontal) {
-        float total_width = 0;
-        for (auto &child : children) {
-            total_width += child->measure_width(ctx);
-        }
-        total_width += (children.size() - 1) * gap;
-        return total_width + *padding_left + *padding_right;
+        child_limits.max_height = inner.max_height;
     } else {
-        float max_width = 0;
-        for (auto &child : children) {
-            max_width = std::max(max_width, child->measure_width(ctx));
-        }
-        return max_width + *padding_left + *padding_right;
+        child_limits.max_width = inner.max_width;
     }
-}
+    constraints own{
+        std::max(limits.min_width, size_limits.min_width),
+        std::min(limits.max_width, size_limits.max_width),
+        std::max(limits.min_height, size_limits.min_height),
+        std::min(limits.max_height, size_limits.max_height),
+    };
+
+    scratch_layout scratch;
+    auto root = add_flex_nodes(ctx, *this, children, scratch.layout, own,
+                               child_limits, true, true);
+    scratch.layout.compute_sizes();
+    return limits.clamp(
+        {scratch.layout.out_width[root], scratch.layout.out_height[root]});
+}
+size_t ui::flex_widget::measure_key() const {
+    // The size only comes from the children while auto sizing
+    return hash_values(auto_size ? NAN : width->dest(),
+                       auto_size ? NAN : height->dest(), horizontal, wrap, gap,
+                       padding_left->var(), padding_right->var(),
+                       padding_top->var(), padding_bottom->var(),
+                       size_limits.min_width, size_limits.max_width,
+                       size_limits.min_height, size_limits.max_height);
+}
 
 bool ui::flex_widget::should_autosize(bool mainAxis) const {
     if (!auto_size)
@@ -889,7 +1610,7 @@ bool ui::flex_widget::should_autosize(bool mainAxis) const {
 }
 
 void ui::update_context::set_hit_hovered(widget *w) {
-    hovered_widgets->push_back(w);
+    w->_hover_claimed = rt.hover_claimed = rt.frame_number;
 }
 bool ui::update_context::mouse_clicked_on(widget *w, bool hittest) const {
     return mouse_clicked && hovered(w, hittest);
@@ -918,6 +1639,10 @@ bool ui::widget::check_hit(const update_context &ctx) {
            ctx.mouse_y >= (y->dest() + ctx.offset_y) &&
            ctx.mouse_y <= (y->dest() + height->dest() + ctx.offset_y);
 }
+ui::rect ui::widget::hit_rect(const update_context &ctx) const {
+    return {x->dest() + ctx.offset_x, y->dest() + ctx.offset_y, width->dest(),
+            height->dest()};
+}
 void ui::widget::update_children(
     update_context &ctx, std::vector<std::shared_ptr<widget>> &children) {
     for (auto &child : children) {
@@ -927,7 +1652,13 @@ void ui::widget::update_children(
     }
 
     // Remove dead children
-    std::erase_if(children, [](auto &child) { return !child; });
+    if (std::erase_if(children, [](auto &child) { return !child; }))
+        invalidate_layout();
+
+    // Children removed from the vector directly, we don't know which ones so
+    // the whole subtree is repainted
+    if (children.size() < _painted_child_count)
+        ctx.add_damage(_subtree_bounds);
 }
 void ui::widget::render_children(
     nanovg_context ctx, std::vector<std::shared_ptr<widget>> &children) {
@@ -940,38 +1671,334 @@ void ui::text_widget::render(nanovg_context ctx) {
     ctx.fontSize(font_size);
     ctx.fillColor(color.nvg());
     ctx.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
-    apply_font_face(ctx, font_family, font_weight);
+    apply_font_face(ctx, _font_face, font_family, font_weight);
 
-    if (max_width > 0) {
-        ctx.textBox(*x, *y + _yoffset_when_update, max_width, text.c_str(),
-                    nullptr);
-        return;
-    } else {
-        ctx.text(*x, *y + _yoffset_when_update, text.c_str(), nullptr);
-    }
+    auto wrap = wrap_width(_layout_limits);
+    _glyphs.draw(ctx, *x, *y + _yoffset_when_update, text,
+                 wrap > 0 ? wrap : -1);
 }
 void ui::text_widget::update(update_context &ctx) {
-    widget::update(ctx);
-    ctx.vg.fontSize(font_size);
-    apply_font_face(ctx.vg, font_family, font_weight);
-    ctx.vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
-
-    auto [w, h, yoffset] =
-        max_width < 0
-            ? ctx.vg.measureTextWithYOffset(this->text.c_str())
-            : ctx.vg.measureTextBoxWithYOffset(this->text.c_str(), max_width);
-
-    _yoffset_when_update = yoffset;
+    widget::update(ctx);
+    auto wrap = wrap_width(_layout_limits);
+    if (!_layout_inputs ||
+        std::tie(text, font_size, font_weight, font_family, wrap) !=
+            *_layout_inputs) {
+        _layout_inputs = {text, font_size, font_weight, font_family, wrap};
+        // The size may stay the same, the glyphs don't
+        needs_repaint = true;
+        // Unless the parent's last layout already measured us like this,
+        // e.g. ahead of the update on a layout_pool
+        if (!_measured || _measure_key != measure_key() ||
+            _measured_limits != _layout_limits)
+            invalidate_layout();
+
+        ctx.vg.fontSize(font_size);
+        apply_font_face(ctx.vg, _font_face, font_family, font_weight);
+        ctx.vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+        auto [w, h, yoffset] =
+            wrap < 0 ? ctx.vg.measureTextWithYOffset(this->text.c_str())
+                     : ctx.vg.measureTextBoxWithYOffset(this->text.c_str(),
+                                                        wrap);
+        _yoffset_when_update = yoffset;
+    }
+    if (auto painted = *color; painted != _painted_color) {
+        _painted_color = painted;
+        needs_repaint = true;
+    }
 
+    auto [w, h] = measured(ctx, _layout_limits);
     if (shrink_horizontal) {
-        width->animate_to(max_width > 0 ? std::min(w, max_width) : w);
+        width->animate_to(w);
     }
 
-    if (shrink_vertical) {
-        height->animate_to(h);
+    if (shrink_vertical) {
+        height->animate_to(h);
+    }
+}
+namespace {
+// A text widget as seen by the key handling textbox_widget and
+// text_editor_widget share. Positions are character indices of a textbox
+// and byte offsets of a text editor.
+struct text_edit_target {
+    bool multiline = false;
+    // Whether keys and typed text may change the text
+    bool editable = false;
+    // Rows Page Up and Page Down move by
+    std::ptrdiff_t page_rows = 1;
+    std::function<size_t()> caret, anchor, end;
+    std::function<size_t(size_t)> prev_char, next_char;
+    // Start and end of the row a position is in
+    std::function<size_t(size_t)> row_start, row_end;
+    std::function<void(size_t, bool)> move_caret;
+    // Moves the caret by rows, keeping it at the x it had before
+    std::function<void(std::ptrdiff_t, bool)> move_rows;
+    std::function<void()> forget_preferred_x;
+    std::function<void(size_t, size_t, std::string_view)> replace;
+    std::function<void()> copy, paste;
+
+    size_t selection_start() const { return std::min(caret(), anchor()); }
+    size_t selection_end() const { return std::max(caret(), anchor()); }
+};
+
+// Applies a key to a text widget, returns false for the keys it leaves to
+// the widgets after it
+bool apply_text_key(const text_edit_target &target, int key, bool shift,
+                    bool ctrl) {
+    const auto caret = target.caret();
+    const bool has_selection = caret != target.anchor();
+    // Removes the selection, or [start, end) without one
+    auto erase = [&](size_t start, size_t end) {
+        if (!target.editable) {
+            return;
+        }
+        if (has_selection) {
+            target.replace(target.selection_start(), target.selection_end(),
+                           "");
+        } else if (start != end) {
+            target.replace(start, end, "");
+        }
+    };
+
+    switch (key) {
+    case GLFW_KEY_A:
+    case GLFW_KEY_C:
+    case GLFW_KEY_X:
+    case GLFW_KEY_V:
+        if (!ctrl) {
+            return false;
+        }
+        if (key == GLFW_KEY_A) {
+            target.move_caret(0, false);
+            target.move_caret(target.end(), true);
+        } else if (key == GLFW_KEY_V) {
+            if (target.editable) {
+                target.paste();
+            }
+        } else {
+            target.copy();
+            if (key == GLFW_KEY_X && target.editable && has_selection) {
+                target.replace(target.selection_start(),
+                               target.selection_end(), "");
+            }
+        }
+        break;
+    case GLFW_KEY_BACKSPACE:
+        erase(target.prev_char(caret), caret);
+        break;
+    case GLFW_KEY_DELETE:
+        erase(caret, target.next_char(caret));
+        break;
+    case GLFW_KEY_LEFT:
+        target.move_caret(!shift && has_selection ? target.selection_start()
+                                                  : target.prev_char(caret),
+                          shift);
+        break;
+    case GLFW_KEY_RIGHT:
+        target.move_caret(!shift && has_selection ? target.selection_end()
+                                                  : target.next_char(caret),
+                          shift);
+        break;
+    case GLFW_KEY_HOME:
+        target.move_caret(
+            ctrl || !target.multiline ? 0 : target.row_start(caret), shift);
+        break;
+    case GLFW_KEY_END:
+        target.move_caret(ctrl || !target.multiline ? target.end()
+                                                    : target.row_end(caret),
+                          shift);
+        break;
+    case GLFW_KEY_UP:
+    case GLFW_KEY_DOWN:
+    case GLFW_KEY_PAGE_UP:
+    case GLFW_KEY_PAGE_DOWN: {
+        if (!target.multiline) {
+            return false;
+        }
+        const std::ptrdiff_t rows =
+            key == GLFW_KEY_UP || key == GLFW_KEY_DOWN ? 1 : target.page_rows;
+        const bool up = key == GLFW_KEY_UP || key == GLFW_KEY_PAGE_UP;
+        // Keeps the preferred x for the next move
+        target.move_rows(up ? -rows : rows, shift);
+        return true;
+    }
+    case GLFW_KEY_ENTER:
+        if (!target.multiline) {
+            return false;
+        }
+        if (target.editable) {
+            target.replace(target.selection_start(), target.selection_end(),
+                           "\n");
+        }
+        break;
+    default:
+        return false;
+    }
+    target.forget_preferred_x();
+    return true;
+}
+
+void apply_typed_text(const text_edit_target &target,
+                      const std::u32string &typed) {
+    if (!target.editable || typed.empty()) {
+        return;
+    }
+    target.replace(
+        target.selection_start(), target.selection_end(),
+        normalize_text_for_textbox(utf8_from_codepoints(typed),
+                                   target.multiline));
+    target.forget_preferred_x();
+}
+
+// Applies the keys and the typed text of a frame to a focused text widget,
+// one event after the other in the order they came in, each key with the
+// modifiers it was pressed with. With on_key_down set they wait in pending
+// until it answered every key of the frame, and the text typed by a key it
+// canceled is dropped. Nothing is applied during an IME composition, its
+// commit comes as typed text.
+void handle_text_keys(
+    ui::update_context &ctx, ui::widget &self, ui::pending_text_keys &pending,
+    const std::function<bool(int, bool, bool, bool, bool)> &on_key_down,
+    bool ime_active, const text_edit_target &target) {
+    using event_kind = ui::input_event::kind;
+
+    // Events of batches answered since the last frame
+    std::vector<ui::pending_text_keys::event> ready;
+    while (!pending.batches.empty() &&
+           std::ranges::all_of(pending.batches.front().events,
+                               &ui::pending_text_keys::event::resolved)) {
+        auto &events = pending.batches.front().events;
+        ready.insert(ready.end(), events.begin(), events.end());
+        pending.batches.pop_front();
+    }
+
+    // Keys pressed or repeated and text typed this frame, repeats included
+    std::vector<ui::pending_text_keys::event> current;
+    bool current_has_keys = false;
+    for (const auto &event : ctx.input_events()) {
+        if (event.type == event_kind::text) {
+            current.push_back({.type = event_kind::text,
+                               .codepoint = event.codepoint,
+                               .resolved = true});
+        } else if (event.action != GLFW_RELEASE && !event.stopped &&
+                   event.key >= 0 && event.key <= GLFW_KEY_LAST) {
+            current.push_back({.key = event.key, .mods = event.mods});
+            current_has_keys = true;
+        }
+    }
+
+    // Text typed while keys wait goes after them
+    if (on_key_down && !current.empty() &&
+        (current_has_keys || !pending.batches.empty())) {
+        ui::pending_text_keys::batch batch;
+        batch.id = pending.next_id++;
+        batch.events = std::move(current);
+        current.clear();
+
+        // pending is a member of self, alive as long as self is
+        auto weak_self = self.weak_from_this();
+        auto *queue = &pending;
+        auto callback = on_key_down;
+        const auto batch_id = batch.id;
+        for (size_t i = 0; i < batch.events.size(); ++i) {
+            const auto &event = batch.events[i];
+            if (event.type != event_kind::key) {
+                continue;
+            }
+            ctx.stop_key_propagation(event.key);
+            ctx.rt.post_loop_thread_task(
+                [weak_self, queue, callback, batch_id, event_index = i,
+                 key = event.key, mods = event.mods]() mutable {
+                    const bool canceled =
+                        callback ? callback(key, mods & GLFW_MOD_SHIFT,
+                                            mods & GLFW_MOD_CONTROL,
+                                            mods & GLFW_MOD_ALT,
+                                            mods & GLFW_MOD_SUPER)
+                                 : false;
+                    auto self = weak_self.lock();
+                    if (!self || !self->owner_rt) {
+                        return;
+                    }
+                    std::lock_guard lock(self->owner_rt->rt_lock);
+                    auto it = std::ranges::find(
+                        queue->batches, batch_id,
+                        &ui::pending_text_keys::batch::id);
+                    if (it == queue->batches.end() ||
+                        event_index >= it->events.size()) {
+                        return;
+                    }
+                    it->events[event_index].canceled = canceled;
+                    it->events[event_index].resolved = true;
+                    self->needs_repaint = true;
+                },
+                true);
+        }
+        pending.batches.push_back(std::move(batch));
+    }
+
+    if (ime_active) {
+        return;
+    }
+    auto apply = [&](const std::vector<ui::pending_text_keys::event> &events,
+                     bool current_frame) {
+        // Consecutive characters are inserted together
+        std::u32string typed;
+        bool drop_typed = false;
+        for (const auto &event : events) {
+            if (event.type == event_kind::text) {
+                if (!drop_typed) {
+                    typed.push_back(event.codepoint);
+                }
+                continue;
+            }
+            apply_typed_text(target, typed);
+            typed.clear();
+            // The text right after a canceled key is what it typed, unless
+            // Ctrl, Alt or Super made it a shortcut
+            drop_typed = event.canceled &&
+                         !(event.mods & (GLFW_MOD_CONTROL | GLFW_MOD_ALT |
+                                         GLFW_MOD_SUPER));
+            if (!event.canceled &&
+                apply_text_key(target, event.key,
+                               event.mods & GLFW_MOD_SHIFT,
+                               event.mods & GLFW_MOD_CONTROL) &&
+                current_frame) {
+                ctx.stop_key_propagation(event.key);
+            }
+        }
+        apply_typed_text(target, typed);
+    };
+    apply(ready, false);
+    apply(current, true);
+}
+
+// Calls on_focus or on_blur when the focus changed. A blur also ends the IME
+// composition and drops the keys still waiting for on_key_down.
+bool update_text_focus(ui::update_context &ctx, bool focused_now,
+                       bool &last_focused, ui::pending_text_keys &pending,
+                       const std::function<void()> &on_focus,
+                       const std::function<void()> &on_blur) {
+    if (focused_now == last_focused) {
+        return false;
+    }
+    if (!focused_now) {
+        ctx.rt.clear_ime_composition();
+        pending.batches.clear();
     }
+    if (auto callback = focused_now ? on_focus : on_blur) {
+        ctx.rt.post_loop_thread_task([callback]() mutable { callback(); },
+                                     true);
+    }
+    last_focused = focused_now;
+    return true;
 }
-ui::textbox_widget::textbox_widget() : widget() {
+} // namespace
+
+struct ui::textbox_widget::layout_cache {
+    cached_textbox_layout text, visual;
+};
+
+ui::textbox_widget::textbox_widget()
+    : widget(), _layout_cache(std::make_unique<layout_cache>()) {
     width->reset_to(160);
     height->reset_to(min_height);
 }
@@ -1016,9 +2043,12 @@ void ui::textbox_widget::render(nanovg_context ctx) {
     const auto visual = make_textbox_visual_state(
         text, selection_start(), selection_end(), caret_index, multiline,
         ime_active ? &ime : nullptr);
-    const auto layout = build_textbox_layout(layout_vg, visual.text, font_size,
-                                             font_weight, multiline, inner_width,
-                                             line_height_multiplier);
+    // Without a composition the visual text is the text update laid out
+    auto &layout_slot = visual.text == text ? _layout_cache->text
+                                            : _layout_cache->visual;
+    const auto &layout = layout_textbox(
+        layout_slot, layout_vg, _font_face, visual.text, font_size,
+        font_weight, multiline, inner_width, line_height_multiplier);
 
     const auto fill_color = disabled ? disabled_background_color.nvg()
                             : readonly ? readonly_background_color.nvg()
@@ -1040,13 +2070,13 @@ void ui::textbox_widget::render(nanovg_context ctx) {
                           std::max(border_radius - border_inset, 0.0f));
 
     auto t = ctx.transaction();
-    ctx.scissor(*x + border_width, *y + border_width,
+    ctx.intersectScissor(*x + border_width, *y + border_width,
                 std::max(*width - border_width * 2.0f, 0.0f),
                 std::max(*height - border_width * 2.0f, 0.0f));
     ctx.translate(*x + padding_x - horizontal_scroll,
                   *y + padding_y - vertical_scroll);
     ctx.fontSize(font_size);
-    apply_font_face(ctx, "main", font_weight);
+    apply_font_face(ctx, _font_face, "main", font_weight);
     ctx.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
 
     const int selection_begin = visual.selection_start;
@@ -1121,30 +2151,28 @@ void ui::textbox_widget::update(update_context &ctx) {
 
     const bool shift_down = ctx.key_down(GLFW_KEY_LEFT_SHIFT) ||
                             ctx.key_down(GLFW_KEY_RIGHT_SHIFT);
-    const bool ctrl_down = ctx.key_down(GLFW_KEY_LEFT_CONTROL) ||
-                           ctx.key_down(GLFW_KEY_RIGHT_CONTROL);
-    const bool alt_down = ctx.key_down(GLFW_KEY_LEFT_ALT) ||
-                          ctx.key_down(GLFW_KEY_RIGHT_ALT);
-    const bool super_down = ctx.key_down(GLFW_KEY_LEFT_SUPER) ||
-                            ctx.key_down(GLFW_KEY_RIGHT_SUPER);
     const float inner_width =
         std::max(width->dest() - padding_x * 2.0f, 1.0f);
     const float inner_height =
         std::max(height->dest() - padding_y * 2.0f, 1.0f);
-    auto layout =
-        build_textbox_layout(ctx.vg, text, font_size, font_weight, multiline, inner_width,
-                             line_height_multiplier);
+    // Both refer into _layout_cache, laying out again updates them
+    auto lay_out = [&](bool visual_text,
+                       std::string_view laid_out) -> const textbox_layout & {
+        return layout_textbox(visual_text ? _layout_cache->visual
+                                          : _layout_cache->text,
+                              ctx.vg, _font_face, laid_out, font_size,
+                              font_weight, multiline, inner_width,
+                              line_height_multiplier);
+    };
+    const auto &layout = lay_out(false, text);
     auto visual = make_textbox_visual_state(text, selection_start(),
                                             selection_end(), caret_index,
                                             multiline);
-    auto visual_layout =
-        build_textbox_layout(ctx.vg, visual.text, font_size, font_weight, multiline,
-                             inner_width, line_height_multiplier);
+    const textbox_layout *visual_layout =
+        visual.text == text ? &layout : &lay_out(true, visual.text);
 
     auto rebuild_layouts = [&]() {
-        layout =
-            build_textbox_layout(ctx.vg, text, font_size, font_weight, multiline,
-                                 inner_width, line_height_multiplier);
+        lay_out(false, text);
         const auto &ime = ctx.ime_composition();
         const bool ime_active = focused() && !disabled && ime.active;
         visual = make_textbox_visual_state(text, selection_start(),
@@ -1152,8 +2180,7 @@ void ui::textbox_widget::update(update_context &ctx) {
                                            multiline,
                                            ime_active ? &ime : nullptr);
         visual_layout =
-            build_textbox_layout(ctx.vg, visual.text, font_size, font_weight, multiline,
-                                 inner_width, line_height_multiplier);
+            visual.text == text ? &layout : &lay_out(true, visual.text);
     };
 
     auto move_caret = [&](int new_index, bool extend_selection) {
@@ -1196,21 +2223,6 @@ void ui::textbox_widget::update(update_context &ctx) {
         return true;
     };
 
-    auto delete_selection_or = [&](int start, int end) {
-        if (readonly || disabled) {
-            return false;
-        }
-        if (selection_start() != selection_end()) {
-            replace_range(selection_start(), selection_end(), "");
-        } else if (start != end) {
-            replace_range(start, end, "");
-        } else {
-            return false;
-        }
-        rebuild_layouts();
-        return true;
-    };
-
     auto pointer_to_caret = [&]() {
         const float local_x = static_cast<float>(
             ctx.mouse_x - (ctx.offset_x + x->dest() + padding_x) +
@@ -1259,275 +2271,88 @@ void ui::textbox_widget::update(update_context &ctx) {
     }
 
     bool text_changed = false;
-    bool suppress_text_input = false;
     if (is_focused) {
-        ctx.need_repaint = true;
         caret_blink_elapsed += ctx.delta_time;
+        // Wake up for the next caret blink
+        ctx.request_frame_after(
+            500.0f - std::fmod(caret_blink_elapsed, 500.0f));
 
-        auto ready_key_batch = [&]() -> std::optional<textbox_widget::pending_key_batch> {
-            if (pending_key_batches.empty()) {
-                return std::nullopt;
-            }
-            if (!std::ranges::all_of(pending_key_batches.front().events,
-                                     [](const auto &event) {
-                                         return event.resolved;
-                                     })) {
-                return std::nullopt;
-            }
-            auto batch = std::move(pending_key_batches.front());
-            pending_key_batches.pop_front();
-            return batch;
-        }();
-
-        std::vector<int> current_triggered_keys;
-        current_triggered_keys.reserve(8);
-        for (int key = 0; key <= GLFW_KEY_LAST; ++key) {
-            if (ctx.key_triggered(key)) {
-                current_triggered_keys.push_back(key);
-            }
-        }
-
-        bool deferred_current_key_batch = false;
-        if (on_key_down && !current_triggered_keys.empty()) {
-            deferred_current_key_batch = true;
-
-            pending_key_batch batch;
-            batch.id = next_pending_key_batch_id++;
-            batch.shift_down = shift_down;
-            batch.ctrl_down = ctrl_down;
-            batch.alt_down = alt_down;
-            batch.super_down = super_down;
-            batch.text_input = ctx.text_input();
-            batch.events.reserve(current_triggered_keys.size());
-            for (int key : current_triggered_keys) {
-                batch.events.push_back({.key = key});
-                ctx.stop_key_propagation(key);
-            }
-
-            auto weak_self = std::weak_ptr<textbox_widget>(
-                std::dynamic_pointer_cast<textbox_widget>(shared_from_this()));
-            auto callback = on_key_down;
-            const auto batch_id = batch.id;
-            const auto event_count = batch.events.size();
-            pending_key_batches.push_back(std::move(batch));
-
-            for (size_t i = 0; i < event_count; ++i) {
-                const int key = current_triggered_keys[i];
-                ctx.rt.post_loop_thread_task(
-                    [weak_self, callback, batch_id, event_index = i, key,
-                     shift = shift_down, ctrl = ctrl_down, alt = alt_down,
-                     super = super_down]() mutable {
-                        const bool canceled =
-                            callback ? callback(key, shift, ctrl, alt, super)
-                                     : false;
-                        auto self = weak_self.lock();
-                        if (!self || !self->owner_rt) {
-                            return;
-                        }
-                        std::lock_guard lock(self->owner_rt->rt_lock);
-                        auto it = std::find_if(
-                            self->pending_key_batches.begin(),
-                            self->pending_key_batches.end(),
-                            [batch_id](const auto &candidate) {
-                                return candidate.id == batch_id;
-                            });
-                        if (it == self->pending_key_batches.end() ||
-                            event_index >= it->events.size()) {
-                            return;
-                        }
-                        it->events[event_index].canceled = canceled;
-                        it->events[event_index].resolved = true;
-                        self->needs_repaint = true;
-                    },
-                    true);
-            }
-        }
-
-        std::vector<unsigned char> active_keys(GLFW_KEY_LAST + 1, 0);
-        bool processing_current_frame_keys = false;
-        const auto *typed_input = &ctx.text_input();
-        bool active_shift_down = shift_down;
-        bool active_ctrl_down = ctrl_down;
-        bool active_alt_down = alt_down;
-        bool active_super_down = super_down;
-
-        if (ready_key_batch) {
-            active_shift_down = ready_key_batch->shift_down;
-            active_ctrl_down = ready_key_batch->ctrl_down;
-            active_alt_down = ready_key_batch->alt_down;
-            active_super_down = ready_key_batch->super_down;
-            typed_input = &ready_key_batch->text_input;
-
-            for (const auto &event : ready_key_batch->events) {
-                if (event.canceled) {
-                    if (!active_ctrl_down && !active_alt_down &&
-                        !active_super_down) {
-                        suppress_text_input = true;
-                    }
-                    continue;
-                }
-                active_keys[event.key] = 1;
-            }
-        } else if (!deferred_current_key_batch) {
-            processing_current_frame_keys = true;
-            for (int key : current_triggered_keys) {
-                active_keys[key] = 1;
-            }
-        } else {
-            static const std::u32string empty_input;
-            typed_input = &empty_input;
-        }
-
-        auto key_triggered = [&](int key) {
-            return key >= 0 && key < static_cast<int>(active_keys.size()) &&
-                   active_keys[static_cast<size_t>(key)] != 0;
-        };
-        auto stop_key_propagation = [&](int key) {
-            if (processing_current_frame_keys) {
-                ctx.stop_key_propagation(key);
-            }
+        auto row_of = [&](size_t index) -> const text_row_layout & {
+            return layout.rows[static_cast<size_t>(
+                find_row_for_index(layout, static_cast<int>(index)))];
         };
-
-        if (!ime_active) {
-            if (active_ctrl_down && key_triggered(GLFW_KEY_A)) {
-                selection_anchor_index = 0;
-                caret_index = build_utf8_index_map(text).char_count();
-                stop_key_propagation(GLFW_KEY_A);
-                reset_caret_blink();
-                rebuild_layouts();
-            }
-
-            if (active_ctrl_down && key_triggered(GLFW_KEY_C)) {
-                copy();
-                stop_key_propagation(GLFW_KEY_C);
-            }
-
-            if (active_ctrl_down && key_triggered(GLFW_KEY_X)) {
-                copy();
-                text_changed |= delete_selection_or(selection_start(),
-                                                    selection_end());
-                stop_key_propagation(GLFW_KEY_X);
-            }
-
-            if (active_ctrl_down && key_triggered(GLFW_KEY_V)) {
-                if (const char *clipboard = glfwGetClipboardString(
-                        static_cast<GLFWwindow *>(ctx.window))) {
-                    text_changed |= insert_text_internal(clipboard);
-                }
-                stop_key_propagation(GLFW_KEY_V);
-            }
-
-            if (key_triggered(GLFW_KEY_BACKSPACE)) {
-                if (selection_start() != selection_end()) {
-                    text_changed |=
-                        delete_selection_or(selection_start(), selection_end());
-                } else if (caret_index > 0) {
-                    text_changed |=
-                        delete_selection_or(caret_index - 1, caret_index);
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_BACKSPACE);
-            }
-
-            if (key_triggered(GLFW_KEY_DELETE)) {
-                if (selection_start() != selection_end()) {
-                    text_changed |=
-                        delete_selection_or(selection_start(), selection_end());
-                } else {
-                    auto char_count = build_utf8_index_map(text).char_count();
-                    if (caret_index < char_count) {
-                        text_changed |=
-                            delete_selection_or(caret_index, caret_index + 1);
+        const text_edit_target target{
+            .multiline = multiline,
+            .editable = !readonly,
+            .page_rows = std::max(
+                static_cast<std::ptrdiff_t>(
+                    inner_height / std::max(layout.line_height, 1.0f)),
+                std::ptrdiff_t{1}),
+            .caret = [&] { return static_cast<size_t>(caret_index); },
+            .anchor =
+                [&] { return static_cast<size_t>(selection_anchor_index); },
+            .end =
+                [&] {
+                    return static_cast<size_t>(
+                        build_utf8_index_map(text).char_count());
+                },
+            .prev_char = [](size_t index) { return index ? index - 1 : 0; },
+            .next_char =
+                [&](size_t index) {
+                    return std::min(index + 1,
+                                    static_cast<size_t>(
+                                        build_utf8_index_map(text)
+                                            .char_count()));
+                },
+            .row_start =
+                [&](size_t index) {
+                    return static_cast<size_t>(row_of(index).start);
+                },
+            .row_end =
+                [&](size_t index) {
+                    return static_cast<size_t>(row_of(index).end);
+                },
+            .move_caret =
+                [&](size_t index, bool extend_selection) {
+                    move_caret(static_cast<int>(index), extend_selection);
+                },
+            .move_rows =
+                [&](std::ptrdiff_t rows, bool extend_selection) {
+                    const auto row_index =
+                        find_row_for_index(layout, caret_index);
+                    const float target_x = preferred_caret_x.value_or(
+                        caret_x_for_index(
+                            layout.rows[static_cast<size_t>(row_index)],
+                            caret_index));
+                    preferred_caret_x = target_x;
+                    const auto last =
+                        static_cast<std::ptrdiff_t>(layout.rows.size()) - 1;
+                    const auto &next_row = layout.rows[static_cast<size_t>(
+                        std::clamp(row_index + rows, std::ptrdiff_t{0},
+                                   last))];
+                    move_caret(caret_index_from_x(next_row, target_x),
+                               extend_selection);
+                },
+            .forget_preferred_x = [&] { preferred_caret_x.reset(); },
+            .replace =
+                [&](size_t start, size_t end, std::string_view replacement) {
+                    replace_range(static_cast<int>(start),
+                                  static_cast<int>(end),
+                                  std::string(replacement));
+                    rebuild_layouts();
+                    text_changed = true;
+                },
+            .copy = [&] { copy(); },
+            .paste =
+                [&] {
+                    if (const char *clipboard = glfwGetClipboardString(
+                            static_cast<GLFWwindow *>(ctx.window))) {
+                        text_changed |= insert_text_internal(clipboard);
                     }
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_DELETE);
-            }
-
-            if (key_triggered(GLFW_KEY_LEFT)) {
-                if (!active_shift_down && selection_start() != selection_end()) {
-                    move_caret(selection_start(), false);
-                } else {
-                    move_caret(caret_index - 1, active_shift_down);
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_LEFT);
-            }
-
-            if (key_triggered(GLFW_KEY_RIGHT)) {
-                if (!active_shift_down && selection_start() != selection_end()) {
-                    move_caret(selection_end(), false);
-                } else {
-                    move_caret(caret_index + 1, active_shift_down);
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_RIGHT);
-            }
-
-            if (key_triggered(GLFW_KEY_HOME)) {
-                if (active_ctrl_down || !multiline) {
-                    move_caret(0, active_shift_down);
-                } else {
-                    const auto row =
-                        layout.rows[static_cast<size_t>(find_row_for_index(
-                            layout, caret_index))];
-                    move_caret(row.start, active_shift_down);
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_HOME);
-            }
-
-            if (key_triggered(GLFW_KEY_END)) {
-                if (active_ctrl_down || !multiline) {
-                    move_caret(build_utf8_index_map(text).char_count(),
-                               active_shift_down);
-                } else {
-                    const auto row =
-                        layout.rows[static_cast<size_t>(find_row_for_index(
-                            layout, caret_index))];
-                    move_caret(row.end, active_shift_down);
-                }
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_END);
-            }
-
-            if (multiline && key_triggered(GLFW_KEY_UP)) {
-                const auto row_index = find_row_for_index(layout, caret_index);
-                const auto &row = layout.rows[static_cast<size_t>(row_index)];
-                const float target_x = preferred_caret_x.value_or(
-                    caret_x_for_index(row, caret_index));
-                preferred_caret_x = target_x;
-                const auto next_row =
-                    layout.rows[static_cast<size_t>(std::max(row_index - 1, 0))];
-                move_caret(caret_index_from_x(next_row, target_x),
-                           active_shift_down);
-                stop_key_propagation(GLFW_KEY_UP);
-            }
-
-            if (multiline && key_triggered(GLFW_KEY_DOWN)) {
-                const auto row_index = find_row_for_index(layout, caret_index);
-                const auto &row = layout.rows[static_cast<size_t>(row_index)];
-                const float target_x = preferred_caret_x.value_or(
-                    caret_x_for_index(row, caret_index));
-                preferred_caret_x = target_x;
-                const auto next_row = layout.rows[static_cast<size_t>(std::min(
-                    row_index + 1, static_cast<int>(layout.rows.size()) - 1))];
-                move_caret(caret_index_from_x(next_row, target_x),
-                           active_shift_down);
-                stop_key_propagation(GLFW_KEY_DOWN);
-            }
-
-            if (multiline && key_triggered(GLFW_KEY_ENTER)) {
-                text_changed |= insert_text_internal("\n");
-                preferred_caret_x.reset();
-                stop_key_propagation(GLFW_KEY_ENTER);
-            }
-
-            if (!readonly && !typed_input->empty() && !suppress_text_input) {
-                text_changed |= insert_text_internal(utf8_from_codepoints(*typed_input));
-                preferred_caret_x.reset();
-            }
-        }
+                },
+        };
+        handle_text_keys(ctx, *this, pending_keys, on_key_down, ime_active,
+                         target);
     } else {
         caret_blink_elapsed = 0;
     }
@@ -1536,7 +2361,7 @@ void ui::textbox_widget::update(update_context &ctx) {
     rebuild_layouts();
 
     const bool use_visual_layout = is_focused && ctx.ime_composition().active;
-    const auto &active_layout = use_visual_layout ? visual_layout : layout;
+    const auto &active_layout = use_visual_layout ? *visual_layout : layout;
     const int active_caret_index =
         use_visual_layout ? visual.caret_index : caret_index;
 
@@ -1590,38 +2415,61 @@ void ui::textbox_widget::update(update_context &ctx) {
     }
 
     const bool focused_now = focused() && !disabled;
-    if (focused_now != last_focused) {
+    if (update_text_focus(ctx, focused_now, last_focused, pending_keys,
+                          on_focus, on_blur)) {
         reset_caret_blink();
-        auto callback = focused_now ? on_focus : on_blur;
-        if (!focused_now) {
-            ctx.rt.clear_ime_composition();
-            pending_key_batches.clear();
-        }
-        if (callback) {
-            ctx.rt.post_loop_thread_task([callback]() mutable { callback(); },
-                                         true);
-        }
-        last_focused = focused_now;
     }
 
     if (text_changed) {
         notify_change(ctx);
     }
-}
 
-float ui::textbox_widget::measure_height(update_context &ctx) {
-    if (height->dest() > 0) {
-        return height->dest();
+    visual_signature signature{
+        .text = visual.text,
+        .placeholder = placeholder,
+        .font_size = font_size,
+        .font_weight = font_weight,
+        .selection_start = visual.selection_start,
+        .selection_end = visual.selection_end,
+        .caret_index = visual.caret_index,
+        .composition_start = visual.composition_start,
+        .composition_end = visual.composition_end,
+        .horizontal_scroll = horizontal_scroll,
+        .vertical_scroll = vertical_scroll,
+        .focused = focused_now,
+        .caret_visible =
+            focused_now && std::fmod(caret_blink_elapsed, 1000.0f) < 500.0f,
+        .disabled = disabled,
+        .readonly = readonly,
+        .multiline = multiline,
+    };
+    if (signature != last_visual_signature) {
+        last_visual_signature = std::move(signature);
+        needs_repaint = true;
     }
-    return multiline ? preferred_multiline_height
-                     : std::max(font_size + padding_y * 2.0f + 6.0f, min_height);
 }
 
 float ui::textbox_widget::measure_width(update_context &ctx) {
-    if (width->dest() > 0) {
-        return width->dest();
+    return measure(ctx, {}).width;
+}
+float ui::textbox_widget::measure_height(update_context &ctx) {
+    return measure(ctx, {}).height;
+}
+ui::size ui::textbox_widget::measure(update_context &ctx,
+                                     const constraints &limits) {
+    size preferred{width->dest() > 0 ? width->dest() : 160.0f,
+                   height->dest()};
+    if (!(preferred.height > 0)) {
+        preferred.height =
+            multiline
+                ? preferred_multiline_height
+                : std::max(font_size + padding_y * 2.0f + 6.0f, min_height);
     }
-    return 160.0f;
+    return limits.clamp(preferred);
+}
+size_t ui::textbox_widget::measure_key() const {
+    return hash_values(width->dest(), height->dest(), multiline, font_size,
+                       padding_y, min_height, preferred_multiline_height);
 }
 
 void ui::textbox_widget::focus() {
@@ -1633,7 +2481,7 @@ void ui::textbox_widget::blur() {
     set_focus(false);
     dragging_selection = false;
     preferred_caret_x.reset();
-    pending_key_batches.clear();
+    pending_keys.batches.clear();
 }
 
 void ui::textbox_widget::select_all() {
@@ -1733,14 +2581,698 @@ void ui::textbox_widget::paste() {
     }
 }
 
+namespace {
+bool is_utf8_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// A line of a text_editor_widget, laid out on its own
+struct editor_line {
+    std::string text;
+    utf8_index_map map;
+    text_row_layout row;
+};
+
+editor_line lay_out_editor_line(ui::nanovg_context &vg, std::string text) {
+    editor_line line;
+    line.text = std::move(text);
+    line.map = build_utf8_index_map(line.text);
+    line.row = make_text_row_layout(vg, line.text, line.map, 0,
+                                    line.map.char_count(), 0, false);
+    return line;
+}
+
+float editor_caret_x(const editor_line &line, size_t byte_in_line) {
+    return caret_x_for_index(
+        line.row,
+        char_index_for_byte(line.map, static_cast<int>(byte_in_line)));
+}
+
+size_t editor_byte_from_x(const editor_line &line, float x) {
+    return byte_offset_for_char(line.map,
+                                caret_index_from_x(line.row, std::max(x, 0.f)));
+}
+} // namespace
+
+struct ui::text_editor_widget::view_cache {
+    int font_id = -1;
+    uint64_t font_generation = 0;
+    float font_size = 0, line_height_multiplier = 0;
+    float line_height = 1;
+    // Widest line laid out since the style changed, for horizontal scrolling
+    float content_width = 0;
+
+    uint64_t revision = 0;
+    size_t line_count = 0;
+    size_t first_line = 0;
+    std::vector<editor_line> lines;
+    editor_line scratch;
+
+    // Sets the font on vg, forgets the layouts when it changed
+    void set_style(nanovg_context &vg, font_face_handle &face,
+                   float font_size, int font_weight,
+                   float line_height_multiplier) {
+        vg.fontSize(font_size);
+        apply_font_face(vg, face, "main", font_weight);
+        vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+        if (font_id == face.font_id && font_generation == face.generation &&
+            this->font_size == font_size &&
+            this->line_height_multiplier == line_height_multiplier) {
+            return;
+        }
+        font_id = face.font_id;
+        font_generation = face.generation;
+        this->font_size = font_size;
+        this->line_height_multiplier = line_height_multiplier;
+        float ascender = 0, descender = 0;
+        vg.textMetrics(&ascender, &descender, &line_height);
+        line_height = std::max(
+            line_height * std::max(line_height_multiplier, 0.1f), 1.0f);
+        content_width = 0;
+        lines.clear();
+    }
+
+    // Lays out count lines from first. Lines already laid out are kept,
+    // also when an edit above them moved them.
+    void lay_out(nanovg_context &vg, const text_document &document,
+                 size_t first, size_t count) {
+        first = std::min(first, document.line_count() - 1);
+        count = std::min(count, document.line_count() - first);
+        if (revision == document.revision() && first_line == first &&
+            lines.size() == count) {
+            return;
+        }
+        // Where an old line would be if the edit added or removed lines
+        // above it
+        const auto shift = static_cast<std::ptrdiff_t>(document.line_count()) -
+                           static_cast<std::ptrdiff_t>(line_count);
+        const bool same_revision = revision == document.revision();
+        auto reusable = [&](size_t line,
+                            std::ptrdiff_t delta) -> editor_line * {
+            const auto old = static_cast<std::ptrdiff_t>(line) - delta -
+                             static_cast<std::ptrdiff_t>(first_line);
+            if (old < 0 || old >= static_cast<std::ptrdiff_t>(lines.size()) ||
+                lines[static_cast<size_t>(old)].row.caret_xs.empty()) {
+                return nullptr;
+            }
+            return &lines[static_cast<size_t>(old)];
+        };
+
+        std::vector<editor_line> laid_out;
+        laid_out.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto line = first + i;
+            if (same_revision) {
+                if (auto *old = reusable(line, 0)) {
+                    laid_out.push_back(std::move(*old));
+                    continue;
+                }
+                laid_out.push_back(
+                    lay_out_editor_line(vg, document.line(line)));
+            } else {
+                auto text = document.line(line);
+                auto *old = reusable(line, 0);
+                if (!old || old->text != text) {
+                    old = shift ? reusable(line, shift) : nullptr;
+                }
+                if (old && old->text == text) {
+                    laid_out.push_back(std::move(*old));
+                } else {
+                    laid_out.push_back(lay_out_editor_line(vg, std::move(text)));
+                }
+            }
+            content_width =
+                std::max(content_width, laid_out.back().row.width);
+        }
+        lines = std::move(laid_out);
+        first_line = first;
+        revision = document.revision();
+        line_count = document.line_count();
+    }
+
+    // The layout of a line, laid out on its own when it is not in view.
+    // Valid until the next call.
+    const editor_line &line(nanovg_context &vg, const text_document &document,
+                            size_t line) {
+        if (revision == document.revision() && line >= first_line &&
+            line < first_line + lines.size()) {
+            return lines[line - first_line];
+        }
+        scratch = lay_out_editor_line(vg, document.line(line));
+        content_width = std::max(content_width, scratch.row.width);
+        return scratch;
+    }
+};
+
+ui::text_editor_widget::text_editor_widget()
+    : widget(), _view(std::make_unique<view_cache>()) {
+    width->reset_to(320);
+    height->reset_to(240);
+}
+
+ui::text_editor_widget::~text_editor_widget() = default;
+
+void ui::text_editor_widget::clamp_indices() {
+    _caret = document.char_start(_caret);
+    _anchor = document.char_start(_anchor);
+    _pending_insert_at = std::min(_pending_insert_at, document.size());
+}
+
+void ui::text_editor_widget::render(nanovg_context ctx) {
+    widget::render(ctx);
+
+    const bool is_focused = focused() && !disabled;
+    const float inner_height =
+        std::max(height->dest() - padding_y * 2.0f, 1.0f);
+    auto layout_vg = ctx.with_reset_offset();
+    ui::ime_composition_state ime;
+    {
+        std::lock_guard lock(ctx.rt->ime_composition_lock);
+        ime = ctx.rt->ime_composition;
+    }
+    const bool ime_active = is_focused && ime.active;
+
+    auto &view = *_view;
+    view.set_style(layout_vg, _font_face, font_size, font_weight,
+                   line_height_multiplier);
+    const float line_height = view.line_height;
+    view.lay_out(layout_vg, document,
+                 static_cast<size_t>(_scroll_y / line_height),
+                 static_cast<size_t>(std::ceil(inner_height / line_height)) +
+                     1);
+
+    // The line the composition is shown in, with it in place of the
+    // selected part of that line
+    const auto selection_begin = selection_start();
+    const auto selection_finish = selection_end();
+    const auto composition_line = document.line_of(selection_begin);
+    editor_line composed;
+    int composition_start = 0, composition_end = 0, composed_caret = 0;
+    if (ime_active) {
+        const auto line_start = document.line_start(composition_line);
+        auto text = document.line(composition_line);
+        const auto replace_start = selection_begin - line_start;
+        const auto replace_end =
+            std::min(selection_finish, document.line_end(composition_line)) -
+            line_start;
+        const auto composition_text = normalize_text_for_textbox(
+            utf8_from_codepoints(ime.text), false);
+        text.replace(replace_start, replace_end - replace_start,
+                     composition_text);
+        composed = lay_out_editor_line(layout_vg, std::move(text));
+        composition_start = char_index_for_byte(
+            composed.map, static_cast<int>(replace_start));
+        composition_end = char_index_for_byte(
+            composed.map,
+            static_cast<int>(replace_start + composition_text.size()));
+        composed_caret =
+            composition_start +
+            std::clamp(ime.cursor, 0, composition_end - composition_start);
+    }
+
+    const float border_width = is_focused ? 2.0f : 1.0f;
+    const float border_inset = border_width * 0.5f;
+    ctx.fillColor(background_color.nvg());
+    ctx.fillRoundedRect(*x, *y, *width, *height, border_radius);
+    ctx.strokeWidth(border_width);
+    ctx.strokeColor(is_focused ? focus_border_color.nvg()
+                               : border_color.nvg());
+    ctx.strokeRoundedRect(*x + border_inset, *y + border_inset,
+                          std::max(*width - border_width, 0.0f),
+                          std::max(*height - border_width, 0.0f),
+                          std::max(border_radius - border_inset, 0.0f));
+
+    auto t = ctx.transaction();
+    ctx.intersectScissor(*x + border_width, *y + border_width,
+                         std::max(*width - border_width * 2.0f, 0.0f),
+                         std::max(*height - border_width * 2.0f, 0.0f));
+    ctx.translate(*x + padding_x - _scroll_x, *y + padding_y);
+    ctx.fontSize(font_size);
+    apply_font_face(ctx, _font_face, "main", font_weight);
+    ctx.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+
+    const auto line_top = [&](size_t line) {
+        return static_cast<float>(static_cast<double>(line) * line_height -
+                                  _scroll_y);
+    };
+    for (size_t i = 0; i < view.lines.size(); ++i) {
+        const auto line_index = view.first_line + i;
+        const float top = line_top(line_index);
+        if (ime_active && line_index == composition_line) {
+            const auto &row = composed.row;
+            ctx.fillColor(text_color.nvg());
+            ctx.text(0, top, composed.text.c_str(), nullptr);
+            const float left = caret_x_for_index(row, composition_start);
+            const float right = caret_x_for_index(row, composition_end);
+            ctx.beginPath();
+            ctx.strokeWidth(1.0f);
+            ctx.strokeColor(composition_underline_color.nvg());
+            ctx.moveTo(left, top + line_height - 1.5f);
+            ctx.lineTo(std::max(right, left + 1.0f), top + line_height - 1.5f);
+            ctx.stroke();
+            continue;
+        }
+
+        const auto &line = view.lines[i];
+        const auto start = document.line_start(line_index);
+        const auto end = document.line_end(line_index);
+        if (!ime_active && selection_begin < selection_finish &&
+            selection_begin <= end && selection_finish > start) {
+            const float left = editor_caret_x(
+                line, std::max(selection_begin, start) - start);
+            float right =
+                editor_caret_x(line, std::min(selection_finish, end) - start);
+            // The line break is selected too
+            if (selection_finish > end) {
+                right += font_size * 0.3f;
+            }
+            ctx.fillColor(selection_color.nvg());
+            ctx.fillRect(left, top, std::max(right - left, 1.0f), line_height);
+        }
+        ctx.fillColor(text_color.nvg());
+        ctx.text(0, top, line.text.c_str(), nullptr);
+    }
+
+    if (is_focused && std::fmod(_caret_blink_elapsed, 1000.0f) < 500.0f) {
+        const auto caret_line =
+            ime_active ? composition_line : document.line_of(_caret);
+        const float caret_x =
+            ime_active ? caret_x_for_index(composed.row, composed_caret)
+                       : editor_caret_x(
+                             view.line(layout_vg, document, caret_line),
+                             _caret - document.line_start(caret_line));
+        const float top = line_top(caret_line);
+        ctx.beginPath();
+        ctx.strokeWidth(1.5f);
+        ctx.strokeColor(caret_color.nvg());
+        ctx.moveTo(caret_x, top + 2.0f);
+        ctx.lineTo(caret_x, top + line_height - 2.0f);
+        ctx.stroke();
+    }
+}
+
+void ui::text_editor_widget::update(update_context &ctx) {
+    widget::update(ctx);
+    clamp_indices();
+
+    if (disabled && focused()) {
+        set_focus(false);
+    }
+
+    const bool shift_down = ctx.key_down(GLFW_KEY_LEFT_SHIFT) ||
+                            ctx.key_down(GLFW_KEY_RIGHT_SHIFT);
+    const float inner_width =
+        std::max(width->dest() - padding_x * 2.0f, 1.0f);
+    const float inner_height =
+        std::max(height->dest() - padding_y * 2.0f, 1.0f);
+
+    auto &view = *_view;
+    view.set_style(ctx.vg, _font_face, font_size, font_weight,
+                   line_height_multiplier);
+    const float line_height = view.line_height;
+    const auto page_lines = std::max(
+        static_cast<size_t>(inner_height / line_height), size_t{1});
+
+    const auto revision_before = document.revision();
+    const auto caret_before = _caret;
+
+    // Streamed insertions go on where they stopped, without splitting a
+    // character
+    if (!_pending_insert.empty()) {
+        auto end = std::min(_pending_insert_offset + paste_chunk_size,
+                            _pending_insert.size());
+        while (end < _pending_insert.size() &&
+               is_utf8_continuation(_pending_insert[end])) {
+            end++;
+        }
+        const auto chunk = std::string_view(_pending_insert)
+                               .substr(_pending_insert_offset,
+                                       end - _pending_insert_offset);
+        document.insert(_pending_insert_at, chunk);
+        for (auto *offset : {&_caret, &_anchor}) {
+            if (*offset >= _pending_insert_at) {
+                *offset += chunk.size();
+            }
+        }
+        _pending_insert_at += chunk.size();
+        _pending_insert_offset = end;
+        if (end == _pending_insert.size()) {
+            _pending_insert.clear();
+            _pending_insert_offset = 0;
+        } else {
+            ctx.request_frame_after(0);
+        }
+    }
+    const bool editable = !readonly && !disabled && _pending_insert.empty();
+
+    auto caret_x_of = [&](size_t offset) {
+        const auto line = document.line_of(offset);
+        return editor_caret_x(view.line(ctx.vg, document, line),
+                              offset - document.line_start(line));
+    };
+    auto offset_at = [&](size_t line, float local_x) {
+        line = std::min(line, document.line_count() - 1);
+        return document.line_start(line) +
+               editor_byte_from_x(view.line(ctx.vg, document, line), local_x);
+    };
+    auto move_caret = [&](size_t offset, bool extend_selection) {
+        _caret = std::min(offset, document.size());
+        if (!extend_selection) {
+            _anchor = _caret;
+        }
+        _caret_blink_elapsed = 0;
+    };
+    auto move_lines = [&](std::ptrdiff_t delta, bool extend_selection) {
+        const auto line = document.line_of(_caret);
+        const float target_x = _preferred_x.value_or(caret_x_of(_caret));
+        const auto last = static_cast<std::ptrdiff_t>(document.line_count()) - 1;
+        const auto target = std::clamp(
+            static_cast<std::ptrdiff_t>(line) + delta, std::ptrdiff_t{0}, last);
+        move_caret(offset_at(static_cast<size_t>(target), target_x),
+                   extend_selection);
+        _preferred_x = target_x;
+    };
+    auto pointer_to_offset = [&]() {
+        const auto local_x = static_cast<float>(
+            ctx.mouse_x - (ctx.offset_x + x->dest() + padding_x) + _scroll_x);
+        const auto local_y =
+            ctx.mouse_y - (ctx.offset_y + y->dest() + padding_y) + _scroll_y;
+        return offset_at(
+            static_cast<size_t>(std::max(local_y, 0.0) / line_height),
+            local_x);
+    };
+
+    if (ctx.mouse_clicked) {
+        if (!disabled && check_hit(ctx)) {
+            set_focus(true);
+            move_caret(pointer_to_offset(), shift_down);
+            _preferred_x.reset();
+            _dragging = true;
+        } else if (focused()) {
+            set_focus(false);
+            _dragging = false;
+            _preferred_x.reset();
+            ctx.rt.clear_ime_composition();
+        }
+    }
+
+    const bool is_focused = focused() && !disabled;
+    const bool ime_active = is_focused && ctx.ime_composition().active;
+
+    if (_dragging && is_focused && ctx.mouse_down) {
+        move_caret(pointer_to_offset(), true);
+        _preferred_x.reset();
+    }
+    if (!ctx.mouse_down) {
+        _dragging = false;
+    }
+
+    if (is_focused) {
+        _caret_blink_elapsed += ctx.delta_time;
+        // Wake up for the next caret blink
+        ctx.request_frame_after(
+            500.0f - std::fmod(_caret_blink_elapsed, 500.0f));
+    } else {
+        _caret_blink_elapsed = 0;
+    }
+
+    if (is_focused) {
+        const text_edit_target target{
+            .multiline = true,
+            .editable = editable,
+            .page_rows = static_cast<std::ptrdiff_t>(page_lines),
+            .caret = [&] { return _caret; },
+            .anchor = [&] { return _anchor; },
+            .end = [&] { return document.size(); },
+            .prev_char =
+                [&](size_t offset) { return document.prev_char(offset); },
+            .next_char =
+                [&](size_t offset) { return document.next_char(offset); },
+            .row_start =
+                [&](size_t offset) {
+                    return document.line_start(document.line_of(offset));
+                },
+            .row_end =
+                [&](size_t offset) {
+                    return document.line_end(document.line_of(offset));
+                },
+            .move_caret = move_caret,
+            .move_rows = move_lines,
+            .forget_preferred_x = [&] { _preferred_x.reset(); },
+            .replace =
+                [&](size_t start, size_t end, std::string_view text) {
+                    _anchor = start;
+                    _caret = end;
+                    replace_selection(text);
+                },
+            .copy = [&] { copy(); },
+            .paste = [&] { paste(); },
+        };
+        handle_text_keys(ctx, *this, _pending_keys, on_key_down, ime_active,
+                         target);
+    }
+    clamp_indices();
+
+    const double content_height =
+        static_cast<double>(document.line_count()) * line_height;
+    const double max_scroll_y =
+        std::max(content_height - inner_height, 0.0);
+    if ((ctx.hovered(this) || is_focused) && std::abs(ctx.scroll_y) > 0) {
+        _scroll_y -= ctx.scroll_y * 40.0f;
+    }
+    // Only follow the caret when it moved, the wheel may scroll it away
+    const float caret_x = caret_x_of(_caret);
+    if (_caret != caret_before || document.revision() != revision_before) {
+        const double caret_top =
+            static_cast<double>(document.line_of(_caret)) * line_height;
+        if (caret_top < _scroll_y) {
+            _scroll_y = caret_top;
+        } else if (caret_top + line_height > _scroll_y + inner_height) {
+            _scroll_y = caret_top + line_height - inner_height;
+        }
+        if (caret_x < _scroll_x) {
+            _scroll_x = caret_x;
+        } else if (caret_x > _scroll_x + inner_width) {
+            _scroll_x = caret_x - inner_width;
+        }
+    }
+    _scroll_y = std::clamp(_scroll_y, 0.0, max_scroll_y);
+    _scroll_x = std::clamp(
+        _scroll_x, 0.0f,
+        std::max(std::max(view.content_width, caret_x) - inner_width, 0.0f));
+
+    const auto first_line = static_cast<size_t>(_scroll_y / line_height);
+    view.lay_out(ctx.vg, document, first_line,
+                 static_cast<size_t>(std::ceil(inner_height / line_height)) +
+                     1);
+
+    if (is_focused) {
+        const auto caret_top = static_cast<float>(
+            static_cast<double>(document.line_of(_caret)) * line_height -
+            _scroll_y);
+        ctx.rt.set_ime_caret_rect(
+            ctx.offset_x + x->dest() + padding_x + caret_x - _scroll_x,
+            ctx.offset_y + y->dest() + padding_y + caret_top, line_height,
+            true, ctx.offset_x + x->dest() + padding_x,
+            ctx.offset_y + y->dest() + padding_y, inner_width, inner_height);
+    }
+
+    const bool focused_now = focused() && !disabled;
+    if (update_text_focus(ctx, focused_now, _last_focused, _pending_keys,
+                          on_focus, on_blur)) {
+        _caret_blink_elapsed = 0;
+        if (!focused_now) {
+            ctx.rt.set_ime_caret_rect(0, 0, 0, false);
+        }
+    }
+
+    if (document.revision() != revision_before && on_change) {
+        ctx.rt.post_loop_thread_task(
+            [callback = on_change]() mutable { callback(); }, true);
+    }
+
+    const auto &ime = ctx.ime_composition();
+    const auto visual_hash = hash_values(
+        document.revision(), _caret, _anchor, _scroll_x, _scroll_y,
+        focused_now,
+        focused_now && std::fmod(_caret_blink_elapsed, 1000.0f) < 500.0f,
+        ime_active ? std::u32string_view(ime.text) : std::u32string_view{},
+        ime_active ? ime.cursor : 0, font_size, font_weight);
+    if (visual_hash != _last_visual_hash) {
+        _last_visual_hash = visual_hash;
+        needs_repaint = true;
+    }
+}
+
+float ui::text_editor_widget::measure_width(update_context &ctx) {
+    return measure(ctx, {}).width;
+}
+float ui::text_editor_widget::measure_height(update_context &ctx) {
+    return measure(ctx, {}).height;
+}
+ui::size ui::text_editor_widget::measure(update_context &ctx,
+                                         const constraints &limits) {
+    return limits.clamp({width->dest() > 0 ? width->dest() : 320.0f,
+                         height->dest() > 0 ? height->dest() : 240.0f});
+}
+
+size_t ui::text_editor_widget::measure_key() const {
+    return hash_values(width->dest(), height->dest());
+}
+
+void ui::text_editor_widget::focus() {
+    set_focus(true);
+    _caret_blink_elapsed = 0;
+}
+
+void ui::text_editor_widget::blur() {
+    set_focus(false);
+    _dragging = false;
+    _preferred_x.reset();
+    _pending_keys.batches.clear();
+}
+
+void ui::text_editor_widget::set_text(std::string text) {
+    document.assign(normalize_text_for_textbox(std::move(text), true));
+    _pending_insert.clear();
+    _pending_insert_offset = _pending_insert_at = 0;
+    _caret = _anchor = 0;
+    _scroll_x = 0;
+    _scroll_y = 0;
+    _preferred_x.reset();
+    _view->content_width = 0;
+}
+
+void ui::text_editor_widget::select_all() {
+    _anchor = 0;
+    _caret = document.size();
+    _caret_blink_elapsed = 0;
+}
+
+size_t ui::text_editor_widget::selection_start() const {
+    return std::min(_anchor, _caret);
+}
+
+size_t ui::text_editor_widget::selection_end() const {
+    return std::max(_anchor, _caret);
+}
+
+void ui::text_editor_widget::set_selection(size_t anchor, size_t caret) {
+    _anchor = anchor;
+    _caret = caret;
+    clamp_indices();
+    _preferred_x.reset();
+    _caret_blink_elapsed = 0;
+}
+
+void ui::text_editor_widget::replace_selection(std::string_view text) {
+    const auto start = selection_start();
+    document.erase(start, selection_end() - start);
+    document.insert(start, text);
+    _caret = _anchor = start + text.size();
+    _caret_blink_elapsed = 0;
+}
+
+void ui::text_editor_widget::insert_text(std::string_view text) {
+    if (readonly || disabled) {
+        return;
+    }
+    replace_selection(
+        normalize_text_for_textbox(std::string(text), true));
+}
+
+void ui::text_editor_widget::insert_text_streamed(std::string text) {
+    if (readonly || disabled) {
+        return;
+    }
+    text = normalize_text_for_textbox(std::move(text), true);
+    if (text.size() <= paste_chunk_size && _pending_insert.empty()) {
+        replace_selection(text);
+        return;
+    }
+    replace_selection("");
+    // Appends to an insertion still going on at the caret
+    if (!_pending_insert.empty() && _pending_insert_at == _caret) {
+        _pending_insert += text;
+        return;
+    }
+    _pending_insert = std::move(text);
+    _pending_insert_offset = 0;
+    _pending_insert_at = _caret;
+    needs_repaint = true;
+}
+
+size_t ui::text_editor_widget::pending_insert_size() const {
+    return _pending_insert.size() - _pending_insert_offset;
+}
+
+void ui::text_editor_widget::delete_text(size_t start, size_t end) {
+    if (readonly || disabled) {
+        return;
+    }
+    if (end < start) {
+        std::swap(start, end);
+    }
+    start = document.char_start(start);
+    end = document.char_start(end);
+    document.erase(start, end - start);
+    _caret = _anchor = start;
+    _caret_blink_elapsed = 0;
+}
+
+void ui::text_editor_widget::copy() {
+    if (!owner_rt || !owner_rt->window) {
+        return;
+    }
+    const auto selected =
+        document.text(selection_start(), selection_end() - selection_start());
+    glfwSetClipboardString(owner_rt->window, selected.c_str());
+}
+
+void ui::text_editor_widget::cut() {
+    if (readonly || disabled) {
+        return;
+    }
+    copy();
+    delete_text(selection_start(), selection_end());
+}
+
+void ui::text_editor_widget::paste() {
+    if (!owner_rt || !owner_rt->window || readonly || disabled) {
+        return;
+    }
+    if (const char *clipboard = glfwGetClipboardString(owner_rt->window)) {
+        insert_text_streamed(clipboard);
+    }
+}
+
+std::pair<size_t, size_t> ui::text_editor_widget::visible_lines() const {
+    return {_view->first_line, _view->first_line + _view->lines.size()};
+}
+
 void ui::padding_widget::update(update_context &ctx) {
+    std::array<float, 4> padding = {*padding_left, *padding_right,
+                                    *padding_top, *padding_bottom};
+    if (padding != _last_padding) {
+        _last_padding = padding;
+        invalidate_layout();
+    }
+
     auto off = ctx.with_offset(*padding_left, *padding_top);
     widget::update(off);
+
+    if (!layout_dirty)
+        return;
+    layout_dirty = false;
 
+    auto child_limits = _layout_limits.deflated(
+        *padding_left + *padding_right, *padding_top + *padding_bottom);
     float max_width = 0, max_height = 0;
     for (auto &child : children) {
-        max_width = std::max(max_width, child->measure_width(ctx));
-        max_height = std::max(max_height, child->measure_height(ctx));
+        child->_layout_limits = child_limits;
+        auto [child_width, child_height] = child->measured(ctx, child_limits);
+        max_width = std::max(max_width, child_width);
+        max_height = std::max(max_height, child_height);
     }
 
     width->animate_to(max_width + *padding_left + *padding_right);
@@ -1791,23 +3323,35 @@ void ui::widget::set_focus(bool focused) {
     }
 }
 
+// The key queries look through the events of the frame, which are few
 bool ui::update_context::key_pressed(int key) const {
-    return (bool)(rt.key_states.get()[key] & key_state::pressed);
+    return std::ranges::any_of(rt.input_events, [&](const auto &event) {
+        return event.type == input_event::kind::key && event.key == key &&
+               event.action == GLFW_PRESS && !event.stopped;
+    });
 }
 bool ui::update_context::key_triggered(int key) const {
-    return (bool)(rt.key_states.get()[key] &
-                  (key_state::pressed | key_state::repeated));
+    return std::ranges::any_of(rt.input_events, [&](const auto &event) {
+        return event.type == input_event::kind::key && event.key == key &&
+               event.action != GLFW_RELEASE && !event.stopped;
+    });
 }
 bool ui::update_context::key_down(int key) const {
-    return glfwGetKey((GLFWwindow *)window, key) == GLFW_PRESS;
+    return key >= 0 && key <= GLFW_KEY_LAST && rt.held_keys[key];
 }
 void ui::update_context::stop_key_propagation(int key) {
-    if (key >= 0 && key < GLFW_KEY_LAST + 1) {
-        rt.key_states.get()[key] = key_state::none;
+    for (auto &event : rt.input_events) {
+        if (event.type == input_event::kind::key && event.key == key) {
+            event.stopped = true;
+        }
     }
 }
 const std::u32string &ui::update_context::text_input() const {
-    return rt.char_input.get();
+    return rt.text_input;
+}
+const std::vector<ui::input_event> &
+ui::update_context::input_events() const {
+    return rt.input_events;
 }
 ui::ime_composition_state ui::update_context::ime_composition() const {
     std::lock_guard lock(rt.ime_composition_lock);
@@ -1925,24 +3469,40 @@ ui::button_widget::button_widget() {
     border_left.reset_to({1, 1, 1, 0.04});
 }
 void ui::widget::remove_child(std::shared_ptr<widget> child) {
+    if (owner_rt)
+        owner_rt->damage.add(child->_subtree_bounds);
     child->parent = nullptr;
     children.erase(std::remove(children.begin(), children.end(), child),
                    children.end());
+    _painted_child_count = std::min(_painted_child_count, children.size());
+    if (owner_rt)
+        owner_rt->request_frame();
     children_dirty = true;
+    _children_changed = true;
+    invalidate_layout();
+}
+float ui::text_widget::wrap_width(const constraints &limits) const {
+    auto limit = std::min(max_width > 0 ? max_width : INFINITY,
+                          limits.max_width);
+    return limit > 0 && limit < INFINITY ? limit : -1;
+}
+float ui::text_widget::measure_width(update_context &ctx) {
+    return measure(ctx, {}).width;
+}
+float ui::text_widget::measure_height(update_context &ctx) {
+    return measure(ctx, {}).height;
+}
+ui::size ui::text_widget::measure(update_context &ctx,
+                                  const constraints &limits) {
+    ctx.vg.fontSize(font_size);
+    apply_font_face(ctx.vg, _measure_font_face, font_family, font_weight);
+    auto wrap = wrap_width(limits);
+    auto [w, h] = wrap < 0
+                      ? ctx.vg.measureText(this->text.c_str())
+                      : ctx.vg.measureTextBox(this->text.c_str(), wrap);
+    return limits.clamp({wrap > 0 ? std::min(w, wrap) : w, h});
 }
-float ui::text_widget::measure_height(update_context &ctx) {
-    ctx.vg.fontSize(font_size);
-    apply_font_face(ctx.vg, font_family, font_weight);
-    auto text = max_width < 0
-                    ? ctx.vg.measureText(this->text.c_str())
-                    : ctx.vg.measureTextBox(this->text.c_str(), max_width);
-    return text.second;
-}
-float ui::text_widget::measure_width(update_context &ctx) {
-    ctx.vg.fontSize(font_size);
-    apply_font_face(ctx.vg, font_family, font_weight);
-    auto text = max_width < 0
-                    ? ctx.vg.measureText(this->text.c_str())
-                    : ctx.vg.measureTextBox(this->text.c_str(), max_width);
-    return max_width > 0 ? std::min(text.first, max_width) : text.first;
+size_t ui::text_widget::measure_key() const {
+    return hash_values(std::string_view(text), font_size, font_weight,
+                       std::string_view(font_family), max_width);
 }
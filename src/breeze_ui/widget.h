@@ -1,13 +1,23 @@
 #pragma once
 #include "breeze_ui/animator.h"
+#include "breeze_ui/flex_layout.h"
+#include "breeze_ui/font.h"
+#include "breeze_ui/glyph_run.h"
 #include "breeze_ui/nanovg_wrapper.h"
+#include "breeze_ui/text_document.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <tuple>
 #include <vector>
 
 namespace ui {
@@ -18,6 +28,113 @@ struct screen_info {
     int width, height;
     float dpi_scale;
 };
+
+// Axis-aligned rectangle in window coordinates
+struct rect {
+    float x = 0, y = 0, width = 0, height = 0;
+
+    bool empty() const { return !(width > 0) || !(height > 0); }
+    float right() const { return x + width; }
+    float bottom() const { return y + height; }
+    bool intersects(const rect &other) const;
+    rect intersected(const rect &other) const;
+    // Smallest rect containing both, empty rects are ignored
+    rect united(const rect &other) const;
+    rect inflated(float d) const {
+        return {x - d, y - d, width + d * 2, height + d * 2};
+    }
+    bool operator==(const rect &) const = default;
+};
+
+struct size {
+    float width = 0, height = 0;
+    bool operator==(const size &) const = default;
+};
+
+// Limits a parent puts on the size of a child when measuring it. The
+// defaults leave the child unconstrained.
+struct constraints {
+    float min_width = 0, max_width = INFINITY;
+    float min_height = 0, max_height = INFINITY;
+
+    size clamp(size s) const {
+        return {std::max(min_width, std::min(s.width, max_width)),
+                std::max(min_height, std::min(s.height, max_height))};
+    }
+    // Limits left for the content after taking the padding away
+    constraints deflated(float horizontal, float vertical) const {
+        return {std::max(0.f, min_width - horizontal),
+                std::max(0.f, max_width - horizontal),
+                std::max(0.f, min_height - vertical),
+                std::max(0.f, max_height - vertical)};
+    }
+    bool operator==(const constraints &) const = default;
+};
+
+// Area of the window that has to be repainted, accumulated by the widgets
+// during update and consumed by the render target after painting.
+struct damage_region {
+    // Union of all damaged rects
+    rect bounds;
+    size_t rect_count = 0;
+    // Set when the change can't be bounded, the whole window is repainted
+    bool full = false;
+
+    void add(const rect &r) {
+        if (r.empty())
+            return;
+        bounds = bounds.united(r);
+        rect_count++;
+    }
+    void add_full() { full = true; }
+    bool empty() const { return !full && rect_count == 0; }
+    void clear() { *this = {}; }
+};
+
+// Rects of all widgets collected during the last update, tested once per
+// frame against the mouse position. A widget remembers the slot its rect
+// went into, so asking whether it is under the mouse is a single lookup and
+// no widget pointers are kept across frames.
+struct hit_test_index {
+    // Stores a rect for the next query and returns its slot
+    uint32_t add(const rect &r);
+    // Tests all stored rects against the point, then starts collecting the
+    // next set of rects
+    void query(float x, float y);
+    // Generation that add() stores into
+    uint64_t generation() const { return _generation; }
+    // Whether the last query covered the rects of `generation`
+    bool answers(uint64_t generation) const {
+        return generation != 0 && generation == _queried;
+    }
+    bool hit(uint32_t slot) const {
+        return slot < _hits.size() && _hits[slot];
+    }
+    size_t hit_count() const { return _hit_count; }
+
+  private:
+    // Stored as separate arrays so the query is a tight loop over floats
+    std::vector<float> _left, _top, _right, _bottom;
+    std::vector<uint8_t> _hits;
+    size_t _hit_count = 0;
+    uint64_t _generation = 1, _queried = 0;
+};
+
+// A key or text input event of a frame. update_context::input_events()
+// has them in the order they came in.
+struct input_event {
+    enum class kind : uint8_t { key, text };
+    kind type = kind::key;
+    // GLFW key, action (GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT) and mods
+    int key = 0, action = 0, mods = 0;
+    // Typed character of text events
+    char32_t codepoint = 0;
+    std::chrono::steady_clock::time_point time;
+    // Set by update_context::stop_key_propagation, hidden from the widgets
+    // updated after
+    bool stopped = false;
+};
+
 struct update_context {
     // time since last frame, in milliseconds
     float delta_time;
@@ -31,11 +148,16 @@ struct update_context {
     screen_info screen;
     float scroll_y;
 
+    // Forces a full repaint of the window. Widgets should prefer setting
+    // their own needs_repaint so only the area they cover is repainted.
     bool &need_repaint;
+    void add_damage(const rect &r);
+    // Asks for another frame within `ms` milliseconds. The render loop
+    // sleeps when no widget asks for one.
+    void request_frame_after(float ms) const;
 
-    // hit test, lifetime is not guaranteed
-    std::shared_ptr<std::vector<widget *>> hovered_widgets =
-        std::make_shared<std::vector<widget *>>();
+    // hit test. Once a widget claimed the hover in a frame, only it and the
+    // children updated after the claim count as hovered for the rest of it.
     void set_hit_hovered(widget *w);
 
     bool hovered(widget *w, bool hittest = true) const;
@@ -50,11 +172,21 @@ struct update_context {
     bool key_down(int key) const;
     bool key_triggered(int key) const;
     const std::u32string &text_input() const;
+    const std::vector<input_event> &input_events() const;
     ime_composition_state ime_composition() const;
 
     float offset_x = 0, offset_y = 0;
     render_target &rt;
     nanovg_context vg;
+    // Visible area in window coordinates, narrowed by widgets that clip
+    // their children. Unbounded when not set.
+    std::optional<rect> clip;
+
+    update_context with_clip(const rect &r) const {
+        auto copy = *this;
+        copy.clip = clip ? clip->intersected(r) : r;
+        return copy;
+    }
 
     update_context with_offset(float x, float y) const {
         auto copy = *this;
@@ -73,6 +205,76 @@ struct update_context {
     update_context within(widget *w) const;
 };
 
+// Region that widgets and their animations can be allocated from. Objects
+// are placed one after another in large blocks, in creation order, so a
+// widget sits next to its animations and children. A block is returned to
+// the system once everything in it has been freed.
+// Everything allocated from the arena keeps it alive, it has to be owned by
+// a shared_ptr.
+struct widget_arena : std::enable_shared_from_this<widget_arena> {
+    static constexpr size_t block_size = 64 * 1024;
+
+    widget_arena() = default;
+    widget_arena(const widget_arena &) = delete;
+    widget_arena &operator=(const widget_arena &) = delete;
+    ~widget_arena();
+
+    void *allocate(size_t size, size_t align);
+    void deallocate(void *p, size_t size, size_t align);
+    size_t reserved_bytes() const { return block_count * block_size; }
+
+    // Widgets and animations created on this thread while the scope is
+    // alive are allocated from the arena
+    struct scope {
+        explicit scope(widget_arena *arena);
+        ~scope();
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+        widget_arena *previous;
+    };
+    static std::shared_ptr<widget_arena> current();
+
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make(Args &&...args);
+
+private:
+    struct block_header {
+        size_t used;
+        size_t live;
+    };
+    std::mutex lock;
+    block_header *current_block = nullptr;
+    size_t block_count = 0;
+};
+
+template <typename T> struct arena_allocator {
+    using value_type = T;
+    std::shared_ptr<widget_arena> arena;
+
+    explicit arena_allocator(std::shared_ptr<widget_arena> arena)
+        : arena(std::move(arena)) {}
+    template <typename U>
+    arena_allocator(const arena_allocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *p, size_t n) {
+        arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+    template <typename U>
+    bool operator==(const arena_allocator<U> &other) const {
+        return arena == other.arena;
+    }
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> widget_arena::make(Args &&...args) {
+    scope s(this);
+    return std::allocate_shared<T>(arena_allocator<T>(shared_from_this()),
+                                   std::forward<Args>(args)...);
+}
+
 struct dying_time {
     float time = 100;
     bool _last_has_value = false;
@@ -124,13 +326,28 @@ It's like `posision: relative` in CSS
 While all other widgets are like `position: absolute`
 */
 struct widget : std::enable_shared_from_this<widget> {
+    // Arena this widget was allocated from, if any. Its animations and the
+    // children created with emplace_child come from the same arena, which
+    // is kept alive for them as long as the widget is.
+    std::shared_ptr<widget_arena> arena = widget_arena::current();
+    // Scheduler of the render target this widget was last updated in, our
+    // animations run on it. Expires with the render target.
+    std::weak_ptr<animation_scheduler> anim_scheduler;
+    // Animations created with anim_float(). Ones added to it directly get
+    // their owner set when the widget is first updated.
     std::vector<sp_anim_float> anim_floats{};
 
     std::vector<std::string> class_list{};
     sp_anim_float anim_float(auto &&...args) {
-        auto anim = std::make_shared<animated_float>(
-            std::forward<decltype(args)>(args)...);
+        auto anim =
+            arena ? std::allocate_shared<animated_float>(
+                        arena_allocator<animated_float>(arena),
+                        std::forward<decltype(args)>(args)...)
+                  : std::make_shared<animated_float>(
+                        std::forward<decltype(args)>(args)...);
+        anim->owner = this;
         anim_floats.push_back(anim);
+        anim->schedule();
         return anim;
     }
 
@@ -141,12 +358,68 @@ struct widget : std::enable_shared_from_this<widget> {
     float flex_grow = 0.0f;
     // Flex shrink factor (0 means no shrinking)
     float flex_shrink = 0.0f;
+    // Main size to grow or shrink from (<0 means the measured size)
+    float flex_basis = -1;
+    // Min and max size a flex container keeps this widget within
+    constraints size_limits;
 
     float _debug_offset_cache[2];
     bool enable_child_clipping = false;
+    // Don't update children that are outside of ctx.clip and have no
+    // animation in flight. Meant for long scrolled panels.
+    bool skip_offscreen_updates = false;
+    // Draw the subtree into an offscreen image once and composite that
+    // until something in the subtree changes. Meant for complex panels
+    // that rarely change.
+    bool cache_as_layer = false;
+    // Opacity the layer is composited with
+    float layer_opacity = 1;
+    // Record the nanovg calls the subtree makes and make them again in
+    // place of render() until something in the subtree changes. Needs no
+    // texture, unlike cache_as_layer, but the calls are still drawn.
+    bool cache_commands = false;
+    std::unique_ptr<recorded_commands> _recorded_commands;
+    // Repaint the area covered by this widget in the next frame. Changed
+    // animations set it automatically.
     bool needs_repaint = true;
     float last_offset_x = 0, last_offset_y = 0;
 
+    // How far render() may draw outside of x/y/width/height, e.g. for
+    // antialiasing, borders or shadows. Added around the damaged area.
+    float damage_margin = 2;
+    // Area covered in window coordinates the last time damage was collected
+    std::optional<rect> _paint_bounds;
+    // _paint_bounds united with the subtree bounds of all children
+    rect _subtree_bounds;
+    size_t _painted_child_count = 0;
+    // Rect used for hit testing and where it is stored in the hit-test index
+    // of the render target
+    rect _hit_rect;
+    uint32_t _hit_slot = 0;
+    uint64_t _hit_generation = 0;
+    // Frame in which we or a parent claimed the hover
+    uint64_t _hover_claimed = 0;
+    // Whether an animation in this subtree was in flight when damage was
+    // collected. The scheduler sets it on the ancestors when it starts one
+    // and counts the ones it runs for us.
+    bool _subtree_animating = false;
+    uint32_t _running_animations = 0;
+    // Position when damage was collected, used to move the stored bounds
+    // along while updates are skipped
+    float _collected_x = 0, _collected_y = 0;
+    // Position and size relative to the parent when damage was collected
+    rect _local_bounds;
+    // Whether anything in the subtree was repainted, moved or resized when
+    // damage was collected. Invalidates the layers of the ancestors.
+    bool _subtree_changed = true;
+    // Set when children were added or removed since damage was collected
+    bool _children_changed = false;
+    // Compares the area covered by this widget against the last frame and
+    // reports the old and new area as damaged when it moved or
+    // needs_repaint is set. Also records the rect for hit testing. Called by
+    // the parent after update().
+    void collect_damage(update_context &ctx);
+
     // Time until the widget is removed from the tree
     // in milliseconds
     // Widget itself will update this value
@@ -157,6 +430,20 @@ struct widget : std::enable_shared_from_this<widget> {
     widget *parent = nullptr;
     render_target *owner_rt = nullptr;
 
+    // Set when something that affects layout changed in this widget or in
+    // its subtree: children added or removed, size or padding changed, text
+    // or font changed. Containers only re-run their layout while it is set,
+    // clean subtrees keep their last layout.
+    bool layout_dirty = true;
+    // Marks this widget and all of its ancestors as needing layout, which
+    // also drops their cached measurements
+    void invalidate_layout();
+    // Size and flex factors last seen by the parent's layout
+    float _reported_width = NAN, _reported_height = NAN;
+    float _reported_flex_grow = 0, _reported_flex_shrink = 0;
+    float _reported_flex_basis = -1;
+    constraints _reported_size_limits;
+
     bool focused();
     bool focus_within();
     void set_focus(bool focused = true);
@@ -173,18 +460,39 @@ struct widget : std::enable_shared_from_this<widget> {
     }
     virtual void render(nanovg_context ctx);
     virtual void update(update_context &ctx);
-    virtual ~widget() = default;
-    // Measure the desired size of the widget
+    virtual ~widget();
+    // Measure the desired size of the widget within the limits
     // It should return the size it wants to be, not the size it is forced to be
-    // by the parent
+    // by the parent. Content that can reflow, like wrapped text, should fit
+    // itself into the maximum size.
+    // By default the size of measure_width() and measure_height().
+    virtual size measure(update_context &ctx, const constraints &limits);
+    // Unconstrained size, one dimension at a time, the widget's own size by
+    // default. Widgets written before measure() override these, widgets
+    // overriding measure() forward them to it.
     virtual float measure_height(update_context &ctx);
     virtual float measure_width(update_context &ctx);
+    // Hash of the widget's own state that measure() reads, e.g. its text,
+    // font or padding. Sizes of the children are not part of it, a child
+    // that changes size invalidates the layout instead.
+    virtual size_t measure_key() const;
+    // measure(), cached until the layout is invalidated, measure_key()
+    // changes or it is asked with other limits. Layout code should call this.
+    size measured(update_context &ctx, const constraints &limits = {});
+    std::optional<size> _measured;
+    constraints _measured_limits;
+    size_t _measure_key = 0;
+    // Limits the parent measured this widget with in its last layout
+    constraints _layout_limits;
     // Update children with the offset.
     // Also deal with the dying time. (If the widget is died, it will be set to
     // nullptr)
     void update_child_basic(update_context &ctx, std::shared_ptr<widget> &w);
     // Render children with the offset.
     void render_child_basic(nanovg_context ctx, std::shared_ptr<widget> &w);
+    // render() for cache_commands, plays the recorded commands when they
+    // are still valid and records new ones otherwise
+    void render_recorded(nanovg_context ctx);
 
     // Update children list in the widget manner
     // It will remove the dead children
@@ -201,7 +509,11 @@ struct widget : std::enable_shared_from_this<widget> {
         return std::dynamic_pointer_cast<T>(this->shared_from_this());
     }
 
+    // Hit tests widgets the hit-test index didn't rule out: the ones the
+    // index hits, and the ones that moved since the last frame
     virtual bool check_hit(const update_context &ctx);
+    // Area recorded in the hit-test index, check_hit has to stay inside it
+    virtual rect hit_rect(const update_context &ctx) const;
 
     void add_child(std::shared_ptr<widget> child);
     void remove_child(std::shared_ptr<widget> child);
@@ -209,8 +521,11 @@ struct widget : std::enable_shared_from_this<widget> {
     bool children_dirty = false;
     template <typename T, typename... Args>
     inline std::shared_ptr<T> emplace_child(Args &&...args) {
-        auto child = std::make_shared<T>(std::forward<Args>(args)...);
+        auto child = arena ? arena->make<T>(std::forward<Args>(args)...)
+                           : std::make_shared<T>(std::forward<Args>(args)...);
+        child->parent = this;
         children.emplace_back(child);
+        invalidate_layout();
         return child;
     }
 
@@ -235,22 +550,15 @@ struct widget : std::enable_shared_from_this<widget> {
     }
 };
 
-// A widget with child which lays out children in a row or column.
-//
-// Specifically, when `horizontal == false` and `align_items == stretch`,
-// it sets its text_widget child's max width to its width.
+// Lays its children out in a row or column with flex_layout. Nested
+// flex_widgets that need a new layout go into the same flex_layout, so the
+// tree is solved once from the outermost one. Stretched children are
+// measured against the cross size they get, so that text wraps to it. A
+// container stretching its children to a size its parent gives it lays
+// them out by itself, once it has that size.
 struct flex_widget : public widget {
-    enum class justify {
-        start,
-        end,
-        center,
-        space_between,
-        space_around,
-        space_evenly,
-        free
-    };
-
-    enum class align { start, end, center, stretch, free };
+    using justify = flex_layout::justify;
+    using align = flex_layout::align;
 
     // Scrolling stuff
     float max_height = INFINITY;
@@ -268,6 +576,8 @@ struct flex_widget : public widget {
     bool horizontal = false;
     bool auto_size = true;
     bool reverse = false;
+    // Children that do not fit into the main size go on to a new line
+    bool wrap = false;
     justify justify_content = justify::start;
     align align_items = align::start;
     sp_anim_float padding_left = anim_float(), padding_right = anim_float(),
@@ -278,18 +588,102 @@ struct flex_widget : public widget {
     void update(update_context &ctx) override;
     void render(nanovg_context ctx) override;
 
-    float measure_height(update_context &ctx) override;
+    size measure(update_context &ctx, const constraints &limits) override;
     float measure_width(update_context &ctx) override;
+    float measure_height(update_context &ctx) override;
+    size_t measure_key() const override;
+    // Limits the children are measured with when laying out within `limits`
+    constraints children_limits(const constraints &limits) const;
+    // Measures the children the way the layout within `limits` does, which
+    // leaves it nothing but cached sizes. Never goes past children with a
+    // fixed size, see layout_pool.
+    void measure_children(update_context &ctx, const constraints &limits);
 
     // Determine if the widget should auto size in the given direction.
     // `should_autosize(horizontal)` checks width side.
     // `should_autosize(!horizontal)` checks height side.
     bool should_autosize(bool mainAxis) const;
 
+    // Everything reposition_children_flex reads from the container itself.
+    // The children are only laid out again when these change or when
+    // layout_dirty is set.
+    struct layout_inputs {
+        float width, height;
+        float padding_left, padding_right, padding_top, padding_bottom;
+        float gap;
+        size_t child_count;
+        bool horizontal, auto_size, reverse, wrap;
+        justify justify_content;
+        align align_items;
+        bool operator==(const layout_inputs &) const = default;
+    };
+    std::optional<layout_inputs> _last_layout_inputs;
+    layout_inputs current_layout_inputs() const;
+    // Limits max_height and remembers the inputs once the children are
+    // placed
+    void finish_layout();
+
     struct spacer : public widget {
         float size = 1;
     };
 };
+// Vertical scrolling list that only keeps the items around the visible area
+// alive. Items are created on demand and stretched to the list's width.
+// Heights of items that were never laid out are estimated from the average
+// of the measured ones.
+struct virtual_list_widget : public flex_widget {
+    size_t item_count = 0;
+    // Creates the widget for an item. An item it returns nullptr for, and
+    // the ones below it, are asked for again by the next update.
+    std::function<std::shared_ptr<widget>(size_t index)> create_item;
+    // Points a widget that scrolled out of view at another item. Without
+    // it widgets are dropped and created again.
+    std::function<void(widget &w, size_t index)> recycle_item;
+    // Items kept alive above and below the visible area
+    size_t overscan = 4;
+    // Height assumed before any item was measured
+    float estimated_item_height = 24;
+
+    virtual_list_widget();
+
+    void update(update_context &ctx) override;
+    void render(nanovg_context ctx) override;
+    size measure(update_context &ctx, const constraints &limits) override;
+    size_t measure_key() const override;
+
+    // Drops all items and measured heights, e.g. after the data changed
+    void invalidate_items();
+    void scroll_to_item(size_t index);
+    // Top of the item relative to the top of the content
+    float item_offset(size_t index) const;
+    // Item at the given distance from the top of the content
+    size_t item_at(float offset) const;
+    float content_height() const;
+    // Index of children[0]
+    size_t first_live_item() const { return _first; }
+
+  private:
+    // Measured heights, NAN for items that were never laid out, and two
+    // Fenwick trees over them for the sum and the number of measured
+    // heights, so offsets stay O(log n) for any item count
+    std::vector<float> _heights;
+    std::vector<double> _height_tree;
+    std::vector<uint32_t> _count_tree;
+    double _measured_sum = 0;
+    size_t _measured_count = 0;
+    size_t _first = 0;
+    std::vector<std::shared_ptr<widget>> _recycled;
+    // Children of the next sync_items, swapped with children to keep both
+    // allocations around
+    std::vector<std::shared_ptr<widget>> _next_children;
+    // Item scrolled to by scroll_to_item, its offset may still change while
+    // the items on the way are measured
+    std::optional<size_t> _scroll_target;
+
+    float average_height() const;
+    void set_height(size_t index, float height);
+    void sync_items(update_context &ctx);
+};
 // A widget that renders text
 struct text_widget : public widget {
     std::string text;
@@ -303,10 +697,49 @@ struct text_widget : public widget {
 
     bool shrink_vertical = true, shrink_horizontal = true;
     float _yoffset_when_update = 0;
+    // Text, font size, font weight, font family and wrap width of the last
+    // update, used to invalidate the parent's layout when they change
+    std::optional<std::tuple<std::string, float, int, std::string, float>>
+        _layout_inputs;
+    // Color of the last repaint. Animations repaint the text by themselves,
+    // a color swapped for another one doesn't.
+    std::array<float, 4> _painted_color = {NAN, NAN, NAN, NAN};
+    // The glyphs drawn last time, drawn again while the text is the same
+    glyph_run _glyphs;
+    // Resolved fonts of update and render, and of measure, which can run on
+    // the context of a layout_pool thread
+    font_face_handle _font_face, _measure_font_face;
     void update(update_context &ctx) override;
 
-    float measure_height(update_context &ctx) override;
-    float measure_width(update_context &ctx) override;
+    size measure(update_context &ctx, const constraints &limits) override;
+    float measure_width(update_context &ctx) override;
+    float measure_height(update_context &ctx) override;
+    size_t measure_key() const override;
+    // Width the text wraps at within the limits, -1 for no wrapping
+    float wrap_width(const constraints &limits) const;
+};
+
+// Keys of a text widget waiting for its on_key_down, which runs on the loop
+// thread and may cancel them. The keys and the typed text of a frame, IME
+// commits included, are held back until every key of it was answered, and
+// so is text typed while earlier keys still wait.
+struct pending_text_keys {
+    // A key pressed or repeated, or a typed character, as in input_event
+    struct event {
+        input_event::kind type = input_event::kind::key;
+        int key = 0, mods = 0;
+        char32_t codepoint = 0;
+        // Answered by on_key_down, typed characters need no answer
+        bool canceled = false;
+        bool resolved = false;
+    };
+    struct batch {
+        std::uint64_t id = 0;
+        std::vector<event> events;
+    };
+
+    std::uint64_t next_id = 1;
+    std::deque<batch> batches;
 };
 
 struct textbox_widget : public widget {
@@ -364,8 +797,10 @@ struct textbox_widget : public widget {
     void render(nanovg_context ctx) override;
     void update(update_context &ctx) override;
 
-    float measure_height(update_context &ctx) override;
+    size measure(update_context &ctx, const constraints &limits) override;
     float measure_width(update_context &ctx) override;
+    float measure_height(update_context &ctx) override;
+    size_t measure_key() const override;
 
     void focus();
     void blur();
@@ -382,21 +817,6 @@ struct textbox_widget : public widget {
     void paste();
 
   private:
-    struct pending_key_event {
-        int key = 0;
-        bool canceled = false;
-        bool resolved = false;
-    };
-    struct pending_key_batch {
-        std::uint64_t id = 0;
-        bool shift_down = false;
-        bool ctrl_down = false;
-        bool alt_down = false;
-        bool super_down = false;
-        std::u32string text_input;
-        std::vector<pending_key_event> events;
-    };
-
     int caret_index = 0;
     int selection_anchor_index = 0;
     float horizontal_scroll = 0;
@@ -405,18 +825,140 @@ struct textbox_widget : public widget {
     bool dragging_selection = false;
     bool last_focused = false;
     std::optional<float> preferred_caret_x;
-    std::uint64_t next_pending_key_batch_id = 1;
-    std::deque<pending_key_batch> pending_key_batches;
+    pending_text_keys pending_keys;
+    font_face_handle _font_face;
+    // Layouts of the text and of what render() shows with an IME
+    // composition, kept between frames and laid out again where they change
+    struct layout_cache;
+    std::unique_ptr<layout_cache> _layout_cache;
+
+    // Everything render() reads apart from the animated colors, compared
+    // after each update to decide whether the textbox has to be repainted
+    struct visual_signature {
+        std::string text, placeholder;
+        float font_size = 0;
+        int font_weight = 0;
+        int selection_start = 0, selection_end = 0, caret_index = 0;
+        int composition_start = -1, composition_end = -1;
+        float horizontal_scroll = 0, vertical_scroll = 0;
+        bool focused = false, caret_visible = false;
+        bool disabled = false, readonly = false, multiline = false;
+        bool operator==(const visual_signature &) const = default;
+    };
+    visual_signature last_visual_signature;
 
     void clamp_indices();
     void reset_caret_blink();
     void notify_change(update_context &ctx);
 };
 
+// Editor for documents too large for textbox_widget, such as logs or
+// generated files. The text is kept in a text_document and only the lines
+// in view are laid out, so the cost of a frame or an edit does not grow
+// with the document. Lines are not wrapped. Selection, keys and IME
+// composition behave as in a multiline textbox_widget, but positions are
+// byte offsets into the document.
+struct text_editor_widget : public widget {
+    text_document document;
+    float font_size = 14;
+    int font_weight = 400;
+    float padding_x = 8;
+    float padding_y = 6;
+    float border_radius = 6;
+    float line_height_multiplier = 1;
+    bool readonly = false;
+    bool disabled = false;
+    // Pastes larger than this are inserted over several frames, this much
+    // per frame
+    size_t paste_chunk_size = 256 * 1024;
+    animated_color background_color = {this, 1.f, 1.f, 1.f, 235.f / 255.f,
+                                       "text_editor.bg"};
+    animated_color border_color = {this, 180.f / 255.f, 180.f / 255.f,
+                                   180.f / 255.f, 1.f, "text_editor.border"};
+    animated_color focus_border_color = {this, 59.f / 255.f, 130.f / 255.f,
+                                         246.f / 255.f, 1.f,
+                                         "text_editor.focus_border"};
+    animated_color text_color = {this, 32.f / 255.f, 32.f / 255.f,
+                                 32.f / 255.f, 1.f, "text_editor.text"};
+    animated_color selection_color = {this, 59.f / 255.f, 130.f / 255.f,
+                                      246.f / 255.f, 100.f / 255.f,
+                                      "text_editor.selection"};
+    animated_color caret_color = {this, 20.f / 255.f, 20.f / 255.f,
+                                  20.f / 255.f, 1.f, "text_editor.caret"};
+    animated_color composition_underline_color = {
+        this, 59.f / 255.f, 130.f / 255.f, 246.f / 255.f, 1.f,
+        "text_editor.composition"};
+
+    // Called on the loop thread after the document changed
+    std::function<void()> on_change;
+    std::function<void()> on_focus;
+    std::function<void()> on_blur;
+    // Called on the loop thread for every key with the modifiers, as for
+    // textbox_widget. Returning true cancels the key.
+    std::function<bool(int, bool, bool, bool, bool)> on_key_down;
+
+    text_editor_widget();
+    ~text_editor_widget() override;
+
+    void render(nanovg_context ctx) override;
+    void update(update_context &ctx) override;
+
+    size measure(update_context &ctx, const constraints &limits) override;
+    float measure_width(update_context &ctx) override;
+    float measure_height(update_context &ctx) override;
+    size_t measure_key() const override;
+
+    void focus();
+    void blur();
+    void set_text(std::string text);
+    void select_all();
+    size_t caret() const { return _caret; }
+    size_t selection_start() const;
+    size_t selection_end() const;
+    void set_selection(size_t anchor, size_t caret);
+    // Replaces the selection
+    void insert_text(std::string_view text);
+    // Replaces the selection over the next frames, paste_chunk_size bytes
+    // at a time
+    void insert_text_streamed(std::string text);
+    // Bytes of a streamed insertion still to come
+    size_t pending_insert_size() const;
+    void delete_text(size_t start, size_t end);
+    void copy();
+    void cut();
+    void paste();
+    // Lines laid out for the last frame, as [first, last)
+    std::pair<size_t, size_t> visible_lines() const;
+
+  private:
+    size_t _caret = 0, _anchor = 0;
+    float _scroll_x = 0;
+    // Line tops of a long document are past what a float holds exactly
+    double _scroll_y = 0;
+    float _caret_blink_elapsed = 0;
+    bool _dragging = false;
+    bool _last_focused = false;
+    std::optional<float> _preferred_x;
+    // A streamed insertion goes to _pending_insert_at, the bytes from
+    // _pending_insert_offset on are still to come
+    std::string _pending_insert;
+    size_t _pending_insert_offset = 0, _pending_insert_at = 0;
+    pending_text_keys _pending_keys;
+    size_t _last_visual_hash = 0;
+    font_face_handle _font_face;
+    // Layouts of the lines in view, kept until they change
+    struct view_cache;
+    std::unique_ptr<view_cache> _view;
+
+    void clamp_indices();
+    void replace_selection(std::string_view text);
+};
+
 // A widget that renders children in it with a padding
 struct padding_widget : public widget {
     sp_anim_float padding_left = anim_float(0), padding_right = anim_float(0),
-                  padding_top = anim_float(0), padding_bottom = anim_float(0);
+                  padding_top = anim_float(0), padding_bottom = anim_float(0);
+    std::array<float, 4> _last_padding = {NAN, NAN, NAN, NAN};
 
     void update(update_context &ctx) override;
     void render(nanovg_context ctx) override;
@@ -105,6 +105,9 @@ int fonsResetAtlas(FONScontext* stash, int width, int height);
 int fonsAddFont(FONScontext* s, const char* name, const char* path, int fontIndex);
 int fonsAddFontMem(FONScontext* s, const char* name, unsigned char* data, int ndata, int freeData, int fontIndex);
 int fonsGetFontByName(FONScontext* s, const char* name);
+// Adds the fonts of src that dst does not have yet, sharing their data, and
+// copies the fallbacks of all of them. Returns 0 if a font can't be added.
+int fonsShareFonts(FONScontext* dst, FONScontext* src);
 
 // State handling
 void fonsPushState(FONScontext* s);
@@ -238,6 +241,7 @@ struct FONSfont
 	unsigned char* data;
 	int dataSize;
 	unsigned char freeData;
+	int fontIndex;
 	float ascender;
 	float descender;
 	float lineh;
@@ -963,6 +967,7 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
 	font->dataSize = dataSize;
 	font->data = data;
 	font->freeData = (unsigned char)freeData;
+	font->fontIndex = fontIndex;
 
 	// Init font
 	stash->nscratch = 0;
@@ -995,6 +1000,27 @@ int fonsGetFontByName(FONScontext* s, const char* name)
 	return FONS_INVALID;
 }
 
+int fonsShareFonts(FONScontext* dst, FONScontext* src)
+{
+	int i;
+	for (i = dst->nfonts; i < src->nfonts; i++) {
+		FONSfont* font = src->fonts[i];
+		if (fonsAddFontMem(dst, font->name, font->data, font->dataSize, 0, font->fontIndex) == FONS_INVALID)
+			return 0;
+	}
+	for (i = 0; i < dst->nfonts && i < src->nfonts; i++) {
+		FONSfont* from = src->fonts[i];
+		FONSfont* to = dst->fonts[i];
+		if (to->nfallbacks == from->nfallbacks &&
+			memcmp(to->fallbacks, from->fallbacks, sizeof(int) * from->nfallbacks) == 0)
+			continue;
+		fonsResetFallbackFont(dst, i);
+		memcpy(to->fallbacks, from->fallbacks, sizeof(from->fallbacks));
+		to->nfallbacks = from->nfallbacks;
+	}
+	return 1;
+}
+
 
 static FONSglyph* fons__allocGlyph(FONSfont* font)
 {
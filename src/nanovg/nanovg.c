@@ -131,6 +131,7 @@ struct NVGcontext {
 	struct FONScontext* fs;
 	int fontImages[NVG_MAX_FONTIMAGES];
 	int fontImageIdx;
+	int textAtlasGeneration;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
@@ -1029,6 +1030,31 @@ void nvgResetScissor(NVGcontext* ctx)
 	state->scissor.extent[1] = -1.0f;
 }
 
+int nvgCurrentScissor(NVGcontext* ctx, float* bounds)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float pxform[6], invxorm[6];
+	float ex, ey, tex, tey;
+
+	if (state->scissor.extent[0] < 0)
+		return 0;
+
+	// Same as nvgIntersectScissor, the result is the bounding box when rotated.
+	memcpy(pxform, state->scissor.xform, sizeof(float)*6);
+	ex = state->scissor.extent[0];
+	ey = state->scissor.extent[1];
+	nvgTransformInverse(invxorm, state->xform);
+	nvgTransformMultiply(pxform, invxorm);
+	tex = ex*nvg__absf(pxform[0]) + ey*nvg__absf(pxform[2]);
+	tey = ex*nvg__absf(pxform[1]) + ey*nvg__absf(pxform[3]);
+
+	bounds[0] = pxform[4]-tex;
+	bounds[1] = pxform[5]-tey;
+	bounds[2] = tex*2;
+	bounds[3] = tey*2;
+	return 1;
+}
+
 // Global composite operation.
 void nvgGlobalCompositeOperation(NVGcontext* ctx, int op)
 {
@@ -2321,6 +2347,11 @@ int nvgFindFont(NVGcontext* ctx, const char* name)
 	return fonsGetFontByName(ctx->fs, name);
 }
 
+int nvgFontCount(NVGcontext* ctx)
+{
+	return ctx->fs->nfonts;
+}
+
 
 int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
 {
@@ -2343,6 +2374,13 @@ void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
 	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
 }
 
+int nvgShareFonts(NVGcontext* dst, NVGcontext* src)
+{
+	nvg__setDevicePixelRatio(dst, src->devicePxRatio);
+	*nvg__getState(dst) = *nvg__getState(src);
+	return fonsShareFonts(dst->fs, src->fs);
+}
+
 // State setting
 void nvgFontSize(NVGcontext* ctx, float size)
 {
@@ -2403,6 +2441,18 @@ static float nvg__getFontScale(NVGstate* state)
 	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
 }
 
+void nvgGetTextStyle(NVGcontext* ctx, NVGtextStyle* style)
+{
+	NVGstate* state = nvg__getState(ctx);
+	style->fontId = state->fontId;
+	style->fontSize = state->fontSize;
+	style->letterSpacing = state->letterSpacing;
+	style->lineHeight = state->lineHeight;
+	style->textAlign = state->textAlign;
+	style->scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	style->fontBlur = state->fontBlur;
+}
+
 static void nvg__flushTextTexture(NVGcontext* ctx)
 {
 	int dirty[4];
@@ -2443,6 +2493,7 @@ static int nvg__allocTextAtlas(NVGcontext* ctx)
 	}
 	++ctx->fontImageIdx;
 	fonsResetAtlas(ctx->fs, iw, ih);
+	ctx->textAtlasGeneration++;
 	return 1;
 }
 
@@ -2583,6 +2634,130 @@ void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const ch
 	state->textAlign = oldAlign;
 }
 
+int nvgTextAtlasGeneration(NVGcontext* ctx)
+{
+	return ctx->textAtlasGeneration;
+}
+
+int nvgTextQuads(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphQuad* quads, int maxQuads)
+{
+	NVGstate* state = nvg__getState(ctx);
+	FONStextIter iter;
+	FONSquad q;
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	float invscale = 1.0f / scale;
+	int nquads = 0;
+	int retried = 0;
+
+	if (end == NULL)
+		end = string + strlen(string);
+
+	if (state->fontId == FONS_INVALID) return 0;
+
+	fonsSetSize(ctx->fs, state->fontSize*scale);
+	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetAlign(ctx->fs, state->textAlign);
+	fonsSetFont(ctx->fs, state->fontId);
+
+	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
+	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
+			// The quads so far point into the old atlas, start over in the new one
+			if (retried || !nvg__allocTextAtlas(ctx))
+				break; // no memory :(
+			retried = 1;
+			nquads = 0;
+			fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
+			continue;
+		}
+		if (nquads < maxQuads) {
+			NVGglyphQuad* g = &quads[nquads++];
+			g->x0 = q.x0*invscale; g->y0 = q.y0*invscale;
+			g->x1 = q.x1*invscale; g->y1 = q.y1*invscale;
+			g->s0 = q.s0; g->t0 = q.t0;
+			g->s1 = q.s1; g->t1 = q.t1;
+		}
+	}
+
+	return nquads;
+}
+
+int nvgTextBoxQuads(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end, NVGglyphQuad* quads, int maxQuads)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGtextRow rows[2];
+	int nrows = 0, i;
+	int nquads = 0;
+	int oldAlign = state->textAlign;
+	int halign = state->textAlign & (NVG_ALIGN_LEFT | NVG_ALIGN_CENTER | NVG_ALIGN_RIGHT);
+	int valign = state->textAlign & (NVG_ALIGN_TOP | NVG_ALIGN_MIDDLE | NVG_ALIGN_BOTTOM | NVG_ALIGN_BASELINE);
+	float lineh = 0;
+
+	if (state->fontId == FONS_INVALID) return 0;
+
+	nvgTextMetrics(ctx, NULL, NULL, &lineh);
+
+	state->textAlign = NVG_ALIGN_LEFT | valign;
+
+	while ((nrows = nvgTextBreakLines(ctx, string, end, breakRowWidth, rows, 2))) {
+		for (i = 0; i < nrows; i++) {
+			NVGtextRow* row = &rows[i];
+			float rowx = x;
+			if (halign & NVG_ALIGN_CENTER)
+				rowx = x + breakRowWidth*0.5f - row->width*0.5f;
+			else if (halign & NVG_ALIGN_RIGHT)
+				rowx = x + breakRowWidth - row->width;
+			nquads += nvgTextQuads(ctx, rowx, y, row->start, row->end, quads + nquads, maxQuads - nquads);
+			y += lineh * state->lineHeight;
+		}
+		string = rows[nrows-1].next;
+	}
+
+	state->textAlign = oldAlign;
+	return nquads;
+}
+
+void nvgDrawTextQuads(NVGcontext* ctx, float x, float y, const NVGglyphQuad* quads, int nquads)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGvertex* verts;
+	int nverts = 0, i;
+	int isFlipped = nvg__isTransformFlipped(state->xform);
+
+	if (nquads <= 0) return;
+
+	verts = nvg__allocTempVerts(ctx, nquads * 6);
+	if (verts == NULL) return;
+
+	for (i = 0; i < nquads; i++) {
+		NVGglyphQuad q = quads[i];
+		float c[4*2];
+		if(isFlipped) {
+			float tmp;
+
+			tmp = q.y0; q.y0 = q.y1; q.y1 = tmp;
+			tmp = q.t0; q.t0 = q.t1; q.t1 = tmp;
+		}
+		// Transform corners.
+		nvgTransformPoint(&c[0],&c[1], state->xform, x + q.x0, y + q.y0);
+		nvgTransformPoint(&c[2],&c[3], state->xform, x + q.x1, y + q.y0);
+		nvgTransformPoint(&c[4],&c[5], state->xform, x + q.x1, y + q.y1);
+		nvgTransformPoint(&c[6],&c[7], state->xform, x + q.x0, y + q.y1);
+		// Create triangles
+		nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+		nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+	}
+
+	nvg__flushTextTexture(ctx);
+
+	nvg__renderText(ctx, verts, nverts);
+}
+
 int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2960,3 +3135,46 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 void nvgFonsResetAtlas(NVGcontext *ctx) {
 	nvg__allocTextAtlas(ctx);
 }
+
+static int nvg__measureCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int nvg__measureCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(type);
+	NVG_NOTUSED(w);
+	NVG_NOTUSED(h);
+	NVG_NOTUSED(imageFlags);
+	NVG_NOTUSED(data);
+	return 1;
+}
+
+static int nvg__measureDeleteTexture(void* uptr, int image)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	return 1;
+}
+
+static int nvg__measureGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(image);
+	*w = *h = NVG_INIT_FONTIMAGE_SIZE;
+	return 1;
+}
+
+NVGcontext* nvgCreateMeasureContext(void)
+{
+	NVGparams params;
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = nvg__measureCreate;
+	params.renderCreateTexture = nvg__measureCreateTexture;
+	params.renderDeleteTexture = nvg__measureDeleteTexture;
+	params.renderGetTextureSize = nvg__measureGetTextureSize;
+	return nvgCreateInternal(&params);
+}
@@ -135,6 +135,12 @@ struct NVGtextRow {
 };
 typedef struct NVGtextRow NVGtextRow;
 
+struct NVGglyphQuad {
+	float x0, y0, x1, y1;	// Corners of the glyph in local coordinate space, relative to where the text is drawn.
+	float s0, t0, s1, t1;	// Corners of the glyph in the font atlas.
+};
+typedef struct NVGglyphQuad NVGglyphQuad;
+
 enum NVGimageFlags {
     NVG_IMAGE_GENERATE_MIPMAPS	= 1<<0,     // Generate mipmaps during creation of the image.
 	NVG_IMAGE_REPEATX			= 1<<1,		// Repeat image in X direction.
@@ -441,6 +447,10 @@ void nvgIntersectScissor(NVGcontext* ctx, float x, float y, float w, float h);
 // Reset and disables scissoring.
 void nvgResetScissor(NVGcontext* ctx);
 
+// Gets the bounds of the current scissor in the current transform space, as x, y, width, height.
+// Returns 0 when no scissor is set.
+int nvgCurrentScissor(NVGcontext* ctx, float* bounds);
+
 //
 // Paths
 //
@@ -559,6 +569,9 @@ int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* da
 // Finds a loaded font of specified name, and returns handle to it, or -1 if the font is not found.
 int nvgFindFont(NVGcontext* ctx, const char* name);
 
+// Returns the number of fonts loaded, it grows with every font created.
+int nvgFontCount(NVGcontext* ctx);
+
 // Adds a fallback font by handle.
 int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont);
 
@@ -571,6 +584,11 @@ void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont);
 // Resets fallback fonts by name.
 void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont);
 
+// Makes dst measure text like src: adds the fonts of src that dst does not
+// have yet, sharing their data, and copies the fallbacks, the pixel ratio
+// and the current state. Returns 0 if a font can't be added.
+int nvgShareFonts(NVGcontext* dst, NVGcontext* src);
+
 // Sets the font size of current text style.
 void nvgFontSize(NVGcontext* ctx, float size);
 
@@ -589,6 +607,20 @@ void nvgTextAlign(NVGcontext* ctx, int align);
 // Gets the text align of current text style, see NVGalign for options.
 int nvgGetTextAlign(NVGcontext* ctx);
 
+struct NVGtextStyle {
+	int fontId;
+	float fontSize;
+	float letterSpacing;
+	float lineHeight;
+	int textAlign;
+	float scale;		// Scale the glyphs are rasterized at, from the transform and the device pixel ratio.
+	float fontBlur;
+};
+typedef struct NVGtextStyle NVGtextStyle;
+
+// Gets everything of the current text style that text bounds depend on.
+void nvgGetTextStyle(NVGcontext* ctx, NVGtextStyle* style);
+
 // Sets the font face based on specified id of current text style.
 void nvgFontFaceId(NVGcontext* ctx, int font);
 
@@ -618,6 +650,20 @@ void nvgTextBoxBounds(NVGcontext* ctx, float x, float y, float breakRowWidth, co
 // Measured values are returned in local coordinate space.
 int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphPosition* positions, int maxPositions);
 
+// Lays out the glyphs of nvgText at (x,y) into at most maxQuads quads, which nvgDrawTextQuads draws again
+// without going through the font. Returns the number of quads. The quads hold as long as the transform scale,
+// the text style and nvgTextAtlasGeneration() stay the same.
+int nvgTextQuads(NVGcontext* ctx, float x, float y, const char* string, const char* end, NVGglyphQuad* quads, int maxQuads);
+
+// Lays out the glyphs of nvgTextBox like nvgTextQuads.
+int nvgTextBoxQuads(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end, NVGglyphQuad* quads, int maxQuads);
+
+// Draws glyph quads of nvgTextQuads moved by (x,y), with the current fill paint and transform.
+void nvgDrawTextQuads(NVGcontext* ctx, float x, float y, const NVGglyphQuad* quads, int nquads);
+
+// Changes whenever the font atlas is reset, which moves the glyphs in it.
+int nvgTextAtlasGeneration(NVGcontext* ctx);
+
 // Returns the vertical metrics based on the current text style.
 // Measured values are returned in local coordinate space.
 void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* lineh);
@@ -689,6 +735,10 @@ void nvgDebugDumpPathCache(NVGcontext* ctx);
 
 void nvgFonsResetAtlas(NVGcontext *ctx);
 
+// Context without a renderer, only good for measuring text. Each thread can
+// measure with its own one, see nvgShareFonts().
+NVGcontext* nvgCreateMeasureContext(void);
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -2,3 +2,4 @@
 #include "glad/glad.h"
 #define NANOVG_GL3_IMPLEMENTATION
 #include "nanovg_gl.h"
+#include "nanovg_gl_utils.h"
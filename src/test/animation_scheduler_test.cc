@@ -0,0 +1,128 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <cmath>
+#include <iostream>
+
+// Checks that only animations in flight are ticked and that the scheduler
+// produces the same values as animated_float::update
+namespace {
+struct colored_widget : public ui::widget {
+    ui::animated_color color = {this, 0, 0, 0, 1};
+};
+} // namespace
+
+void test_animation_scheduler() {
+    auto &rt = *(new ui::render_target{});
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {},
+    };
+
+    std::vector<std::shared_ptr<colored_widget>> widgets;
+    auto root = std::make_shared<ui::widget>();
+    for (int i = 0; i < 100; i++)
+        widgets.push_back(root->emplace_child<colored_widget>());
+
+    std::cout << "Animation Scheduler Test Results:" << std::endl;
+
+    root->update(ctx);
+    rt.animations->tick(ctx.delta_time);
+    check(rt.animations->running() == 0, "settled animations are not ticked");
+
+    // Reference animation that isn't owned by a widget
+    ui::animated_float reference(0, 160, ui::easing_type::ease_in_out);
+    reference.update(0);
+    reference.animate_to(1);
+
+    auto &target = widgets[42];
+    target->color.r->set_easing(ui::easing_type::ease_in_out);
+    target->color.r->set_duration(160);
+    target->color.r->animate_to(1);
+    check(rt.animations->running() == 1, "animate_to registers the animation");
+
+    for (auto &w : widgets)
+        w->needs_repaint = false;
+    bool values_match = true, only_target_repainted = true;
+    for (int frame = 0; frame < 5; frame++) {
+        rt.animations->tick(ctx.delta_time);
+        reference.update(ctx.delta_time);
+        values_match &= std::abs(**target->color.r - *reference) < 1e-6f;
+        only_target_repainted &= rt.animations->repaint_widgets.size() == 1 &&
+                                 rt.animations->repaint_widgets[0] ==
+                                     target.get();
+        target->needs_repaint = false;
+    }
+    check(values_match, "scheduled values match animated_float::update");
+    check(only_target_repainted, "only the owner is marked for repaint");
+
+    auto &delayed = widgets[7];
+    delayed->color.g->set_easing(ui::easing_type::linear);
+    delayed->color.g->set_delay(100);
+    delayed->color.g->animate_to(1);
+    check(std::abs(rt.animations->next_change_in() - 0) < 1e-6f,
+          "running animations need the next frame");
+
+    for (int frame = 0; frame < 40; frame++)
+        rt.animations->tick(ctx.delta_time);
+    check(**target->color.r == 1 && **delayed->color.g == 1,
+          "animations reach their destination");
+    check(rt.animations->running() == 0, "finished animations are removed");
+    check(std::isinf(rt.animations->next_change_in()),
+          "no deadline once everything settled");
+
+    delayed->color.b->set_easing(ui::easing_type::linear);
+    delayed->color.b->set_delay(100);
+    delayed->color.b->animate_to(1);
+    rt.animations->tick(ctx.delta_time);
+    check(std::abs(rt.animations->next_change_in() - 84) < 1e-3f,
+          "delayed animations report the end of their delay");
+
+    widgets.clear();
+    root->children.clear();
+    check(rt.animations->running() == 0,
+          "destroyed widgets leave the scheduler");
+
+    // A widget that outlives the render target it was updated in
+    auto survivor = std::make_shared<colored_widget>();
+    survivor->color.r->set_easing(ui::easing_type::linear);
+    survivor->color.g->set_easing(ui::easing_type::linear);
+    {
+        ui::headless_target gone(800, 600);
+        gone.rt.root->add_child(survivor);
+        gone.frame();
+        survivor->color.r->animate_to(1);
+        check(gone.rt.animations->running() == 1,
+              "animations run on the render target of the last update");
+        gone.rt.root->remove_child(survivor);
+    }
+    survivor->color.g->animate_to(1);
+    check(survivor->color.g->next_change_in() == 0,
+          "animations of a widget outliving its render target still run");
+    survivor->update(ctx);
+    check(rt.animations->running() == 2,
+          "the next render target takes the animations over");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+}
+
+int main() {
+    test_animation_scheduler();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+#include "breeze_ui/font.h"
+#include "breeze_ui/glyph_run.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/text_document.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Synthetic workloads run on a headless_target with a renderer that draws
+// nothing, so they run without a display or GPU. Results are written as
+// JSON, one entry per benchmark with the time of an iteration:
+//
+//   breeze_bench [--filter=<substring>] [--min-time=<ms>] [--out=<file>]
+//                [--font=<ttf>]
+//
+// Text benchmarks need a font, they are left out when none is found.
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+// Times the iterations of one benchmark. The body loops on next() and can
+// leave setup out of the time between pause() and resume().
+struct bench_state {
+    explicit bench_state(double min_time_ms) : min_time_ms(min_time_ms) {}
+
+    bool next() {
+        auto now = bench_clock::now();
+        if (running) {
+            auto ns = std::chrono::duration<double, std::nano>(
+                          now - iteration_start)
+                          .count() -
+                      paused_ns;
+            samples.push_back(ns);
+            total_ns += ns;
+        }
+        running = samples.size() < min_iterations ||
+                  (total_ns < min_time_ms * 1e6 &&
+                   samples.size() < max_iterations);
+        paused_ns = 0;
+        iteration_start = bench_clock::now();
+        return running;
+    }
+    void pause() { pause_start = bench_clock::now(); }
+    void resume() {
+        paused_ns += std::chrono::duration<double, std::nano>(
+                         bench_clock::now() - pause_start)
+                         .count();
+    }
+
+    // Work items in an iteration, nodes or edits or shapes
+    double items = 1;
+    std::vector<double> samples;
+
+  private:
+    static constexpr size_t min_iterations = 3, max_iterations = 1000000;
+    double min_time_ms, total_ns = 0, paused_ns = 0;
+    bool running = false;
+    bench_clock::time_point iteration_start, pause_start;
+};
+
+struct bench_case {
+    std::string name;
+    std::function<void(bench_state &)> run;
+    bool needs_font = false;
+};
+
+struct bench_result {
+    std::string name;
+    size_t iterations;
+    double min_ns, median_ns, mean_ns, items;
+};
+
+std::string font_path;
+
+bool load_font(NVGcontext *nvg) {
+    if (font_path.empty())
+        return false;
+    return ui::register_font_family(
+        nvg, {.family_name = "main",
+              .faces = {{.weight = 400, .source = {.path = font_path}}}});
+}
+
+// A vertical flex_widget of rows, each a horizontal flex_widget with 99
+// items, nodes widgets in all
+std::shared_ptr<ui::flex_widget> make_flex_tree(int nodes,
+                                                std::vector<ui::widget *> *leaves =
+                                                    nullptr) {
+    constexpr int items_per_row = 99;
+    auto root = std::make_shared<ui::flex_widget>();
+    root->auto_size = false;
+    root->width->reset_to(1000);
+    root->height->reset_to(600);
+    root->align_items = ui::flex_widget::align::stretch;
+    for (int r = 0; r < nodes / (items_per_row + 1); r++) {
+        auto row = root->emplace_child<ui::flex_widget>();
+        row->horizontal = true;
+        row->gap = 1;
+        row->justify_content = ui::flex_widget::justify::center;
+        for (int i = 0; i < items_per_row; i++) {
+            auto leaf = row->emplace_child<ui::widget>();
+            leaf->width->reset_to(5.f + i % 7);
+            leaf->height->reset_to(10.f + i % 5);
+            leaf->flex_grow = i % 3 == 0;
+            if (leaves)
+                leaves->push_back(leaf.get());
+        }
+    }
+    return root;
+}
+
+void bench_tree_build(bench_state &state, int nodes) {
+    state.items = nodes;
+    while (state.next()) {
+        auto root = make_flex_tree(nodes);
+        state.pause();
+        root.reset();
+        state.resume();
+    }
+}
+
+// Frames of a tree where nothing changes but the mouse position
+void bench_tree_update(bench_state &state, int nodes) {
+    ui::headless_target target(1000, 600);
+    target.rt.root->add_child(make_flex_tree(nodes));
+    target.frame();
+    state.items = nodes;
+    int frame = 0;
+    while (state.next()) {
+        target.mouse_x = frame++ % 1000;
+        target.mouse_y = 300;
+        target.frame();
+    }
+}
+
+// Frames after the layout of every leaf was invalidated
+void bench_tree_layout(bench_state &state, int nodes) {
+    ui::headless_target target(1000, 600);
+    std::vector<ui::widget *> leaves;
+    target.rt.root->add_child(make_flex_tree(nodes, &leaves));
+    target.frame();
+    state.items = nodes;
+    while (state.next()) {
+        state.pause();
+        for (auto leaf : leaves)
+            leaf->invalidate_layout();
+        state.resume();
+        target.frame();
+    }
+}
+
+std::vector<std::string> sample_lines(int count) {
+    static constexpr const char *words[] = {
+        "breeze", "widget", "layout", "the",   "flex",      "of",
+        "render", "frame",  "a",      "glyph", "measuring", "text",
+    };
+    std::vector<std::string> lines;
+    for (int i = 0; i < count; i++) {
+        std::string line;
+        for (int w = 0; w < 3 + i % 17; w++) {
+            if (!line.empty())
+                line += ' ';
+            line += words[(i * 7 + w * 3) % std::size(words)];
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+void bench_text_measure(bench_state &state, bool wrapped) {
+    ui::headless_target target(800, 600);
+    load_font(target.rt.nvg);
+    ui::nanovg_context vg{target.rt.nvg, &target.rt};
+    vg.fontSize(14);
+    vg.fontFace(ui::resolve_font_face_name(target.rt.nvg, "main").c_str());
+    auto lines = sample_lines(256);
+    if (wrapped) {
+        for (auto &line : lines)
+            line = line + ' ' + line + ' ' + line;
+    }
+    state.items = lines.size();
+    float sink = 0;
+    while (state.next()) {
+        for (auto &line : lines) {
+            auto [w, h] = wrapped ? vg.measureTextBox(line.c_str(), 200)
+                                  : vg.measureText(line.c_str());
+            sink += w + h;
+        }
+    }
+    if (sink < 0)
+        std::cerr << sink;
+}
+
+// Typing into and deleting from the middle of a focused multiline textbox
+// holding chars characters, one frame per edit
+void bench_textbox_edit(bench_state &state, int chars) {
+    ui::headless_target target(800, 600);
+    load_font(target.rt.nvg);
+    auto textbox = target.rt.root->emplace_child<ui::textbox_widget>();
+    textbox->multiline = true;
+    textbox->width->reset_to(600);
+    textbox->height->reset_to(400);
+    std::string text;
+    for (auto &line : sample_lines(chars / 40 + 1)) {
+        if (static_cast<int>(text.size()) >= chars)
+            break;
+        text += line + '\n';
+    }
+    text.resize(chars);
+    textbox->text = text;
+    // Focus needs the render target the first frame sets
+    target.frame();
+    textbox->focus();
+    textbox->set_selection(chars / 2, chars / 2);
+    target.frame();
+    state.items = 1;
+    bool typing = true;
+    while (state.next()) {
+        if (typing)
+            target.type(U"x");
+        else
+            target.key_press(GLFW_KEY_BACKSPACE);
+        target.frame();
+        if (!typing)
+            target.key_release(GLFW_KEY_BACKSPACE);
+        typing = !typing;
+    }
+}
+
+// Typing in the middle of a large document in a text_editor_widget
+void bench_text_editor_edit(bench_state &state, size_t chars) {
+    ui::headless_target target(800, 600);
+    load_font(target.rt.nvg);
+    auto editor = target.rt.root->emplace_child<ui::text_editor_widget>();
+    editor->width->reset_to(600);
+    editor->height->reset_to(400);
+    std::string text;
+    auto lines = sample_lines(1000);
+    for (size_t i = 0; text.size() < chars; ++i)
+        text += lines[i % lines.size()] + '\n';
+    text.resize(chars);
+    editor->set_text(std::move(text));
+    target.frame();
+    editor->focus();
+    editor->set_selection(chars / 2, chars / 2);
+    target.frame();
+    state.items = 1;
+    bool typing = true;
+    while (state.next()) {
+        if (typing)
+            target.type(U"x");
+        else
+            target.key_press(GLFW_KEY_BACKSPACE);
+        target.frame();
+        if (!typing)
+            target.key_release(GLFW_KEY_BACKSPACE);
+        typing = !typing;
+    }
+}
+
+// Edits at random places of a large document, finding the line of each
+// like the editor does. Every edit splits the pieces further.
+void bench_text_document_edit(bench_state &state, size_t chars) {
+    std::string text;
+    auto lines = sample_lines(1000);
+    for (size_t i = 0; text.size() < chars; ++i)
+        text += lines[i % lines.size()] + '\n';
+    text.resize(chars);
+    ui::text_document document(std::move(text));
+    std::mt19937 random(1);
+    constexpr int edits = 1000;
+    state.items = edits;
+    while (state.next()) {
+        for (int i = 0; i < edits; i++) {
+            auto offset = random() % document.size();
+            if (i % 2)
+                document.erase(offset, 1);
+            else
+                document.insert(offset, "x\n");
+            document.line_start(document.line_of(offset));
+        }
+    }
+}
+
+struct animated_widget : public ui::widget {
+    ui::sp_anim_float value = anim_float(0, 1e9f, ui::easing_type::linear);
+};
+
+// Ticks of the animation scheduler with count animations running
+void bench_animation_tick(bench_state &state, int count) {
+    ui::headless_target target(800, 600);
+    std::vector<std::shared_ptr<animated_widget>> widgets;
+    for (int i = 0; i < count; i++)
+        widgets.push_back(target.rt.root->emplace_child<animated_widget>());
+    // The first frame gives the widgets their scheduler
+    target.frame();
+    for (auto &w : widgets)
+        w->value->animate_to(1);
+    state.items = count;
+    while (state.next())
+        target.rt.animations->tick(16);
+}
+
+// Shapes widgets draw, tessellated by nanovg and thrown away by the
+// renderer
+void bench_tessellate_shapes(bench_state &state) {
+    ui::headless_target target(1000, 1000);
+    auto nvg = target.rt.nvg;
+    constexpr int count = 1000;
+    state.items = count;
+    while (state.next()) {
+        nvgBeginFrame(nvg, 1000, 1000, 1);
+        for (int i = 0; i < count; i++) {
+            float x = i % 40 * 25.f, y = i / 40 * 40.f;
+            nvgBeginPath(nvg);
+            switch (i % 4) {
+            case 0:
+                nvgRoundedRect(nvg, x, y, 22, 30, 6);
+                break;
+            case 1:
+                nvgCircle(nvg, x + 11, y + 15, 10);
+                break;
+            case 2:
+                nvgRoundedRectVarying(nvg, x, y, 22, 30, 2, 8, 2, 8);
+                break;
+            default:
+                nvgMoveTo(nvg, x, y);
+                nvgBezierTo(nvg, x + 20, y, x, y + 30, x + 22, y + 30);
+                break;
+            }
+            nvgFillColor(nvg, nvgRGBA(40, 120, 200, 200));
+            nvgFill(nvg);
+            nvgStrokeWidth(nvg, 1.5f);
+            nvgStrokeColor(nvg, nvgRGBA(0, 0, 0, 255));
+            nvgStroke(nvg);
+        }
+        nvgEndFrame(nvg);
+    }
+}
+
+void bench_tessellate_text(bench_state &state) {
+    ui::headless_target target(1000, 1000);
+    load_font(target.rt.nvg);
+    auto nvg = target.rt.nvg;
+    auto face = ui::resolve_font_face_name(nvg, "main");
+    auto lines = sample_lines(60);
+    state.items = lines.size();
+    while (state.next()) {
+        nvgBeginFrame(nvg, 1000, 1000, 1);
+        nvgFontFace(nvg, face.c_str());
+        nvgFontSize(nvg, 14);
+        nvgFillColor(nvg, nvgRGBA(0, 0, 0, 255));
+        for (size_t i = 0; i < lines.size(); i++)
+            nvgText(nvg, 10, 16.f * (i + 1), lines[i].c_str(), nullptr);
+        nvgEndFrame(nvg);
+    }
+}
+
+// The same lines drawn from glyph runs, as text widgets repaint them
+void bench_glyph_runs(bench_state &state) {
+    ui::headless_target target(1000, 1000);
+    load_font(target.rt.nvg);
+    ui::nanovg_context vg{target.rt.nvg, &target.rt};
+    auto face = ui::resolve_font_face_name(vg.ctx, "main");
+    auto lines = sample_lines(60);
+    std::vector<ui::glyph_run> runs(lines.size());
+    state.items = lines.size();
+    while (state.next()) {
+        vg.beginFrame(1000, 1000, 1);
+        vg.fontFace(face.c_str());
+        vg.fontSize(14);
+        vg.fillColor(nvgRGBA(0, 0, 0, 255));
+        for (size_t i = 0; i < lines.size(); i++)
+            runs[i].draw(vg, 10, 16.f * (i + 1), lines[i]);
+        vg.endFrame();
+    }
+}
+
+std::vector<bench_case> all_cases() {
+    std::vector<bench_case> cases;
+    for (auto [nodes, label] :
+         {std::pair{1000, "1k"}, {10000, "10k"}, {100000, "100k"}}) {
+        cases.push_back({std::string("tree/build/") + label,
+                         [=](auto &s) { bench_tree_build(s, nodes); }});
+        cases.push_back({std::string("tree/update/") + label,
+                         [=](auto &s) { bench_tree_update(s, nodes); }});
+        cases.push_back({std::string("tree/layout/") + label,
+                         [=](auto &s) { bench_tree_layout(s, nodes); }});
+    }
+    cases.push_back({"text/measure/line",
+                     [](auto &s) { bench_text_measure(s, false); }, true});
+    cases.push_back({"text/measure/wrapped",
+                     [](auto &s) { bench_text_measure(s, true); }, true});
+    for (auto [chars, label] : {std::pair{10000, "10k"}, {100000, "100k"}}) {
+        cases.push_back({std::string("textbox/edit/") + label,
+                         [=](auto &s) { bench_textbox_edit(s, chars); },
+                         true});
+    }
+    for (auto [chars, label] :
+         {std::pair{size_t{1} << 20, "1m"}, {size_t{10} << 20, "10m"}}) {
+        cases.push_back({std::string("text_editor/edit/") + label,
+                         [=](auto &s) { bench_text_editor_edit(s, chars); },
+                         true});
+    }
+    for (auto [chars, label] :
+         {std::pair{size_t{1} << 20, "1m"}, {size_t{10} << 20, "10m"}}) {
+        cases.push_back({std::string("text_document/edit/") + label,
+                         [=](auto &s) { bench_text_document_edit(s, chars); }});
+    }
+    for (auto [count, label] :
+         {std::pair{1000, "1k"}, {10000, "10k"}, {100000, "100k"}}) {
+        cases.push_back({std::string("animation/tick/") + label,
+                         [=](auto &s) { bench_animation_tick(s, count); }});
+    }
+    cases.push_back({"nanovg/tessellate/shapes", bench_tessellate_shapes});
+    cases.push_back({"nanovg/tessellate/text", bench_tessellate_text, true});
+    cases.push_back({"nanovg/glyph_runs/text", bench_glyph_runs, true});
+    return cases;
+}
+
+bench_result summarize(const std::string &name, bench_state &state) {
+    auto samples = state.samples;
+    std::ranges::sort(samples);
+    double sum = 0;
+    for (auto s : samples)
+        sum += s;
+    return {
+        .name = name,
+        .iterations = samples.size(),
+        .min_ns = samples.front(),
+        .median_ns = samples[samples.size() / 2],
+        .mean_ns = sum / samples.size(),
+        .items = state.items,
+    };
+}
+
+std::string json_string(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+            continue;
+        }
+        out += c;
+    }
+    return out + '"';
+}
+
+std::string to_json(const std::vector<bench_result> &results) {
+    std::ostringstream out;
+    out.precision(17);
+    out << "{\n  \"context\": {\n";
+    out << "    \"timestamp\": " << std::time(nullptr) << ",\n";
+#ifdef NDEBUG
+    out << "    \"build\": \"release\",\n";
+#else
+    out << "    \"build\": \"debug\",\n";
+#endif
+    out << "    \"font\": " << json_string(font_path) << "\n  },\n";
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << json_string(r.name)
+            << ", \"iterations\": " << r.iterations
+            << ", \"min_ns\": " << r.min_ns
+            << ", \"median_ns\": " << r.median_ns
+            << ", \"mean_ns\": " << r.mean_ns
+            << ", \"items_per_iteration\": " << r.items
+            << ", \"items_per_second\": " << r.items * 1e9 / r.median_ns
+            << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string filter, out_path;
+    double min_time_ms = 500;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view option) {
+            return arg.substr(option.size());
+        };
+        if (arg.starts_with("--filter="))
+            filter = value("--filter=");
+        else if (arg.starts_with("--min-time="))
+            min_time_ms = std::stod(std::string(value("--min-time=")));
+        else if (arg.starts_with("--out="))
+            out_path = value("--out=");
+        else if (arg.starts_with("--font="))
+            font_path = value("--font=");
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (font_path.empty())
+        font_path = find_font();
+    if (font_path.empty())
+        std::cerr << "No font found, text benchmarks are skipped"
+                  << std::endl;
+
+    std::vector<bench_result> results;
+    for (auto &c : all_cases()) {
+        if (!c.name.contains(filter) || (c.needs_font && font_path.empty()))
+            continue;
+        bench_state state(min_time_ms);
+        c.run(state);
+        results.push_back(summarize(c.name, state));
+        auto &r = results.back();
+        std::cerr << c.name << ": " << r.median_ns / 1e3 << " us, "
+                  << r.iterations << " iterations" << std::endl;
+    }
+
+    auto json = to_json(results);
+    if (out_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(out_path) << json;
+    }
+    return 0;
+}
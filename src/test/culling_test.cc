@@ -0,0 +1,145 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+
+// Checks that widgets outside of the visible area are neither drawn nor,
+// when asked for, updated
+namespace {
+struct probe_widget : public ui::widget {
+    int update_count = 0, render_count = 0;
+    probe_widget() {
+        width->reset_to(300);
+        height->reset_to(20);
+    }
+    void update(ui::update_context &ctx) override {
+        update_count++;
+        widget::update(ctx);
+    }
+    void render(ui::nanovg_context ctx) override {
+        render_count++;
+        widget::render(ctx);
+    }
+};
+} // namespace
+
+void test_culling() {
+    auto &rt = *(new ui::render_target{});
+    auto nvg = ui::create_null_nvg();
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    auto list = std::make_shared<ui::flex_widget>();
+    list->enable_scrolling = true;
+    list->max_height = 200;
+    list->skip_offscreen_updates = true;
+    std::vector<std::shared_ptr<probe_widget>> probes;
+    for (int i = 0; i < 500; i++) {
+        auto probe = std::make_shared<probe_widget>();
+        list->add_child(probe);
+        probes.push_back(probe);
+    }
+    rt.root->add_child(list);
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+        .clip = ui::rect{0, 0, 800, 600},
+    };
+
+    // Same steps as render_target::render for a full repaint, without the
+    // GL parts
+    auto frame = [&]() {
+        for (auto &probe : probes)
+            probe->update_count = probe->render_count = 0;
+        rt.drawn_widgets = rt.culled_widgets = rt.skipped_updates = 0;
+        rt.animations->tick(ctx.delta_time);
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        auto damage = rt.damage;
+        rt.damage.clear();
+
+        ui::nanovg_context vg{nvg, &rt};
+        vg.beginFrame(800, 600, 1);
+        vg.scissor(0, 0, 800, 600);
+        rt.root->render(vg);
+        vg.endFrame();
+        return damage;
+    };
+    auto counted = [&](auto field, int first, int last) {
+        int count = 0;
+        for (int i = first; i < last; i++)
+            count += probes[i].get()->*field;
+        return count;
+    };
+
+    std::cout << "Culling Test Results:" << std::endl;
+
+    frame();
+    check(counted(&probe_widget::update_count, 0, 500) == 500,
+          "everything is updated in the first frame");
+    // The child right below the list is within the damage margin
+    check(rt.drawn_widgets == 12 && rt.culled_widgets == 489,
+          "only the visible children are drawn");
+    check(counted(&probe_widget::render_count, 0, 11) == 11 &&
+              counted(&probe_widget::render_count, 11, 500) == 0,
+          "children below the list are culled");
+
+    frame();
+    check(rt.skipped_updates == 489 &&
+              counted(&probe_widget::update_count, 0, 11) == 11,
+          "offscreen children are not updated");
+
+    list->scroll_top->reset_to(-2000);
+    auto damage = frame();
+    check(counted(&probe_widget::update_count, 100, 110) == 10 &&
+              counted(&probe_widget::render_count, 100, 110) == 10,
+          "scrolled in children are updated and drawn");
+    check(counted(&probe_widget::update_count, 0, 10) == 0 &&
+              counted(&probe_widget::render_count, 0, 10) == 0,
+          "scrolled out children are skipped");
+    check(!damage.full && damage.bounds.y <= 0 && damage.bounds.bottom() >= 200,
+          "the list area is damaged");
+
+    frame();
+    check(rt.skipped_updates == 488 && rt.drawn_widgets == 13,
+          "skipping settles after scrolling");
+
+    probes[400]->x->set_easing(ui::easing_type::linear);
+    probes[400]->x->set_duration(1000);
+    probes[400]->x->animate_to(10);
+    frame();
+    frame();
+    check(probes[400]->update_count == 1,
+          "animating children keep being updated");
+    check(probes[400]->render_count == 0, "but are still culled");
+
+    for (int i = 0; i < 70; i++)
+        frame();
+    check(probes[400]->update_count == 0 && rt.skipped_updates == 488,
+          "skipping resumes once the animation is done");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    nvgDeleteInternal(nvg);
+}
+
+int main() {
+    test_culling();
+    return test_passed ? 0 : 1;
+}
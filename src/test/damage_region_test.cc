@@ -0,0 +1,123 @@
+#include "breeze_ui/extra_widgets.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+
+// Checks that only the widgets touching the damaged area are redrawn
+namespace {
+struct probe_widget : public ui::rect_widget {
+    int render_count = 0;
+    probe_widget(float x, float y) {
+        this->x->reset_to(x);
+        this->y->reset_to(y);
+        width->reset_to(50);
+        height->reset_to(50);
+    }
+    void render(ui::nanovg_context ctx) override {
+        render_count++;
+        rect_widget::render(ctx);
+    }
+};
+
+// Text with a fixed size, so changing it doesn't move anything
+struct probe_label : public ui::text_widget {
+    int render_count = 0;
+    probe_label(float x, float y) {
+        this->x->reset_to(x);
+        this->y->reset_to(y);
+        width->reset_to(100);
+        height->reset_to(20);
+        shrink_horizontal = shrink_vertical = false;
+        text = "Hello";
+    }
+    void render(ui::nanovg_context ctx) override {
+        render_count++;
+        text_widget::render(ctx);
+    }
+};
+} // namespace
+
+void test_damage_region() {
+    ui::headless_target target(800, 600);
+    auto &root = target.rt.root;
+
+    auto probe1 = std::make_shared<probe_widget>(0, 0);
+    auto probe2 = std::make_shared<probe_widget>(100, 0);
+    auto probe3 = std::make_shared<probe_widget>(200, 0);
+    auto label = std::make_shared<probe_label>(300, 0);
+    root->add_child(probe1);
+    root->add_child(probe2);
+    root->add_child(probe3);
+    root->add_child(label);
+
+    auto frame = [&]() {
+        for (auto probe : {probe1, probe2, probe3})
+            probe->render_count = 0;
+        label->render_count = 0;
+        return target.frame(16.67f);
+    };
+
+    std::cout << "Damage Region Test Results:" << std::endl;
+
+    auto damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{-2, -2, 404, 54},
+          "first frame damages every widget");
+    check(probe1->render_count == 1 && probe2->render_count == 1 &&
+              probe3->render_count == 1 && label->render_count == 1,
+          "first frame draws every widget");
+
+    damage = frame();
+    check(damage.empty(), "nothing changed, nothing damaged");
+    check(probe1->render_count == 0 && probe2->render_count == 0 &&
+              probe3->render_count == 0 && label->render_count == 0,
+          "nothing changed, nothing drawn");
+
+    label->text = "World";
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{298, -2, 104, 24},
+          "text change of the same size damages the label");
+    check(label->render_count == 1 && probe1->render_count == 0 &&
+              probe2->render_count == 0 && probe3->render_count == 0,
+          "text change of the same size redraws the label");
+
+    label->color.reset_to(1, 0, 0, 1);
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{298, -2, 104, 24},
+          "text color change damages the label");
+
+    probe2->bg_color = nvgRGBAf(1, 0, 0, 1);
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{98, -2, 54, 54},
+          "color change damages only the widget");
+    check(probe1->render_count == 0 && probe2->render_count == 1 &&
+              probe3->render_count == 0,
+          "color change redraws only the widget");
+
+    probe3->y->reset_to(100);
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{198, -2, 54, 154},
+          "move damages the old and the new position");
+    check(probe1->render_count == 0 && probe2->render_count == 0 &&
+              probe3->render_count == 1,
+          "move redraws only the moved widget");
+
+    root->remove_child(probe1);
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{-2, -2, 54, 54},
+          "removal damages the removed widget's area");
+    check(probe2->render_count == 0 && probe3->render_count == 0,
+          "removal redraws nothing else");
+
+    probe2->dying_time = 0;
+    damage = frame();
+    check(!damage.full && damage.bounds == ui::rect{98, -2, 54, 54},
+          "dead children damage their area");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+}
+
+int main() {
+    test_damage_region();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+#include "breeze_ui/display_list.h"
+#include "breeze_ui/draw_list.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Records widgets into display lists and checks that playing them back
+// draws exactly what render() draws, and that cache_commands skips render()
+// while a subtree is unchanged. Drawing goes into a draw_recorder, which
+// keeps what the renderer would get.
+namespace {
+struct box_widget : public ui::widget {
+    NVGcolor color;
+    int render_count = 0;
+    box_widget(float x, float y, float size, NVGcolor color) : color(color) {
+        this->x->reset_to(x);
+        this->y->reset_to(y);
+        width->reset_to(size);
+        height->reset_to(size);
+    }
+    void render(ui::nanovg_context ctx) override {
+        render_count++;
+        ctx.fillColor(color);
+        ctx.fillRoundedRect(*x, *y, *width, *height, 3);
+        ctx.strokeColor(nvgRGBA(0, 0, 0, 255));
+        ctx.strokeWidth(1.5f);
+        ctx.strokeRect(*x, *y, *width, *height);
+        widget::render(ctx);
+    }
+};
+
+bool load_font(NVGcontext *nvg) {
+    auto path = find_font();
+    return !path.empty() && nvgCreateFont(nvg, "main", path.c_str()) >= 0;
+}
+
+// Whether two frames reach the renderer the same way
+bool same_drawing(const ui::draw_list &a, const ui::draw_list &b) {
+    if (a.commands.size() != b.commands.size() ||
+        a.calls.size() != b.calls.size() ||
+        a.vertices.size() != b.vertices.size())
+        return false;
+    for (size_t i = 0; i < a.commands.size(); i++)
+        if (a.commands[i].type != b.commands[i].type)
+            return false;
+    return std::memcmp(a.vertices.data(), b.vertices.data(),
+                       a.vertices.size() * sizeof(NVGvertex)) == 0;
+}
+} // namespace
+
+int main() {
+    constexpr int width = 400, height = 300;
+    ui::draw_list drawn;
+    ui::draw_recorder recorder;
+    recorder.target = &drawn;
+    auto nvg = recorder.create_context(true);
+    bool has_font = load_font(nvg);
+
+    auto &rt = *(new ui::render_target{});
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    auto panel =
+        std::make_shared<box_widget>(10, 10, 120, nvgRGBA(255, 0, 0, 255));
+    std::vector<std::shared_ptr<box_widget>> boxes;
+    for (int i = 0; i < 9; i++) {
+        auto box = std::make_shared<box_widget>(
+            (i % 3) * 35 + 5, (i / 3) * 35 + 5, 25, nvgRGBA(0, 255, 0, 255));
+        panel->add_child(box);
+        boxes.push_back(box);
+    }
+    auto label = std::make_shared<ui::text_widget>();
+    label->text = "Hello, display list";
+    label->font_size = 14;
+    label->y->reset_to(100);
+    if (has_font)
+        panel->add_child(label);
+    rt.root->add_child(panel);
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {width, height, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+    };
+
+    // Same steps as render_target::render, repainting everything. Draws
+    // into drawn, and records the nanovg calls into commands if given.
+    auto frame = [&](ui::display_list *commands = nullptr) {
+        for (auto &box : boxes)
+            box->render_count = 0;
+        panel->render_count = 0;
+        rt.replayed_widgets = 0;
+        rt.animations->tick(ctx.delta_time);
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        rt.damage.clear();
+
+        drawn.clear();
+        ui::nanovg_context vg{nvg, &rt};
+        vg.recording = commands;
+        vg.beginFrame(width, height, 1);
+        vg.scissor(0, 0, width, height);
+        rt.root->render(vg);
+        vg.endFrame();
+    };
+    auto box_renders = [&]() {
+        int count = 0;
+        for (auto &box : boxes)
+            count += box->render_count;
+        return count;
+    };
+
+    std::cout << "Display List Test Results:" << std::endl;
+
+    // What a frame drew can be looked at without a renderer
+    ui::display_list commands;
+    frame(&commands);
+    frame(&commands);
+    commands.clear();
+    frame(&commands);
+    auto count = [&](ui::display_list::op type) {
+        return std::ranges::count_if(commands.commands, [&](auto &c) {
+            return c.type == type;
+        });
+    };
+    using op = ui::display_list::op;
+    check(count(op::fill) == 10 && count(op::stroke) == 10,
+          "every box is recorded as a fill and a stroke");
+    check(count(op::save) == count(op::restore),
+          "saves and restores are balanced");
+    auto first_rect = std::ranges::find_if(
+        commands.commands, [](auto &c) { return c.type == op::rounded_rect; });
+    check(first_rect != commands.commands.end() &&
+              std::ranges::equal(commands.arguments(*first_rect),
+                                 std::vector<float>{10, 10, 120, 120, 3}),
+          "arguments are recorded with the offset applied");
+    if (has_font) {
+        auto run = std::ranges::find_if(
+            commands.commands, [](auto &c) { return c.type == op::text; });
+        check(run != commands.commands.end() &&
+                  commands.text(*run) == "Hello, display list",
+              "text runs keep their string");
+    }
+
+    // Playing the calls back draws the same
+    auto direct = drawn;
+    drawn.clear();
+    nvgBeginFrame(nvg, width, height, 1);
+    nvgScissor(nvg, 0, 0, width, height);
+    commands.replay(nvg);
+    nvgEndFrame(nvg);
+    check(same_drawing(direct, drawn), "a replayed frame draws the same");
+
+    auto capacity = commands.args.capacity();
+    commands.clear();
+    frame(&commands);
+    check(commands.args.capacity() == capacity,
+          "a cleared list reuses its memory");
+
+    // The panel keeps its calls while nothing in it changes
+    panel->cache_commands = true;
+    frame();
+    check(box_renders() == 9 && rt.replayed_widgets == 0,
+          "first frame renders and records the panel");
+    direct = drawn;
+
+    commands.clear();
+    frame(&commands);
+    check(box_renders() == 0 && panel->render_count == 0 &&
+              rt.replayed_widgets == 1,
+          "unchanged panel is played back without render()");
+    check(same_drawing(direct, drawn), "played back panel draws the same");
+    check(count(op::fill) == 10,
+          "played back calls are recorded by an outer recording");
+
+    boxes[4]->color = nvgRGBA(0, 0, 255, 255);
+    boxes[4]->needs_repaint = true;
+    frame();
+    check(box_renders() == 9 && rt.replayed_widgets == 0,
+          "a repainted child records the panel again");
+    frame();
+    check(box_renders() == 0 && rt.replayed_widgets == 1,
+          "and the new calls are played back");
+
+    panel->x->reset_to(200);
+    frame();
+    check(box_renders() == 9, "a moved panel records again");
+    direct = drawn;
+    frame();
+    check(rt.replayed_widgets == 1 && same_drawing(direct, drawn),
+          "at the new position");
+
+    // Frames that repaint part of the window cull inside the panel, what
+    // they draw is not kept
+    boxes[0]->needs_repaint = true;
+    rt.repaint_region = ui::rect{200, 10, 40, 40};
+    frame();
+    rt.repaint_region.reset();
+    check(panel->render_count == 1 && rt.replayed_widgets == 0,
+          "a partial repaint renders the changed panel");
+    frame();
+    check(box_renders() == 9 && rt.replayed_widgets == 0,
+          "and the next full repaint records it");
+
+    nvgDeleteInternal(nvg);
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+#include "breeze_ui/draw_list.h"
+#include "breeze_ui/ui.h"
+#include "test_utils.h"
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks that a frame recorded into a draw_list and replayed reaches the
+// renderer exactly as when drawn directly, and that swap_buffer hands every
+// frame over in order
+namespace {
+// nanovg backend that logs what it is asked to do
+struct logging_backend {
+    std::vector<std::string> log;
+    int next_image = 100;
+    struct texture {
+        int width, height, row_bytes;
+    };
+    std::map<int, texture> textures;
+};
+
+// Joins the parts with spaces
+template <typename... T> std::string entry(const T &...parts) {
+    std::ostringstream s;
+    ((s << parts << ' '), ...);
+    return s.str();
+}
+size_t hash_bytes(const void *data, size_t size) {
+    return std::hash<std::string_view>{}(
+        std::string_view(static_cast<const char *>(data), size));
+}
+std::string describe(const NVGpaint *paint, const NVGscissor *scissor) {
+    return entry("paint", hash_bytes(paint, offsetof(NVGpaint, image)),
+                 "image", paint->image, "scissor",
+                 hash_bytes(scissor, sizeof(*scissor)));
+}
+std::string describe(const NVGpath *paths, int npaths) {
+    std::string s;
+    for (int i = 0; i < npaths; i++) {
+        auto &p = paths[i];
+        s += entry("[", p.nfill,
+                   hash_bytes(p.fill, p.nfill * sizeof(NVGvertex)), p.nstroke,
+                   hash_bytes(p.stroke, p.nstroke * sizeof(NVGvertex)),
+                   p.winding, p.convex, "]");
+    }
+    return s;
+}
+logging_backend &backend(void *uptr) {
+    return *static_cast<logging_backend *>(uptr);
+}
+
+int log_create(void *) { return 1; }
+int log_create_texture(void *uptr, int type, int w, int h, int flags,
+                       const unsigned char *data) {
+    auto &b = backend(uptr);
+    int image = b.next_image++;
+    b.textures[image] = {w, h, w * (type == NVG_TEXTURE_RGBA ? 4 : 1)};
+    b.log.push_back(entry(
+        "create", image, type, w, h, flags,
+        data ? hash_bytes(data, w * h * (type == NVG_TEXTURE_RGBA ? 4 : 1))
+             : 0));
+    return image;
+}
+int log_delete_texture(void *uptr, int image) {
+    backend(uptr).textures.erase(image);
+    backend(uptr).log.push_back(entry("delete", image));
+    return 1;
+}
+int log_update_texture(void *uptr, int image, int x, int y, int w, int h,
+                       const unsigned char *data) {
+    // Like the GL renderer, only the rows of the rectangle are read
+    auto &b = backend(uptr);
+    auto row = b.textures.at(image).row_bytes;
+    b.log.push_back(entry("update", image, x, y, w, h,
+                          hash_bytes(data + y * row, h * row)));
+    return 1;
+}
+int log_get_texture_size(void *uptr, int image, int *w, int *h) {
+    auto &b = backend(uptr);
+    auto it = b.textures.find(image);
+    if (it == b.textures.end())
+        return 0;
+    *w = it->second.width;
+    *h = it->second.height;
+    return 1;
+}
+void log_viewport(void *uptr, float width, float height, float ratio) {
+    backend(uptr).log.push_back(
+        entry("viewport", width, height, ratio));
+}
+void log_cancel(void *uptr) { backend(uptr).log.push_back("cancel"); }
+void log_flush(void *uptr) { backend(uptr).log.push_back("flush"); }
+void log_fill(void *uptr, NVGpaint *paint, NVGcompositeOperationState,
+              NVGscissor *scissor, float fringe, const float *bounds,
+              const NVGpath *paths, int npaths) {
+    backend(uptr).log.push_back(entry("fill", describe(paint, scissor),
+                                      fringe, bounds[0], bounds[1], bounds[2],
+                                      bounds[3], describe(paths, npaths)));
+}
+void log_stroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState,
+                NVGscissor *scissor, float fringe, float width,
+                const NVGpath *paths, int npaths) {
+    backend(uptr).log.push_back(entry("stroke", describe(paint, scissor),
+                                      fringe, width, describe(paths, npaths)));
+}
+void log_triangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState,
+                   NVGscissor *scissor, const NVGvertex *verts, int nverts,
+                   float fringe) {
+    backend(uptr).log.push_back(
+        entry("triangles", describe(paint, scissor), nverts,
+              hash_bytes(verts, nverts * sizeof(NVGvertex)), fringe));
+}
+void log_delete(void *) {}
+
+NVGcontext *create_logging_nvg(logging_backend &b) {
+    NVGparams params{
+        .userPtr = &b,
+        .edgeAntiAlias = 1,
+        .renderCreate = log_create,
+        .renderCreateTexture = log_create_texture,
+        .renderDeleteTexture = log_delete_texture,
+        .renderUpdateTexture = log_update_texture,
+        .renderGetTextureSize = log_get_texture_size,
+        .renderViewport = log_viewport,
+        .renderCancel = log_cancel,
+        .renderFlush = log_flush,
+        .renderFill = log_fill,
+        .renderStroke = log_stroke,
+        .renderTriangles = log_triangles,
+        .renderDelete = log_delete,
+    };
+    return nvgCreateInternal(&params);
+}
+
+bool load_font(NVGcontext *nvg) {
+    auto path = find_font();
+    return !path.empty() && nvgCreateFont(nvg, "main", path.c_str()) >= 0;
+}
+
+// A frame with the kinds of calls widgets make, changing with frame
+void draw_scene(NVGcontext *vg, int frame, int &image, bool has_font) {
+    nvgBeginFrame(vg, 800, 600, 1.5f);
+    nvgScale(vg, 1.5f, 1.5f);
+    nvgScissor(vg, 10, 10, 500, 380);
+
+    nvgBeginPath(vg);
+    nvgRoundedRect(vg, 20 + frame, 20, 200, 120, 8);
+    nvgFillPaint(vg, nvgLinearGradient(vg, 20, 20, 220, 140,
+                                       nvgRGBA(255, 0, 0, 255),
+                                       nvgRGBA(0, 0, 255, 128)));
+    nvgFill(vg);
+
+    nvgBeginPath(vg);
+    nvgCircle(vg, 300, 200, 40 + frame);
+    nvgStrokeWidth(vg, 3);
+    nvgStrokeColor(vg, nvgRGBA(0, 255, 0, 255));
+    nvgStroke(vg);
+
+    std::vector<unsigned char> pixels(16 * 16 * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (unsigned char)(i * 7 + frame);
+    if (!image)
+        image = nvgCreateImageRGBA(vg, 16, 16, 0, pixels.data());
+    else
+        nvgUpdateImage(vg, image, pixels.data());
+    nvgBeginPath(vg);
+    nvgRect(vg, 50, 200, 64, 64);
+    nvgFillPaint(vg, nvgImagePattern(vg, 50, 200, 64, 64, 0, image, 0.8f));
+    nvgFill(vg);
+
+    if (has_font) {
+        nvgFontFace(vg, "main");
+        nvgFontSize(vg, 14 + frame);
+        nvgFillColor(vg, nvgRGBA(255, 255, 255, 255));
+        nvgText(vg, 40, 320, ("Frame " + std::to_string(frame)).c_str(),
+                nullptr);
+    }
+    nvgEndFrame(vg);
+}
+
+void test_replay() {
+    logging_backend direct_log, replay_log;
+    // The presenting context takes the first id for an atlas of its own
+    direct_log.next_image++;
+    auto direct = create_logging_nvg(direct_log);
+    auto presenter = create_logging_nvg(replay_log);
+    ui::draw_replayer replayer(nvgInternalParams(presenter));
+
+    ui::draw_list list;
+    ui::draw_recorder recorder;
+    recorder.target = &list;
+    replay_log.log.clear();
+    auto recorded = recorder.create_context(true);
+    // The font atlas is created with the context
+    replayer.replay(list);
+    check(replay_log.log == direct_log.log,
+          "the context is created the same way");
+    direct_log.log.clear();
+
+    bool has_font = load_font(direct) && load_font(recorded);
+    if (!has_font)
+        std::cout << "No font found, drawing without text" << std::endl;
+
+    int direct_image = 0, recorded_image = 0;
+    size_t capacity = 0;
+    for (int frame = 0; frame < 4; frame++) {
+        direct_log.log.clear();
+        draw_scene(direct, frame, direct_image, has_font);
+
+        list.clear();
+        draw_scene(recorded, frame, recorded_image, has_font);
+        check(!list.empty(), "a frame records commands");
+        replay_log.log.clear();
+        replayer.replay(list);
+
+        check(replay_log.log == direct_log.log,
+              "frame " + std::to_string(frame) + " replays like it was drawn");
+        if (frame == 2)
+            capacity = list.vertices.capacity();
+        if (frame == 3)
+            check(list.vertices.capacity() == capacity,
+                  "a cleared list reuses its memory");
+    }
+
+    // A frame that is never presented still has to create its textures
+    list.clear();
+    nvgBeginFrame(recorded, 100, 100, 1);
+    auto extra = nvgCreateImageRGBA(recorded, 4, 4, 0,
+                                    std::vector<unsigned char>(64).data());
+    nvgBeginPath(recorded);
+    nvgRect(recorded, 0, 0, 10, 10);
+    nvgFill(recorded);
+    nvgEndFrame(recorded);
+    list.drop_drawing();
+    replay_log.log.clear();
+    replayer.replay(list);
+    check(replay_log.log.size() == 1 &&
+              replay_log.log[0].starts_with("create"),
+          "drop_drawing keeps only the texture changes");
+    check(extra != 0, "the recorder hands out texture ids");
+
+    nvgDeleteInternal(recorded);
+    nvgDeleteInternal(direct);
+    nvgDeleteInternal(presenter);
+}
+
+void test_swap_buffer() {
+    ui::swap_buffer<int> frames;
+    constexpr int count = 1000;
+    std::atomic<int> released = 0;
+    std::vector<int> seen;
+
+    std::thread consumer([&] {
+        while (auto frame = frames.acquire()) {
+            seen.push_back(*frame);
+            if (seen.size() % 100 == 0)
+                std::this_thread::yield();
+            released = *frame;
+            frames.release();
+        }
+    });
+    bool ahead = false;
+    for (int i = 1; i <= count; i++) {
+        frames.back() = i;
+        if (!frames.publish()) {
+            check(false, "publish succeeds while open");
+            break;
+        }
+        // publish() waited for the frame before to be released
+        if (released < i - 1)
+            ahead = true;
+    }
+    frames.close();
+    consumer.join();
+
+    check(!ahead, "the producer is at most one frame ahead");
+    bool in_order = seen.size() == count;
+    for (int i = 0; in_order && i < count; i++)
+        in_order = seen[i] == i + 1;
+    check(in_order, "every published frame is consumed in order");
+
+    check(frames.acquire() == nullptr, "acquire returns nothing once closed");
+    check(!frames.publish(), "publish fails once closed");
+
+    // Closing wakes a consumer that waits for a frame
+    frames.open();
+    std::thread waiting([&] { check(!frames.acquire(), "woken by close"); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    frames.close();
+    waiting.join();
+
+    // A frame published before closing is kept for the next consumer
+    frames.open();
+    frames.back() = 42;
+    frames.publish();
+    frames.close();
+    frames.open();
+    auto kept = frames.acquire();
+    check(kept && *kept == 42, "an unconsumed frame survives reopening");
+    frames.release();
+}
+} // namespace
+
+int main() {
+    test_replay();
+    test_swap_buffer();
+    std::cout << (test_passed ? "Test PASSED" : "Test FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
@@ -1,7 +1,13 @@
 #include "breeze_ui/widget.h"
 #include "breeze_ui/ui.h"
+#include "test_utils.h"
+#include <cmath>
 #include <iostream>
 
+namespace {
+bool near(float a, float b) { return std::abs(a - b) < 0.01f; }
+} // namespace
+
 // Simple test to verify flex grow functionality
 void test_flex_grow() {
     // Create a horizontal flex container
@@ -79,15 +85,274 @@ void test_flex_grow() {
     std::cout << "Child2 width: " << expected_child2 << std::endl;
     std::cout << "Child3 width: " << expected_child3 << std::endl;
     
-    bool test_passed = 
+    bool passed = 
         std::abs(child1->width->dest() - expected_child1) < 1.0f &&
         std::abs(child2->width->dest() - expected_child2) < 1.0f &&
         std::abs(child3->width->dest() - expected_child3) < 1.0f;
     
-    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    std::cout << "\nTest " << (passed ? "PASSED" : "FAILED") << std::endl;
+    test_passed &= passed;
+}
+
+// Conformance of flex_layout with the flexbox rules it implements
+void test_flex_layout() {
+    using layout = ui::flex_layout;
+    layout l;
+    auto row = [&](float width, float height = NAN) {
+        l.clear();
+        auto n = l.add();
+        l.flags[n] = layout::is_horizontal;
+        l.width[n] = width;
+        l.height[n] = height;
+        return n;
+    };
+    auto item = [&](layout::node parent, float width, float height) {
+        auto n = l.add(parent);
+        l.width[n] = width;
+        l.height[n] = height;
+        return n;
+    };
+
+    std::cout << "\nFlex Layout Conformance:" << std::endl;
+
+    auto r = row(200);
+    auto a = item(r, 200, 10), b = item(r, 100, 10);
+    l.shrink[a] = l.shrink[b] = 1;
+    l.compute();
+    check(near(l.out_width[a], 133.33f) && near(l.out_width[b], 66.67f),
+          "shrinking is weighted by the base size");
+
+    r = row(300);
+    a = item(r, 50, 10), b = item(r, 50, 10);
+    l.grow[a] = l.grow[b] = 1;
+    l.max_width[a] = 80;
+    l.compute();
+    check(l.out_width[a] == 80 && l.out_width[b] == 220,
+          "items clamped by their max size give the space to the others");
+
+    r = row(300);
+    a = item(r, 50, 10), b = item(r, 50, 10);
+    l.shrink[a] = l.shrink[b] = 1;
+    l.width[r] = 60;
+    l.min_width[a] = 40;
+    l.compute();
+    check(l.out_width[a] == 40 && l.out_width[b] == 20,
+          "items clamped by their min size are frozen while shrinking");
+
+    r = row(400);
+    a = item(r, 50, 10), b = item(r, 50, 10);
+    l.basis[a] = l.basis[b] = 0;
+    l.grow[a] = 1;
+    l.grow[b] = 3;
+    l.compute();
+    check(l.out_width[a] == 100 && l.out_width[b] == 300,
+          "a basis replaces the size as the starting point");
+
+    r = row(100);
+    l.flags[r] |= layout::is_wrapping;
+    l.gap[r] = 5;
+    layout::node items[5];
+    for (auto &i : items)
+        i = item(r, 30, 10);
+    l.compute();
+    check(l.y[items[2]] == 0 && l.x[items[2]] == 70 && l.y[items[3]] == 15 &&
+              l.x[items[3]] == 0,
+          "items that do not fit wrap to the next line");
+    check(l.out_height[r] == 25,
+          "the container is as high as its lines and the gap between them");
+
+    r = row(NAN);
+    l.flags[r] |= layout::is_wrapping;
+    l.max_width[r] = 70;
+    for (auto &i : items)
+        i = item(r, 30, 10);
+    l.compute();
+    check(l.out_width[r] == 60 && l.out_height[r] == 30,
+          "auto sized containers wrap at their max size");
+
+    r = row(200);
+    a = item(r, 20, 10), b = item(r, 20, 10);
+    auto c = item(r, 20, 10);
+    l.justify_content[r] = layout::justify::space_between;
+    l.compute();
+    check(l.x[a] == 0 && l.x[b] == 90 && l.x[c] == 180, "space_between");
+    l.justify_content[r] = layout::justify::space_evenly;
+    l.compute();
+    check(l.x[a] == 35 && l.x[b] == 90 && l.x[c] == 145, "space_evenly");
+    l.justify_content[r] = layout::justify::center;
+    l.compute();
+    check(l.x[a] == 70, "center");
+    l.width[r] = 40;
+    l.justify_content[r] = layout::justify::space_between;
+    l.compute();
+    check(l.x[a] == 0 && l.x[b] == 20,
+          "overflowing space_between falls back to start");
+
+    r = row(200, 50);
+    a = item(r, 20, 10), b = item(r, 20, 10);
+    l.flags[r] |= layout::is_reversed;
+    l.align_items[r] = layout::align::center;
+    l.compute();
+    check(l.x[b] == 0 && l.x[a] == 20, "reverse lays out last to first");
+    check(l.y[a] == 20, "align center");
+    l.align_items[r] = layout::align::end;
+    l.compute();
+    check(l.y[a] == 40, "align end");
+    l.align_items[r] = layout::align::stretch;
+    l.max_height[b] = 30;
+    l.compute();
+    check(l.out_height[a] == 50 && l.out_height[b] == 30,
+          "stretching respects the max size");
+    l.align_items[r] = layout::align::free;
+    l.compute();
+    check(std::isnan(l.y[a]), "align free leaves the cross position alone");
+
+    r = row(200);
+    a = item(r, 20, 10), b = item(r, 20, 10);
+    c = item(r, 0, 0);
+    l.flags[c] = layout::is_spacer;
+    l.grow[a] = 1;
+    l.compute();
+    check(l.out_width[c] == 160 && l.out_width[a] == 20,
+          "spacers take the free space before anything grows");
+
+    // Column stretching its rows, whose items grow into the stretched width
+    l.clear();
+    auto column = l.add();
+    l.width[column] = 300;
+    l.height[column] = NAN;
+    l.align_items[column] = layout::align::stretch;
+    l.padding_left[column] = l.padding_right[column] = 10;
+    auto inner = l.add(column);
+    l.width[inner] = l.height[inner] = NAN;
+    l.flags[inner] = layout::is_horizontal;
+    a = item(inner, 20, 10), b = item(inner, 20, 30);
+    l.grow[a] = 1;
+    l.compute();
+    check(l.out_width[inner] == 280 && l.x[inner] == 10,
+          "nested containers are stretched");
+    check(l.out_width[a] == 260 && l.x[b] == 260,
+          "their children grow into the stretched size");
+    check(l.out_height[column] == 30, "the column fits its rows");
+
+    auto data = l.x.data();
+    auto capacity = l.x.capacity();
+    l.clear();
+    for (int i = 0; i < 5; i++)
+        l.add(i ? 0 : layout::none);
+    l.compute();
+    check(l.x.data() == data && l.x.capacity() == capacity,
+          "laying out again reuses the memory");
+}
+
+// flex_widget options that are passed on to flex_layout
+void test_flex_widget_wrap() {
+    auto container = std::make_shared<ui::flex_widget>();
+    container->horizontal = true;
+    container->wrap = true;
+    container->auto_size = false;
+    container->width->reset_to(100);
+    container->height->reset_to(100);
+    container->gap = 10;
+    std::vector<std::shared_ptr<ui::widget>> children;
+    for (int i = 0; i < 3; i++) {
+        auto child = std::make_shared<ui::widget>();
+        child->width->reset_to(40);
+        child->height->reset_to(20);
+        container->add_child(child);
+        children.push_back(child);
+    }
+    children[2]->flex_basis = 60;
+    children[2]->size_limits.max_height = 15;
+    container->align_items = ui::flex_widget::align::stretch;
+
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = 0,
+        .mouse_y = 0,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = *(new bool{false}),
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = *(new ui::render_target{}),
+        .vg = {}
+    };
+    container->update(ctx);
+
+    std::cout << "\nFlex Widget Wrap:" << std::endl;
+    check(children[1]->x->dest() == 50 && children[2]->x->dest() == 0,
+          "children wrap to a new line");
+    check(children[2]->width->dest() == 60,
+          "the basis is used as the main size");
+    // Lines of 20 and 15 share the 45 left over, the second one starts at
+    // 20 + 22.5 + 10
+    check(children[2]->y->dest() == 57 && children[2]->height->dest() == 15,
+          "lines share the cross size and respect the max size");
+}
+
+// Nested flex_widgets are laid out together with the outermost one
+void test_flex_widget_nested() {
+    auto root = std::make_shared<ui::flex_widget>();
+    root->auto_size = false;
+    root->width->reset_to(300);
+    root->height->reset_to(200);
+    auto row = root->emplace_child<ui::flex_widget>();
+    row->horizontal = true;
+    row->gap = 5;
+    auto leaf = [](ui::widget &parent, float width, float height) {
+        auto child = parent.emplace_child<ui::widget>();
+        child->width->reset_to(width);
+        child->height->reset_to(height);
+        return child;
+    };
+    leaf(*row, 50, 20);
+    auto grown = leaf(*row, 30, 10);
+    grown->flex_grow = 1;
+    auto column = row->emplace_child<ui::flex_widget>();
+    leaf(*column, 40, 10);
+    auto second = leaf(*column, 40, 10);
+
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = 0,
+        .mouse_y = 0,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = *(new bool{false}),
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = *(new ui::render_target{}),
+        .vg = {}
+    };
+    root->update(ctx);
+
+    std::cout << "\nFlex Widget Nested:" << std::endl;
+    check(row->width->dest() == 130 && row->height->dest() == 20,
+          "containers take the size of their children");
+    check(grown->width->dest() == 30 && column->x->dest() == 90,
+          "nothing grows in an auto sized row");
+    check(second->y->dest() == 10 && column->height->dest() == 20,
+          "the inner column is laid out");
 }
 
 int main() {
     test_flex_grow();
-    return 0;
+    test_flex_layout();
+    test_flex_widget_wrap();
+    test_flex_widget_nested();
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    return test_passed ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "breeze_ui/flex_layout.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Lays out a 10k-node tree of 100 rows with 99 items each, once through
+// flex_widget and once as a flat flex_layout.
+namespace {
+constexpr int row_count = 100;
+constexpr int items_per_row = 99;
+constexpr int rounds = 50;
+
+using bench_clock = std::chrono::steady_clock;
+double ms_since(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() -
+                                                     start)
+        .count();
+}
+
+float item_width(int i) { return 5.f + i % 7; }
+float item_height(int i) { return 10.f + i % 5; }
+
+// Layout through the widget tree: every leaf invalidated, then one update
+void run_widgets() {
+    auto &rt = *(new ui::render_target{});
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {},
+    };
+
+    auto root = std::make_shared<ui::flex_widget>();
+    root->auto_size = false;
+    root->width->reset_to(1000);
+    root->height->reset_to(4000);
+    root->align_items = ui::flex_widget::align::stretch;
+    std::vector<ui::widget *> leaves;
+    for (int r = 0; r < row_count; r++) {
+        auto row = root->emplace_child<ui::flex_widget>();
+        row->horizontal = true;
+        row->gap = 1;
+        row->justify_content = ui::flex_widget::justify::center;
+        for (int i = 0; i < items_per_row; i++) {
+            auto leaf = row->emplace_child<ui::widget>();
+            leaf->width->reset_to(item_width(i));
+            leaf->height->reset_to(item_height(i));
+            leaf->flex_grow = i % 3 == 0;
+            leaves.push_back(leaf.get());
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        rt.animations->tick(ctx.delta_time);
+        root->update(ctx);
+    }
+
+    auto start = bench_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (auto leaf : leaves)
+            leaf->invalidate_layout();
+        root->update(ctx);
+    }
+    auto update_ms = ms_since(start) / rounds;
+
+    start = bench_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        root->reposition_children_flex(ctx, root->children);
+        for (auto &row : root->children)
+            static_cast<ui::flex_widget *>(row.get())
+                ->reposition_children_flex(ctx, row->children);
+    }
+    auto reposition_ms = ms_since(start) / rounds;
+
+    std::cout << "flex_widget: relayout " << update_ms
+              << " ms, reposition_children_flex " << reposition_ms << " ms"
+              << std::endl;
+}
+
+void build(ui::flex_layout &l) {
+    l.clear();
+    auto root = l.add();
+    l.width[root] = 1000;
+    l.height[root] = 4000;
+    l.align_items[root] = ui::flex_layout::align::stretch;
+    auto rows = l.add(root, row_count);
+    for (int r = 0; r < row_count; r++) {
+        auto row = rows + r;
+        l.width[row] = l.height[row] = NAN;
+        l.flags[row] = ui::flex_layout::is_horizontal;
+        l.gap[row] = 1;
+        l.justify_content[row] = ui::flex_layout::justify::center;
+    }
+    // Rows first, then their items, so that each row's children are
+    // added after it
+    for (int r = 0; r < row_count; r++) {
+        auto items = l.add(rows + r, items_per_row);
+        for (int i = 0; i < items_per_row; i++) {
+            auto n = items + i;
+            l.width[n] = item_width(i);
+            l.height[n] = item_height(i);
+            l.grow[n] = i % 3 == 0;
+        }
+    }
+}
+
+void run_flat() {
+    ui::flex_layout l;
+    build(l);
+    l.compute();
+
+    auto start = bench_clock::now();
+    for (int i = 0; i < rounds; i++)
+        l.compute();
+    auto compute_ms = ms_since(start) / rounds;
+
+    start = bench_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        build(l);
+        l.compute();
+    }
+    auto build_ms = ms_since(start) / rounds;
+
+    float checksum = 0;
+    for (size_t n = 0; n < l.size(); n++)
+        checksum += l.x[n] + l.y[n];
+    std::cout << "flex_layout: compute " << compute_ms
+              << " ms, build and compute " << build_ms << " ms (checksum "
+              << checksum << ")" << std::endl;
+}
+} // namespace
+
+int main() {
+    std::cout << "Flex layout benchmark, "
+              << 1 + row_count * (items_per_row + 1) << " nodes" << std::endl;
+    for (int i = 0; i < 3; i++) {
+        run_widgets();
+        run_flat();
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "breeze_ui/font.h"
+#include "nanovg.h"
+#include "test_utils.h"
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks that font face handles resolve to the faces resolve_font_face_name
+// picks, keep them while the registry stays the same, resolve again when
+// it changes, and can be used from many threads at once. Faces that are
+// not loaded are looked up again once fonts are loaded.
+namespace {
+bool register_main(NVGcontext *nvg, const std::string &regular,
+                   const std::string &bold) {
+    return ui::register_font_family(
+        nvg, {.family_name = "main",
+              .faces = {{.weight = 400, .source = {.path = regular}},
+                        {.weight = 700, .source = {.path = bold}}}});
+}
+
+int expected_id(NVGcontext *nvg, const char *family, int weight) {
+    return nvgFindFont(nvg,
+                       ui::resolve_font_face_name(nvg, family, weight).c_str());
+}
+} // namespace
+
+int main() {
+    auto regular = find_font(
+        {"C:/Windows/Fonts/segoeui.ttf",
+         "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"});
+    auto bold = find_font(
+        {"C:/Windows/Fonts/segoeuib.ttf",
+         "/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf"});
+    if (regular.empty()) {
+        std::cout << "No font found, skipped" << std::endl;
+        std::cout << "Test PASSED" << std::endl;
+        return 0;
+    }
+    if (bold.empty())
+        bold = regular;
+
+    bool ok = true;
+    auto nvg = nvgCreateMeasureContext();
+    register_main(nvg, regular, bold);
+
+    ui::font_face_handle face;
+    auto id = ui::resolve_font_face(face, nvg, "main", 400);
+    if (id < 0 || id != expected_id(nvg, "main", 400)) {
+        std::cout << "FAILED: resolved main to " << id << std::endl;
+        ok = false;
+    }
+    auto generation = face.generation;
+    if (ui::resolve_font_face(face, nvg, "main", 400) != id ||
+        face.generation != generation) {
+        std::cout << "FAILED: same face resolved again" << std::endl;
+        ok = false;
+    }
+    auto bold_id = ui::resolve_font_face(face, nvg, "main", 700);
+    if (bold_id != expected_id(nvg, "main", 700)) {
+        std::cout << "FAILED: bold resolved to " << bold_id << std::endl;
+        ok = false;
+    }
+
+    // Registering fonts can pick another face
+    ui::register_font_family(
+        nvg, {.family_name = "other",
+              .faces = {{.weight = 400, .source = {.path = regular}}}});
+    ui::resolve_font_face(face, nvg, "main", 700);
+    if (face.generation == generation ||
+        face.generation != ui::font_registry_generation()) {
+        std::cout << "FAILED: handle kept generation " << face.generation
+                  << " after registering fonts" << std::endl;
+        ok = false;
+    }
+
+    // Faces that are not loaded are found once they are
+    ui::font_face_handle late;
+    if (ui::resolve_font_face(late, nvg, "late") != -1) {
+        std::cout << "FAILED: resolved a face that is not loaded" << std::endl;
+        ok = false;
+    }
+    if (ui::resolve_font_face(late, nvg, "late") != -1 ||
+        late.font_count != nvgFontCount(nvg) ||
+        late.generation != ui::font_registry_generation()) {
+        std::cout << "FAILED: face that is not loaded resolved again"
+                  << std::endl;
+        ok = false;
+    }
+    auto late_id = nvgCreateFont(nvg, "late", regular.c_str());
+    if (ui::resolve_font_face(late, nvg, "late") != late_id) {
+        std::cout << "FAILED: face loaded later was not found" << std::endl;
+        ok = false;
+    }
+
+    // Threads with their own contexts resolve while fonts are registered
+    constexpr int threads = 4;
+    std::vector<NVGcontext *> contexts;
+    for (int i = 0; i < threads; i++) {
+        contexts.push_back(nvgCreateMeasureContext());
+        register_main(contexts.back(), regular, bold);
+    }
+    std::atomic<int> wrong = 0;
+    std::atomic<bool> done = false;
+    std::vector<std::jthread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&, nvg = contexts[i]] {
+            ui::font_face_handle regular_face, bold_face;
+            auto regular_id = expected_id(nvg, "main", 400);
+            auto bold_id = expected_id(nvg, "main", 700);
+            for (int j = 0; j < 200000; j++) {
+                if (ui::resolve_font_face(regular_face, nvg, "main", 400) !=
+                        regular_id ||
+                    ui::resolve_font_face(bold_face, nvg, "main", 700) !=
+                        bold_id)
+                    wrong++;
+            }
+            done = true;
+        });
+    }
+    for (int i = 0; i < 20 && !done; i++)
+        register_main(nvg, regular, bold);
+    workers.clear();
+    if (wrong) {
+        std::cout << "FAILED: " << wrong << " wrong faces on threads"
+                  << std::endl;
+        ok = false;
+    }
+
+    for (auto context : contexts) {
+        ui::clear_font_registry(context);
+        nvgDeleteInternal(context);
+    }
+    ui::clear_font_registry(nvg);
+    nvgDeleteInternal(nvg);
+
+    std::cout << (ok ? "Test PASSED" : "Test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
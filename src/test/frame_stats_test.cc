@@ -0,0 +1,95 @@
+#include "breeze_ui/frame_stats.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+// Checks the percentiles, histogram and frame counts of frame_stats, and
+// that it can be read while frames are recorded
+int main() {
+    std::cout << "Frame Stats Test Results:" << std::endl;
+
+    ui::frame_stats stats;
+    auto empty = stats.snapshot();
+    check(empty.frames == 0 && empty.window_frames == 0 &&
+              empty.total_ms.p99 == 0,
+          "no frames, no statistics");
+
+    // 1 to 100 ms, every fourth frame repainted
+    for (int i = 1; i <= 100; i++) {
+        stats.record({.interval_ms = 16,
+                      .total_ms = static_cast<float>(i),
+                      .update_ms = i / 2.f,
+                      .render_ms = i / 2.f,
+                      .repainted = i % 4 == 0});
+    }
+    auto summary = stats.snapshot();
+    check(summary.frames == 100 && summary.repainted == 25 &&
+              summary.skipped == 75,
+          "repainted and skipped frames are counted");
+    check(summary.total_ms.p50 >= 50 && summary.total_ms.p50 <= 51,
+          "p50");
+    check(summary.total_ms.p95 >= 95 && summary.total_ms.p95 <= 96,
+          "p95");
+    check(summary.total_ms.p99 >= 99 && summary.total_ms.p99 <= 100,
+          "p99");
+    check(summary.total_ms.max == 100, "max");
+    check(summary.update_ms.max == 50 && summary.interval_ms.p99 == 16,
+          "each time has its own percentiles");
+    // Bounds 2, 4, 8, 12, 16.7, 33.4, 50, 100
+    check(summary.histogram[0] == 2 && summary.histogram[1] == 2 &&
+              summary.histogram[2] == 4 && summary.histogram[3] == 4 &&
+              summary.histogram[4] == 4 && summary.histogram[5] == 17 &&
+              summary.histogram[6] == 17 && summary.histogram[7] == 50 &&
+              summary.histogram[8] == 0,
+          "frames are counted into the histogram");
+
+    for (int i = 0; i < 1000; i++)
+        stats.record({.total_ms = 1});
+    summary = stats.snapshot();
+    check(summary.frames == 1100 &&
+              summary.window_frames == ui::frame_stats::window,
+          "percentiles cover the last frames only");
+    check(summary.total_ms.max == 1, "older frames drop out");
+
+    // Frames of a headless target, the first one and one with a widget to
+    // repaint draw
+    ui::headless_target target(200, 100);
+    auto child = target.rt.root->emplace_child<ui::widget>();
+    child->width->reset_to(10);
+    child->height->reset_to(10);
+    for (int i = 0; i < 10; i++) {
+        if (i == 5)
+            child->needs_repaint = true;
+        target.frame(20);
+    }
+    summary = target.rt.stats.snapshot();
+    check(summary.frames == 10 && summary.repainted == 2 &&
+              summary.skipped == 8,
+          "render targets count the frames they skip");
+    check(summary.interval_ms.p50 == 20, "and record the frame interval");
+
+    // Read from another thread while frames are recorded
+    std::atomic<bool> done = false, consistent = true;
+    std::thread reader([&] {
+        while (!done) {
+            auto s = target.rt.stats.snapshot();
+            if (s.window_frames > ui::frame_stats::window ||
+                s.repainted + s.skipped != s.frames ||
+                s.total_ms.p50 > s.total_ms.p99 ||
+                s.total_ms.p99 > s.total_ms.max)
+                consistent = false;
+        }
+    });
+    for (int i = 0; i < 2000; i++)
+        target.frame();
+    done = true;
+    reader.join();
+    check(consistent, "snapshots taken during frames are consistent");
+    check(target.rt.stats.snapshot().frames == 2010, "no frame is lost");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
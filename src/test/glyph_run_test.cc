@@ -0,0 +1,129 @@
+#include "breeze_ui/font.h"
+#include "breeze_ui/glyph_run.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/nanovg_wrapper.h"
+#include "test_utils.h"
+#include <iostream>
+#include <vector>
+
+// Checks that a glyph run draws the vertices nvgText and nvgTextBox draw,
+// moves them without laying the glyphs out again, and lays them out again
+// when the text, the style or the font atlas change
+namespace {
+std::vector<NVGvertex> drawn;
+
+void keep_triangles(void *, NVGpaint *, NVGcompositeOperationState,
+                    NVGscissor *, const NVGvertex *verts, int nverts, float) {
+    drawn.insert(drawn.end(), verts, verts + nverts);
+}
+
+// Draws nothing and keeps the text vertices
+NVGcontext *create_keeping_nvg() {
+    auto params = ui::null_nvg_params();
+    params.renderTriangles = keep_triangles;
+    return nvgCreateInternal(&params);
+}
+
+bool load_font(NVGcontext *nvg) {
+    auto path = find_font();
+    return !path.empty() &&
+           ui::register_font_family(
+               nvg, {.family_name = "main",
+                     .faces = {{.weight = 400, .source = {.path = path}}}});
+}
+
+bool same_vertices(const std::vector<NVGvertex> &a,
+                   const std::vector<NVGvertex> &b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].u != b[i].u ||
+            a[i].v != b[i].v)
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+int main() {
+    auto nvg = create_keeping_nvg();
+    if (!load_font(nvg)) {
+        std::cout << "No font found, skipped" << std::endl;
+        std::cout << "Test PASSED" << std::endl;
+        nvgDeleteInternal(nvg);
+        return 0;
+    }
+    bool ok = true;
+    ui::nanovg_context vg{nvg, nullptr};
+    nvgBeginFrame(nvg, 800, 600, 1);
+    vg.fontFace(ui::resolve_font_face_name(nvg, "main").c_str());
+    vg.fontSize(14);
+    vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+
+    const char *text = "Glyph runs draw the quick brown fox again";
+    ui::glyph_run run;
+    auto compare = [&](const char *what, float x, float y, float wrap) {
+        drawn.clear();
+        if (wrap < 0)
+            nvgText(nvg, x, y, text, nullptr);
+        else
+            nvgTextBox(nvg, x, y, wrap, text, nullptr);
+        auto expected = drawn;
+        drawn.clear();
+        run.draw(vg, x, y, text, wrap);
+        if (expected.empty() || !same_vertices(expected, drawn)) {
+            std::cout << "FAILED: " << what << " drew " << drawn.size()
+                      << " vertices, nanovg " << expected.size() << std::endl;
+            ok = false;
+        }
+    };
+
+    compare("line", 10, 20, -1);
+    compare("moved line", 30, 45, -1);
+    if (run.layouts != 1 || run.quads().empty()) {
+        std::cout << "FAILED: moving the line laid it out " << run.layouts
+                  << " times" << std::endl;
+        ok = false;
+    }
+
+    // Another wrap width, alignment or size is another layout
+    compare("box", 10, 20, 120);
+    vg.textAlign(NVG_ALIGN_TOP | NVG_ALIGN_CENTER);
+    compare("centered box", 10, 20, 120);
+    vg.fontSize(20);
+    compare("larger box", 5, 5, 120);
+    if (run.layouts != 4) {
+        std::cout << "FAILED: " << run.layouts
+                  << " layouts after changing the style" << std::endl;
+        ok = false;
+    }
+
+    // A reset atlas no longer has the glyphs where they were
+    vg.fonsResetAtlas();
+    compare("box after atlas reset", 5, 5, 120);
+    if (run.layouts != 5) {
+        std::cout << "FAILED: atlas reset left " << run.layouts
+                  << " layouts" << std::endl;
+        ok = false;
+    }
+
+    // Recorded like textBox, so cached commands replay the same text
+    ui::display_list list;
+    vg.recording = &list;
+    run.draw(vg, 5, 5, text, 120);
+    vg.recording = nullptr;
+    if (list.size() != 1 ||
+        list.commands[0].type != ui::display_list::op::text_box ||
+        list.text(list.commands[0]) != text) {
+        std::cout << "FAILED: glyph run recorded " << list.size()
+                  << " commands" << std::endl;
+        ok = false;
+    }
+
+    nvgEndFrame(nvg);
+    ui::clear_font_registry(nvg);
+    nvgDeleteInternal(nvg);
+
+    std::cout << (ok ? "Test PASSED" : "Test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
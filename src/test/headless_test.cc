@@ -0,0 +1,144 @@
+#include "breeze_ui/display_list.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Drives a widget tree through headless_target with injected input and
+// time. Needs no window, GL or display.
+namespace {
+struct probe_widget : public ui::widget {
+    int clicks = 0, renders = 0;
+    bool key_pressed = false, key_down = false;
+    std::u32string text;
+    // Events of the last frame, keys as their GLFW key and text as itself
+    std::vector<int> events;
+    probe_widget() {
+        x->reset_to(50);
+        y->reset_to(50);
+        width->reset_to(100);
+        height->reset_to(40);
+    }
+    void update(ui::update_context &ctx) override {
+        widget::update(ctx);
+        if (ctx.mouse_clicked_on(this))
+            clicks++;
+        key_pressed = ctx.key_pressed(GLFW_KEY_A);
+        key_down = ctx.key_down(GLFW_KEY_A);
+        text += ctx.text_input();
+        events.clear();
+        for (const auto &event : ctx.input_events()) {
+            events.push_back(event.type == ui::input_event::kind::key
+                                 ? event.key
+                                 : static_cast<int>(event.codepoint));
+        }
+    }
+    void render(ui::nanovg_context ctx) override {
+        renders++;
+        ctx.fillColor(nvgRGBA(0, 128, 255, 255));
+        ctx.fillRect(*x, *y, *width, *height);
+        widget::render(ctx);
+    }
+};
+} // namespace
+
+int main() {
+    ui::headless_target target(400, 300, 1.5f);
+    auto probe = std::make_shared<probe_widget>();
+    target.rt.root->add_child(probe);
+
+    std::cout << "Headless Target Test Results:" << std::endl;
+
+    auto damage = target.frame();
+    check(!damage.empty() && probe->renders == 1,
+          "first frame updates and renders the tree");
+    damage = target.frame();
+    check(damage.empty() && probe->renders == 1,
+          "an unchanged tree is not repainted");
+
+    // Mouse
+    target.mouse_x = 60;
+    target.mouse_y = 60;
+    target.mouse_down = true;
+    target.frame();
+    target.frame();
+    target.mouse_down = false;
+    target.frame();
+    check(probe->clicks == 1, "an injected press clicks the widget once");
+    target.mouse_x = 300;
+    target.mouse_down = true;
+    target.frame();
+    target.mouse_down = false;
+    target.frame();
+    check(probe->clicks == 1, "a press elsewhere does not");
+
+    // Keys and text
+    target.key_press(GLFW_KEY_A);
+    target.type(U"hi");
+    target.frame();
+    check(probe->key_pressed && probe->key_down, "a key press is seen");
+    check(probe->text == U"hi", "typed text is seen");
+    target.frame();
+    check(!probe->key_pressed && probe->key_down,
+          "the press lasts one frame, the key stays down");
+    target.key_release(GLFW_KEY_A);
+    target.frame();
+    check(!probe->key_down, "a released key is up");
+    target.key_press(GLFW_KEY_LEFT_SHIFT);
+    target.type(U"b");
+    target.key_press(GLFW_KEY_C);
+    target.key_release(GLFW_KEY_C);
+    target.frame();
+    check(probe->events == std::vector<int>{GLFW_KEY_LEFT_SHIFT, 'b',
+                                            GLFW_KEY_C, GLFW_KEY_C},
+          "key and text events keep their order");
+    check(target.rt.input_events.back().mods == GLFW_MOD_SHIFT,
+          "key events have the modifiers held");
+    target.key_release(GLFW_KEY_LEFT_SHIFT);
+    target.frame();
+
+    // Time
+    probe->x->set_easing(ui::easing_type::linear);
+    probe->x->animate_to(150);
+    target.frame(100);
+    float halfway = *probe->x;
+    check(halfway > 50 && halfway < 150,
+          "animations advance by the injected time");
+    damage = target.frame(100);
+    check(**probe->x == 150, "and finish after their duration");
+    check(!damage.empty() && !damage.full,
+          "a moved widget repaints only its area");
+
+    // What a frame drew
+    ui::display_list commands;
+    target.recording = &commands;
+    probe->needs_repaint = true;
+    target.frame();
+    target.recording = nullptr;
+    auto fills = std::ranges::count_if(commands.commands, [](auto &c) {
+        return c.type == ui::display_list::op::fill;
+    });
+    check(fills == 1, "recorded frames can be inspected");
+    auto rect = std::ranges::find_if(commands.commands, [](auto &c) {
+        return c.type == ui::display_list::op::rect;
+    });
+    check(rect != commands.commands.end() &&
+              commands.arguments(*rect)[0] == 150,
+          "at the position the widget moved to");
+
+    // Tasks posted from other threads run in the next frame
+    std::atomic<bool> ran = false;
+    std::thread([&] {
+        target.rt.post_loop_thread_task([&] { ran = true; });
+    }).join();
+    check(!ran, "a posted task waits for the frame");
+    target.frame();
+    check(ran, "and runs in it");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
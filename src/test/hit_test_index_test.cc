@@ -0,0 +1,147 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+
+// Checks that hovered() answers from the hit-test index the same way a
+// direct hit test would
+namespace {
+int check_hit_calls = 0;
+struct probe_widget : public ui::widget {
+    bool was_hovered = false;
+    bool claim = false;
+    probe_widget(float x, float y, float width, float height) {
+        this->x->reset_to(x);
+        this->y->reset_to(y);
+        this->width->reset_to(width);
+        this->height->reset_to(height);
+    }
+    void update(ui::update_context &ctx) override {
+        widget::update(ctx);
+        was_hovered = claim ? ctx.hovered_hit(this) : ctx.hovered(this);
+    }
+    bool check_hit(const ui::update_context &ctx) override {
+        check_hit_calls++;
+        return widget::check_hit(ctx);
+    }
+};
+// Only hit in its left half, like a widget with a shape of its own
+struct half_widget : public probe_widget {
+    using probe_widget::probe_widget;
+    bool check_hit(const ui::update_context &ctx) override {
+        return probe_widget::check_hit(ctx) &&
+               ctx.mouse_x < ctx.offset_x + *x + *width / 2;
+    }
+};
+// Claims the hover before its children are updated, like a container
+struct claiming_widget : public probe_widget {
+    using probe_widget::probe_widget;
+    void update(ui::update_context &ctx) override {
+        was_hovered = ctx.hovered_hit(this);
+        widget::update(ctx);
+    }
+};
+} // namespace
+
+void test_hit_test_index() {
+    ui::headless_target target(800, 600);
+    auto &rt = target.rt;
+
+    // A column of rows, each with a button-like child
+    std::vector<std::shared_ptr<probe_widget>> rows, buttons;
+    for (int i = 0; i < 1000; i++) {
+        auto row = std::make_shared<probe_widget>(0, i * 20, 300, 20);
+        auto button = std::make_shared<probe_widget>(250, 2, 40, 16);
+        row->add_child(button);
+        rt.root->add_child(row);
+        rows.push_back(row);
+        buttons.push_back(button);
+    }
+
+    auto frame = [&](float mouse_x, float mouse_y) {
+        check_hit_calls = 0;
+        target.mouse_x = mouse_x;
+        target.mouse_y = mouse_y;
+        target.frame();
+    };
+    auto hovered_rows = [&]() {
+        std::vector<int> result;
+        for (size_t i = 0; i < rows.size(); i++)
+            if (rows[i]->was_hovered)
+                result.push_back(i);
+        return result;
+    };
+
+    std::cout << "Hit Test Index Test Results:" << std::endl;
+
+    frame(10, 105);
+    check(hovered_rows() == std::vector<int>{5},
+          "first frame falls back to direct hit testing");
+
+    frame(10, 105);
+    check(rt.hit_index.hit_count() == 1, "index finds only the row");
+    check(hovered_rows() == std::vector<int>{5}, "index finds the row");
+    check(check_hit_calls == 1, "only the widget the index hits is tested");
+    check(!buttons[5]->was_hovered, "button beside the mouse isn't hovered");
+
+    frame(260, 305);
+    check(rt.hit_index.hit_count() == 2, "index finds row and button");
+    check(hovered_rows() == std::vector<int>{15} && buttons[15]->was_hovered,
+          "both report being hovered");
+
+    // Rows 15 and 16 share the edge at y = 320, like check_hit does
+    frame(10, 320);
+    check((hovered_rows() == std::vector<int>{15, 16}),
+          "edges count as inside");
+
+    // A widget moved under the mouse is found in the same frame
+    rows[900]->y->reset_to(500);
+    frame(10, 510);
+    // The button moved along with its row, row 25 is hit by the index
+    check((hovered_rows() == std::vector<int>{25, 900}) &&
+              check_hit_calls == 3,
+          "moved widget is hit tested directly");
+    frame(10, 510);
+    check((hovered_rows() == std::vector<int>{25, 900}),
+          "moved widget is found by the index afterwards");
+    rows[900]->y->reset_to(900 * 20);
+
+    // The first widget claiming the hover hides the ones updated after it
+    rows[25]->claim = true;
+    frame(10, 510);
+    check(rows[25]->was_hovered && !rows[900]->was_hovered,
+          "claimed hover still hides later widgets");
+    rows[25]->claim = false;
+
+    auto container = std::make_shared<claiming_widget>(400, 0, 100, 100);
+    auto inner = std::make_shared<probe_widget>(10, 10, 20, 20);
+    container->add_child(inner);
+    rt.root->add_child(container);
+    frame(415, 15);
+    frame(415, 15);
+    check(container->was_hovered && inner->was_hovered,
+          "claimed hover covers the children updated after it");
+    rt.root->remove_child(container);
+
+    auto half = std::make_shared<half_widget>(600, 0, 100, 100);
+    rt.root->add_child(half);
+    frame(680, 50);
+    frame(680, 50);
+    bool right_half = half->was_hovered;
+    frame(620, 50);
+    check(!right_half && half->was_hovered,
+          "widgets narrowing check_hit are asked after an index hit");
+    rt.root->remove_child(half);
+
+    frame(-5, -5);
+    check(rt.hit_index.hit_count() == 0 && hovered_rows().empty(),
+          "nothing hovered outside of the window");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+}
+
+int main() {
+    test_hit_test_index();
+    return test_passed ? 0 : 1;
+}
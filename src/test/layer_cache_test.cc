@@ -0,0 +1,203 @@
+#include "GLFW/glfw3.h"
+#include "glad/glad.h"
+
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+
+#define NANOVG_GL3 1
+#include "nanovg_gl.h"
+extern "C" {
+#include "nanovg_gl_utils.h"
+#include "test_utils.h"
+}
+#include <array>
+#include <iostream>
+#include <vector>
+
+// Renders a panel through the layer cache on a hidden window and reads the
+// pixels back. Runs on software GL, e.g. Mesa llvmpipe with
+// LIBGL_ALWAYS_SOFTWARE=1.
+namespace {
+struct box_widget : public ui::widget {
+    NVGcolor color;
+    int render_count = 0;
+    box_widget(float x, float y, float size, NVGcolor color) : color(color) {
+        this->x->reset_to(x);
+        this->y->reset_to(y);
+        width->reset_to(size);
+        height->reset_to(size);
+    }
+    void render(ui::nanovg_context ctx) override {
+        render_count++;
+        ctx.fillColor(color);
+        ctx.fillRect(*x, *y, *width, *height);
+        widget::render(ctx);
+    }
+};
+} // namespace
+
+int main() {
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    auto window = glfwCreateWindow(400, 300, "Layer Cache Test", nullptr,
+                                   nullptr);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    constexpr int width = 400, height = 300;
+    auto nvg = nvgCreateGL3(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+    auto target = nvgluCreateFramebuffer(nvg, width, height, 0);
+
+    auto &rt = *(new ui::render_target{});
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    // A red panel with a grid of green boxes
+    auto panel =
+        std::make_shared<box_widget>(10, 10, 100, nvgRGBA(255, 0, 0, 255));
+    panel->cache_as_layer = true;
+    std::vector<std::shared_ptr<box_widget>> boxes;
+    for (int i = 0; i < 16; i++) {
+        auto box = std::make_shared<box_widget>(
+            (i % 4) * 25 + 5, (i / 4) * 25 + 5, 15, nvgRGBA(0, 255, 0, 255));
+        panel->add_child(box);
+        boxes.push_back(box);
+    }
+    rt.root->add_child(panel);
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {width, height, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+    };
+
+    // Same steps as render_target::render, always repainting everything
+    std::vector<unsigned char> pixels(width * height * 4);
+    auto frame = [&]() {
+        for (auto &box : boxes)
+            box->render_count = 0;
+        rt.animations->tick(ctx.delta_time);
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        rt.damage.clear();
+
+        rt.layers.render_pending(nvg, &rt, 1);
+        nvgluBindFramebuffer(target);
+        glViewport(0, 0, width, height);
+        glClearColor(1, 1, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        ui::nanovg_context vg{nvg, &rt};
+        vg.beginFrame(width, height, 1);
+        rt.root->render(vg);
+        vg.endFrame();
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                     pixels.data());
+        nvgluBindFramebuffer(nullptr);
+    };
+    auto pixel = [&](int x, int y) {
+        auto p = &pixels[((height - 1 - y) * width + x) * 4];
+        return std::array<int, 3>{p[0], p[1], p[2]};
+    };
+    auto box_renders = [&]() {
+        int count = 0;
+        for (auto &box : boxes)
+            count += box->render_count;
+        return count;
+    };
+    using rgb = std::array<int, 3>;
+
+    std::cout << "Layer Cache Test Results:" << std::endl;
+
+    frame();
+    check(rt.layers.stats.misses == 1 && rt.layers.stats.hits == 0,
+          "first frame draws the layer");
+    check(pixel(12, 12) == rgb{255, 0, 0} && pixel(22, 22) == rgb{0, 255, 0},
+          "layer shows the panel and its boxes");
+    check(rt.layers.stats.layer_count == 1 &&
+              rt.layers.stats.texture_bytes == 104 * 104 * 4,
+          "one texture covering the panel and its margin");
+
+    frame();
+    check(rt.layers.stats.hits == 1 && box_renders() == 0,
+          "clean panel is composited without drawing the boxes");
+    check(pixel(22, 22) == rgb{0, 255, 0}, "composited layer looks the same");
+
+    boxes[0]->color = nvgRGBA(0, 0, 255, 255);
+    boxes[0]->needs_repaint = true;
+    frame();
+    check(rt.layers.stats.misses == 2 && pixel(22, 22) == rgb{0, 0, 255},
+          "a repainted child redraws the layer");
+
+    panel->x->reset_to(200);
+    frame();
+    check(rt.layers.stats.misses == 2 && box_renders() == 0,
+          "moving the panel reuses the layer");
+    check(pixel(212, 12) == rgb{255, 0, 0} && pixel(12, 12) == rgb{255, 255, 255},
+          "layer is composited at the new position");
+
+    panel->layer_opacity = 0.5f;
+    frame();
+    auto faded = pixel(212, 12);
+    check(faded[0] == 255 && faded[1] > 100 && faded[1] < 155,
+          "layer is composited with its opacity");
+    panel->layer_opacity = 1;
+
+    // Room for one layer only, the second panel is drawn directly
+    auto second =
+        std::make_shared<box_widget>(10, 150, 100, nvgRGBA(0, 0, 255, 255));
+    second->cache_as_layer = true;
+    rt.root->add_child(second);
+    rt.layers.budget_bytes = 104 * 104 * 4;
+    frame();
+    check(rt.layers.stats.layer_count == 1 &&
+              rt.layers.stats.texture_bytes <= rt.layers.budget_bytes,
+          "budget is kept while both layers are in use");
+    check(pixel(12, 152) == rgb{0, 0, 255} && pixel(212, 12) == rgb{255, 0, 0},
+          "panel without a layer is drawn directly");
+
+    // Once the first panel is gone its layer makes room
+    rt.root->remove_child(panel);
+    panel = nullptr;
+    frame();
+    frame();
+    check(rt.layers.stats.layer_count == 1 && rt.layers.stats.misses == 3,
+          "freed budget goes to the other layer");
+    check(rt.layers.stats.hit_rate() > 0, "hit rate is reported");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+
+    rt.layers.clear();
+    nvgluDeleteFramebuffer(target);
+    nvgDeleteGL3(nvg);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <functional>
+#include <iostream>
+
+// Checks that measurements are cached until the layout is invalidated, so a
+// settled tree measures nothing and a change only measures the changed chain
+namespace {
+constexpr int depth = 6, fan_out = 3;
+
+// Nested rows and columns with 10x10 leaves
+std::shared_ptr<ui::widget> build(int level, size_t &nodes,
+                                  std::vector<ui::widget *> &leaves) {
+    nodes++;
+    if (level == depth) {
+        auto leaf = std::make_shared<ui::widget>();
+        leaf->width->reset_to(10);
+        leaf->height->reset_to(10);
+        leaves.push_back(leaf.get());
+        return leaf;
+    }
+    auto box = std::make_shared<ui::flex_widget>();
+    box->horizontal = level % 2 == 0;
+    box->gap = 2;
+    box->padding_left->reset_to(1);
+    for (int i = 0; i < fan_out; i++)
+        box->add_child(build(level + 1, nodes, leaves));
+    return box;
+}
+
+// Size the tree should have, worked out from the leaves
+std::pair<float, float> expected_size(ui::widget *w) {
+    auto flex = dynamic_cast<ui::flex_widget *>(w);
+    if (!flex)
+        return {w->width->dest(), w->height->dest()};
+    float main = 0, cross = 0;
+    for (auto &child : flex->children) {
+        auto [cw, ch] = expected_size(child.get());
+        main += flex->horizontal ? cw : ch;
+        cross = std::max(cross, flex->horizontal ? ch : cw);
+    }
+    main += (flex->children.size() - 1) * flex->gap;
+    return flex->horizontal ? std::pair{main + 1, cross}
+                            : std::pair{cross + 1, main};
+}
+} // namespace
+
+void test_measure_cache() {
+    auto &rt = *(new ui::render_target{});
+    auto nvg = ui::create_null_nvg();
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    size_t nodes = 0;
+    std::vector<ui::widget *> leaves;
+    auto tree = build(0, nodes, leaves);
+    rt.root->add_child(tree);
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+        .clip = ui::rect{0, 0, 800, 600},
+    };
+
+    // Same update steps as render_target::render, returns the measure calls
+    auto frame = [&]() {
+        rt.measure_calls = 0;
+        rt.animations->tick(ctx.delta_time);
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        rt.damage.clear();
+        return rt.measure_calls;
+    };
+    // Until the layout and the size animations have settled
+    auto settle = [&]() {
+        size_t calls = 0;
+        for (int i = 0; i < 30; i++)
+            calls += frame();
+        return calls;
+    };
+
+    std::cout << "Measure Cache Test Results:" << std::endl;
+
+    auto first = frame();
+    std::cout << "  " << nodes << " widgets, " << first
+              << " measure calls in the first frame" << std::endl;
+    // Nothing measures the top of the tree
+    check(first == nodes - 1,
+          "the first frame measures every widget once for both sizes");
+
+    settle();
+    check(frame() == 0, "a settled tree measures nothing");
+    auto [width, height] = expected_size(tree.get());
+    check(tree->width->dest() == width && tree->height->dest() == height,
+          "the tree has its expected size");
+
+    leaves[leaves.size() / 2]->width->reset_to(40);
+    auto changed = settle();
+    std::cout << "  " << changed << " measure calls after changing a leaf"
+              << std::endl;
+    check(changed <= 2 * (depth + 1),
+          "changing a leaf only measures its ancestors again");
+    std::tie(width, height) = expected_size(tree.get());
+    check(tree->width->dest() == width && tree->height->dest() == height,
+          "the tree is resized after the change");
+
+    leaves[0]->parent->add_child(std::make_shared<ui::widget>());
+    changed = settle();
+    check(changed <= 2 * (depth + 2),
+          "adding a child only measures its ancestors again");
+    check(frame() == 0, "the tree settles again");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    nvgDeleteInternal(nvg);
+}
+
+int main() {
+    test_measure_cache();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+
+// Checks that measure() honours the limits it is given and that containers
+// pass their own limits down instead of changing their children
+namespace {
+// Fills an area of 2000 square pixels, narrower when it has to
+struct wrapping_widget : public ui::widget {
+    int measure_count = 0;
+    ui::size measure(ui::update_context &ctx,
+                     const ui::constraints &limits) override {
+        measure_count++;
+        float w = std::min(200.f, limits.max_width);
+        return limits.clamp({w, std::ceil(2000 / w)});
+    }
+};
+// Sized like widgets written before measure() existed
+struct legacy_widget : public ui::widget {
+    float measure_width(ui::update_context &ctx) override { return 70; }
+    float measure_height(ui::update_context &ctx) override { return 30; }
+};
+} // namespace
+
+void test_measure_constraints() {
+    auto &rt = *(new ui::render_target{});
+    auto nvg = ui::create_null_nvg();
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+        .clip = ui::rect{0, 0, 800, 600},
+    };
+    auto frame = [&]() {
+        rt.animations->tick(ctx.delta_time);
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        rt.damage.clear();
+    };
+
+    // Fixed width column, its stretched children get its inner width
+    auto column = std::make_shared<ui::flex_widget>();
+    column->auto_size = false;
+    column->width->reset_to(120);
+    column->height->reset_to(400);
+    column->align_items = ui::flex_widget::align::stretch;
+    column->padding_left->reset_to(10);
+    column->padding_right->reset_to(10);
+    auto wrapped = std::make_shared<wrapping_widget>();
+    column->add_child(wrapped);
+    // Auto sized box in the column, passes the column's limit on
+    auto box = std::make_shared<ui::flex_widget>();
+    box->padding_left->reset_to(5);
+    box->padding_right->reset_to(5);
+    auto nested = std::make_shared<wrapping_widget>();
+    box->add_child(nested);
+    column->add_child(box);
+    auto text = std::make_shared<ui::text_widget>();
+    text->text = "some text";
+    column->add_child(text);
+    rt.root->add_child(column);
+
+    std::cout << "Measure Constraints Test Results:" << std::endl;
+
+    frame();
+    check(wrapped->_layout_limits.max_width == 100,
+          "stretched children are limited to the inner width");
+    check(wrapped->measure_count == 1,
+          "both sizes come from a single measurement");
+    check(nested->_layout_limits.max_width == 90,
+          "auto sized boxes pass their limits on");
+    check(nested->measured(ctx, nested->_layout_limits) == ui::size{90, 23},
+          "the nested child fits itself into the limits");
+    check(text->max_width == -1 &&
+              text->wrap_width(text->_layout_limits) == 100,
+          "text wraps to the limits without max_width being changed");
+
+    for (int i = 0; i < 30; i++)
+        frame();
+    check(box->width->dest() == 100 && box->height->dest() == 23,
+          "the box takes the size of its limited child");
+
+    // A container measured on its own
+    auto row = std::make_shared<ui::flex_widget>();
+    row->horizontal = true;
+    for (int i = 0; i < 3; i++) {
+        auto child = std::make_shared<ui::widget>();
+        child->width->reset_to(50);
+        child->height->reset_to(20);
+        row->add_child(child);
+    }
+    check(row->measure(ctx, {}) == ui::size{150, 20},
+          "unconstrained containers measure their content");
+    check(row->measure(ctx, {.max_width = 100, .min_height = 80}) ==
+              ui::size{100, 80},
+          "containers are clamped to the limits");
+    check(row->measure_width(ctx) == 150 && row->measure_height(ctx) == 20,
+          "measure_width and measure_height are unconstrained");
+
+    row->add_child(std::make_shared<legacy_widget>());
+    check(row->measure(ctx, {}) == ui::size{220, 30},
+          "measure_width and measure_height overrides are laid out");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    nvgDeleteInternal(nvg);
+}
+
+int main() {
+    test_measure_constraints();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/layout_pool.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <format>
+#include <functional>
+#include <iostream>
+
+// Checks that measuring fixed size panels on a layout_pool gives exactly the
+// layout of measuring everything on one thread, and leaves the update
+// nothing to measure
+namespace {
+// The same font under the name text_widget asks for
+bool load_font(NVGcontext *nvg) {
+    auto path = find_font();
+    return !path.empty() && nvgCreateFont(nvg, "main", path.c_str()) >= 0;
+}
+
+std::shared_ptr<ui::text_widget> make_text(std::string text, float size) {
+    auto t = std::make_shared<ui::text_widget>();
+    t->text = std::move(text);
+    t->font_size = size;
+    return t;
+}
+
+// Rows of fixed size panels with wrapped text, a column that sizes itself
+// and a fixed size badge nested in each
+struct dashboard {
+    std::shared_ptr<ui::flex_widget> board;
+    std::vector<ui::text_widget *> bodies;
+};
+dashboard build_dashboard() {
+    dashboard d;
+    d.board = std::make_shared<ui::flex_widget>();
+    d.board->auto_size = false;
+    d.board->width->reset_to(1200);
+    d.board->height->reset_to(800);
+    d.board->gap = 8;
+    d.board->align_items = ui::flex_widget::align::stretch;
+    for (int r = 0; r < 4; r++) {
+        auto row = std::make_shared<ui::flex_widget>();
+        row->horizontal = true;
+        row->gap = 8;
+        for (int p = 0; p < 6; p++) {
+            auto panel = std::make_shared<ui::flex_widget>();
+            panel->auto_size = false;
+            panel->width->reset_to(180 + p * 4);
+            panel->height->reset_to(160);
+            panel->padding_left->reset_to(6);
+            panel->padding_right->reset_to(6);
+            panel->padding_top->reset_to(6);
+            panel->gap = 4;
+            panel->align_items = ui::flex_widget::align::stretch;
+            panel->add_child(make_text(std::format("Panel {}-{}", r, p), 16));
+            auto body = make_text(
+                std::format("Requests served by node {} over the last {} "
+                            "minutes, grouped by status code",
+                            r * 6 + p, 5 + p),
+                12);
+            d.bodies.push_back(body.get());
+            panel->add_child(body);
+
+            auto column = std::make_shared<ui::flex_widget>();
+            column->gap = 2;
+            for (int i = 0; i < 3; i++)
+                column->add_child(make_text(std::format("{} ms", i * 37 + p),
+                                            11 + i));
+            panel->add_child(column);
+
+            auto badge = std::make_shared<ui::flex_widget>();
+            badge->auto_size = false;
+            badge->width->reset_to(60);
+            badge->height->reset_to(20);
+            badge->add_child(make_text("OK", 10));
+            panel->add_child(badge);
+            row->add_child(panel);
+        }
+        d.board->add_child(row);
+    }
+    return d;
+}
+
+// Number of widgets whose position or size differ between the trees
+size_t differences(ui::widget *a, ui::widget *b) {
+    size_t diff = a->x->dest() != b->x->dest() ||
+                  a->y->dest() != b->y->dest() ||
+                  a->width->dest() != b->width->dest() ||
+                  a->height->dest() != b->height->dest();
+    if (a->children.size() != b->children.size())
+        return diff + 1;
+    for (size_t i = 0; i < a->children.size(); i++)
+        diff += differences(a->children[i].get(), b->children[i].get());
+    return diff;
+}
+
+// A render target with its own nanovg context and update context
+struct window {
+    ui::render_target &rt = *(new ui::render_target{});
+    NVGcontext *nvg = ui::create_null_nvg();
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {1280, 900, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+        .clip = ui::rect{0, 0, 1280, 900},
+    };
+    dashboard d = build_dashboard();
+
+    window() {
+        rt.nvg = nvg;
+        rt.root = std::make_shared<ui::widget>();
+        rt.root->add_child(d.board);
+    }
+
+    // Same update steps as render_target::render, returns the measure calls
+    // of the update itself
+    size_t frame(ui::layout_pool *pool = nullptr) {
+        rt.animations->tick(ctx.delta_time);
+        if (pool)
+            pool->measure(ctx, *rt.root);
+        rt.measure_calls = 0;
+        rt.root->update(ctx);
+        rt.root->collect_damage(ctx);
+        rt.damage.clear();
+        return rt.measure_calls;
+    }
+};
+} // namespace
+
+void test_parallel_layout() {
+    std::cout << "Parallel Layout Test Results:" << std::endl;
+    window serial, parallel;
+    bool fonts = load_font(serial.nvg) && load_font(parallel.nvg);
+    if (!fonts)
+        std::cout << "  (no font found, text measures as empty)" << std::endl;
+    ui::layout_pool pool(3);
+
+    serial.frame();
+    auto update_calls = parallel.frame(&pool);
+    std::cout << "  " << pool.measured_containers
+              << " containers measured on the pool, " << update_calls
+              << " measure calls left to the update" << std::endl;
+    check(pool.measured_containers > 1,
+          "the panels are measured as separate parts");
+    check(update_calls == 0, "the update finds every size measured");
+    check(differences(serial.d.board.get(), parallel.d.board.get()) == 0,
+          "the first frame matches the serial layout");
+    if (fonts)
+        check(serial.d.bodies[0]->height->dest() >
+                  serial.d.bodies[0]->font_size * 1.5f,
+              "the panel text wraps");
+
+    size_t diff = 0;
+    for (int i = 0; i < 30; i++) {
+        serial.frame();
+        parallel.frame(&pool);
+        diff += differences(serial.d.board.get(), parallel.d.board.get());
+    }
+    check(diff == 0, "the layouts stay the same while settling");
+    check(pool.measured_containers == 0, "a settled tree measures nothing");
+
+    for (size_t i = 0; i < serial.d.bodies.size(); i += 5) {
+        for (auto w : {&serial, &parallel}) {
+            auto body = w->d.bodies[i];
+            body->text += " and by the region the requests came from";
+            body->invalidate_layout();
+        }
+    }
+    serial.frame();
+    update_calls = parallel.frame(&pool);
+    check(update_calls == 0, "changed panels are measured on the pool");
+    for (int i = 0; i < 30; i++) {
+        serial.frame();
+        parallel.frame(&pool);
+        diff += differences(serial.d.board.get(), parallel.d.board.get());
+    }
+    check(diff == 0, "the layouts match after changing text");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+}
+
+int main() {
+    test_parallel_layout();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdio>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Checks shared by the tests. Each one prints a line, main() returns
+// whether all of them held.
+inline bool test_passed = true;
+inline void check(bool condition, std::string_view what) {
+    std::cout << (condition ? "  ok: " : "  FAILED: ") << what << std::endl;
+    test_passed &= condition;
+}
+
+// The first of the fonts that exists, empty when none does. Tests that need
+// text are skipped without one.
+inline std::string
+find_font(std::initializer_list<const char *> paths = {
+              "C:/Windows/Fonts/segoeui.ttf", "C:/Windows/Fonts/arial.ttf",
+              "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+              "/usr/share/fonts/TTF/DejaVuSans.ttf",
+              "/System/Library/Fonts/Supplemental/Arial.ttf"}) {
+    for (auto path : paths) {
+        if (FILE *f = std::fopen(path, "rb")) {
+            std::fclose(f);
+            return path;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,300 @@
+#include "breeze_ui/font.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/text_document.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+// Checks the piece table of text_document against a plain string, then
+// edits a large document in a text_editor_widget, which has to lay out only
+// the lines in view and insert large pastes over several frames
+namespace {
+std::string font_path;
+
+// Line starts of text, the way text_document indexes them
+std::vector<size_t> line_starts(const std::string &text) {
+    std::vector<size_t> starts = {0};
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n')
+            starts.push_back(i + 1);
+    }
+    return starts;
+}
+
+void check_document(const ui::text_document &document,
+                    const std::string &expected, const std::string &what) {
+    check(document.size() == expected.size(), what + ": size");
+    check(document.str() == expected, what + ": text");
+    const auto starts = line_starts(expected);
+    check(document.line_count() == starts.size(), what + ": line count");
+    for (size_t i = 0; i < starts.size() && i < document.line_count(); ++i) {
+        if (document.line_start(i) != starts[i]) {
+            check(false, what + ": start of line " + std::to_string(i));
+            return;
+        }
+        auto end = i + 1 < starts.size() ? starts[i + 1] - 1 : expected.size();
+        if (document.line(i) != expected.substr(starts[i], end - starts[i])) {
+            check(false, what + ": line " + std::to_string(i));
+            return;
+        }
+    }
+    for (size_t offset = 0; offset <= expected.size(); offset += 7) {
+        auto line = static_cast<size_t>(
+            std::upper_bound(starts.begin(), starts.end(), offset) -
+            starts.begin() - 1);
+        if (document.line_of(offset) != line) {
+            check(false, what + ": line of " + std::to_string(offset));
+            return;
+        }
+    }
+}
+
+void test_document() {
+    std::mt19937 random(7);
+    const std::string pieces[] = {"a", "bc", "\n", "line\n", "\xC3\xA9",
+                                  "\xE4\xB8\xAD\xE6\x96\x87", "\n\n", "xyz"};
+    std::string expected = "first\nsecond\n\xC3\xA9t\xC3\xA9\nlast";
+    ui::text_document document(expected);
+    check_document(document, expected, "initial");
+
+    bool char_starts = true;
+    for (int round = 0; round < 2000; ++round) {
+        auto offset = random() % (expected.size() + 1);
+        // Edits start and end between characters
+        while (offset > 0 && offset < expected.size() &&
+               (static_cast<unsigned char>(expected[offset]) & 0xC0) == 0x80)
+            offset--;
+        char_starts &= document.char_start(offset) == offset;
+        if (random() % 3 || expected.empty()) {
+            const auto &text = pieces[random() % std::size(pieces)];
+            document.insert(offset, text);
+            expected.insert(offset, text);
+        } else {
+            auto end = offset;
+            for (auto n = random() % 6; n > 0 && end < expected.size(); --n)
+                end = document.next_char(end);
+            document.erase(offset, end - offset);
+            expected.erase(offset, end - offset);
+        }
+        if (round % 100 == 0) {
+            check_document(document, expected,
+                           "after edit " + std::to_string(round));
+        }
+    }
+    check(char_starts, "char start");
+    check_document(document, expected, "after edits");
+
+    std::string walked;
+    bool prev_chars = true;
+    for (size_t offset = 0; offset < document.size();) {
+        auto next = document.next_char(offset);
+        prev_chars &= document.prev_char(next) == offset;
+        walked += document.text(offset, next - offset);
+        offset = next;
+    }
+    check(prev_chars, "prev char");
+    check(walked == expected, "walking characters");
+
+    document.erase(0, document.size());
+    check(document.empty() && document.line_count() == 1 &&
+              document.line(0).empty(),
+          "emptied document");
+    document.insert(0, "one\ntwo");
+    check_document(document, "one\ntwo", "after emptying");
+}
+
+struct editor {
+    ui::headless_target target{400, 400};
+    std::shared_ptr<ui::text_editor_widget> widget;
+
+    explicit editor(std::string text) {
+        ui::register_font_family(
+            target.rt.nvg,
+            {.family_name = "main",
+             .faces = {{.weight = 400, .source = {.path = font_path}}}});
+        widget = target.rt.root->emplace_child<ui::text_editor_widget>();
+        widget->width->reset_to(300);
+        widget->height->reset_to(360);
+        widget->set_text(std::move(text));
+        // Focus needs the render target the first frame sets
+        target.frame();
+        widget->focus();
+        target.frame();
+    }
+
+    size_t caret() const { return widget->caret(); }
+    void press(int key) {
+        target.key_press(key);
+        target.frame();
+        target.key_release(key);
+        target.frame();
+    }
+    void press_with(int modifier, int key) {
+        target.key_press(modifier);
+        press(key);
+        target.key_release(modifier);
+        target.frame();
+    }
+    void type(std::u32string_view text) {
+        target.type(text);
+        target.frame();
+    }
+};
+
+void test_editor() {
+    const size_t line_count = 200000;
+    std::string text;
+    for (size_t i = 0; i < line_count; ++i)
+        text += "line " + std::to_string(i) + " of the document\n";
+    editor e(text);
+    auto &document = e.widget->document;
+    check(document.line_count() == line_count + 1, "editor line count");
+
+    auto check_view = [&](const std::string &what) {
+        auto [first, last] = e.widget->visible_lines();
+        check(last > first && last - first < 40,
+              what + ": only the lines in view are laid out");
+        auto line = document.line_of(e.caret());
+        check(line >= first && line < last, what + ": caret in view");
+    };
+    check_view("opened");
+
+    e.press_with(GLFW_KEY_LEFT_CONTROL, GLFW_KEY_END);
+    check(e.caret() == document.size(), "ctrl+end");
+    check_view("ctrl+end");
+
+    e.press(GLFW_KEY_UP);
+    e.press(GLFW_KEY_END);
+    e.type(U"!");
+    text.insert(text.size() - 1, "!");
+    check(document.str() == text, "typing at the end");
+
+    e.press(GLFW_KEY_PAGE_UP);
+    check(document.line_of(e.caret()) < line_count - 10, "page up");
+    check_view("page up");
+
+    // Down keeps the column across lines of other lengths
+    e.widget->set_selection(document.line_start(1000) + 10,
+                            document.line_start(1000) + 10);
+    e.target.frame();
+    e.press(GLFW_KEY_DOWN);
+    e.press(GLFW_KEY_DOWN);
+    check(e.caret() == document.line_start(1002) + 10, "down keeps column");
+    check_view("down");
+
+    const auto caret = e.caret();
+    e.press(GLFW_KEY_ENTER);
+    e.press(GLFW_KEY_BACKSPACE);
+    e.press(GLFW_KEY_BACKSPACE);
+    text.erase(caret - 1, 1);
+    check(document.str() == text, "enter and backspace");
+
+    const auto start = document.line_start(5), end = document.line_start(7);
+    e.widget->set_selection(start, end);
+    e.press(GLFW_KEY_DELETE);
+    text.erase(start, end - start);
+    check(document.str() == text, "deleting a selection");
+
+    // A large paste goes in over several frames, the caret following it
+    std::string paste;
+    for (int i = 0; i < 40000; ++i)
+        paste += "pasted \xE4\xB8\xAD\xE6\x96\x87 " + std::to_string(i) + "\n";
+    e.widget->paste_chunk_size = 64 * 1024;
+    const auto at = document.line_start(3);
+    e.widget->set_selection(at, at);
+    e.widget->insert_text_streamed(paste);
+    int frames = 0;
+    bool streamed = true;
+    while (e.widget->pending_insert_size() && frames < 1000) {
+        e.target.frame();
+        frames++;
+        streamed &= document.size() < text.size() + paste.size() ||
+                    !e.widget->pending_insert_size();
+    }
+    check(streamed, "paste is streamed");
+    text.insert(at, paste);
+    check(frames > 3, "paste took several frames");
+    check(document.str() == text, "streamed paste");
+    check(e.caret() == at + paste.size(), "caret after streamed paste");
+    check_view("after paste");
+}
+
+// The events of a frame apply in the order they came in, each key with its
+// own modifiers and repeats included
+void test_editor_event_order() {
+    editor e("abc");
+    auto &document = e.widget->document;
+    e.widget->set_selection(3, 3);
+    e.target.frame();
+
+    e.target.key_press(GLFW_KEY_BACKSPACE);
+    e.target.key_press(GLFW_KEY_BACKSPACE);
+    e.target.key_release(GLFW_KEY_BACKSPACE);
+    e.target.frame();
+    check(document.str() == "a", "backspace twice in a frame");
+
+    e.target.type(U"x");
+    e.target.key_press(GLFW_KEY_LEFT);
+    e.target.key_release(GLFW_KEY_LEFT);
+    e.target.type(U"y");
+    e.target.frame();
+    check(document.str() == "ayx", "typing around a key in a frame");
+
+    // Shift is up again by the end of the frame, the first Left still
+    // selects and the second one collapses the selection
+    e.target.key_press(GLFW_KEY_LEFT_SHIFT);
+    e.target.key_press(GLFW_KEY_LEFT);
+    e.target.key_release(GLFW_KEY_LEFT);
+    e.target.key_release(GLFW_KEY_LEFT_SHIFT);
+    e.target.key_press(GLFW_KEY_LEFT);
+    e.target.key_release(GLFW_KEY_LEFT);
+    e.target.frame();
+    check(e.caret() == 1 && e.widget->selection_start() == 1 &&
+              e.widget->selection_end() == 1,
+          "modifiers of each key in a frame");
+}
+
+// Keys and the text they type wait for on_key_down, as in a textbox
+void test_editor_key_down() {
+    editor e("abc");
+    auto &document = e.widget->document;
+    e.widget->set_selection(3, 3);
+    e.widget->on_key_down = [](int key, bool, bool, bool, bool) {
+        return key == GLFW_KEY_BACKSPACE || key == GLFW_KEY_A;
+    };
+    auto press_typing = [&](int key, std::u32string_view text) {
+        const auto before = document.str();
+        e.target.key_press(key);
+        e.target.type(text);
+        e.target.frame();
+        check(document.str() == before, "keys wait for on_key_down");
+        e.target.key_release(key);
+        e.target.frame();
+    };
+
+    e.press(GLFW_KEY_BACKSPACE);
+    check(document.str() == "abc", "canceled backspace");
+    press_typing(GLFW_KEY_D, U"d");
+    check(document.str() == "abcd", "text typed with an answered key");
+    press_typing(GLFW_KEY_A, U"a");
+    check(document.str() == "abcd", "text typed with a canceled key");
+}
+} // namespace
+
+int main() {
+    font_path = find_font();
+    if (font_path.empty()) {
+        std::cout << "SKIPPED: no font" << std::endl;
+        return 0;
+    }
+    test_document();
+    test_editor();
+    test_editor_event_order();
+    test_editor_key_down();
+
+    std::cout << (test_passed ? "Test PASSED" : "Test FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
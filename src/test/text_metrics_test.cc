@@ -0,0 +1,115 @@
+#include "breeze_ui/font.h"
+#include "breeze_ui/nanovg_wrapper.h"
+#include "breeze_ui/text_metrics.h"
+#include "test_utils.h"
+#include <iostream>
+#include <string>
+
+// Checks that the text metrics cache returns what nanovg measures, tells
+// text styles apart, drops the least recently used strings and is emptied
+// when fonts are registered
+namespace {
+std::string font_path;
+
+bool load_font(NVGcontext *nvg) {
+    return ui::register_font_family(
+        nvg, {.family_name = "main",
+              .faces = {{.weight = 400, .source = {.path = font_path}}}});
+}
+
+} // namespace
+
+int main() {
+    font_path = find_font();
+    if (font_path.empty()) {
+        std::cout << "No font found, skipped" << std::endl;
+        std::cout << "Test PASSED" << std::endl;
+        return 0;
+    }
+    auto nvg = nvgCreateMeasureContext();
+    bool ok = load_font(nvg);
+    if (!ok)
+        std::cout << "FAILED: font not registered" << std::endl;
+
+    ui::nanovg_context vg{nvg, nullptr};
+    vg.fontFace(ui::resolve_font_face_name(nvg, "main").c_str());
+    vg.fontSize(14);
+    vg.textAlign(NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    auto &cache = ui::text_metrics_cache::of(nvg);
+    cache.clear();
+    cache.hits = cache.misses = 0;
+
+    const char *text = "The quick brown fox jumps over the lazy dog";
+    float bounds[4];
+    nvgTextBounds(nvg, 0, 0, text, nullptr, bounds);
+    for (int i = 0; i < 2; i++) {
+        auto [w, h, y] = vg.measureTextWithYOffset(text);
+        if (w != bounds[2] - bounds[0] ||
+            h != bounds[3] - bounds[1] || y != -bounds[1]) {
+            std::cout << "FAILED: line " << i << " measured " << w << "x" << h
+                      << " at " << y << std::endl;
+            ok = false;
+        }
+    }
+    nvgTextBoxBounds(nvg, 0, 0, 80, text, nullptr, bounds);
+    for (int i = 0; i < 2; i++) {
+        auto [w, h] = vg.measureTextBox(text, 80);
+        if (w != bounds[2] - bounds[0] ||
+            h != bounds[3] - bounds[1]) {
+            std::cout << "FAILED: box " << i << " measured " << w << "x" << h
+                      << std::endl;
+            ok = false;
+        }
+    }
+    if (cache.hits != 2 || cache.misses != 2) {
+        std::cout << "FAILED: " << cache.hits << " hits, " << cache.misses
+                  << " misses after measuring twice" << std::endl;
+        ok = false;
+    }
+
+    // Another size and another alignment are other entries
+    auto [w14, h14] = vg.measureText(text);
+    vg.fontSize(28);
+    auto [w28, h28] = vg.measureText(text);
+    vg.textAlign(NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
+    auto [w, h, y] = vg.measureTextWithYOffset(text);
+    nvgTextBounds(nvg, 0, 0, text, nullptr, bounds);
+    if (!(w28 > w14 * 1.5f) || w != w28 ||
+        y != (bounds[3] - bounds[1]) / 2 - bounds[3] || cache.misses != 4) {
+        std::cout << "FAILED: style changes gave " << w28 << " after " << w14
+                  << " with " << cache.misses << " misses" << std::endl;
+        ok = false;
+    }
+
+    // The first strings are dropped once capacity more are measured
+    cache.clear();
+    vg.measureText("first");
+    for (size_t i = 0; i < ui::text_metrics_cache::capacity; i++)
+        vg.measureText(std::to_string(i).c_str());
+    auto misses = cache.misses;
+    vg.measureText(std::to_string(ui::text_metrics_cache::capacity - 1).c_str());
+    vg.measureText("first");
+    if (cache.size() != ui::text_metrics_cache::capacity ||
+        cache.misses != misses + 1) {
+        std::cout << "FAILED: " << cache.size() << " entries, "
+                  << cache.misses - misses << " misses after eviction"
+                  << std::endl;
+        ok = false;
+    }
+
+    // Registering fonts again can change what the faces measure
+    load_font(nvg);
+    misses = cache.misses;
+    vg.measureText("first");
+    if (cache.misses != misses + 1 || cache.size() != 1) {
+        std::cout << "FAILED: cache kept " << cache.size()
+                  << " entries after registering fonts" << std::endl;
+        ok = false;
+    }
+
+    ui::clear_font_registry(nvg);
+    nvgDeleteInternal(nvg);
+
+    std::cout << (ok ? "Test PASSED" : "Test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#include "breeze_ui/font.h"
+#include "breeze_ui/headless.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Edits a wrapped multiline textbox, whose layout is only laid out again
+// where the text changed, and checks that moving the caret with keys and
+// clicks lands where it does in a textbox laid out from scratch
+namespace {
+std::string font_path;
+
+struct editor {
+    ui::headless_target target{400, 400};
+    std::shared_ptr<ui::textbox_widget> textbox;
+
+    explicit editor(const std::string &text) {
+        ui::register_font_family(
+            target.rt.nvg,
+            {.family_name = "main",
+             .faces = {{.weight = 400, .source = {.path = font_path}}}});
+        textbox = target.rt.root->emplace_child<ui::textbox_widget>();
+        textbox->multiline = true;
+        textbox->width->reset_to(220);
+        textbox->height->reset_to(360);
+        textbox->text = text;
+        // Focus needs the render target the first frame sets
+        target.frame();
+        textbox->focus();
+        target.frame();
+    }
+
+    int caret() const { return textbox->selection_end(); }
+    void place(int index) {
+        textbox->set_selection(index, index);
+        target.frame();
+    }
+    void press(int key) {
+        target.key_press(key);
+        target.frame();
+        target.key_release(key);
+        target.frame();
+    }
+    void type(std::u32string_view text) {
+        target.type(text);
+        target.frame();
+    }
+    void click(double x, double y) {
+        target.mouse_x = x;
+        target.mouse_y = y;
+        target.mouse_down = true;
+        target.frame();
+        target.mouse_down = false;
+        target.frame();
+    }
+};
+
+// Caret moves in the edited textbox against one that lays the same text out
+// from scratch. Registering fonts would lay out both from scratch, so the
+// other textbox is given the text and laid out at another width first.
+void compare(editor &edited, editor &fresh, const char *what) {
+    fresh.textbox->text = edited.textbox->text;
+    fresh.textbox->width->reset_to(221);
+    fresh.target.frame();
+    fresh.textbox->width->reset_to(220);
+    fresh.target.frame();
+    const int chars = static_cast<int>(
+        std::u32string(edited.textbox->text.begin(),
+                       edited.textbox->text.end())
+            .size());
+    int mismatches = 0;
+    for (int index = 0; index <= chars; index += 3) {
+        for (int key : {GLFW_KEY_DOWN, GLFW_KEY_UP, GLFW_KEY_END,
+                        GLFW_KEY_HOME}) {
+            edited.place(index);
+            fresh.place(index);
+            edited.press(key);
+            fresh.press(key);
+            if (edited.caret() != fresh.caret())
+                mismatches++;
+        }
+    }
+    // Inside the textbox, clicks elsewhere take the focus away
+    for (double y = 10; y < 300; y += 13) {
+        for (double x = 5; x < 215; x += 17) {
+            edited.click(x, y);
+            fresh.click(x, y);
+            if (edited.caret() != fresh.caret())
+                mismatches++;
+        }
+    }
+    std::cout << (mismatches ? "  FAILED: " : "  ok: ") << what;
+    if (mismatches)
+        std::cout << ", " << mismatches << " carets differ";
+    std::cout << std::endl;
+    test_passed &= mismatches == 0;
+}
+} // namespace
+
+int main() {
+    font_path = find_font();
+    if (font_path.empty()) {
+        std::cout << "No font found, skipped" << std::endl;
+        std::cout << "Test PASSED" << std::endl;
+        return 0;
+    }
+
+    editor edited("The first paragraph wraps over a few rows of the box.\n"
+                  "\n"
+                  "A second one, after an empty line.\n"
+                  "Short\n"
+                  "And the last paragraph, long enough to wrap as well.");
+    editor fresh("");
+    compare(edited, fresh, "laid out from scratch");
+
+    edited.place(10);
+    edited.type(U"inserted words ");
+    compare(edited, fresh, "typed into the first paragraph");
+
+    edited.press(GLFW_KEY_ENTER);
+    compare(edited, fresh, "split a paragraph");
+
+    edited.press(GLFW_KEY_BACKSPACE);
+    compare(edited, fresh, "joined the paragraphs again");
+
+    // Deleting the empty line joins the paragraphs around it
+    edited.place(70);
+    edited.press(GLFW_KEY_END);
+    edited.press(GLFW_KEY_DELETE);
+    edited.press(GLFW_KEY_DELETE);
+    compare(edited, fresh, "deleted an empty line");
+
+    edited.place(static_cast<int>(edited.textbox->text.size()));
+    edited.type(U" More text at the end\nand a new paragraph");
+    compare(edited, fresh, "appended paragraphs");
+
+    edited.place(0);
+    edited.type(U"\u00e9\u4e2d\u6587 ");
+    compare(edited, fresh, "typed multibyte characters first");
+
+    edited.textbox->select_all();
+    edited.type(U"replaced");
+    compare(edited, fresh, "replaced everything");
+
+    std::cout << (test_passed ? "Test PASSED" : "Test FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
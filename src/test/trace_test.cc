@@ -0,0 +1,95 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/trace.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Checks that trace zones of frames end up in the Chrome trace, and only
+// while tracing is enabled
+namespace {
+size_t count(const std::string &haystack, const std::string &needle) {
+    size_t n = 0;
+    for (auto i = haystack.find(needle); i != std::string::npos;
+         i = haystack.find(needle, i + 1))
+        n++;
+    return n;
+}
+
+std::string trace() {
+    std::ostringstream out;
+    ui::tracing().write_chrome_trace(out);
+    return out.str();
+}
+
+// Needs a size, a widget without one has nothing to repaint
+struct traced_widget : public ui::widget {
+    traced_widget() {
+        width->reset_to(10);
+        height->reset_to(10);
+    }
+};
+} // namespace
+
+int main() {
+    std::cout << "Trace Test Results:" << std::endl;
+    auto &tracing = ui::tracing();
+    ui::headless_target target(400, 300);
+    target.rt.root->emplace_child<traced_widget>();
+
+    target.frame();
+    check(count(trace(), "\"ph\":\"X\"") == 0,
+          "nothing is recorded while tracing is off");
+
+    tracing.enable();
+    target.rt.root->children[0]->needs_repaint = true;
+    target.frame();
+    auto json = trace();
+    check(json.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["),
+          "the trace is a Chrome trace");
+    for (auto phase : {"frame", "hit test", "animations", "update", "damage",
+                       "render", "endFrame"}) {
+        check(count(json, std::string("\"name\":\"") + phase + "\"") == 1,
+              phase);
+    }
+    check(count(json, "traced_widget") == 0,
+          "widget zones are off by default");
+
+    tracing.clear();
+    tracing.enable(true);
+    target.rt.root->children[0]->needs_repaint = true;
+    target.frame();
+    json = trace();
+    check(count(json, "traced_widget") == 2,
+          "widget zones are named after the widget type");
+    check(count(json, "\"cat\":\"widget\"") == 2, "in their own category");
+
+    tracing.clear();
+    tracing.enable();
+    std::thread([&] {
+        tracing.name_thread("worker");
+        ui::trace_zone zone("on a worker");
+    }).join();
+    json = trace();
+    check(count(json, "\"on a worker\"") == 1 &&
+              count(json, "\"args\":{\"name\":\"worker\"}") == 1,
+          "zones of other threads show up under their name");
+
+    tracing.clear();
+    for (size_t i = 0; i < ui::trace_buffer::capacity + 10; i++)
+        ui::trace_zone zone(i < 10 ? "old" : "new");
+    json = trace();
+    check(count(json, "\"old\"") == 0 &&
+              count(json, "\"new\"") == ui::trace_buffer::capacity,
+          "the ring buffer keeps the latest events");
+
+    tracing.clear();
+    tracing.disable();
+    target.frame();
+    check(count(trace(), "\"ph\":\"X\"") == 0, "disabling stops recording");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+#include "breeze_ui/headless.h"
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include "test_utils.h"
+#include <iostream>
+
+// Checks that a virtual list only keeps the visible items alive and lays
+// them out at their measured heights
+namespace {
+size_t created_items = 0, recycled_items = 0;
+struct item_widget : public ui::widget {
+    size_t index;
+    bool drawn = false;
+    item_widget(size_t index) : index(index) { created_items++; }
+    void render(ui::nanovg_context ctx) override {
+        drawn = true;
+        widget::render(ctx);
+    }
+    void update(ui::update_context &ctx) override {
+        widget::update(ctx);
+        // Heights are only known once the item is laid out
+        height->reset_to(20 + (index % 3) * 10);
+    }
+};
+} // namespace
+
+void test_virtual_list() {
+    auto &rt = *(new ui::render_target{});
+    auto nvg = ui::create_null_nvg();
+    rt.nvg = nvg;
+    rt.root = std::make_shared<ui::widget>();
+
+    auto list = std::make_shared<ui::virtual_list_widget>();
+    list->width->reset_to(300);
+    list->max_height = 400;
+    list->item_count = 100000;
+    list->create_item = [](size_t index) {
+        return std::make_shared<item_widget>(index);
+    };
+    list->recycle_item = [](ui::widget &w, size_t index) {
+        static_cast<item_widget &>(w).index = index;
+        recycled_items++;
+    };
+    rt.root->add_child(list);
+
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.67f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {nvg, &rt},
+    };
+
+    // Same steps as render_target::render, without the GL parts
+    auto frames = [&](int count) {
+        for (int i = 0; i < count; i++) {
+            rt.animations->tick(ctx.delta_time);
+            rt.root->update(ctx);
+            rt.root->collect_damage(ctx);
+            rt.damage.clear();
+        }
+    };
+    auto laid_out = [&]() {
+        float y = list->item_offset(list->first_live_item());
+        for (auto &child : list->children) {
+            auto item = static_cast<item_widget *>(child.get());
+            if (item->y->dest() != y ||
+                item->index != list->first_live_item() +
+                                   (&child - list->children.data()) ||
+                item->width->dest() != 300 ||
+                item->_layout_limits.max_width != 300)
+                return false;
+            y += item->height->dest();
+        }
+        return true;
+    };
+    auto is_live = [&](size_t index) {
+        return index >= list->first_live_item() &&
+               index < list->first_live_item() + list->children.size();
+    };
+
+    std::cout << "Virtual List Test Results:" << std::endl;
+
+    frames(1);
+    check(list->height->dest() == 400, "list is limited to max_height");
+    check(list->children.size() <= 400 / 20 + 1 + list->overscan,
+          "only the visible items are created");
+    check(created_items == list->children.size(),
+          "nothing was created twice");
+
+    frames(1);
+    check(laid_out(), "items are placed at their measured heights");
+    // Heights are 20, 30 and 40 in turn
+    check(std::abs(list->content_height() - 100000 * 30.f) < 100000 * 1.f,
+          "estimate follows the measured average");
+
+    list->scroll_to_item(50000);
+    frames(30);
+    check(is_live(50000), "scrolled item is alive");
+    check(list->item_offset(50000) + *list->scroll_top <= 1 &&
+              list->item_offset(50000) + *list->scroll_top >= -1,
+          "scrolled item is at the top");
+    check(laid_out(), "items are placed after scrolling");
+    check(list->children.size() <= 400 / 20 + 1 + 2 * list->overscan,
+          "items in between were released");
+    auto created_before = created_items;
+    auto recycled_before = recycled_items;
+
+    list->scroll_to_item(50100);
+    frames(30);
+    check(is_live(50100), "scrolling further keeps up");
+    check(created_items == created_before && recycled_items > recycled_before,
+          "items are recycled instead of created");
+
+    list->item_count = 50;
+    frames(3);
+    check(std::abs(list->content_height() - 1490) < 50,
+          "shrinking the list shrinks the content");
+    check(is_live(49) && list->children.size() <= 50 &&
+              *list->scroll_top == 400 - list->actual_height,
+          "scroll position is clamped to the new end");
+    check(laid_out(), "items are placed after shrinking");
+
+    // Overscan items above the view are alive but outside of the list,
+    // which is moved down so they would be on screen
+    list->enable_scrolling = false;
+    list->y->reset_to(150);
+    frames(1);
+    for (auto &child : list->children)
+        static_cast<item_widget *>(child.get())->drawn = false;
+    ui::nanovg_context vg{nvg, &rt};
+    vg.beginFrame(800, 600, 1);
+    vg.scissor(0, 0, 800, 600);
+    rt.root->render(vg);
+    vg.endFrame();
+    bool drawn_inside = true, overscan_alive = false;
+    for (auto &child : list->children) {
+        auto item = static_cast<item_widget *>(child.get());
+        auto top = *item->y + *list->scroll_top;
+        bool inside = top + *item->height > 0 && top < 400;
+        overscan_alive |= !inside;
+        drawn_inside &= item->drawn == inside;
+    }
+    check(overscan_alive && drawn_inside,
+          "only items inside the list are drawn");
+
+    // Items that can't be created are asked for again by the next frame
+    list->invalidate_items();
+    list->recycle_item = nullptr;
+    list->create_item = nullptr;
+    frames(1);
+    bool none_created = list->children.empty();
+    size_t missing = 45;
+    list->create_item = [&](size_t index) -> std::shared_ptr<ui::widget> {
+        if (index == missing)
+            return nullptr;
+        return std::make_shared<item_widget>(index);
+    };
+    frames(1);
+    bool stop_at_missing =
+        !list->children.empty() &&
+        list->first_live_item() + list->children.size() == missing;
+    missing = SIZE_MAX;
+    frames(2);
+    check(none_created && stop_at_missing && is_live(49) && laid_out(),
+          "missing items are created on the next frame");
+
+    std::cout << "\nTest " << (test_passed ? "PASSED" : "FAILED") << std::endl;
+    nvgDeleteInternal(nvg);
+}
+
+int main() {
+    test_virtual_list();
+    return test_passed ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "breeze_ui/ui.h"
+#include "breeze_ui/widget.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Builds, walks and tears down 50k-node trees allocated from the heap and
+// from a widget_arena.
+//
+// Traversal cache behaviour is shown through the time of walking the tree;
+// run under `perf stat -e cache-misses` (or VTune) to get the miss counts of
+// each phase.
+namespace {
+constexpr int group_count = 500;
+constexpr int leaves_per_group = 100;
+
+using bench_clock = std::chrono::steady_clock;
+double ms_since(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() -
+                                                     start)
+        .count();
+}
+
+void build(ui::widget &root) {
+    for (int g = 0; g < group_count; g++) {
+        auto group = root.emplace_child<ui::widget>();
+        group->y->reset_to(g * 20);
+        for (int l = 0; l < leaves_per_group; l++) {
+            auto leaf = group->emplace_child<ui::widget>();
+            leaf->x->reset_to(l * 4);
+            leaf->width->reset_to(4);
+            leaf->height->reset_to(20);
+        }
+    }
+}
+
+// A long running process has a fragmented heap, fresh allocations land in
+// the holes left by earlier ones instead of next to each other
+std::vector<std::unique_ptr<char[]>> fragment_heap() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> size(16, 512);
+    std::vector<std::unique_ptr<char[]>> blocks(400000);
+    for (auto &block : blocks)
+        block = std::make_unique<char[]>(size(rng));
+    std::shuffle(blocks.begin(), blocks.end(), rng);
+    blocks.resize(blocks.size() / 2);
+    return blocks;
+}
+
+float walk(const ui::widget &w) {
+    float sum = **w.x + **w.y + **w.width + **w.height;
+    for (auto &child : w.children)
+        sum += walk(*child);
+    return sum;
+}
+
+void run(const char *name, std::shared_ptr<ui::widget_arena> arena) {
+    ui::render_target rt{};
+    bool need_repaint = false;
+    ui::update_context ctx{
+        .delta_time = 16.f,
+        .mouse_x = -1,
+        .mouse_y = -1,
+        .mouse_down = false,
+        .right_mouse_down = false,
+        .window = nullptr,
+        .mouse_clicked = false,
+        .right_mouse_clicked = false,
+        .mouse_up = false,
+        .screen = {800, 600, 1.0f},
+        .scroll_y = 0,
+        .need_repaint = need_repaint,
+        .offset_x = 0,
+        .offset_y = 0,
+        .rt = rt,
+        .vg = {},
+    };
+
+    auto start = bench_clock::now();
+    auto root =
+        arena ? arena->make<ui::widget>() : std::make_shared<ui::widget>();
+    build(*root);
+    auto build_ms = ms_since(start);
+
+    root->update(ctx);
+    start = bench_clock::now();
+    constexpr int update_rounds = 20;
+    for (int i = 0; i < update_rounds; i++) {
+        rt.animations->tick(ctx.delta_time);
+        root->update(ctx);
+    }
+    auto update_ms = ms_since(start) / update_rounds;
+
+    start = bench_clock::now();
+    constexpr int walk_rounds = 50;
+    float checksum = 0;
+    for (int i = 0; i < walk_rounds; i++)
+        checksum += walk(*root);
+    auto walk_ms = ms_since(start) / walk_rounds;
+
+    start = bench_clock::now();
+    root = nullptr;
+    auto teardown_ms = ms_since(start);
+
+    std::cout << name << ": build " << build_ms << " ms, update " << update_ms
+              << " ms, walk " << walk_ms << " ms, teardown " << teardown_ms
+              << " ms (checksum " << checksum << ")" << std::endl;
+}
+} // namespace
+
+int main() {
+    std::cout << "Widget arena benchmark, "
+              << group_count * (leaves_per_group + 1) << " widgets"
+              << std::endl;
+    auto fragments = fragment_heap();
+    for (int i = 0; i < 3; i++) {
+        run("heap ", nullptr);
+        run("arena", std::make_shared<ui::widget_arena>());
+    }
+    return 0;
+}
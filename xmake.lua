@@ -37,8 +37,13 @@ target("breeze_ui")
     add_deps("breeze-nanovg", "breeze-nanosvg", {
         public = true
     })
-    add_syslinks("dwmapi", "imm32", "shcore", "windowsapp", "CoreMessaging")
-    add_files("src/breeze_ui/*.cc")
+    if is_plat("windows") then
+        add_syslinks("dwmapi", "imm32", "shcore", "windowsapp", "CoreMessaging")
+        add_files("src/breeze_ui/*.cc|ui_headless.cc")
+    else
+        -- No window or acrylic, the widgets run on headless_target
+        add_files("src/breeze_ui/*.cc|ui.cc|acrylic_host.cc|hbitmap_utils.cc")
+    end
     add_headerfiles("src/(breeze_ui/*.h)")
     add_includedirs("src/", {
         public = true
@@ -52,6 +57,138 @@ target("flex_grow_test")
     add_files("src/test/flex_grow_test.cc")
     add_includedirs("src/")
 
+target("damage_region_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/damage_region_test.cc")
+    add_includedirs("src/")
+
+target("animation_scheduler_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/animation_scheduler_test.cc")
+    add_includedirs("src/")
+
+target("widget_arena_bench")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/widget_arena_bench.cc")
+    add_includedirs("src/")
+
+target("flex_layout_bench")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/flex_layout_bench.cc")
+    add_includedirs("src/")
+
+target("breeze_bench")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/breeze_bench.cc")
+    add_includedirs("src/")
+
+target("hit_test_index_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/hit_test_index_test.cc")
+    add_includedirs("src/")
+
+target("virtual_list_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/virtual_list_test.cc")
+    add_includedirs("src/")
+
+target("culling_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/culling_test.cc")
+    add_includedirs("src/")
+
+target("layer_cache_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/layer_cache_test.cc")
+    add_includedirs("src/")
+
+target("measure_cache_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/measure_cache_test.cc")
+    add_includedirs("src/")
+
+target("measure_constraints_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/measure_constraints_test.cc")
+    add_includedirs("src/")
+
+target("parallel_layout_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/parallel_layout_test.cc")
+    add_includedirs("src/")
+
+target("draw_list_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/draw_list_test.cc")
+    add_includedirs("src/")
+
+target("display_list_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/display_list_test.cc")
+    add_includedirs("src/")
+
+target("headless_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/headless_test.cc")
+    add_includedirs("src/")
+
+target("trace_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/trace_test.cc")
+    add_includedirs("src/")
+
+target("frame_stats_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/frame_stats_test.cc")
+    add_includedirs("src/")
+
+target("text_metrics_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/text_metrics_test.cc")
+    add_includedirs("src/")
+
+target("glyph_run_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/glyph_run_test.cc")
+    add_includedirs("src/")
+
+target("font_face_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/font_face_test.cc")
+    add_includedirs("src/")
+
+target("textbox_layout_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/textbox_layout_test.cc")
+    add_includedirs("src/")
+
+target("text_editor_test")
+    set_kind("binary")
+    add_deps("breeze_ui")
+    add_files("src/test/text_editor_test.cc")
+    add_includedirs("src/")
+
 target("text_bounds_test")
     set_kind("binary")
     add_deps("breeze_ui")